@@ -0,0 +1,223 @@
+/**
+ * @file bitvec.h
+ * @brief Definition and functions for a packed bit vector.
+ * @note Bits are packed 64 to a word, bit `i` is bit `i % 64` of word
+ * `i / 64`, and the bits past the size in the last word are kept at 0.
+ * @note Counting uses AVX2 or the popcnt instruction when the CPU supports
+ * them and a portable loop otherwise.
+ */
+
+#ifndef BITVEC_H
+#define BITVEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "iterator.h"
+
+/**
+ * @brief Opaque type of a bit vector.
+ */
+typedef struct bitvec BitVec;
+
+/**
+ * @struct BitVecArgs
+ * @brief Optional args for creating a bit vector.
+ */
+typedef struct {
+    /** The initial capacity in bits */
+    size_t cap;
+
+    /** The allocator used for the words and the rank index */
+    Allocator alloc;
+} BitVecArgs;
+
+/**
+ * @brief Creates a new empty bit vector.
+ * @param bitvec_args Optional args, see `BitVecArgs` for more info.
+ * @return The created bit vector.
+ * @note `bitvec_args` defaults to `(BitVecArgs) { .cap = 0, .alloc = allocator_new() }`
+ */
+#define bitvec_new(...)                                                        \
+    internal_bitvec_new(                                                       \
+        (BitVecArgs) { .cap = 0, .alloc = allocator_new(), __VA_ARGS__ }       \
+    )
+
+/**
+ * @brief Counts the set bits of an array of words.
+ * @param words The array.
+ * @param size The number of words in the array.
+ * @return The number of set bits.
+ */
+size_t mem_popcount(const uint64_t *words, size_t size);
+
+/**
+ * @brief Appends a bit to the bit vector.
+ * @param bitvec The bit vector.
+ * @param value The bit.
+ */
+void bitvec_push_back(BitVec *bitvec, bool value);
+
+/**
+ * @brief Sets a bit to 1.
+ * @param bitvec The bit vector.
+ * @param index The index of the bit.
+ */
+void bitvec_set(BitVec *bitvec, size_t index);
+
+/**
+ * @brief Sets a bit to 0.
+ * @param bitvec The bit vector.
+ * @param index The index of the bit.
+ */
+void bitvec_clear(BitVec *bitvec, size_t index);
+
+/**
+ * @brief Returns a bit.
+ * @param bitvec The bit vector.
+ * @param index The index of the bit.
+ * @return Whether the bit is set.
+ */
+bool bitvec_test(const BitVec *bitvec, size_t index);
+
+/**
+ * @brief Changes the number of bits of the bit vector.
+ * @param bitvec The bit vector.
+ * @param size The new number of bits.
+ * @param value The value of the bits added past the old size.
+ */
+void bitvec_resize(BitVec *bitvec, size_t size, bool value);
+
+/**
+ * @brief Sets all the bits to the same value.
+ * @param bitvec The bit vector.
+ * @param value The value.
+ */
+void bitvec_fill(BitVec *bitvec, bool value);
+
+/**
+ * @brief Computes `dst &= src` a word at a time.
+ * @param dst The bit vector to update.
+ * @param src A bit vector of the same size.
+ */
+void bitvec_and(BitVec *dst, const BitVec *src);
+
+/**
+ * @brief Computes `dst |= src` a word at a time.
+ * @param dst The bit vector to update.
+ * @param src A bit vector of the same size.
+ */
+void bitvec_or(BitVec *dst, const BitVec *src);
+
+/**
+ * @brief Computes `dst ^= src` a word at a time.
+ * @param dst The bit vector to update.
+ * @param src A bit vector of the same size.
+ */
+void bitvec_xor(BitVec *dst, const BitVec *src);
+
+/**
+ * @brief Computes `dst &= ~src` a word at a time.
+ * @param dst The bit vector to update.
+ * @param src A bit vector of the same size.
+ */
+void bitvec_andnot(BitVec *dst, const BitVec *src);
+
+/**
+ * @brief Counts the set bits of the bit vector.
+ * @param bitvec The bit vector.
+ * @return The number of set bits.
+ */
+size_t bitvec_count(const BitVec *bitvec);
+
+/**
+ * @brief Counts the set bits before an index.
+ * @param bitvec The bit vector.
+ * @param index The index, at most the size of the bit vector.
+ * @return The number of set bits in `[0, index)`.
+ * @note Rank and select share an index of the counts before every 512
+ * bits, about 3% of the size of the bit vector. It is built by the first
+ * call after a modification, then both run in constant and logarithmic
+ * time, so they suit bit vectors that are mostly read.
+ */
+size_t bitvec_rank(BitVec *bitvec, size_t index);
+
+/**
+ * @brief Finds a set bit by its rank.
+ * @param bitvec The bit vector.
+ * @param rank The number of set bits before the bit to find.
+ * @return The index of the bit, the size of the bit vector if there are
+ * not more than `rank` set bits.
+ * @note See `bitvec_rank` for the index the search uses.
+ */
+size_t bitvec_select(BitVec *bitvec, size_t rank);
+
+/**
+ * @brief Returns the number of bits of the bit vector.
+ * @param bitvec The bit vector.
+ * @return The number of bits.
+ */
+size_t bitvec_size(const BitVec *bitvec);
+
+/**
+ * @brief Returns the capacity of the bit vector.
+ * @param bitvec The bit vector.
+ * @return The number of bits the bit vector can hold without growing.
+ */
+size_t bitvec_capacity(const BitVec *bitvec);
+
+/**
+ * @brief Returns the words of the bit vector.
+ * @param bitvec The bit vector.
+ * @return The words, invalidated when the bit vector grows.
+ */
+const uint64_t *bitvec_words(const BitVec *bitvec);
+
+/**
+ * @brief Frees the bit vector.
+ * @param bitvec The bit vector.
+ */
+void bitvec_free(BitVec *bitvec);
+
+/**
+ * @struct BitVecOnes
+ * @brief State of an iterator over the set bits of a bit vector.
+ */
+typedef struct {
+    /** The bit vector */
+    const BitVec *bitvec;
+
+    /** The bits of the current word not yielded yet */
+    uint64_t word;
+
+    /** The index of the current word */
+    size_t word_index;
+
+    /** The index of the last yielded bit */
+    size_t position;
+} BitVecOnes;
+
+/**
+ * @brief Returns an iterator over the indices of the set bits.
+ * @param ones The state of the iterator.
+ * @param bitvec The bit vector, it must not be modified while iterating.
+ * @return The iterator, yielding pointers to `size_t` indices in
+ * ascending order.
+ * @note Zero words are skipped whole and each set bit is found with a
+ * count of trailing zeros.
+ */
+Iterator bitvec_ones_iter(BitVecOnes *ones, const BitVec *bitvec);
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new bit vector.
+ * @param args The capacity and allocator of the bit vector.
+ * @return The new bit vector.
+ */
+BitVec *internal_bitvec_new(BitVecArgs args);
+
+
+#endif // BITVEC_H
@@ -0,0 +1,181 @@
+/**
+ * @file concvec.h
+ * @brief Definition and functions for a lock-free vector that supports
+ * appending from many threads at once.
+ */
+
+#ifndef CONCVEC_H
+#define CONCVEC_H
+
+#include <stddef.h>
+
+#include "allocator.h"
+#include "iterator.h"
+
+/**
+ * @brief The maximum number of segments of a concurrent vector.
+ */
+#define CONCVEC_MAX_SEGMENTS 64
+
+/**
+ * @brief Macro to define a concurrent vector type with the specified
+ * element type.
+ * @param elem_type The type of the elements in the concurrent vector.
+ * @return The defined concurrent vector type.
+ * @note Like `SegVec`, elements live in geometrically growing segments and
+ * never move. Writers reserve slots with an atomic fetch-add and publish
+ * each slot once it is written, readers only ever see the committed prefix
+ * (the longest run of published slots starting at index 0).
+ * @note ```ConcVec(int) cvec = cvec_new(int);```
+ */
+#define ConcVec(elem_type) elem_type **
+
+/**
+ * @brief Creates a new concurrent vector with the specified element type.
+ * @param elem_type The type of the elements in the concurrent vector.
+ * @param cvec_args Optional args, see `ConcVecArgs` for more info.
+ * @return The created concurrent vector.
+ * @note `cvec_args` defaults to
+ * `(ConcVecArgs) { .cap = 0, .alloc = allocator_new() }`
+ * @note The allocator must be safe to call from multiple threads.
+ */
+#define cvec_new(elem_type, ...)                                               \
+    internal_cvec_new(                                                         \
+        sizeof(elem_type),                                                     \
+        (ConcVecArgs) { .cap = 0, .alloc = allocator_new(), __VA_ARGS__ }      \
+    )
+
+/**
+ * @brief Returns a pointer to a committed element.
+ * @param cvec The concurrent vector.
+ * @param index The index of the element, must be < `cvec_size(cvec)`.
+ * @return A pointer to the element.
+ */
+#define cvec_get(cvec, index)                                                  \
+    ((typeof(*cvec)) internal_cvec_get(cvec, index))
+
+/**
+ * @brief Appends an element to the back of the concurrent vector.
+ * @param cvec The concurrent vector.
+ * @param elem The element to append.
+ * @return The index of the appended element.
+ * @note Safe to call from multiple threads at once.
+ * @note elem is shallow copied.
+ */
+#define cvec_push_back(cvec, elem) ({                                          \
+    typeof(**cvec) _e = elem;                                                  \
+    internal_cvec_push_many(cvec, &_e, 1);                                     \
+})
+
+/**
+ * @brief Appends the elements of an array to the back of the concurrent
+ * vector, the elements are given contiguous indices.
+ * @param cvec The concurrent vector.
+ * @param array The array to append.
+ * @param size The number of elements in the array.
+ * @return The index of the first appended element.
+ * @note Safe to call from multiple threads at once.
+ * @note array elements are shallow copied.
+ */
+#define cvec_push_many(cvec, array, size) ({                                   \
+    typeof(*cvec) _a = array;                                                  \
+    internal_cvec_push_many(cvec, _a, size);                                   \
+})
+
+/**
+ * @brief Returns the number of committed elements of the concurrent vector.
+ * @param cvec The concurrent vector.
+ * @return The size of the committed prefix.
+ * @note Safe to call from multiple threads at once. Elements that are
+ * reserved but not yet published, and every element after them, are not
+ * counted.
+ */
+size_t cvec_size(const void *cvec);
+
+/**
+ * @brief Returns the number of slots reserved by writers so far.
+ * @param cvec The concurrent vector.
+ * @return The number of reserved slots, it is >= `cvec_size(cvec)`.
+ */
+size_t cvec_reserved(const void *cvec);
+
+/**
+ * @brief Allocates segments up front so that at least the specified number
+ * of elements can be appended without allocating.
+ * @param cvec The concurrent vector.
+ * @param new_capacity The capacity to reserve.
+ * @note Safe to call from multiple threads at once.
+ */
+void cvec_reserve(void *cvec, size_t new_capacity);
+
+/**
+ * @brief Clears the concurrent vector, removing all elements.
+ * @param cvec The concurrent vector to clear.
+ * @note Must not be called while other threads use the concurrent vector.
+ */
+void cvec_clear(void *cvec);
+
+/**
+ * @brief Frees the memory used by the concurrent vector.
+ * @param cvec The concurrent vector to free.
+ * @note Must not be called while other threads use the concurrent vector.
+ */
+void cvec_free(void *cvec);
+
+/**
+ * @brief Creates an iterator over the committed prefix of the concurrent
+ * vector.
+ * @param cvec The concurrent vector.
+ * @return An iterator for the concurrent vector.
+ * @note Elements committed while iterating are also visited.
+ */
+Iterator cvec_iter(void *cvec);
+
+/*----------------------------- Argument Struct -----------------------------*/
+
+/**
+ * @brief Represents optional arguments for configuring a concurrent vector.
+ * @note Examples of how to use this struct:
+ * @note `ConcVec(int) cvec = cvec_new(int);`
+ * @note `ConcVec(int) cvec = cvec_new(int, .cap = 4096);`
+ */
+typedef struct {
+    /**
+     * The size of the first segment, rounded up to a power of 2.
+     * Defaults to 64 when 0.
+     */
+    size_t cap;
+
+    /** The allocator for memory allocation */
+    Allocator alloc;
+} ConcVecArgs;
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new concurrent vector.
+ * @param elem_size The size of an element of the concurrent vector.
+ * @param args The first segment size and allocator.
+ * @return The new concurrent vector.
+ */
+void *internal_cvec_new(size_t elem_size, ConcVecArgs args);
+
+/**
+ * @brief Internal function to get a pointer to a committed element.
+ * @param cvec The concurrent vector.
+ * @param index The index of the element.
+ * @return A pointer to the element.
+ */
+void *internal_cvec_get(const void *cvec, size_t index);
+
+/**
+ * @brief Internal function to append elements to the concurrent vector.
+ * @param cvec The concurrent vector.
+ * @param array A pointer to the elements to append.
+ * @param size The number of elements to append.
+ * @return The index of the first appended element.
+ */
+size_t internal_cvec_push_many(void *cvec, const void *array, size_t size);
+
+
+#endif // CONCVEC_H
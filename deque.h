@@ -0,0 +1,218 @@
+/**
+ * @file deque.h
+ * @brief Definition and functions for a double ended queue backed by a
+ * growable ring buffer.
+ */
+
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include <stddef.h>
+
+#include "allocator.h"
+#include "iterator.h"
+
+/**
+ * @brief Macro to define a deque type with the specified element type.
+ * @param elem_type The type of the elements in the deque.
+ * @return The defined deque type.
+ * @note Unlike `Vec`, elements must be accessed with `deque_get` since the
+ * ring buffer wraps around.
+ * @note ```Deque(int) deque = deque_new(int);```
+ */
+#define Deque(elem_type) elem_type *
+
+/**
+ * @brief Creates a new deque with the specified element type.
+ * @param elem_type The type of the elements in the deque.
+ * @param deque_args Optional args, see `DequeArgs` for more info.
+ * @return The created deque.
+ * @note `deque_args` defaults to `(DequeArgs) { .cap = 0, .alloc = allocator_new() }`
+ * @note The capacity is rounded up to a power of 2.
+ */
+#define deque_new(elem_type, ...)                                              \
+    internal_deque_new(                                                        \
+        sizeof(elem_type),                                                     \
+        (DequeArgs) { .cap = 0, .alloc = allocator_new(), __VA_ARGS__ }        \
+    )
+
+/**
+ * @brief Returns a pointer to the element at the specified index.
+ * @param deque The deque.
+ * @param index The index of the element, counted from the front.
+ * @return A pointer to the element.
+ */
+#define deque_get(deque, index)                                                \
+    ((typeof(deque)) internal_deque_get(deque, index))
+
+/**
+ * @brief Appends an element to the back of the deque.
+ * @param deque The deque.
+ * @param elem The element to append.
+ * @note elem is shallow copied.
+ */
+#define deque_push_back(deque, elem)                                           \
+    do {                                                                       \
+        typeof(*deque) _e = elem;                                              \
+        deque = internal_deque_push_back(deque, &_e);                          \
+    } while(0)
+
+/**
+ * @brief Prepends an element to the front of the deque.
+ * @param deque The deque.
+ * @param elem The element to prepend.
+ * @note elem is shallow copied.
+ */
+#define deque_push_front(deque, elem)                                          \
+    do {                                                                       \
+        typeof(*deque) _e = elem;                                              \
+        deque = internal_deque_push_front(deque, &_e);                         \
+    } while(0)
+
+/**
+ * @brief Removes the last element from the deque.
+ * @param deque The deque.
+ * @param elem A pointer to store the popped element.
+ * @note Supply NULL for `elem` if you don't care about the popped value.
+ */
+void deque_pop_back(void *deque, void *elem);
+
+/**
+ * @brief Removes the first element from the deque.
+ * @param deque The deque.
+ * @param elem A pointer to store the popped element.
+ * @note Supply NULL for `elem` if you don't care about the popped value.
+ */
+void deque_pop_front(void *deque, void *elem);
+
+/**
+ * @brief Returns the number of elements in the deque.
+ * @param deque The deque.
+ * @return The size of the deque.
+ */
+size_t deque_size(const void *deque);
+
+/**
+ * @brief Returns the capacity of the deque.
+ * @param deque The deque.
+ * @return The capacity of the deque.
+ */
+size_t deque_capacity(const void *deque);
+
+/**
+ * @brief Checks if the deque is empty.
+ * @param deque The deque.
+ * @return `true` if the deque is empty, `false` otherwise.
+ */
+bool deque_is_empty(const void *deque);
+
+/**
+ * @brief Clears the deque, removing all elements.
+ * @param deque The deque to clear.
+ * @note The capacity of deque remains the same (i.e. free is not called).
+ */
+void deque_clear(void *deque);
+
+/**
+ * @brief Frees the memory used by the deque.
+ * @param deque The deque to free.
+ */
+void deque_free(void *deque);
+
+/**
+ * @brief Reserves capacity for the deque, ensuring it can hold at least
+ * the specified number of elements.
+ * @param deque The deque.
+ * @param new_capacity The new capacity to reserve.
+ * @return A pointer to the deque with the reserved capacity.
+ */
+void *deque_reserve(void *deque, size_t new_capacity);
+
+/**
+ * @brief Represents a contiguous run of elements in a deque.
+ */
+typedef struct {
+    /** A pointer to the first element of the span */
+    void *data;
+
+    /** The number of elements in the span */
+    size_t size;
+} DequeSpan;
+
+/**
+ * @brief Returns the elements of the deque as at most two contiguous spans.
+ * @param deque The deque.
+ * @param spans The spans, `spans[0]` holds the front of the deque and
+ * `spans[1]` holds the elements that wrapped around.
+ * @note `spans[1].size` is 0 when the elements do not wrap around.
+ */
+void deque_spans(const void *deque, DequeSpan spans[2]);
+
+/**
+ * @brief Creates an iterator for the deque, from front to back.
+ * @param deque The deque.
+ * @return An iterator for the deque.
+ */
+Iterator deque_iter(void *deque);
+
+/**
+ * @brief Returns the elements remaining in a deque iterator as at most two
+ * contiguous spans, without moving the iterator.
+ * @param iterator An iterator created by `deque_iter`.
+ * @param spans The spans, see `deque_spans`.
+ */
+void deque_iter_spans(const Iterator *iterator, DequeSpan spans[2]);
+
+/*----------------------------- Argument Struct -----------------------------*/
+
+/**
+ * @brief Represents optional arguments for configuring a deque.
+ * @note Examples of how to use this struct:
+ * @note `Deque(int) deque = deque_new(int);`
+ * @note `Deque(int) deque = deque_new(int, .cap = 16);`
+ * @note `Deque(int) deque = deque_new(int, .alloc = allocator_new());`
+ */
+typedef struct {
+    /** The capacity of the deque */
+    size_t cap;
+
+    /** The allocator for memory allocation */
+    Allocator alloc;
+} DequeArgs;
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new deque.
+ * @param elem_size The size of an element of the deque.
+ * @param args The capacity and allocator for the deque.
+ * @return The new deque.
+ */
+void *internal_deque_new(size_t elem_size, DequeArgs args);
+
+/**
+ * @brief Internal function to get a pointer to the element at an index.
+ * @param deque The deque.
+ * @param index The index of the element, counted from the front.
+ * @return A pointer to the element.
+ */
+void *internal_deque_get(const void *deque, size_t index);
+
+/**
+ * @brief Internal function to push an element to the back of the deque.
+ * @param deque The deque.
+ * @param elem A pointer to the element to push.
+ * @return The deque with the pushed element.
+ */
+void *internal_deque_push_back(void *deque, const void *elem);
+
+/**
+ * @brief Internal function to push an element to the front of the deque.
+ * @param deque The deque.
+ * @param elem A pointer to the element to push.
+ * @return The deque with the pushed element.
+ */
+void *internal_deque_push_front(void *deque, const void *elem);
+
+
+#endif // DEQUE_H
@@ -0,0 +1,126 @@
+/**
+ * @file ext_sort.h
+ * @brief Functions for sorting more elements than fit in memory.
+ * @note The input is read in runs of a fixed number of elements, each run
+ * is sorted in memory with `view_sort` and spilled to an unlinked
+ * temporary file. The runs are then merged by a loser tree
+ * (`merge_k_iter`), reading each one through a small buffer. The last run
+ * is never spilled, so an input that fits in a single run never touches
+ * the disk.
+ */
+
+#ifndef EXT_SORT_H
+#define EXT_SORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "allocator.h"
+#include "base.h"
+#include "iterator.h"
+
+/**
+ * @brief Opaque type of an external sort.
+ */
+typedef struct ext_sort ExtSort;
+
+/**
+ * @struct ExtSortArgs
+ * @brief Optional args for an external sort.
+ */
+typedef struct {
+    /** The number of elements sorted in memory at once */
+    size_t run_size;
+
+    /** The size in bytes of the read buffer of each run while merging and
+     * of the write buffer of `ext_sort_write_fd` */
+    size_t buffer_size;
+
+    /** The directory of the temporary file, NULL for `$TMPDIR` or `/tmp` */
+    const char *tmp_dir;
+
+    /** The allocator used for the runs and buffers */
+    Allocator alloc;
+} ExtSortArgs;
+
+/**
+ * @brief Sorts the elements of an iterator, spilling them to disk.
+ * @param iterator Pointer to the iterator, it is consumed.
+ * @param elem_type The type of the elements.
+ * @param compare The comparison function used to order the elements.
+ * @param ext_sort_args Optional args, see `ExtSortArgs` for more info.
+ * @return The sort, its result is read with `ext_sort_iter` or
+ * `ext_sort_write_fd`.
+ * @note `ext_sort_args` defaults to
+ * `(ExtSortArgs) { .run_size = 1 << 20, .buffer_size = 1 << 16,
+ * .tmp_dir = NULL, .alloc = allocator_new() }`
+ * @note Memory use is about `run_size` elements plus one buffer per run.
+ * The sort is not stable.
+ */
+#define ext_sort_new(iterator, elem_type, compare, ...)                        \
+    internal_ext_sort_new(                                                     \
+        iterator,                                                              \
+        sizeof(elem_type),                                                     \
+        compare,                                                               \
+        (ExtSortArgs) {                                                        \
+            .run_size = 1 << 20,                                               \
+            .buffer_size = 1 << 16,                                            \
+            .tmp_dir = NULL,                                                   \
+            .alloc = allocator_new(),                                          \
+            __VA_ARGS__                                                        \
+        }                                                                      \
+    )
+
+/**
+ * @brief Returns an iterator over the sorted elements.
+ * @param sort The sort.
+ * @return The iterator.
+ * @note The result can be read once, either through this iterator or with
+ * `ext_sort_write_fd`. An element is valid until the next one is taken.
+ */
+Iterator ext_sort_iter(ExtSort *sort);
+
+/**
+ * @brief Writes the sorted elements to a file, through a buffer of
+ * `buffer_size` bytes.
+ * @param sort The sort.
+ * @param fd The file descriptor.
+ * @return true on success, false on error, see `ext_sort_error`.
+ */
+bool ext_sort_write_fd(ExtSort *sort, int fd);
+
+/**
+ * @brief Returns the first I/O error of the sort.
+ * @param sort The sort.
+ * @return The `errno` of the error, 0 if there was none.
+ * @note An error while spilling stops reading the input and leaves the
+ * result empty, an error while merging ends the result early.
+ */
+int ext_sort_error(const ExtSort *sort);
+
+/**
+ * @brief Frees the sort and closes its temporary file.
+ * @param sort The sort.
+ */
+void ext_sort_free(ExtSort *sort);
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to sort the elements of an iterator, spilling
+ * them to disk.
+ * @param iterator Pointer to the iterator.
+ * @param elem_size The size of an element.
+ * @param compare The comparison function used to order the elements.
+ * @param args Args, see `ExtSortArgs` for more info.
+ * @return The sort.
+ */
+ExtSort *internal_ext_sort_new(
+    Iterator *iterator,
+    size_t elem_size,
+    compare_fn compare,
+    ExtSortArgs args
+);
+
+
+#endif // EXT_SORT_H
@@ -0,0 +1,187 @@
+/**
+ * @file indexed_heap.h
+ * @brief Definition and functions for an indexed priority queue.
+ */
+
+#ifndef INDEXED_HEAP_H
+#define INDEXED_HEAP_H
+
+#include <stddef.h>
+
+#include "allocator.h"
+#include "base.h"
+
+/**
+ * @brief Macro to define an indexed heap type with the specified priority type.
+ * @param elem_type The type of the priorities in the indexed heap.
+ * @return The defined indexed heap type.
+ * @note An indexed heap maps keys in the range `[0, capacity)` to priorities,
+ * the priority of a key can be read with `iheap[key]` while it is in the heap
+ * and after it has been popped.
+ * @note ```IndexedHeap(double) dist = iheap_new(double, compare);```
+ */
+#define IndexedHeap(elem_type) elem_type *
+
+/**
+ * @brief Creates a new indexed heap with the specified priority type.
+ * @param elem_type The type of the priorities in the indexed heap.
+ * @param compare The comparison function used to order the priorities.
+ * @param iheap_args Optional args, see `IndexedHeapArgs` for more info.
+ * @return The created indexed heap.
+ * @note `iheap_args` defaults to
+ * `(IndexedHeapArgs) { .cap = 0, .arity = 2, .alloc = allocator_new() }`
+ * @note The heap is a min heap with respect to `compare`.
+ */
+#define iheap_new(elem_type, compare, ...)                                     \
+    internal_iheap_new(                                                        \
+        sizeof(elem_type),                                                     \
+        compare,                                                               \
+        (IndexedHeapArgs) {                                                    \
+            .cap = 0, .arity = 2, .alloc = allocator_new(), __VA_ARGS__        \
+        }                                                                      \
+    )
+
+/**
+ * @brief Pushes a key with the given priority onto the indexed heap.
+ * @param iheap The indexed heap.
+ * @param key The key to push, must not already be in the heap.
+ * @param priority The priority of the key.
+ * @note The capacity grows to fit `key` if needed, so keys should be dense.
+ * @note priority is shallow copied.
+ */
+#define iheap_push(iheap, key, priority)                                       \
+    do {                                                                       \
+        typeof(*iheap) _p = priority;                                          \
+        iheap = internal_iheap_push(iheap, key, &_p);                          \
+    } while(0)
+
+/**
+ * @brief Lowers the priority of a key that is in the indexed heap.
+ * @param iheap The indexed heap.
+ * @param key The key whose priority is lowered.
+ * @param priority The new priority, must not be greater than the current one.
+ * @note priority is shallow copied.
+ */
+#define iheap_decrease_key(iheap, key, priority)                               \
+    do {                                                                       \
+        typeof(*iheap) _p = priority;                                          \
+        internal_iheap_decrease_key(iheap, key, &_p);                          \
+    } while(0)
+
+/**
+ * @brief Removes the key with the smallest priority from the indexed heap.
+ * @param iheap The indexed heap, must not be empty.
+ * @return The removed key.
+ * @note The priority of the removed key remains readable as `iheap[key]`
+ * until the key is pushed again.
+ */
+size_t iheap_pop(void *iheap);
+
+/**
+ * @brief Returns the key with the smallest priority without removing it.
+ * @param iheap The indexed heap, must not be empty.
+ * @return The key with the smallest priority.
+ */
+size_t iheap_top(const void *iheap);
+
+/**
+ * @brief Removes a key from the indexed heap.
+ * @param iheap The indexed heap.
+ * @param key The key to remove, must be in the heap.
+ */
+void iheap_remove(void *iheap, size_t key);
+
+/**
+ * @brief Checks if a key is in the indexed heap.
+ * @param iheap The indexed heap.
+ * @param key The key to check.
+ * @return `true` if the key is in the heap, `false` otherwise.
+ */
+bool iheap_contains(const void *iheap, size_t key);
+
+/**
+ * @brief Returns the number of keys in the indexed heap.
+ * @param iheap The indexed heap.
+ * @return The size of the indexed heap.
+ */
+size_t iheap_size(const void *iheap);
+
+/**
+ * @brief Returns the number of keys the indexed heap can hold without
+ * reallocating.
+ * @param iheap The indexed heap.
+ * @return The capacity of the indexed heap.
+ */
+size_t iheap_capacity(const void *iheap);
+
+/**
+ * @brief Checks if the indexed heap is empty.
+ * @param iheap The indexed heap.
+ * @return `true` if the indexed heap is empty, `false` otherwise.
+ */
+bool iheap_is_empty(const void *iheap);
+
+/**
+ * @brief Clears the indexed heap, removing all keys.
+ * @param iheap The indexed heap.
+ * @note The capacity of the indexed heap remains the same.
+ */
+void iheap_clear(void *iheap);
+
+/**
+ * @brief Frees the memory used by the indexed heap.
+ * @param iheap The indexed heap to free.
+ */
+void iheap_free(void *iheap);
+
+/*----------------------------- Argument Struct -----------------------------*/
+
+/**
+ * @brief Represents optional arguments for configuring an indexed heap.
+ * @note Examples of how to use this struct:
+ * @note `IndexedHeap(int) iheap = iheap_new(int, compare);`
+ * @note `IndexedHeap(int) iheap = iheap_new(int, compare, .cap = 1024);`
+ * @note `IndexedHeap(int) iheap = iheap_new(int, compare, .arity = 4);`
+ */
+typedef struct {
+    /** The number of keys the indexed heap can hold */
+    size_t cap;
+
+    /** The number of children of each node, must be >= 2 */
+    size_t arity;
+
+    /** The allocator for memory allocation */
+    Allocator alloc;
+} IndexedHeapArgs;
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new indexed heap.
+ * @param elem_size The size of a priority.
+ * @param compare The comparison function used to order the priorities.
+ * @param args The capacity, arity and allocator for the indexed heap.
+ * @return The new indexed heap.
+ */
+void *internal_iheap_new(size_t elem_size, compare_fn compare,
+                         IndexedHeapArgs args);
+
+/**
+ * @brief Internal function to push a key onto the indexed heap.
+ * @param iheap The indexed heap.
+ * @param key The key to push.
+ * @param priority A pointer to the priority of the key.
+ * @return The indexed heap with the pushed key.
+ */
+void *internal_iheap_push(void *iheap, size_t key, const void *priority);
+
+/**
+ * @brief Internal function to lower the priority of a key.
+ * @param iheap The indexed heap.
+ * @param key The key whose priority is lowered.
+ * @param priority A pointer to the new priority of the key.
+ */
+void internal_iheap_decrease_key(void *iheap, size_t key, const void *priority);
+
+
+#endif // INDEXED_HEAP_H
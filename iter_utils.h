@@ -1,6 +1,7 @@
 #ifndef ITER_UTILS_H
 #define ITER_UTILS_H
 
+#include "allocator.h"
 #include "iterator.h"
 
 bool iter_all(Iterator *iterator, pred_fn predicate);
@@ -29,12 +30,14 @@ void iter_reduce(Iterator *iterator, void (*func)(void *, void *),
 #define for_each(type, variable, iterator, body)                               \
     do {                                                                       \
         Iterator _it = iterator;                                               \
+        Chunk _ch = iter_take_chunk(&_it);                                     \
         for (                                                                  \
-            Option option = iter_next(_it);                                    \
-            option.is_valid;                                                   \
-            option = iter_next(_it)                                            \
+            size_t _i = 0;                                                     \
+            _i < _ch.size                                                      \
+                || (_ch = iter_take_chunk(&_it), _i = 0, _ch.size > 0);        \
+            _i++                                                               \
         ) {                                                                    \
-            type variable = option_unwrap(option, type);                       \
+            type variable = ((type *) _ch.data)[_i];                           \
             body                                                               \
         }                                                                      \
     } while(0)
@@ -58,18 +61,238 @@ void iter_reduce(Iterator *iterator, void (*func)(void *, void *),
 typedef struct {
     Iterator *iterator;
     map_fn unary_op;
+    size_t front;
+    size_t mapped_front;
 } Map;
 
 Iterator map_iter(Map *map, Iterator *iterator, map_fn unary_op);
 
 /*------------------------------- IterFilter --------------------------------*/
 
+// The run of matches found by next_chunk is kept until it is taken, with
+// the number of rejected elements after it, so the predicate is called
+// once per element.
 typedef struct {
     Iterator *iterator;
     pred_fn predicate;
+    Chunk run;
+    size_t rejected;
 } Filter;
 
 Iterator filter_iter(Filter *filter, Iterator *iterator, pred_fn predicate);
 
+/*--------------------------------- IterRev ---------------------------------*/
+
+typedef struct {
+    Iterator *iterator;
+} Rev;
+
+Iterator rev_iter(Rev *rev, Iterator *iterator);
+
+/*--------------------------------- IterZip ---------------------------------*/
+
+typedef struct {
+    void *first;
+    void *second;
+} Pair;
+
+typedef struct {
+    Iterator *iterator1;
+    Iterator *iterator2;
+    Pair pair;
+} Zip;
+
+Iterator zip_iter(Zip *zip, Iterator *iterator1, Iterator *iterator2);
+
+/*-------------------------------- IterChain --------------------------------*/
+
+typedef struct {
+    Iterator *iterator1;
+    Iterator *iterator2;
+} Chain;
+
+Iterator chain_iter(Chain *chain, Iterator *iterator1, Iterator *iterator2);
+
+/*------------------------------ IterEnumerate ------------------------------*/
+
+typedef struct {
+    size_t index;
+    void *value;
+} Enumerated;
+
+typedef struct {
+    Iterator *iterator;
+    size_t index;
+    Enumerated enumerated;
+} Enumerate;
+
+Iterator enumerate_iter(Enumerate *enumerate, Iterator *iterator);
+
+/*--------------------------------- IterTake --------------------------------*/
+
+typedef struct {
+    Iterator *iterator;
+    size_t n;
+} Take;
+
+Iterator take_iter(Take *take, Iterator *iterator, size_t n);
+
+/*--------------------------------- IterSkip --------------------------------*/
+
+typedef struct {
+    Iterator *iterator;
+    size_t n;
+} Skip;
+
+Iterator skip_iter(Skip *skip, Iterator *iterator, size_t n);
+
+/*-------------------------------- IterStepBy -------------------------------*/
+
+typedef struct {
+    Iterator *iterator;
+    size_t step;
+} StepBy;
+
+Iterator step_by_iter(StepBy *step_by, Iterator *iterator, size_t step);
+
+/*-------------------------------- IterChunks -------------------------------*/
+
+// Chunks point into a block of the iterator when it holds them whole,
+// otherwise elements are copied to the caller's buffer of size elements.
+typedef struct {
+    Iterator *iterator;
+    size_t elem_size;
+    size_t size;
+    Chunk chunk;
+    char *buffer;
+} Chunks;
+
+Iterator chunks_iter(Chunks *chunks, Iterator *iterator, void *buffer, size_t elem_size, size_t size);
+
+/*------------------------------- IterWindows -------------------------------*/
+
+// Windows point into a block of the iterator while it holds them whole.
+// After that, the last elements are kept in the caller's buffer of 2 * size
+// elements, as a ring written twice so each window is contiguous.
+typedef struct {
+    Iterator *iterator;
+    size_t elem_size;
+    size_t size;
+    Chunk window;
+    bool buffering;
+    size_t head;
+    char *buffer;
+} Windows;
+
+Iterator windows_iter(
+    Windows *windows,
+    Iterator *iterator,
+    void *buffer,
+    size_t elem_size,
+    size_t size
+);
+
+/*-------------------------------- IterMergeK -------------------------------*/
+
+// Loser tree merge of k sorted iterators, ties go to the lower index. An
+// element is valid until the next one is taken, deduplication compares
+// against a copy of it. The merge is freed with merge_k_free.
+typedef struct {
+    Iterator *iterators;
+    size_t k;
+    size_t elem_size;
+    compare_fn compare;
+    bool dedup;
+    bool started;
+    size_t yielded;
+    bool has_last;
+    void *last;
+    void **heads;
+    size_t *tree;
+    Allocator alloc;
+} MergeK;
+
+Iterator merge_k_iter(
+    MergeK *merge,
+    Iterator *iterators,
+    size_t k,
+    size_t elem_size,
+    compare_fn compare,
+    Allocator alloc
+);
+
+Iterator merge_k_dedup_iter(
+    MergeK *merge,
+    Iterator *iterators,
+    size_t k,
+    size_t elem_size,
+    compare_fn compare,
+    Allocator alloc
+);
+
+void merge_k_free(MergeK *merge);
+
+/*--------------------------------- IterPipe --------------------------------*/
+
+// Fuses MAP(expr), FILTER(expr) and a final REDUCE(acc_type, acc, init, expr)
+// or FOR_EACH(body) into one loop over a span (anything with data and size,
+// e.g. View, Chunk or DequeSpan). Stage expressions refer to the element as
+// `variable`, MAP replaces its value. The pipeline evaluates to acc.
+// int sum = ITER_PIPE(int, x, vec_view(vec), MAP(x * x), FILTER(x > 9),
+//                     REDUCE(int, acc, 0, acc + x));
+#define ITER_PIPE(type, variable, span, ...)                                   \
+    ({                                                                         \
+        typeof(span) _ps = span;                                               \
+        ITER_PIPE_EACH(INIT, __VA_ARGS__)                                      \
+        for (size_t _pi = 0; _pi < _ps.size; _pi++) {                          \
+            type variable = ((type *) _ps.data)[_pi];                          \
+            type *_pe = &variable;                                             \
+            (void) _pe;                                                        \
+            ITER_PIPE_EACH(BODY, __VA_ARGS__)                                  \
+        }                                                                      \
+        ITER_PIPE_EACH(RESULT, __VA_ARGS__)                                    \
+    })
+
+#define ITER_PIPE_INIT_MAP(...)
+#define ITER_PIPE_BODY_MAP(...) *_pe = (__VA_ARGS__);
+#define ITER_PIPE_RESULT_MAP(...)
+
+#define ITER_PIPE_INIT_FILTER(...)
+#define ITER_PIPE_BODY_FILTER(...) if (!(__VA_ARGS__)) { continue; }
+#define ITER_PIPE_RESULT_FILTER(...)
+
+#define ITER_PIPE_INIT_REDUCE(type, acc, init, ...) type acc = (init);
+#define ITER_PIPE_BODY_REDUCE(type, acc, init, ...) acc = (__VA_ARGS__);
+#define ITER_PIPE_RESULT_REDUCE(type, acc, init, ...) acc;
+
+#define ITER_PIPE_INIT_FOR_EACH(...)
+#define ITER_PIPE_BODY_FOR_EACH(...) __VA_ARGS__
+#define ITER_PIPE_RESULT_FOR_EACH(...)
+
+// Expand ITER_PIPE_<phase>_<stage> for each of up to 8 stages.
+#define ITER_PIPE_EACH(phase, ...)                                             \
+    ITER_PIPE_CAT(ITER_PIPE_EACH_, ITER_PIPE_COUNT(__VA_ARGS__))(phase, __VA_ARGS__)
+#define ITER_PIPE_COUNT(...)                                                   \
+    ITER_PIPE_COUNT_I(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define ITER_PIPE_COUNT_I(_1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define ITER_PIPE_CAT(a, b) ITER_PIPE_CAT_I(a, b)
+#define ITER_PIPE_CAT_I(a, b) a##b
+
+#define ITER_PIPE_EACH_1(phase, stage) ITER_PIPE_##phase##_##stage
+#define ITER_PIPE_EACH_2(phase, stage, ...)                                    \
+    ITER_PIPE_##phase##_##stage ITER_PIPE_EACH_1(phase, __VA_ARGS__)
+#define ITER_PIPE_EACH_3(phase, stage, ...)                                    \
+    ITER_PIPE_##phase##_##stage ITER_PIPE_EACH_2(phase, __VA_ARGS__)
+#define ITER_PIPE_EACH_4(phase, stage, ...)                                    \
+    ITER_PIPE_##phase##_##stage ITER_PIPE_EACH_3(phase, __VA_ARGS__)
+#define ITER_PIPE_EACH_5(phase, stage, ...)                                    \
+    ITER_PIPE_##phase##_##stage ITER_PIPE_EACH_4(phase, __VA_ARGS__)
+#define ITER_PIPE_EACH_6(phase, stage, ...)                                    \
+    ITER_PIPE_##phase##_##stage ITER_PIPE_EACH_5(phase, __VA_ARGS__)
+#define ITER_PIPE_EACH_7(phase, stage, ...)                                    \
+    ITER_PIPE_##phase##_##stage ITER_PIPE_EACH_6(phase, __VA_ARGS__)
+#define ITER_PIPE_EACH_8(phase, stage, ...)                                    \
+    ITER_PIPE_##phase##_##stage ITER_PIPE_EACH_7(phase, __VA_ARGS__)
+
 
 #endif // ITER_UTILS_H
@@ -2,15 +2,54 @@
 #define ITERATOR_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "option.h"
 
+// A contiguous block of elements, elem_size is 0 for blocks of 1 element
+// made from next.
+typedef struct {
+    void *data;
+    size_t size;
+    size_t elem_size;
+} Chunk;
+
+// Bounds on the number of elements left in an iterator, upper is SIZE_MAX
+// when there is no known bound.
+typedef struct {
+    size_t lower;
+    size_t upper;
+} SizeHint;
+
+// Capabilities of an iterator, ITER_DOUBLE_ENDED iterators have next_back
+// and ITER_RANDOM_ACCESS iterators have get.
+typedef enum {
+    ITER_DOUBLE_ENDED = 1 << 0,
+    ITER_RANDOM_ACCESS = 1 << 1
+} IterFlags;
+
+// size_hint must not move the iterator. next_back takes elements from the
+// back, back counts how many were taken. get returns the element at an
+// index counted from the front without moving the iterator. next_chunk is
+// optional (NULL when unsupported). It returns the next
+// contiguous block of elements without moving the iterator, the caller
+// moves past the elements it used with advance. take_chunk is optional
+// too, it returns the next block and moves past it, for iterators such as
+// maps that must not touch elements before they are taken.
 typedef struct iterator {
     void *container;
     void *current;
+    size_t index;
+    size_t back;
+    unsigned flags;
     Option (*next)(struct iterator *iterator);
     Option (*advance)(struct iterator *iterator, size_t n);
     size_t (*size)(struct iterator *iterator);
+    Chunk (*next_chunk)(struct iterator *iterator);
+    SizeHint (*size_hint)(struct iterator *iterator);
+    Option (*next_back)(struct iterator *iterator);
+    Option (*get)(struct iterator *iterator, size_t index);
+    Chunk (*take_chunk)(struct iterator *iterator);
 } Iterator;
 
 Iterator iter_default(
@@ -19,6 +58,17 @@ Iterator iter_default(
     Option (*next)(Iterator *iterator)
 );
 
+Chunk iter_take_chunk(Iterator *iterator);
+
+SizeHint size_hint_exact(size_t size);
+
+SizeHint size_hint_min(SizeHint hint1, SizeHint hint2);
+
+bool size_hint_is_exact(SizeHint hint);
+
+
+#define CHUNK_GET(chunk, index)                            \
+    ((void *) ((size_t) (chunk).data + ((index) * (chunk).elem_size)))
 
 #define iter_next(iterator)                                \
     ((iterator).next(&(iterator)))
@@ -29,10 +79,23 @@ Iterator iter_default(
 #define iter_size(iterator)                                \
     ((iterator).size(&(iterator)))
 
-#define iter_get(iterator, index) (                        \
-    iter_advance(&(iterator), index);                      \
-    iter_next(&(iterator));                                \
-)
+#define iter_size_hint(iterator)                           \
+    ((iterator).size_hint(&(iterator)))
+
+#define iter_next_chunk(iterator)                          \
+    ((iterator).next_chunk(&(iterator)))
+
+#define iter_has_chunks(iterator)                          \
+    ((iterator).next_chunk != NULL)
+
+#define iter_next_back(iterator)                           \
+    ((iterator).next_back(&(iterator)))
+
+#define iter_get(iterator, index)                          \
+    ((iterator).get(&(iterator), index))
+
+#define iter_has_flags(iterator, iter_flags)               \
+    (((iterator).flags & (iter_flags)) == (iter_flags))
 
 
 #endif // ITERATOR_H
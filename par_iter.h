@@ -0,0 +1,190 @@
+/**
+ * @file par_iter.h
+ * @brief Functions for running per element work of an iterator on many
+ * threads.
+ * @note The blocks an iterator yields through `next_chunk` (the whole
+ * remaining range for vector and view iterators) are split into ranges
+ * that run as tasks of a thread pool. Iterators without chunks run
+ * on the calling thread, since their elements may live in storage shared
+ * by the whole iterator.
+ */
+
+#ifndef PAR_ITER_H
+#define PAR_ITER_H
+
+#include <stddef.h>
+
+#include "allocator.h"
+#include "iterator.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Blocks with fewer elements than this per thread are processed by
+ * fewer threads, down to the calling thread alone.
+ */
+#define PAR_MIN_RANGE 1024
+
+/**
+ * @struct ParArgs
+ * @brief Optional args for the parallel functions.
+ */
+typedef struct {
+    /** The maximum number of ranges a block is split into, 0 for one per
+     * worker of the pool plus one for the calling thread */
+    size_t nthreads;
+
+    /** The pool running the ranges, NULL for `thread_pool_global()` */
+    ThreadPool *pool;
+
+    /** Allocator for the per call scratch memory and returned vectors */
+    Allocator alloc;
+} ParArgs;
+
+/**
+ * @brief Calls a function on every element of an iterator, using many
+ * threads.
+ * @param iterator Pointer to the iterator, it is consumed.
+ * @param func The function, called as `func(element, context)`.
+ * @param context The context passed to every call of `func`.
+ * @param par_args Optional args, see `ParArgs` for more info.
+ * @note `par_args` defaults to
+ * `(ParArgs) { .nthreads = 0, .pool = NULL, .alloc = allocator_new() }`
+ * @note `func` is called concurrently, so it must synchronize its own
+ * accesses to `context`.
+ */
+#define par_for_each(iterator, func, context, ...)                             \
+    internal_par_for_each(                                                     \
+        iterator,                                                              \
+        func,                                                                  \
+        context,                                                               \
+        (ParArgs) {                                                            \
+            .nthreads = 0, .pool = NULL, .alloc = allocator_new(), __VA_ARGS__ \
+        }                                                                      \
+    )
+
+/**
+ * @brief Maps every element of an iterator in place, using many threads.
+ * @param iterator Pointer to the iterator, it is consumed.
+ * @param unary_op The function that maps an element in place.
+ * @param par_args Optional args, see `ParArgs` for more info.
+ * @note `par_args` defaults to
+ * `(ParArgs) { .nthreads = 0, .pool = NULL, .alloc = allocator_new() }`
+ * @note The elements are written through the iterator, so a vector that
+ * may share its elements with a clone must be unshared with
+ * `vec_make_unique` before its iterator is made.
+ */
+#define par_map(iterator, unary_op, ...)                                       \
+    internal_par_map(                                                          \
+        iterator,                                                              \
+        unary_op,                                                              \
+        (ParArgs) {                                                            \
+            .nthreads = 0, .pool = NULL, .alloc = allocator_new(), __VA_ARGS__ \
+        }                                                                      \
+    )
+
+/**
+ * @brief Reduces the elements of an iterator, using many threads.
+ * @param iterator Pointer to the iterator, it is consumed.
+ * @param func The function that folds an element into an accumulator,
+ * called as `func(accumulator, element)`.
+ * @param combine The function that folds an accumulator into another,
+ * called as `combine(accumulator, other)`.
+ * @param init Typed pointer to the accumulator, it receives the result.
+ * @param par_args Optional args, see `ParArgs` for more info.
+ * @note `par_args` defaults to
+ * `(ParArgs) { .nthreads = 0, .pool = NULL, .alloc = allocator_new() }`
+ * @note Every thread starts from a copy of `*init`, so it must be an
+ * identity of `combine` (like 0 for a sum). The partial results are
+ * combined in element order, so `combine` only needs to be associative.
+ */
+#define par_reduce(iterator, func, combine, init, ...)                         \
+    internal_par_reduce(                                                       \
+        iterator,                                                              \
+        func,                                                                  \
+        combine,                                                               \
+        init,                                                                  \
+        sizeof(*(init)),                                                       \
+        (ParArgs) {                                                            \
+            .nthreads = 0, .pool = NULL, .alloc = allocator_new(), __VA_ARGS__ \
+        }                                                                      \
+    )
+
+/**
+ * @brief Creates a new vector holding the elements of a vector that
+ * satisfy a predicate, using many threads.
+ * @param vector The vector to filter.
+ * @param predicate The predicate.
+ * @param par_args Optional args, see `ParArgs` for more info.
+ * @return The new vector, the elements keep their order.
+ * @note `par_args` defaults to
+ * `(ParArgs) { .nthreads = 0, .pool = NULL, .alloc = allocator_new() }`
+ * @note The predicate is called once per element. The first pass records
+ * the matches of each range in a bitmap and counts them, the counts give
+ * the offset of each range in the output, which is allocated once. The
+ * second pass copies the matches without any locking.
+ */
+#define vec_par_filter(vector, predicate, ...)                                 \
+    ((typeof(vector)) internal_vec_par_filter(                                 \
+        vector,                                                                \
+        predicate,                                                             \
+        (ParArgs) {                                                            \
+            .nthreads = 0, .pool = NULL, .alloc = allocator_new(), __VA_ARGS__ \
+        }                                                                      \
+    ))
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to call a function on every element of an
+ * iterator, using many threads.
+ * @param iterator Pointer to the iterator.
+ * @param func The function, called as `func(element, context)`.
+ * @param context The context passed to every call of `func`.
+ * @param args Args, see `ParArgs` for more info.
+ */
+void internal_par_for_each(
+    Iterator *iterator,
+    void (*func)(void *value, void *context),
+    void *context,
+    ParArgs args
+);
+
+/**
+ * @brief Internal function to map every element of an iterator in place,
+ * using many threads.
+ * @param iterator Pointer to the iterator.
+ * @param unary_op The function that maps an element in place.
+ * @param args Args, see `ParArgs` for more info.
+ */
+void internal_par_map(Iterator *iterator, map_fn unary_op, ParArgs args);
+
+/**
+ * @brief Internal function to reduce the elements of an iterator, using
+ * many threads.
+ * @param iterator Pointer to the iterator.
+ * @param func The function that folds an element into an accumulator.
+ * @param combine The function that folds an accumulator into another.
+ * @param init Pointer to the accumulator, it receives the result.
+ * @param acc_size The size of the accumulator.
+ * @param args Args, see `ParArgs` for more info.
+ */
+void internal_par_reduce(
+    Iterator *iterator,
+    void (*func)(void *acc, void *value),
+    void (*combine)(void *acc, void *other),
+    void *init,
+    size_t acc_size,
+    ParArgs args
+);
+
+/**
+ * @brief Internal function to filter a vector using many threads.
+ * @param vector The vector to filter.
+ * @param predicate The predicate.
+ * @param args Args, see `ParArgs` for more info.
+ * @return The new vector.
+ */
+void *internal_vec_par_filter(const void *vector, pred_fn predicate, ParArgs args);
+
+
+#endif // PAR_ITER_H
@@ -0,0 +1,107 @@
+/**
+ * @file record_reader.h
+ * @brief Definition and functions for streaming records from a file
+ * through an iterator.
+ * @note Records are read through large reusable buffers, so files larger
+ * than memory can go through the iter_* functions and adapters without
+ * being loaded first. With `.background` a thread fills one buffer while
+ * the other is being consumed.
+ */
+
+#ifndef RECORD_READER_H
+#define RECORD_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "allocator.h"
+#include "iterator.h"
+
+/**
+ * @brief Opaque type of a record reader.
+ */
+typedef struct record_reader RecordReader;
+
+/**
+ * @struct RecordReaderArgs
+ * @brief Optional args for creating a record reader.
+ */
+typedef struct {
+    /** The size of a record, 0 for records prefixed by their length in
+     * bytes as a native `uint32_t` */
+    size_t record_size;
+
+    /** The size in bytes of a buffer */
+    size_t buffer_size;
+
+    /** Whether a background thread reads the next buffer ahead */
+    bool background;
+
+    /** The allocator used for the reader and its buffers */
+    Allocator alloc;
+} RecordReaderArgs;
+
+/**
+ * @brief Creates a new record reader on a file descriptor.
+ * @param fd The file descriptor, it is read from its current offset and
+ * not closed by the reader.
+ * @param record_reader_args Optional args, see `RecordReaderArgs` for more
+ * info.
+ * @return The created record reader.
+ * @note `record_reader_args` defaults to
+ * `(RecordReaderArgs) { .record_size = 0, .buffer_size = 1 << 20,
+ * .background = false, .alloc = allocator_new() }`
+ * @note The file is advised to be read sequentially, and each buffer
+ * read asks the kernel to prefetch the next one.
+ */
+#define record_reader_new(fd, ...)                                             \
+    internal_record_reader_new(                                                \
+        fd,                                                                    \
+        (RecordReaderArgs) {                                                   \
+            .record_size = 0,                                                  \
+            .buffer_size = 1 << 20,                                            \
+            .background = false,                                               \
+            .alloc = allocator_new(),                                          \
+            __VA_ARGS__                                                        \
+        }                                                                      \
+    )
+
+/**
+ * @brief Returns an iterator over the records of a reader.
+ * @param reader The record reader.
+ * @return The iterator.
+ * @note Fixed size records are yielded as pointers to the records, and in
+ * blocks through `next_chunk`. Length prefixed records are yielded as
+ * pointers to a `Chunk` holding the bytes of the record (`elem_size` 1).
+ * @note A record is only valid until the next record is taken, a record
+ * split across buffers is put together in a separate buffer.
+ */
+Iterator record_reader_iter(RecordReader *reader);
+
+/**
+ * @brief Returns the first error of a reader.
+ * @param reader The record reader.
+ * @return The `errno` of the error, `EBADMSG` for a file ending inside a
+ * record, 0 if there was none.
+ * @note An error ends the iteration.
+ */
+int record_reader_error(const RecordReader *reader);
+
+/**
+ * @brief Stops the background thread of a reader and frees it.
+ * @param reader The record reader.
+ */
+void record_reader_free(RecordReader *reader);
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new record reader.
+ * @param fd The file descriptor.
+ * @param args Args, see `RecordReaderArgs` for more info.
+ * @return The new record reader.
+ */
+RecordReader *internal_record_reader_new(int fd, RecordReaderArgs args);
+
+
+#endif // RECORD_READER_H
@@ -0,0 +1,244 @@
+/**
+ * @file roaring.h
+ * @brief Definition and functions for a compressed bitmap of 32 bits
+ * integers, in the style of Roaring bitmaps.
+ * @note The values are split by their high 16 bits into chunks of 65536,
+ * each held by the smallest fitting container: a sorted array of the low
+ * 16 bits for at most `ROARING_ARRAY_MAX` values, a bitmap of 1024 words
+ * for more, or a list of runs for long ranges of consecutive values.
+ * Containers switch between arrays and bitmaps as values are added and
+ * removed, runs are made by `roaring_add_range` and `roaring_optimize`.
+ */
+
+#ifndef ROARING_H
+#define ROARING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "iterator.h"
+
+/**
+ * @brief The largest number of values of an array container, a bitmap
+ * container takes the same memory.
+ */
+#define ROARING_ARRAY_MAX 4096
+
+/**
+ * @brief The magic number at the start of a serialized bitmap, "ROAR".
+ */
+#define ROARING_MAGIC 0x524f4152u
+
+/**
+ * @brief Opaque type of a compressed bitmap.
+ */
+typedef struct roaring Roaring;
+
+/**
+ * @struct RoaringArgs
+ * @brief Optional args for creating a compressed bitmap.
+ */
+typedef struct {
+    /** The allocator used for the bitmap and its containers */
+    Allocator alloc;
+} RoaringArgs;
+
+/**
+ * @brief Creates a new empty compressed bitmap.
+ * @param roaring_args Optional args, see `RoaringArgs` for more info.
+ * @return The created bitmap.
+ * @note `roaring_args` defaults to `(RoaringArgs) { .alloc = allocator_new() }`
+ */
+#define roaring_new(...)                                                       \
+    internal_roaring_new((RoaringArgs) { .alloc = allocator_new(), __VA_ARGS__ })
+
+/**
+ * @brief Reads a compressed bitmap written by `roaring_serialize`.
+ * @param data The serialized bitmap.
+ * @param size The size of the serialized bitmap in bytes.
+ * @param roaring_args Optional args, see `RoaringArgs` for more info.
+ * @return The bitmap, NULL on error with `errno` set to `EINVAL` if the
+ * data does not start with `ROARING_MAGIC` and `EBADMSG` if it is
+ * truncated or holds an invalid container.
+ * @note `roaring_args` defaults to `(RoaringArgs) { .alloc = allocator_new() }`
+ */
+#define roaring_deserialize(data, size, ...)                                   \
+    internal_roaring_deserialize(                                              \
+        data,                                                                  \
+        size,                                                                  \
+        (RoaringArgs) { .alloc = allocator_new(), __VA_ARGS__ }                \
+    )
+
+/**
+ * @brief Adds a value to the bitmap.
+ * @param roaring The bitmap.
+ * @param value The value.
+ */
+void roaring_add(Roaring *roaring, uint32_t value);
+
+/**
+ * @brief Adds a range of values to the bitmap.
+ * @param roaring The bitmap.
+ * @param first The first value of the range.
+ * @param last The last value of the range, included.
+ * @note Chunks covered by the whole range become single runs.
+ */
+void roaring_add_range(Roaring *roaring, uint32_t first, uint32_t last);
+
+/**
+ * @brief Removes a value from the bitmap.
+ * @param roaring The bitmap.
+ * @param value The value.
+ * @return Whether the value was in the bitmap.
+ */
+bool roaring_remove(Roaring *roaring, uint32_t value);
+
+/**
+ * @brief Checks whether a value is in the bitmap.
+ * @param roaring The bitmap.
+ * @param value The value.
+ * @return Whether the value is in the bitmap.
+ */
+bool roaring_contains(const Roaring *roaring, uint32_t value);
+
+/**
+ * @brief Returns the number of values in the bitmap.
+ * @param roaring The bitmap.
+ * @return The number of values.
+ * @note The cardinality of each container is kept, so this is linear in
+ * the number of containers only.
+ */
+uint64_t roaring_cardinality(const Roaring *roaring);
+
+/**
+ * @brief Checks whether two bitmaps hold the same values.
+ * @param roaring1 The first bitmap.
+ * @param roaring2 The second bitmap.
+ * @return Whether they hold the same values, whatever their containers.
+ */
+bool roaring_equals(const Roaring *roaring1, const Roaring *roaring2);
+
+/**
+ * @brief Computes the union of two bitmaps.
+ * @param roaring1 The first bitmap.
+ * @param roaring2 The second bitmap.
+ * @return A new bitmap, using the allocator of `roaring1`.
+ */
+Roaring *roaring_union(const Roaring *roaring1, const Roaring *roaring2);
+
+/**
+ * @brief Computes the intersection of two bitmaps.
+ * @param roaring1 The first bitmap.
+ * @param roaring2 The second bitmap.
+ * @return A new bitmap, using the allocator of `roaring1`.
+ * @note Small arrays are intersected with large ones by galloping, and
+ * with bitmaps or runs by looking up each value.
+ */
+Roaring *roaring_intersection(const Roaring *roaring1, const Roaring *roaring2);
+
+/**
+ * @brief Computes the values of a bitmap not in another one.
+ * @param roaring1 The bitmap to take the values from.
+ * @param roaring2 The bitmap of the values to leave out.
+ * @return A new bitmap, using the allocator of `roaring1`.
+ */
+Roaring *roaring_difference(const Roaring *roaring1, const Roaring *roaring2);
+
+/**
+ * @brief Converts each container to the type taking the least memory,
+ * including runs.
+ * @param roaring The bitmap.
+ * @note Adding or removing a value converts a run container back to an
+ * array or a bitmap, so this is for bitmaps that are mostly read.
+ */
+void roaring_optimize(Roaring *roaring);
+
+/**
+ * @brief Returns the size of the serialized bitmap.
+ * @param roaring The bitmap.
+ * @return The size in bytes.
+ */
+size_t roaring_serialized_size(const Roaring *roaring);
+
+/**
+ * @brief Writes the bitmap to a buffer.
+ * @param roaring The bitmap.
+ * @param buffer The buffer, at least `roaring_serialized_size` bytes.
+ * @return The number of bytes written.
+ * @note The format stores, in native byte order: `ROARING_MAGIC` (u32),
+ * the number of containers (u32), then for each container its key (u16),
+ * type (u16) and number of entries (u32), then the entries of each
+ * container: the u16 values of arrays, 1024 u64 words for bitmaps and
+ * (start, length - 1) u16 pairs for runs.
+ */
+size_t roaring_serialize(const Roaring *roaring, void *buffer);
+
+/**
+ * @brief Frees the bitmap.
+ * @param roaring The bitmap.
+ */
+void roaring_free(Roaring *roaring);
+
+/**
+ * @struct RoaringIter
+ * @brief State of an iterator over the values of a compressed bitmap.
+ */
+typedef struct {
+    /** The bitmap */
+    const Roaring *roaring;
+
+    /** The index of the current container */
+    size_t container;
+
+    /** The position in the current container: an array index, a word
+     * index or a run index */
+    size_t position;
+
+    /** The bits of the current word not yielded yet */
+    uint64_t word;
+
+    /** The offset of the next value in the current run */
+    uint32_t offset;
+
+    /** The number of values left in the current container */
+    uint32_t container_left;
+
+    /** The number of values left */
+    uint64_t left;
+
+    /** The last yielded value */
+    uint32_t value;
+} RoaringIter;
+
+/**
+ * @brief Returns an iterator over the values of a bitmap.
+ * @param iter The state of the iterator.
+ * @param roaring The bitmap, it must not be modified while iterating.
+ * @return The iterator, yielding pointers to `uint32_t` values in
+ * ascending order.
+ * @note The size hint is exact and advancing skips whole containers.
+ */
+Iterator roaring_iter(RoaringIter *iter, const Roaring *roaring);
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new compressed bitmap.
+ * @param args The allocator of the bitmap.
+ * @return The new bitmap.
+ */
+Roaring *internal_roaring_new(RoaringArgs args);
+
+/**
+ * @brief Internal function to read a serialized compressed bitmap.
+ * @param data The serialized bitmap.
+ * @param size The size of the serialized bitmap in bytes.
+ * @param args The allocator of the bitmap.
+ * @return The bitmap, NULL on error.
+ */
+Roaring *internal_roaring_deserialize(const void *data, size_t size, RoaringArgs args);
+
+
+#endif // ROARING_H
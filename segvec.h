@@ -0,0 +1,183 @@
+/**
+ * @file segvec.h
+ * @brief Definition and functions for a segmented vector whose elements
+ * never move once they are pushed.
+ */
+
+#ifndef SEGVEC_H
+#define SEGVEC_H
+
+#include <stddef.h>
+
+#include "allocator.h"
+#include "iterator.h"
+
+/**
+ * @brief The maximum number of segments of a segmented vector.
+ */
+#define SEGVEC_MAX_SEGMENTS 64
+
+/**
+ * @brief Macro to define a segmented vector type with the specified
+ * element type.
+ * @param elem_type The type of the elements in the segmented vector.
+ * @return The defined segmented vector type.
+ * @note The segmented vector is a table of segments, segment `k` holds
+ * `first_segment_size * 2^k` elements (the first two segments are the same
+ * size). Growing allocates a new segment and never copies or moves existing
+ * elements, so pointers to elements stay valid until they are popped or
+ * the segmented vector is freed.
+ * @note ```SegVec(int) segvec = segvec_new(int);```
+ */
+#define SegVec(elem_type) elem_type **
+
+/**
+ * @brief Creates a new segmented vector with the specified element type.
+ * @param elem_type The type of the elements in the segmented vector.
+ * @param segvec_args Optional args, see `SegVecArgs` for more info.
+ * @return The created segmented vector.
+ * @note `segvec_args` defaults to
+ * `(SegVecArgs) { .cap = 0, .alloc = allocator_new() }`
+ */
+#define segvec_new(elem_type, ...)                                             \
+    internal_segvec_new(                                                       \
+        sizeof(elem_type),                                                     \
+        (SegVecArgs) { .cap = 0, .alloc = allocator_new(), __VA_ARGS__ }       \
+    )
+
+/**
+ * @brief Returns a pointer to the element at the specified index.
+ * @param segvec The segmented vector.
+ * @param index The index of the element.
+ * @return A pointer to the element.
+ */
+#define segvec_get(segvec, index)                                              \
+    ((typeof(*segvec)) internal_segvec_get(segvec, index))
+
+/**
+ * @brief Appends an element to the back of the segmented vector.
+ * @param segvec The segmented vector.
+ * @param elem The element to append.
+ * @return A pointer to the appended element, it stays valid until the
+ * element is popped or the segmented vector is freed.
+ * @note elem is shallow copied.
+ */
+#define segvec_push_back(segvec, elem) ({                                      \
+    typeof(**segvec) _e = elem;                                                \
+    (typeof(*segvec)) internal_segvec_push_back(segvec, &_e);                  \
+})
+
+/**
+ * @brief Removes the last element from the segmented vector.
+ * @param segvec The segmented vector.
+ * @param elem A pointer to store the popped element.
+ * @note Supply NULL for `elem` if you don't care about the popped value.
+ * @note The capacity remains the same (i.e. free is not called).
+ */
+void segvec_pop_back(void *segvec, void *elem);
+
+/**
+ * @brief Returns the number of elements in the segmented vector.
+ * @param segvec The segmented vector.
+ * @return The size of the segmented vector.
+ */
+size_t segvec_size(const void *segvec);
+
+/**
+ * @brief Returns the capacity of the segmented vector.
+ * @param segvec The segmented vector.
+ * @return The capacity of the segmented vector.
+ */
+size_t segvec_capacity(const void *segvec);
+
+/**
+ * @brief Checks if the segmented vector is empty.
+ * @param segvec The segmented vector.
+ * @return `true` if the segmented vector is empty, `false` otherwise.
+ */
+bool segvec_is_empty(const void *segvec);
+
+/**
+ * @brief Clears the segmented vector, removing all elements.
+ * @param segvec The segmented vector to clear.
+ * @note The capacity remains the same (i.e. free is not called).
+ */
+void segvec_clear(void *segvec);
+
+/**
+ * @brief Frees the memory used by the segmented vector.
+ * @param segvec The segmented vector to free.
+ */
+void segvec_free(void *segvec);
+
+/**
+ * @brief Reserves capacity for the segmented vector, ensuring it can hold
+ * at least the specified number of elements.
+ * @param segvec The segmented vector.
+ * @param new_capacity The new capacity to reserve.
+ * @note Unlike `vec_reserve` the segmented vector does not move.
+ */
+void segvec_reserve(void *segvec, size_t new_capacity);
+
+/**
+ * @brief Frees the segments that hold no elements.
+ * @param segvec The segmented vector.
+ */
+void segvec_shrink(void *segvec);
+
+/**
+ * @brief Creates an iterator for the segmented vector.
+ * @param segvec The segmented vector.
+ * @return An iterator for the segmented vector.
+ */
+Iterator segvec_iter(void *segvec);
+
+/*----------------------------- Argument Struct -----------------------------*/
+
+/**
+ * @brief Represents optional arguments for configuring a segmented vector.
+ * @note Examples of how to use this struct:
+ * @note `SegVec(int) segvec = segvec_new(int);`
+ * @note `SegVec(int) segvec = segvec_new(int, .cap = 1024);`
+ * @note `SegVec(int) segvec = segvec_new(int, .alloc = allocator_new());`
+ */
+typedef struct {
+    /**
+     * The size of the first segment, rounded up to a power of 2.
+     * Defaults to 16 when 0.
+     */
+    size_t cap;
+
+    /** The allocator for memory allocation */
+    Allocator alloc;
+} SegVecArgs;
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new segmented vector.
+ * @param elem_size The size of an element of the segmented vector.
+ * @param args The first segment size and allocator for the segmented vector.
+ * @return The new segmented vector.
+ */
+void *internal_segvec_new(size_t elem_size, SegVecArgs args);
+
+/**
+ * @brief Internal function to get a pointer to the element at an index.
+ * @param segvec The segmented vector.
+ * @param index The index of the element.
+ * @return A pointer to the element.
+ */
+void *internal_segvec_get(const void *segvec, size_t index);
+
+/**
+ * @brief Internal function to push an element to the back of the
+ * segmented vector.
+ * @param segvec The segmented vector.
+ * @param elem A pointer to the element to push.
+ * @return A pointer to the pushed element.
+ */
+void *internal_segvec_push_back(void *segvec, const void *elem);
+
+
+#endif // SEGVEC_H
@@ -0,0 +1,278 @@
+/**
+ * @file soa.h
+ * @brief Definition and functions for a struct-of-arrays container.
+ * @note A SoA stores the listed fields of a struct type in one contiguous
+ * column per field, so a loop over a few fields only loads those fields.
+ * The columns share the size and capacity and live in a single
+ * allocation, each starting on a 64 byte boundary.
+ */
+
+#ifndef SOA_H
+#define SOA_H
+
+#include <stddef.h>
+
+#include "allocator.h"
+#include "base.h"
+#include "view.h"
+
+/**
+ * @brief The maximum number of fields of a SoA.
+ */
+#define SOA_MAX_FIELDS 16
+
+/**
+ * @brief Opaque type of a struct-of-arrays container.
+ */
+typedef struct soa SoA;
+
+/**
+ * @struct SoAField
+ * @brief Describes a field of the row type, one column of a SoA.
+ */
+typedef struct {
+    /** The offset of the field in the row type */
+    size_t offset;
+
+    /** The size of the field */
+    size_t size;
+} SoAField;
+
+/**
+ * @struct SoAArgs
+ * @brief Optional args for creating a SoA.
+ */
+typedef struct {
+    /** The initial capacity in rows */
+    size_t cap;
+
+    /** The allocator used for the columns */
+    Allocator alloc;
+} SoAArgs;
+
+/**
+ * @brief Creates a new SoA storing fields of a struct type.
+ * @param type The row type.
+ * @param fields The parenthesized list of the fields to store, up to
+ * `SOA_MAX_FIELDS`, like `(x, y, id)`.
+ * @param soa_args Optional args, see `SoAArgs` for more info.
+ * @return The created SoA.
+ * @note `soa_args` defaults to `(SoAArgs) { .cap = 0, .alloc = allocator_new() }`
+ * @note ```SoA *soa = soa_new(Particle, (x, y, mass), .cap = 1024);```
+ */
+#define soa_new(type, fields, ...)                                             \
+    internal_soa_new(                                                          \
+        sizeof(type),                                                          \
+        (SoAField[]) { SOA_EACH(type, SOA_UNPACK fields) },                    \
+        SOA_COUNT(SOA_UNPACK fields),                                          \
+        (SoAArgs) { .cap = 0, .alloc = allocator_new(), __VA_ARGS__ }          \
+    )
+
+/**
+ * @brief Returns the column of a field.
+ * @param soa The SoA.
+ * @param type The row type.
+ * @param field The field.
+ * @return A typed pointer to the first element of the column, it is
+ * invalidated when the SoA grows.
+ */
+#define soa_column(soa, type, field)                                           \
+    ((typeof(((type *) 0)->field) *) internal_soa_column(                      \
+        soa, offsetof(type, field)                                             \
+    ))
+
+/**
+ * @brief Returns a view of the column of a field.
+ * @param soa The SoA.
+ * @param type The row type.
+ * @param field The field.
+ * @return The view, it is invalidated when the SoA grows.
+ * @note The view works with `view_iter` and `ITER_PIPE`.
+ */
+#define soa_view(soa, type, field)                                             \
+    view_new(                                                                  \
+        internal_soa_column(soa, offsetof(type, field)),                       \
+        soa_size(soa),                                                         \
+        sizeof(((type *) 0)->field)                                            \
+    )
+
+/**
+ * @brief Appends a row to the SoA.
+ * @param soa The SoA.
+ * @param row The row, its fields are copied to their columns.
+ */
+#define soa_push_back(soa, row)                                                \
+    do {                                                                       \
+        typeof(row) _r = row;                                                  \
+        internal_soa_push_back(soa, &_r, sizeof(_r));                          \
+    } while(0)
+
+/**
+ * @brief Sorts the rows of the SoA by the values of a column.
+ * @param soa The SoA.
+ * @param type The row type.
+ * @param field The field to sort by.
+ * @param compare The comparison function of the field values.
+ * @note The sort is stable. It sorts a permutation of the rows once, then
+ * applies it to every column with `soa_permute`.
+ */
+#define soa_sort_by(soa, type, field, compare)                                 \
+    internal_soa_sort_by(soa, offsetof(type, field), compare)
+
+/**
+ * @brief Copies a row out of the SoA.
+ * @param soa The SoA.
+ * @param index The index of the row.
+ * @param row Pointer to the row, the fields without a column are zeroed.
+ */
+void soa_get(const SoA *soa, size_t index, void *row);
+
+/**
+ * @brief Overwrites a row of the SoA.
+ * @param soa The SoA.
+ * @param index The index of the row.
+ * @param row Pointer to the row.
+ */
+void soa_set(SoA *soa, size_t index, const void *row);
+
+/**
+ * @brief Removes a row, moving the rows after it down.
+ * @param soa The SoA.
+ * @param index The index of the row.
+ */
+void soa_erase(SoA *soa, size_t index);
+
+/**
+ * @brief Removes a row, moving the last row into its place.
+ * @param soa The SoA.
+ * @param index The index of the row.
+ * @note O(1), the order of the rows is not kept.
+ */
+void soa_swap_erase(SoA *soa, size_t index);
+
+/**
+ * @brief Reorders the rows of the SoA.
+ * @param soa The SoA.
+ * @param permutation The permutation, row `i` becomes the row at index
+ * `permutation[i]` before the call.
+ */
+void soa_permute(SoA *soa, const size_t *permutation);
+
+/**
+ * @brief Returns the number of rows of the SoA.
+ * @param soa The SoA.
+ * @return The number of rows.
+ */
+size_t soa_size(const SoA *soa);
+
+/**
+ * @brief Returns the capacity of the SoA.
+ * @param soa The SoA.
+ * @return The number of rows the SoA can hold without growing.
+ */
+size_t soa_capacity(const SoA *soa);
+
+/**
+ * @brief Grows the capacity of the SoA.
+ * @param soa The SoA.
+ * @param new_capacity The capacity, nothing is done if it is not greater
+ * than the current one.
+ */
+void soa_reserve(SoA *soa, size_t new_capacity);
+
+/**
+ * @brief Removes all the rows of the SoA, the capacity remains the same.
+ * @param soa The SoA.
+ */
+void soa_clear(SoA *soa);
+
+/**
+ * @brief Frees the SoA.
+ * @param soa The SoA.
+ */
+void soa_free(SoA *soa);
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new SoA.
+ * @param row_size The size of the row type.
+ * @param fields The fields to store.
+ * @param nfields The number of fields.
+ * @param args The capacity and allocator of the SoA.
+ * @return The new SoA.
+ */
+SoA *internal_soa_new(size_t row_size, const SoAField *fields, size_t nfields, SoAArgs args);
+
+/**
+ * @brief Internal function to get the column of a field.
+ * @param soa The SoA.
+ * @param offset The offset of the field in the row type.
+ * @return The column.
+ */
+void *internal_soa_column(const SoA *soa, size_t offset);
+
+/**
+ * @brief Internal function to append a row to the SoA.
+ * @param soa The SoA.
+ * @param row Pointer to the row.
+ * @param row_size The size of the row, checked against the row type.
+ */
+void internal_soa_push_back(SoA *soa, const void *row, size_t row_size);
+
+/**
+ * @brief Internal function to sort the rows by the values of a column.
+ * @param soa The SoA.
+ * @param offset The offset of the field in the row type.
+ * @param compare The comparison function of the field values.
+ */
+void internal_soa_sort_by(SoA *soa, size_t offset, compare_fn compare);
+
+#define SOA_FIELD(type, field) { offsetof(type, field), sizeof(((type *) 0)->field) }
+#define SOA_UNPACK(...) __VA_ARGS__
+
+// Expand SOA_FIELD(type, field) for each of up to 16 fields.
+#define SOA_EACH(type, ...)                                                    \
+    SOA_CAT(SOA_EACH_, SOA_COUNT(__VA_ARGS__))(type, __VA_ARGS__)
+#define SOA_COUNT(...)                                                         \
+    SOA_COUNT_I(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, \
+                2, 1, 0)
+#define SOA_COUNT_I(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13,    \
+                    _14, _15, _16, n, ...) n
+#define SOA_CAT(a, b) SOA_CAT_I(a, b)
+#define SOA_CAT_I(a, b) a##b
+
+#define SOA_EACH_1(type, field) SOA_FIELD(type, field)
+#define SOA_EACH_2(type, field, ...)                                           \
+    SOA_FIELD(type, field), SOA_EACH_1(type, __VA_ARGS__)
+#define SOA_EACH_3(type, field, ...)                                           \
+    SOA_FIELD(type, field), SOA_EACH_2(type, __VA_ARGS__)
+#define SOA_EACH_4(type, field, ...)                                           \
+    SOA_FIELD(type, field), SOA_EACH_3(type, __VA_ARGS__)
+#define SOA_EACH_5(type, field, ...)                                           \
+    SOA_FIELD(type, field), SOA_EACH_4(type, __VA_ARGS__)
+#define SOA_EACH_6(type, field, ...)                                           \
+    SOA_FIELD(type, field), SOA_EACH_5(type, __VA_ARGS__)
+#define SOA_EACH_7(type, field, ...)                                           \
+    SOA_FIELD(type, field), SOA_EACH_6(type, __VA_ARGS__)
+#define SOA_EACH_8(type, field, ...)                                           \
+    SOA_FIELD(type, field), SOA_EACH_7(type, __VA_ARGS__)
+#define SOA_EACH_9(type, field, ...)                                           \
+    SOA_FIELD(type, field), SOA_EACH_8(type, __VA_ARGS__)
+#define SOA_EACH_10(type, field, ...)                                          \
+    SOA_FIELD(type, field), SOA_EACH_9(type, __VA_ARGS__)
+#define SOA_EACH_11(type, field, ...)                                          \
+    SOA_FIELD(type, field), SOA_EACH_10(type, __VA_ARGS__)
+#define SOA_EACH_12(type, field, ...)                                          \
+    SOA_FIELD(type, field), SOA_EACH_11(type, __VA_ARGS__)
+#define SOA_EACH_13(type, field, ...)                                          \
+    SOA_FIELD(type, field), SOA_EACH_12(type, __VA_ARGS__)
+#define SOA_EACH_14(type, field, ...)                                          \
+    SOA_FIELD(type, field), SOA_EACH_13(type, __VA_ARGS__)
+#define SOA_EACH_15(type, field, ...)                                          \
+    SOA_FIELD(type, field), SOA_EACH_14(type, __VA_ARGS__)
+#define SOA_EACH_16(type, field, ...)                                          \
+    SOA_FIELD(type, field), SOA_EACH_15(type, __VA_ARGS__)
+
+
+#endif // SOA_H
@@ -0,0 +1,453 @@
+#include <string.h>
+
+#include "../base.h"
+#include "../bitvec.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define X86_SIMD
+#include <immintrin.h>
+#endif
+
+// The rank index stores the count before every block of 8 words relative
+// to its superblock of 1024 words, and the count before every superblock.
+#define BLOCK_WORDS 8
+#define SUPER_WORDS 1024
+
+typedef enum { OP_AND, OP_OR, OP_XOR, OP_ANDNOT } BitOp;
+
+struct bitvec {
+    uint64_t *words;
+    size_t size;
+    size_t capacity;
+    Allocator alloc;
+
+    // Rank index, valid while indexed is set.
+    bool indexed;
+    size_t ones;
+    uint64_t *supers;
+    uint16_t *blocks;
+};
+
+static size_t word_count(size_t bits);
+static void grow(BitVec *bitvec, size_t capacity);
+static void trim(BitVec *bitvec);
+static void combine(BitVec *dst, const BitVec *src, BitOp op);
+static void build_index(BitVec *bitvec);
+static size_t select_in_word(uint64_t word, size_t rank);
+static Option ones_next(Iterator *iterator);
+static Option ones_advance(Iterator *iterator, size_t n);
+static SizeHint ones_size_hint(Iterator *iterator);
+static size_t popcount_scalar(const uint64_t *words, size_t size);
+#ifdef X86_SIMD
+static size_t popcount_popcnt(const uint64_t *words, size_t size);
+static size_t popcount_avx2(const uint64_t *words, size_t size);
+#endif
+
+BitVec *internal_bitvec_new(BitVecArgs args) {
+    BitVec *bitvec = allocator_allocate(args.alloc, sizeof(BitVec));
+    ASSERT(bitvec != NULL, "Out of memory");
+    *bitvec = (BitVec) { .alloc = args.alloc };
+    if (args.cap > 0) {
+        grow(bitvec, args.cap);
+    }
+    return bitvec;
+}
+
+size_t mem_popcount(const uint64_t *words, size_t size) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return popcount_avx2(words, size);
+    }
+    if (__builtin_cpu_supports("popcnt")) {
+        return popcount_popcnt(words, size);
+    }
+#endif
+    return popcount_scalar(words, size);
+}
+
+void bitvec_push_back(BitVec *bitvec, bool value) {
+    if (bitvec->size == bitvec->capacity) {
+        grow(bitvec, (bitvec->capacity > 0) ? bitvec->capacity * 2 : 64);
+    }
+    size_t index = bitvec->size++;
+    bitvec->words[index / 64] |= (uint64_t) value << (index % 64);
+    bitvec->indexed = false;
+}
+
+void bitvec_set(BitVec *bitvec, size_t index) {
+    ASSERT(index < bitvec->size, "Index out of bounds");
+    bitvec->words[index / 64] |= UINT64_C(1) << (index % 64);
+    bitvec->indexed = false;
+}
+
+void bitvec_clear(BitVec *bitvec, size_t index) {
+    ASSERT(index < bitvec->size, "Index out of bounds");
+    bitvec->words[index / 64] &= ~(UINT64_C(1) << (index % 64));
+    bitvec->indexed = false;
+}
+
+bool bitvec_test(const BitVec *bitvec, size_t index) {
+    ASSERT(index < bitvec->size, "Index out of bounds");
+    return (bitvec->words[index / 64] >> (index % 64)) & 1;
+}
+
+void bitvec_resize(BitVec *bitvec, size_t size, bool value) {
+    if (size > bitvec->capacity) {
+        grow(bitvec, (size > bitvec->capacity * 2) ? size : bitvec->capacity * 2);
+    }
+    if (value && size > bitvec->size) {
+        // Set the rest of the last word, then whole words.
+        size_t first = word_count(bitvec->size);
+        if (bitvec->size % 64 != 0) {
+            bitvec->words[first - 1] |= UINT64_MAX << (bitvec->size % 64);
+        }
+        memset(bitvec->words + first, 0xff, (word_count(size) - first) * sizeof(uint64_t));
+    }
+    size_t old_size = bitvec->size;
+    bitvec->size = size;
+    trim(bitvec);
+    if (size < old_size) {
+        // Shrinking leaves set bits past the last word, clear them so
+        // growing again starts from zeros.
+        size_t first = word_count(size);
+        memset(bitvec->words + first, 0, (word_count(old_size) - first) * sizeof(uint64_t));
+    }
+    bitvec->indexed = false;
+}
+
+void bitvec_fill(BitVec *bitvec, bool value) {
+    if (bitvec->size == 0) {
+        return;
+    }
+    memset(bitvec->words, value ? 0xff : 0, word_count(bitvec->size) * sizeof(uint64_t));
+    trim(bitvec);
+    bitvec->indexed = false;
+}
+
+void bitvec_and(BitVec *dst, const BitVec *src) {
+    combine(dst, src, OP_AND);
+}
+
+void bitvec_or(BitVec *dst, const BitVec *src) {
+    combine(dst, src, OP_OR);
+}
+
+void bitvec_xor(BitVec *dst, const BitVec *src) {
+    combine(dst, src, OP_XOR);
+}
+
+void bitvec_andnot(BitVec *dst, const BitVec *src) {
+    combine(dst, src, OP_ANDNOT);
+}
+
+size_t bitvec_count(const BitVec *bitvec) {
+    if (bitvec->indexed) {
+        return bitvec->ones;
+    }
+    return mem_popcount(bitvec->words, word_count(bitvec->size));
+}
+
+size_t bitvec_rank(BitVec *bitvec, size_t index) {
+    ASSERT(index <= bitvec->size, "Index out of bounds");
+    if (!bitvec->indexed) {
+        build_index(bitvec);
+    }
+    size_t word = index / 64;
+    size_t block = word / BLOCK_WORDS;
+    size_t rank = bitvec->supers[word / SUPER_WORDS] + bitvec->blocks[block];
+    for (size_t i = block * BLOCK_WORDS; i < word; i++) {
+        rank += __builtin_popcountll(bitvec->words[i]);
+    }
+    if (index % 64 != 0) {
+        rank += __builtin_popcountll(bitvec->words[word] & ~(UINT64_MAX << (index % 64)));
+    }
+    return rank;
+}
+
+size_t bitvec_select(BitVec *bitvec, size_t rank) {
+    if (!bitvec->indexed) {
+        build_index(bitvec);
+    }
+    if (rank >= bitvec->ones) {
+        return bitvec->size;
+    }
+    // Find the last superblock, then the last block in it, starting with
+    // at most rank set bits.
+    size_t nwords = word_count(bitvec->size);
+    size_t low = 0;
+    size_t high = nwords / SUPER_WORDS + 1;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (bitvec->supers[middle] <= rank) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    size_t super = low;
+    rank -= bitvec->supers[super];
+
+    size_t nblocks = nwords / BLOCK_WORDS + 1;
+    low = super * (SUPER_WORDS / BLOCK_WORDS);
+    high = low + SUPER_WORDS / BLOCK_WORDS;
+    high = (high < nblocks) ? high : nblocks;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (bitvec->blocks[middle] <= rank) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    rank -= bitvec->blocks[low];
+
+    for (size_t i = low * BLOCK_WORDS;; i++) {
+        size_t count = __builtin_popcountll(bitvec->words[i]);
+        if (rank < count) {
+            return i * 64 + select_in_word(bitvec->words[i], rank);
+        }
+        rank -= count;
+    }
+}
+
+size_t bitvec_size(const BitVec *bitvec) {
+    return bitvec->size;
+}
+
+size_t bitvec_capacity(const BitVec *bitvec) {
+    return bitvec->capacity;
+}
+
+const uint64_t *bitvec_words(const BitVec *bitvec) {
+    return bitvec->words;
+}
+
+void bitvec_free(BitVec *bitvec) {
+    Allocator alloc = bitvec->alloc;
+    if (bitvec->words != NULL) {
+        allocator_deallocate(alloc, bitvec->words);
+    }
+    if (bitvec->supers != NULL) {
+        allocator_deallocate(alloc, bitvec->supers);
+        allocator_deallocate(alloc, bitvec->blocks);
+    }
+    allocator_deallocate(alloc, bitvec);
+}
+
+Iterator bitvec_ones_iter(BitVecOnes *ones, const BitVec *bitvec) {
+    *ones = (BitVecOnes) {
+        .bitvec = bitvec,
+        .word = (bitvec->size > 0) ? bitvec->words[0] : 0,
+        .word_index = 0,
+        .position = 0
+    };
+    Iterator iterator = iter_default((void *) bitvec, ones, ones_next);
+    iterator.advance = ones_advance;
+    iterator.size_hint = ones_size_hint;
+    return iterator;
+}
+
+// Get the number of words holding bits.
+static size_t word_count(size_t bits) {
+    return bits / 64 + (bits % 64 != 0);
+}
+
+// Reallocate the words for at least capacity bits, zeroing the new ones.
+static void grow(BitVec *bitvec, size_t capacity) {
+    size_t old_words = bitvec->capacity / 64;
+    size_t new_words = word_count(capacity);
+    uint64_t *words = allocator_reallocate(bitvec->alloc, bitvec->words, new_words * sizeof(uint64_t));
+    ASSERT(words != NULL, "Out of memory");
+    memset(words + old_words, 0, (new_words - old_words) * sizeof(uint64_t));
+    bitvec->words = words;
+    bitvec->capacity = new_words * 64;
+}
+
+// Clear the bits past the size in the last word.
+static void trim(BitVec *bitvec) {
+    if (bitvec->size % 64 != 0) {
+        bitvec->words[bitvec->size / 64] &= ~(UINT64_MAX << (bitvec->size % 64));
+    }
+}
+
+// Apply an operation to every word, the op is switched on once so each
+// loop is a plain word loop.
+static void combine(BitVec *dst, const BitVec *src, BitOp op) {
+    ASSERT(dst->size == src->size, "Bit vectors must have the same size");
+    if (dst == src) {
+        // The words must not alias, x op x is x or 0.
+        if (op == OP_XOR || op == OP_ANDNOT) {
+            bitvec_fill(dst, false);
+        }
+        return;
+    }
+    uint64_t *restrict a = dst->words;
+    const uint64_t *restrict b = src->words;
+    size_t nwords = word_count(dst->size);
+    switch (op) {
+        case OP_AND:
+            for (size_t i = 0; i < nwords; i++) {
+                a[i] &= b[i];
+            }
+            break;
+        case OP_OR:
+            for (size_t i = 0; i < nwords; i++) {
+                a[i] |= b[i];
+            }
+            break;
+        case OP_XOR:
+            for (size_t i = 0; i < nwords; i++) {
+                a[i] ^= b[i];
+            }
+            break;
+        case OP_ANDNOT:
+            for (size_t i = 0; i < nwords; i++) {
+                a[i] &= ~b[i];
+            }
+            break;
+    }
+    dst->indexed = false;
+}
+
+// Count the set bits before each block and superblock.
+static void build_index(BitVec *bitvec) {
+    size_t nwords = word_count(bitvec->size);
+    size_t nsupers = nwords / SUPER_WORDS + 1;
+    size_t nblocks = nwords / BLOCK_WORDS + 1;
+    uint64_t *supers = allocator_reallocate(bitvec->alloc, bitvec->supers, nsupers * sizeof(uint64_t));
+    uint16_t *blocks = allocator_reallocate(bitvec->alloc, bitvec->blocks, nblocks * sizeof(uint16_t));
+    ASSERT(supers != NULL && blocks != NULL, "Out of memory");
+    bitvec->supers = supers;
+    bitvec->blocks = blocks;
+
+    uint64_t total = 0;
+    for (size_t block = 0; block < nblocks; block++) {
+        size_t word = block * BLOCK_WORDS;
+        if (word % SUPER_WORDS == 0) {
+            supers[word / SUPER_WORDS] = total;
+        }
+        blocks[block] = (uint16_t) (total - supers[word / SUPER_WORDS]);
+        for (size_t i = word; i < word + BLOCK_WORDS && i < nwords; i++) {
+            total += __builtin_popcountll(bitvec->words[i]);
+        }
+    }
+    bitvec->ones = total;
+    bitvec->indexed = true;
+}
+
+// Find the index of the set bit of a word with rank set bits before it.
+static size_t select_in_word(uint64_t word, size_t rank) {
+    for (size_t i = 0; i < rank; i++) {
+        word &= word - 1;
+    }
+    return __builtin_ctzll(word);
+}
+
+// Yield the lowest set bit of the current word, moving to the next non
+// zero word when it is empty.
+static Option ones_next(Iterator *iterator) {
+    BitVecOnes *current = iterator->current;
+    const BitVec *bitvec = current->bitvec;
+    size_t nwords = word_count(bitvec->size);
+    while (current->word == 0) {
+        if (current->word_index + 1 >= nwords) {
+            current->word_index = nwords;
+            return option_none();
+        }
+        current->word = bitvec->words[++current->word_index];
+    }
+    current->position = current->word_index * 64 + __builtin_ctzll(current->word);
+    current->word &= current->word - 1;
+    return option_some(&current->position);
+}
+
+// Yield the next set bit and skip the n - 1 after it, counting whole
+// words at once so the yielded index is not overwritten.
+static Option ones_advance(Iterator *iterator, size_t n) {
+    BitVecOnes *current = iterator->current;
+    const BitVec *bitvec = current->bitvec;
+    size_t nwords = word_count(bitvec->size);
+    Option first = ones_next(iterator);
+    size_t skip = first.is_valid ? n - 1 : 0;
+    while (skip > 0) {
+        size_t count = __builtin_popcountll(current->word);
+        if (skip < count) {
+            for (; skip > 0; skip--) {
+                current->word &= current->word - 1;
+            }
+            break;
+        }
+        skip -= count;
+        current->word = 0;
+        if (current->word_index + 1 >= nwords) {
+            current->word_index = nwords;
+            break;
+        }
+        current->word = bitvec->words[++current->word_index];
+    }
+    return first;
+}
+
+// At most the set bits of the current word and the bits of the words
+// after it are left.
+static SizeHint ones_size_hint(Iterator *iterator) {
+    BitVecOnes *current = iterator->current;
+    size_t size = current->bitvec->size;
+    size_t rest = (current->word_index + 1) * 64;
+    size_t upper = __builtin_popcountll(current->word) + ((size > rest) ? size - rest : 0);
+    return (SizeHint) { .lower = (current->word != 0), .upper = upper };
+}
+
+// Portable version of mem_popcount, also used for the tails of the SIMD
+// versions.
+static size_t popcount_scalar(const uint64_t *words, size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) {
+        count += __builtin_popcountll(words[i]);
+    }
+    return count;
+}
+
+#ifdef X86_SIMD
+// Version of mem_popcount using the popcnt instruction, in 4 independent
+// sums so the instructions overlap.
+__attribute__((target("popcnt")))
+static size_t popcount_popcnt(const uint64_t *words, size_t size) {
+    size_t counts[4] = { 0, 0, 0, 0 };
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        counts[0] += __builtin_popcountll(words[i]);
+        counts[1] += __builtin_popcountll(words[i + 1]);
+        counts[2] += __builtin_popcountll(words[i + 2]);
+        counts[3] += __builtin_popcountll(words[i + 3]);
+    }
+    for (; i < size; i++) {
+        counts[0] += __builtin_popcountll(words[i]);
+    }
+    return counts[0] + counts[1] + counts[2] + counts[3];
+}
+
+// AVX2 version of mem_popcount, 4 words at a time. The count of each
+// nibble is looked up with a byte shuffle and the byte counts are summed
+// into 4 lanes.
+__attribute__((target("avx2")))
+static size_t popcount_avx2(const uint64_t *words, size_t size) {
+    const __m256i table = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+    );
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i sums = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) (words + i));
+        __m256i low = _mm256_and_si256(block, low_mask);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), low_mask);
+        __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(table, low), _mm256_shuffle_epi8(table, high));
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, sums);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcount_scalar(words + i, size - i);
+}
+#endif
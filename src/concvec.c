@@ -0,0 +1,279 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "../base.h"
+#include "../concvec.h"
+
+#define CVEC_META_PTR(cvec) (((ConcVecMeta *) cvec) - 1)
+#define CVEC_PTR(cvec_meta) ((_Atomic(void *) *) (cvec_meta + 1))
+#define CVEC_GET(segment, index, elem_size) (void *) ((size_t) segment + ((index) * elem_size))
+#define DEFAULT_FIRST_SEGMENT_SIZE 64
+
+// Each segment holds its elements followed by one ready flag per element.
+typedef struct {
+    atomic_size_t reserved;
+    atomic_size_t committed;
+    size_t first_segment_bits;
+    size_t elem_size;
+    Allocator alloc;
+} ConcVecMeta;
+
+static size_t segment_of(const ConcVecMeta *cvec_meta, size_t index);
+static size_t segment_start(const ConcVecMeta *cvec_meta, size_t segment);
+static size_t segment_size(const ConcVecMeta *cvec_meta, size_t segment);
+static void *acquire_segment(ConcVecMeta *cvec_meta, size_t segment);
+static void *locate(const ConcVecMeta *cvec_meta, size_t index);
+static bool is_published(const ConcVecMeta *cvec_meta, size_t index);
+static size_t committed_size(ConcVecMeta *cvec_meta);
+static Option cit_next(Iterator *iterator);
+static Option cit_advance(Iterator *iterator, size_t n);
+static size_t cit_size(Iterator *iterator);
+static SizeHint cit_size_hint(Iterator *iterator);
+
+void *internal_cvec_new(size_t elem_size, ConcVecArgs args) {
+    ConcVecMeta *cvec_meta = allocator_allocate(
+        args.alloc,
+        sizeof(ConcVecMeta) + (sizeof(_Atomic(void *)) * CONCVEC_MAX_SEGMENTS)
+    );
+    ASSERT(cvec_meta != NULL, "Out of memory");
+
+    // The first segment size is the smallest power of 2 >= args.cap.
+    size_t first_segment_bits = 0;
+    size_t cap = (args.cap == 0) ? DEFAULT_FIRST_SEGMENT_SIZE : args.cap;
+    while (((size_t) 1 << first_segment_bits) < cap) {
+        first_segment_bits++;
+    }
+
+    atomic_init(&cvec_meta->reserved, 0);
+    atomic_init(&cvec_meta->committed, 0);
+    cvec_meta->first_segment_bits = first_segment_bits;
+    cvec_meta->elem_size = elem_size;
+    cvec_meta->alloc = args.alloc;
+
+    _Atomic(void *) *segments = CVEC_PTR(cvec_meta);
+    for (size_t i = 0; i < CONCVEC_MAX_SEGMENTS; i++) {
+        atomic_init(&segments[i], NULL);
+    }
+    return segments;
+}
+
+void *internal_cvec_get(const void *cvec, size_t index) {
+    ConcVecMeta *cvec_meta = CVEC_META_PTR(cvec);
+    ASSERT(
+        index < cvec_size(cvec),
+        "Index (is %zu) should be < cvec_size (is %zu)",
+        index,
+        cvec_size(cvec)
+    );
+    return locate(cvec_meta, index);
+}
+
+size_t internal_cvec_push_many(void *cvec, const void *array, size_t size) {
+    ConcVecMeta *cvec_meta = CVEC_META_PTR(cvec);
+    size_t start = atomic_fetch_add_explicit(&cvec_meta->reserved, size, memory_order_relaxed);
+
+    // Copy the elements segment by segment, then publish them. The release
+    // stores to the ready flags order the copies before them.
+    size_t index = start;
+    size_t end = start + size;
+    while (index < end) {
+        size_t segment = segment_of(cvec_meta, index);
+        size_t seg_size = segment_size(cvec_meta, segment);
+        size_t offset = index - segment_start(cvec_meta, segment);
+        size_t count = (end - index < seg_size - offset) ? end - index : seg_size - offset;
+
+        char *data = acquire_segment(cvec_meta, segment);
+        atomic_uchar *ready = (atomic_uchar *) (data + (seg_size * cvec_meta->elem_size));
+        memcpy(
+            CVEC_GET(data, offset, cvec_meta->elem_size),
+            CVEC_GET(array, index - start, cvec_meta->elem_size),
+            count * cvec_meta->elem_size
+        );
+        for (size_t i = offset; i < offset + count; i++) {
+            atomic_store_explicit(&ready[i], 1, memory_order_release);
+        }
+        index += count;
+    }
+    return start;
+}
+
+size_t cvec_size(const void *cvec) {
+    return committed_size(CVEC_META_PTR(cvec));
+}
+
+size_t cvec_reserved(const void *cvec) {
+    return atomic_load_explicit(&CVEC_META_PTR(cvec)->reserved, memory_order_relaxed);
+}
+
+void cvec_reserve(void *cvec, size_t new_capacity) {
+    ConcVecMeta *cvec_meta = CVEC_META_PTR(cvec);
+    for (size_t segment = 0; segment_start(cvec_meta, segment) < new_capacity; segment++) {
+        acquire_segment(cvec_meta, segment);
+    }
+}
+
+void cvec_clear(void *cvec) {
+    ConcVecMeta *cvec_meta = CVEC_META_PTR(cvec);
+    _Atomic(void *) *segments = CVEC_PTR(cvec_meta);
+    for (size_t i = 0; i < CONCVEC_MAX_SEGMENTS; i++) {
+        char *data = atomic_load_explicit(&segments[i], memory_order_relaxed);
+        if (data != NULL) {
+            size_t seg_size = segment_size(cvec_meta, i);
+            memset(data + (seg_size * cvec_meta->elem_size), 0, seg_size);
+        }
+    }
+    atomic_store(&cvec_meta->reserved, 0);
+    atomic_store(&cvec_meta->committed, 0);
+}
+
+void cvec_free(void *cvec) {
+    ConcVecMeta *cvec_meta = CVEC_META_PTR(cvec);
+    _Atomic(void *) *segments = CVEC_PTR(cvec_meta);
+    for (size_t i = 0; i < CONCVEC_MAX_SEGMENTS; i++) {
+        void *data = atomic_load_explicit(&segments[i], memory_order_relaxed);
+        if (data != NULL) {
+            allocator_deallocate(cvec_meta->alloc, data);
+        }
+    }
+    allocator_deallocate(cvec_meta->alloc, cvec_meta);
+}
+
+Iterator cvec_iter(void *cvec) {
+    Iterator iterator = iter_default(CVEC_META_PTR(cvec), NULL, cit_next);
+    iterator.advance = cit_advance;
+    iterator.size = cit_size;
+    iterator.size_hint = cit_size_hint;
+    return iterator;
+}
+
+// Find the segment which holds the element at index.
+static size_t segment_of(const ConcVecMeta *cvec_meta, size_t index) {
+    size_t first_segments = index >> cvec_meta->first_segment_bits;
+    if (first_segments == 0) {
+        return 0;
+    }
+    return (sizeof(size_t) * 8) - (size_t) __builtin_clzl(first_segments);
+}
+
+// Find the index of the first element of a segment.
+static size_t segment_start(const ConcVecMeta *cvec_meta, size_t segment) {
+    return (segment == 0) ? 0 : (size_t) 1 << (cvec_meta->first_segment_bits + segment - 1);
+}
+
+// Find the number of elements a segment holds.
+static size_t segment_size(const ConcVecMeta *cvec_meta, size_t segment) {
+    return (segment == 0)
+        ? (size_t) 1 << cvec_meta->first_segment_bits
+        : segment_start(cvec_meta, segment);
+}
+
+// Get a segment, allocating it if no thread has done so yet. When several
+// threads race to install the same segment the losers free their copy.
+static void *acquire_segment(ConcVecMeta *cvec_meta, size_t segment) {
+    ASSERT(
+        segment < CONCVEC_MAX_SEGMENTS,
+        "segment (is %zu) should be < %d",
+        segment,
+        CONCVEC_MAX_SEGMENTS
+    );
+    _Atomic(void *) *segments = CVEC_PTR(cvec_meta);
+    void *data = atomic_load_explicit(&segments[segment], memory_order_acquire);
+    if (data != NULL) {
+        return data;
+    }
+
+    size_t seg_size = segment_size(cvec_meta, segment);
+    char *new_data = allocator_allocate(
+        cvec_meta->alloc,
+        seg_size * (cvec_meta->elem_size + sizeof(atomic_uchar))
+    );
+    ASSERT(new_data != NULL, "Out of memory");
+    memset(new_data + (seg_size * cvec_meta->elem_size), 0, seg_size * sizeof(atomic_uchar));
+
+    if (atomic_compare_exchange_strong_explicit(
+            &segments[segment], &data, new_data,
+            memory_order_acq_rel, memory_order_acquire)) {
+        return new_data;
+    }
+    allocator_deallocate(cvec_meta->alloc, new_data);
+    return data;
+}
+
+// Get a pointer to the slot of index, its segment must be allocated.
+static void *locate(const ConcVecMeta *cvec_meta, size_t index) {
+    _Atomic(void *) *segments = CVEC_PTR(cvec_meta);
+    size_t segment = segment_of(cvec_meta, index);
+    return CVEC_GET(
+        atomic_load_explicit(&segments[segment], memory_order_acquire),
+        index - segment_start(cvec_meta, segment),
+        cvec_meta->elem_size
+    );
+}
+
+// Check if the slot at index has been written and published.
+static bool is_published(const ConcVecMeta *cvec_meta, size_t index) {
+    _Atomic(void *) *segments = CVEC_PTR(cvec_meta);
+    size_t segment = segment_of(cvec_meta, index);
+    char *data = atomic_load_explicit(&segments[segment], memory_order_acquire);
+    if (data == NULL) {
+        return false;
+    }
+    size_t seg_size = segment_size(cvec_meta, segment);
+    atomic_uchar *ready = (atomic_uchar *) (data + (seg_size * cvec_meta->elem_size));
+    return atomic_load_explicit(
+        &ready[index - segment_start(cvec_meta, segment)],
+        memory_order_acquire
+    );
+}
+
+// Find the committed prefix by scanning the ready flags past the last known
+// committed size, then try to advance the shared committed size.
+static size_t committed_size(ConcVecMeta *cvec_meta) {
+    size_t committed = atomic_load_explicit(&cvec_meta->committed, memory_order_acquire);
+    size_t reserved = atomic_load_explicit(&cvec_meta->reserved, memory_order_relaxed);
+    size_t size = committed;
+    while (size < reserved && is_published(cvec_meta, size)) {
+        size++;
+    }
+
+    while (committed < size && !atomic_compare_exchange_weak_explicit(
+            &cvec_meta->committed, &committed, size,
+            memory_order_release, memory_order_acquire));
+    return (committed > size) ? committed : size;
+}
+
+// Move the iterator by 1 element.
+static Option cit_next(Iterator *iterator) {
+    return cit_advance(iterator, 1);
+}
+
+// Move the iterator by n elements, only the cheap committed size check is
+// done unless the iterator reaches it.
+static Option cit_advance(Iterator *iterator, size_t n) {
+    ConcVecMeta *cvec_meta = iterator->container;
+    size_t index = iterator->index;
+    if (index >= atomic_load_explicit(&cvec_meta->committed, memory_order_acquire)
+        && index >= committed_size(cvec_meta)) {
+        return option_none();
+    }
+    iterator->index += n;
+    return option_some(locate(cvec_meta, index));
+}
+
+// Get the number of elements in the iterator.
+static size_t cit_size(Iterator *iterator) {
+    size_t committed = committed_size(iterator->container);
+    size_t size = (iterator->index < committed) ? committed - iterator->index : 0;
+    iterator->index = (iterator->index < committed) ? committed : iterator->index;
+    return size;
+}
+
+// Get the number of committed elements left without moving the iterator,
+// more may be committed while iterating so there is no upper bound.
+static SizeHint cit_size_hint(Iterator *iterator) {
+    size_t committed = committed_size(iterator->container);
+    return (SizeHint) {
+        .lower = (iterator->index < committed) ? committed - iterator->index : 0,
+        .upper = SIZE_MAX
+    };
+}
@@ -0,0 +1,295 @@
+#include <string.h>
+
+#include "../base.h"
+#include "../deque.h"
+
+#define DEQUE_META_PTR(deque) (((DequeMeta *) deque) - 1)
+#define DEQUE_PTR(deque_meta) ((void *) (deque_meta + 1))
+#define DEQUE_GET(deque, index, elem_size) (void *) ((size_t) deque + ((index) * elem_size))
+#define DEQUE_SLOT(deque_meta, index) (((deque_meta)->head + (index)) & ((deque_meta)->capacity - 1))
+
+typedef struct {
+    size_t capacity;
+    size_t size;
+    size_t head;
+    size_t elem_size;
+    Allocator alloc;
+} DequeMeta;
+
+static void *resize(DequeMeta **deque_meta_ref, size_t new_capacity);
+static size_t find_new_capacity(size_t current_capacity, size_t required_capacity);
+static void spans_from(const DequeMeta *deque_meta, size_t index, DequeSpan spans[2]);
+static Option dit_next(Iterator *iterator);
+static Option dit_advance(Iterator *iterator, size_t n);
+static size_t dit_size(Iterator *iterator);
+static SizeHint dit_size_hint(Iterator *iterator);
+static size_t dit_index(const Iterator *iterator);
+
+void *internal_deque_new(size_t elem_size, DequeArgs args) {
+    size_t capacity = find_new_capacity(0, args.cap);
+    DequeMeta *deque_meta = allocator_allocate(
+        args.alloc,
+        sizeof(DequeMeta) + (elem_size * capacity)
+    );
+    ASSERT(deque_meta != NULL, "Out of memory");
+
+    deque_meta->capacity = capacity;
+    deque_meta->size = 0;
+    deque_meta->head = 0;
+    deque_meta->elem_size = elem_size;
+    deque_meta->alloc = args.alloc;
+    return DEQUE_PTR(deque_meta);
+}
+
+void *internal_deque_get(const void *deque, size_t index) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    ASSERT(
+        index < deque_meta->size,
+        "Index (is %zu) should be < deque_size (is %zu)",
+        index,
+        deque_meta->size
+    );
+    return DEQUE_GET(deque, DEQUE_SLOT(deque_meta, index), deque_meta->elem_size);
+}
+
+void *internal_deque_push_back(void *deque, const void *elem) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    if (deque_meta->size == deque_meta->capacity) {
+        deque = resize(&deque_meta, deque_meta->capacity * 2);
+        ASSERT(deque != NULL, "Out of memory");
+    }
+
+    // Insert the element after the last element.
+    memcpy(
+        DEQUE_GET(deque, DEQUE_SLOT(deque_meta, deque_meta->size), deque_meta->elem_size),
+        elem,
+        deque_meta->elem_size
+    );
+    deque_meta->size++;
+    return deque;
+}
+
+void *internal_deque_push_front(void *deque, const void *elem) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    if (deque_meta->size == deque_meta->capacity) {
+        deque = resize(&deque_meta, deque_meta->capacity * 2);
+        ASSERT(deque != NULL, "Out of memory");
+    }
+
+    // Move the head back by 1 slot and insert the element there.
+    deque_meta->head = DEQUE_SLOT(deque_meta, deque_meta->capacity - 1);
+    memcpy(
+        DEQUE_GET(deque, deque_meta->head, deque_meta->elem_size),
+        elem,
+        deque_meta->elem_size
+    );
+    deque_meta->size++;
+    return deque;
+}
+
+void deque_pop_back(void *deque, void *elem) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    ASSERT(
+        deque_meta->size > 0,
+        "deque_size (is %zu) should be > 0",
+        deque_meta->size
+    );
+
+    // Copy the popped element to elem.
+    deque_meta->size--;
+    if (elem != NULL) {
+        memcpy(
+            elem,
+            DEQUE_GET(deque, DEQUE_SLOT(deque_meta, deque_meta->size), deque_meta->elem_size),
+            deque_meta->elem_size
+        );
+    }
+}
+
+void deque_pop_front(void *deque, void *elem) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    ASSERT(
+        deque_meta->size > 0,
+        "deque_size (is %zu) should be > 0",
+        deque_meta->size
+    );
+
+    // Copy the popped element to elem and move the head forward by 1 slot.
+    if (elem != NULL) {
+        memcpy(
+            elem,
+            DEQUE_GET(deque, deque_meta->head, deque_meta->elem_size),
+            deque_meta->elem_size
+        );
+    }
+    deque_meta->head = DEQUE_SLOT(deque_meta, 1);
+    deque_meta->size--;
+}
+
+size_t deque_size(const void *deque) {
+    return DEQUE_META_PTR(deque)->size;
+}
+
+size_t deque_capacity(const void *deque) {
+    return DEQUE_META_PTR(deque)->capacity;
+}
+
+bool deque_is_empty(const void *deque) {
+    return deque_size(deque) == 0;
+}
+
+void deque_clear(void *deque) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    deque_meta->size = 0;
+    deque_meta->head = 0;
+}
+
+void deque_free(void *deque) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    allocator_deallocate(deque_meta->alloc, deque_meta);
+}
+
+void *deque_reserve(void *deque, size_t new_capacity) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    if (new_capacity > deque_meta->capacity) {
+        deque = resize(
+            &deque_meta,
+            find_new_capacity(deque_meta->capacity, new_capacity)
+        );
+        ASSERT(deque != NULL, "Out of memory");
+    }
+    return deque;
+}
+
+void deque_spans(const void *deque, DequeSpan spans[2]) {
+    spans_from(DEQUE_META_PTR(deque), 0, spans);
+}
+
+Iterator deque_iter(void *deque) {
+    DequeMeta *deque_meta = DEQUE_META_PTR(deque);
+    Iterator iterator = iter_default(
+        deque_meta,
+        (deque_meta->size > 0) ? DEQUE_GET(deque, deque_meta->head, deque_meta->elem_size) : NULL,
+        dit_next
+    );
+    iterator.advance = dit_advance;
+    iterator.size = dit_size;
+    iterator.size_hint = dit_size_hint;
+    return iterator;
+}
+
+void deque_iter_spans(const Iterator *iterator, DequeSpan spans[2]) {
+    spans_from(iterator->container, dit_index(iterator), spans);
+}
+
+// Resize the deque's capacity to new_capacity, which must be a power of 2,
+// updating deque_meta_ref and returning the updated deque. Elements that
+// wrapped around are moved so that they are contiguous with the head again.
+static void *resize(DequeMeta **deque_meta_ref, size_t new_capacity) {
+    size_t old_capacity = (*deque_meta_ref)->capacity;
+    DequeMeta *deque_meta = allocator_reallocate(
+        (*deque_meta_ref)->alloc,
+        *deque_meta_ref,
+        sizeof(DequeMeta) + ((*deque_meta_ref)->elem_size * new_capacity)
+    );
+    if (deque_meta == NULL) {
+        return NULL;
+    }
+
+    void *deque = DEQUE_PTR(deque_meta);
+    size_t elem_size = deque_meta->elem_size;
+    size_t head_count = old_capacity - deque_meta->head;
+    if (deque_meta->size > head_count) {
+        // Move whichever of the two runs is shorter.
+        size_t wrapped_count = deque_meta->size - head_count;
+        if (wrapped_count <= head_count) {
+            memcpy(
+                DEQUE_GET(deque, old_capacity, elem_size),
+                deque,
+                wrapped_count * elem_size
+            );
+        } else {
+            size_t new_head = new_capacity - head_count;
+            memmove(
+                DEQUE_GET(deque, new_head, elem_size),
+                DEQUE_GET(deque, deque_meta->head, elem_size),
+                head_count * elem_size
+            );
+            deque_meta->head = new_head;
+        }
+    }
+
+    deque_meta->capacity = new_capacity;
+    *deque_meta_ref = deque_meta;
+    return deque;
+}
+
+// Find the capacity that is a power of 2 which is greater than or equal to required_capacity.
+static size_t find_new_capacity(size_t current_capacity, size_t required_capacity) {
+    current_capacity = (current_capacity == 0) ? 1 : current_capacity;
+    while (current_capacity < required_capacity) {
+        current_capacity *= 2;
+    }
+    return current_capacity;
+}
+
+// Split the elements from index to the back of the deque into the run up
+// to the end of the buffer and the run that wrapped around.
+static void spans_from(const DequeMeta *deque_meta, size_t index, DequeSpan spans[2]) {
+    void *deque = DEQUE_PTR(deque_meta);
+    size_t count = deque_meta->size - index;
+    size_t slot = DEQUE_SLOT(deque_meta, index);
+    size_t first_count = deque_meta->capacity - slot;
+    first_count = (count < first_count) ? count : first_count;
+
+    spans[0].data = DEQUE_GET(deque, slot, deque_meta->elem_size);
+    spans[0].size = first_count;
+    spans[1].data = deque;
+    spans[1].size = count - first_count;
+}
+
+// Move the iterator by 1 element.
+static Option dit_next(Iterator *iterator) {
+    return dit_advance(iterator, 1);
+}
+
+// Move the iterator by n elements.
+static Option dit_advance(Iterator *iterator, size_t n) {
+    DequeMeta *deque_meta = iterator->container;
+    void *current = iterator->current;
+    if (current == NULL) {
+        return option_none();
+    }
+
+    // The iterator is exhausted when it moves past the back of the deque.
+    size_t index = dit_index(iterator) + n;
+    iterator->current = (index < deque_meta->size)
+        ? DEQUE_GET(DEQUE_PTR(deque_meta), DEQUE_SLOT(deque_meta, index), deque_meta->elem_size)
+        : NULL;
+    return option_some(current);
+}
+
+// Get the number of elements in the iterator.
+static size_t dit_size(Iterator *iterator) {
+    DequeMeta *deque_meta = iterator->container;
+    size_t size = deque_meta->size - dit_index(iterator);
+    iterator->current = NULL;
+    return size;
+}
+
+// Get the exact number of elements left without moving the iterator.
+static SizeHint dit_size_hint(Iterator *iterator) {
+    DequeMeta *deque_meta = iterator->container;
+    return size_hint_exact(deque_meta->size - dit_index(iterator));
+}
+
+// Get the index, counted from the front of the deque, of the iterator's
+// current element. An exhausted iterator is at index deque_size.
+static size_t dit_index(const Iterator *iterator) {
+    DequeMeta *deque_meta = iterator->container;
+    if (iterator->current == NULL) {
+        return deque_meta->size;
+    }
+    size_t slot = ((size_t) iterator->current - (size_t) DEQUE_PTR(deque_meta)) / deque_meta->elem_size;
+    return (slot - deque_meta->head) & (deque_meta->capacity - 1);
+}
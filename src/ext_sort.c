@@ -0,0 +1,277 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../ext_sort.h"
+#include "../iter_utils.h"
+#include "../vector.h"
+#include "../view.h"
+
+// A sorted run spilled to the temporary file, read back through its own
+// buffer while merging.
+typedef struct {
+    ExtSort *sort;
+    off_t offset;
+    size_t remaining;
+    char *buffer;
+    size_t capacity;
+    size_t pos;
+    size_t filled;
+} SortRun;
+
+struct ext_sort {
+    size_t elem_size;
+    compare_fn compare;
+    ExtSortArgs args;
+    int fd;
+    int error;
+    char *run;
+    View last_run;
+    Vec(SortRun) runs;
+    Iterator *sources;
+    MergeK merge;
+    Iterator iterator;
+};
+
+static void spill(ExtSort *sort, size_t size);
+static int open_tmp(const char *tmp_dir, Allocator alloc);
+static Option srit_next(Iterator *iterator);
+static SizeHint srit_size_hint(Iterator *iterator);
+static bool write_all(int fd, const char *data, size_t size);
+static bool pread_all(int fd, char *data, size_t size, off_t offset);
+
+ExtSort *internal_ext_sort_new(
+    Iterator *iterator,
+    size_t elem_size,
+    compare_fn compare,
+    ExtSortArgs args
+) {
+    ASSERT(args.run_size > 0, "Run size must be greater than 0");
+    ExtSort *sort = allocator_allocate(args.alloc, sizeof(ExtSort));
+    ASSERT(sort != NULL, "Out of memory");
+    sort->elem_size = elem_size;
+    sort->compare = compare;
+    sort->args = args;
+    sort->fd = -1;
+    sort->error = 0;
+    sort->run = allocator_allocate(args.alloc, args.run_size * elem_size);
+    ASSERT(sort->run != NULL, "Out of memory");
+    sort->runs = vec_new(SortRun, .alloc = args.alloc);
+    sort->sources = NULL;
+
+    // Fill the run from whole blocks when the iterator has them, a full run
+    // is sorted and spilled before reading on.
+    size_t size = 0;
+    for (Chunk chunk = iter_take_chunk(iterator); chunk.size > 0 && sort->error == 0; chunk = iter_take_chunk(iterator)) {
+        ASSERT(chunk.elem_size == 0 || chunk.elem_size == elem_size, "Element size mismatch");
+        size_t copied = 0;
+        while (copied < chunk.size && sort->error == 0) {
+            if (size == args.run_size) {
+                spill(sort, size);
+                size = 0;
+            } else if (chunk.elem_size == 0) {
+                memcpy(sort->run + size * elem_size, chunk.data, elem_size);
+                size++;
+                copied++;
+            } else {
+                size_t count = chunk.size - copied;
+                count = (count < args.run_size - size) ? count : args.run_size - size;
+                memcpy(sort->run + size * elem_size, (char *) chunk.data + copied * elem_size, count * elem_size);
+                size += count;
+                copied += count;
+            }
+        }
+    }
+    sort->last_run = view_new(sort->run, (sort->error == 0) ? size : 0, elem_size);
+    view_sort(sort->last_run, compare);
+
+    // Without spilled runs the result is the run itself, otherwise the runs
+    // and the last run are merged, one buffer of at least one element per
+    // spilled run.
+    size_t nruns = vec_size(sort->runs);
+    if (nruns == 0 || sort->error != 0) {
+        sort->iterator = view_iter(&sort->last_run);
+        return sort;
+    }
+    size_t buffer_elems = args.buffer_size / elem_size;
+    buffer_elems = (buffer_elems > 0) ? buffer_elems : 1;
+    sort->sources = allocator_allocate(args.alloc, (nruns + 1) * sizeof(Iterator));
+    ASSERT(sort->sources != NULL, "Out of memory");
+    for (size_t i = 0; i < nruns; i++) {
+        SortRun *run = &sort->runs[i];
+        run->buffer = allocator_allocate(args.alloc, buffer_elems * elem_size);
+        ASSERT(run->buffer != NULL, "Out of memory");
+        run->sort = sort;
+        run->capacity = buffer_elems;
+        run->pos = 0;
+        run->filled = 0;
+        sort->sources[i] = iter_default(NULL, run, srit_next);
+        sort->sources[i].size_hint = srit_size_hint;
+    }
+    sort->sources[nruns] = view_iter(&sort->last_run);
+    sort->iterator = merge_k_iter(
+        &sort->merge,
+        sort->sources,
+        nruns + 1,
+        elem_size,
+        compare,
+        args.alloc
+    );
+    return sort;
+}
+
+Iterator ext_sort_iter(ExtSort *sort) {
+    return sort->iterator;
+}
+
+bool ext_sort_write_fd(ExtSort *sort, int fd) {
+    size_t buffer_elems = sort->args.buffer_size / sort->elem_size;
+    buffer_elems = (buffer_elems > 0) ? buffer_elems : 1;
+    char *buffer = allocator_allocate(sort->args.alloc, buffer_elems * sort->elem_size);
+    ASSERT(buffer != NULL, "Out of memory");
+    size_t size = 0;
+    bool ok = true;
+    for (Option option = iter_next(sort->iterator); option.is_valid && ok; option = iter_next(sort->iterator)) {
+        memcpy(buffer + size * sort->elem_size, option.value, sort->elem_size);
+        if (++size == buffer_elems) {
+            ok = write_all(fd, buffer, size * sort->elem_size);
+            size = 0;
+        }
+    }
+    ok = ok && write_all(fd, buffer, size * sort->elem_size);
+    if (!ok && sort->error == 0) {
+        sort->error = errno;
+    }
+    allocator_deallocate(sort->args.alloc, buffer);
+    return ok && sort->error == 0;
+}
+
+int ext_sort_error(const ExtSort *sort) {
+    return sort->error;
+}
+
+void ext_sort_free(ExtSort *sort) {
+    Allocator alloc = sort->args.alloc;
+    if (sort->sources != NULL) {
+        merge_k_free(&sort->merge);
+        allocator_deallocate(alloc, sort->sources);
+        for (size_t i = 0; i < vec_size(sort->runs); i++) {
+            allocator_deallocate(alloc, sort->runs[i].buffer);
+        }
+    }
+    if (sort->fd >= 0) {
+        close(sort->fd);
+    }
+    vec_free(sort->runs);
+    allocator_deallocate(alloc, sort->run);
+    allocator_deallocate(alloc, sort);
+}
+
+// Sort the run and append it to the temporary file with a single write,
+// the file is created on the first spill. Errors are recorded in the sort.
+static void spill(ExtSort *sort, size_t size) {
+    if (sort->fd < 0) {
+        sort->fd = open_tmp(sort->args.tmp_dir, sort->args.alloc);
+        if (sort->fd < 0) {
+            sort->error = errno;
+            return;
+        }
+    }
+    view_sort(view_new(sort->run, size, sort->elem_size), sort->compare);
+    off_t offset = lseek(sort->fd, 0, SEEK_CUR);
+    if (offset < 0 || !write_all(sort->fd, sort->run, size * sort->elem_size)) {
+        sort->error = errno;
+        return;
+    }
+    vec_push_back(sort->runs, ((SortRun) { .offset = offset, .remaining = size }));
+}
+
+// Create a temporary file and unlink it right away, so it is removed once
+// closed even if the process dies.
+static int open_tmp(const char *tmp_dir, Allocator alloc) {
+    if (tmp_dir == NULL) {
+        tmp_dir = getenv("TMPDIR");
+        tmp_dir = (tmp_dir != NULL && tmp_dir[0] != '\0') ? tmp_dir : "/tmp";
+    }
+    size_t path_size = strlen(tmp_dir) + sizeof("/ext_sort_XXXXXX");
+    char *path = allocator_allocate(alloc, path_size);
+    ASSERT(path != NULL, "Out of memory");
+    snprintf(path, path_size, "%s/ext_sort_XXXXXX", tmp_dir);
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        unlink(path);
+    }
+    allocator_deallocate(alloc, path);
+    return fd;
+}
+
+// Return the next element of a spilled run, refilling its buffer when it
+// is empty. A read error ends the run.
+static Option srit_next(Iterator *iterator) {
+    SortRun *current = iterator->current;
+    ExtSort *sort = current->sort;
+    if (current->pos == current->filled) {
+        if (current->remaining == 0) {
+            return option_none();
+        }
+        size_t count = (current->remaining < current->capacity) ? current->remaining : current->capacity;
+        if (!pread_all(sort->fd, current->buffer, count * sort->elem_size, current->offset)) {
+            sort->error = (sort->error != 0) ? sort->error : errno;
+            current->remaining = 0;
+            current->pos = current->filled;
+            return option_none();
+        }
+        current->offset += (off_t) (count * sort->elem_size);
+        current->remaining -= count;
+        current->pos = 0;
+        current->filled = count;
+    }
+    return option_some(current->buffer + current->pos++ * sort->elem_size);
+}
+
+// A spilled run knows exactly how many elements it has left.
+static SizeHint srit_size_hint(Iterator *iterator) {
+    SortRun *current = iterator->current;
+    size_t size = current->remaining + (current->filled - current->pos);
+    return (SizeHint) { .lower = size, .upper = size };
+}
+
+// Write the whole buffer, retrying on short writes and interrupts.
+static bool write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= (size_t) written;
+    }
+    return true;
+}
+
+// Read the whole buffer at an offset, retrying on short reads and
+// interrupts. Reaching the end of the file early is an error.
+static bool pread_all(int fd, char *data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t bytes = pread(fd, data, size, offset);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (bytes == 0) {
+            errno = EIO;
+            return false;
+        }
+        data += bytes;
+        offset += bytes;
+        size -= (size_t) bytes;
+    }
+    return true;
+}
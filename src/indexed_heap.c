@@ -0,0 +1,264 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../indexed_heap.h"
+
+#define IHEAP_META_PTR(iheap) (((IndexedHeapMeta *) iheap) - 1)
+#define IHEAP_PTR(iheap_meta) ((void *) (iheap_meta + 1))
+#define IHEAP_GET(iheap, key, elem_size) (void *) ((size_t) iheap + ((key) * elem_size))
+#define NOT_IN_HEAP SIZE_MAX
+
+typedef struct {
+    size_t capacity;
+    size_t size;
+    size_t elem_size;
+    size_t arity;
+    compare_fn compare;
+    size_t *heap;
+    size_t *positions;
+    Allocator alloc;
+} IndexedHeapMeta;
+
+static void *resize(IndexedHeapMeta **iheap_meta_ref, size_t new_capacity);
+static size_t find_new_capacity(size_t current_capacity, size_t required_capacity);
+static void sift_up(IndexedHeapMeta *iheap_meta, size_t index);
+static void sift_down(IndexedHeapMeta *iheap_meta, size_t index);
+static void remove_at(IndexedHeapMeta *iheap_meta, size_t index);
+
+void *internal_iheap_new(size_t elem_size, compare_fn compare,
+                         IndexedHeapArgs args) {
+    ASSERT(args.arity >= 2, "arity (is %zu) should be >= 2", args.arity);
+    IndexedHeapMeta *iheap_meta = allocator_allocate(args.alloc, sizeof(IndexedHeapMeta));
+    ASSERT(iheap_meta != NULL, "Out of memory");
+
+    iheap_meta->capacity = 0;
+    iheap_meta->size = 0;
+    iheap_meta->elem_size = elem_size;
+    iheap_meta->arity = args.arity;
+    iheap_meta->compare = compare;
+    iheap_meta->heap = NULL;
+    iheap_meta->positions = NULL;
+    iheap_meta->alloc = args.alloc;
+
+    void *iheap = resize(&iheap_meta, args.cap);
+    ASSERT(iheap != NULL, "Out of memory");
+    return iheap;
+}
+
+void *internal_iheap_push(void *iheap, size_t key, const void *priority) {
+    IndexedHeapMeta *iheap_meta = IHEAP_META_PTR(iheap);
+    if (key >= iheap_meta->capacity) {
+        iheap = resize(
+            &iheap_meta,
+            find_new_capacity(iheap_meta->capacity, key + 1)
+        );
+        ASSERT(iheap != NULL, "Out of memory");
+    }
+    ASSERT(
+        iheap_meta->positions[key] == NOT_IN_HEAP,
+        "key (is %zu) is already in the heap",
+        key
+    );
+
+    // Store the priority and add the key as a leaf.
+    memcpy(IHEAP_GET(iheap, key, iheap_meta->elem_size), priority, iheap_meta->elem_size);
+    iheap_meta->heap[iheap_meta->size] = key;
+    iheap_meta->positions[key] = iheap_meta->size;
+    iheap_meta->size++;
+    sift_up(iheap_meta, iheap_meta->size - 1);
+    return iheap;
+}
+
+void internal_iheap_decrease_key(void *iheap, size_t key, const void *priority) {
+    IndexedHeapMeta *iheap_meta = IHEAP_META_PTR(iheap);
+    ASSERT(iheap_contains(iheap, key), "key (is %zu) is not in the heap", key);
+
+    void *current = IHEAP_GET(iheap, key, iheap_meta->elem_size);
+    ASSERT(
+        iheap_meta->compare(priority, current) <= 0,
+        "new priority of key (is %zu) should be <= its current priority",
+        key
+    );
+    memcpy(current, priority, iheap_meta->elem_size);
+    sift_up(iheap_meta, iheap_meta->positions[key]);
+}
+
+size_t iheap_pop(void *iheap) {
+    IndexedHeapMeta *iheap_meta = IHEAP_META_PTR(iheap);
+    ASSERT(
+        iheap_meta->size > 0,
+        "iheap_size (is %zu) should be > 0",
+        iheap_meta->size
+    );
+    size_t key = iheap_meta->heap[0];
+    remove_at(iheap_meta, 0);
+    return key;
+}
+
+size_t iheap_top(const void *iheap) {
+    IndexedHeapMeta *iheap_meta = IHEAP_META_PTR(iheap);
+    ASSERT(
+        iheap_meta->size > 0,
+        "iheap_size (is %zu) should be > 0",
+        iheap_meta->size
+    );
+    return iheap_meta->heap[0];
+}
+
+void iheap_remove(void *iheap, size_t key) {
+    ASSERT(iheap_contains(iheap, key), "key (is %zu) is not in the heap", key);
+    IndexedHeapMeta *iheap_meta = IHEAP_META_PTR(iheap);
+    remove_at(iheap_meta, iheap_meta->positions[key]);
+}
+
+bool iheap_contains(const void *iheap, size_t key) {
+    IndexedHeapMeta *iheap_meta = IHEAP_META_PTR(iheap);
+    return key < iheap_meta->capacity && iheap_meta->positions[key] != NOT_IN_HEAP;
+}
+
+size_t iheap_size(const void *iheap) {
+    return IHEAP_META_PTR(iheap)->size;
+}
+
+size_t iheap_capacity(const void *iheap) {
+    return IHEAP_META_PTR(iheap)->capacity;
+}
+
+bool iheap_is_empty(const void *iheap) {
+    return iheap_size(iheap) == 0;
+}
+
+void iheap_clear(void *iheap) {
+    IndexedHeapMeta *iheap_meta = IHEAP_META_PTR(iheap);
+    for (size_t i = 0; i < iheap_meta->size; i++) {
+        iheap_meta->positions[iheap_meta->heap[i]] = NOT_IN_HEAP;
+    }
+    iheap_meta->size = 0;
+}
+
+void iheap_free(void *iheap) {
+    IndexedHeapMeta *iheap_meta = IHEAP_META_PTR(iheap);
+    allocator_deallocate(iheap_meta->alloc, iheap_meta->heap);
+    allocator_deallocate(iheap_meta->alloc, iheap_meta);
+}
+
+// Resize the capacity to new_capacity, growing the priorities, the heap and
+// the key positions. Updates iheap_meta_ref and returns the updated heap.
+static void *resize(IndexedHeapMeta **iheap_meta_ref, size_t new_capacity) {
+    IndexedHeapMeta *iheap_meta = *iheap_meta_ref;
+    size_t old_capacity = iheap_meta->capacity;
+    if (new_capacity <= old_capacity && iheap_meta->heap != NULL) {
+        return IHEAP_PTR(iheap_meta);
+    }
+
+    // The heap and the positions share one allocation, heap first.
+    size_t *heap = allocator_reallocate(
+        iheap_meta->alloc,
+        iheap_meta->heap,
+        2 * sizeof(size_t) * ((new_capacity == 0) ? 1 : new_capacity)
+    );
+    if (heap == NULL) {
+        return NULL;
+    }
+    size_t *positions = heap + new_capacity;
+    memmove(positions, heap + old_capacity, old_capacity * sizeof(size_t));
+    for (size_t i = old_capacity; i < new_capacity; i++) {
+        positions[i] = NOT_IN_HEAP;
+    }
+    iheap_meta->heap = heap;
+    iheap_meta->positions = positions;
+
+    iheap_meta = allocator_reallocate(
+        iheap_meta->alloc,
+        iheap_meta,
+        sizeof(IndexedHeapMeta) + (iheap_meta->elem_size * new_capacity)
+    );
+    if (iheap_meta == NULL) {
+        return NULL;
+    }
+    memset(
+        IHEAP_GET(IHEAP_PTR(iheap_meta), old_capacity, iheap_meta->elem_size),
+        0,
+        (new_capacity - old_capacity) * iheap_meta->elem_size
+    );
+    iheap_meta->capacity = new_capacity;
+    *iheap_meta_ref = iheap_meta;
+    return IHEAP_PTR(iheap_meta);
+}
+
+// Find the capacity that is a power of 2 which is greater than or equal to required_capacity.
+static size_t find_new_capacity(size_t current_capacity, size_t required_capacity) {
+    current_capacity = (current_capacity == 0) ? 1 : current_capacity;
+    while (current_capacity < required_capacity) {
+        current_capacity *= 2;
+    }
+    return current_capacity;
+}
+
+// Move the key at heap index towards the root until its parent is not greater.
+static void sift_up(IndexedHeapMeta *iheap_meta, size_t index) {
+    void *iheap = IHEAP_PTR(iheap_meta);
+    size_t key = iheap_meta->heap[index];
+    void *priority = IHEAP_GET(iheap, key, iheap_meta->elem_size);
+
+    while (index > 0) {
+        size_t parent = (index - 1) / iheap_meta->arity;
+        size_t parent_key = iheap_meta->heap[parent];
+        if (iheap_meta->compare(priority, IHEAP_GET(iheap, parent_key, iheap_meta->elem_size)) >= 0) {
+            break;
+        }
+        iheap_meta->heap[index] = parent_key;
+        iheap_meta->positions[parent_key] = index;
+        index = parent;
+    }
+    iheap_meta->heap[index] = key;
+    iheap_meta->positions[key] = index;
+}
+
+// Move the key at heap index towards the leaves until no child is smaller.
+static void sift_down(IndexedHeapMeta *iheap_meta, size_t index) {
+    void *iheap = IHEAP_PTR(iheap_meta);
+    size_t key = iheap_meta->heap[index];
+    void *priority = IHEAP_GET(iheap, key, iheap_meta->elem_size);
+
+    for (size_t child = index * iheap_meta->arity + 1; child < iheap_meta->size;
+         child = index * iheap_meta->arity + 1) {
+        size_t last_child = child + iheap_meta->arity;
+        last_child = (last_child < iheap_meta->size) ? last_child : iheap_meta->size;
+
+        size_t min_child = child;
+        void *min_priority = IHEAP_GET(iheap, iheap_meta->heap[child], iheap_meta->elem_size);
+        for (size_t i = child + 1; i < last_child; i++) {
+            void *child_priority = IHEAP_GET(iheap, iheap_meta->heap[i], iheap_meta->elem_size);
+            if (iheap_meta->compare(child_priority, min_priority) < 0) {
+                min_priority = child_priority;
+                min_child = i;
+            }
+        }
+
+        if (iheap_meta->compare(min_priority, priority) >= 0) {
+            break;
+        }
+        iheap_meta->heap[index] = iheap_meta->heap[min_child];
+        iheap_meta->positions[iheap_meta->heap[index]] = index;
+        index = min_child;
+    }
+    iheap_meta->heap[index] = key;
+    iheap_meta->positions[key] = index;
+}
+
+// Remove the key at heap index by replacing it with the last leaf.
+static void remove_at(IndexedHeapMeta *iheap_meta, size_t index) {
+    iheap_meta->positions[iheap_meta->heap[index]] = NOT_IN_HEAP;
+    iheap_meta->size--;
+    if (index == iheap_meta->size) {
+        return;
+    }
+
+    // The last leaf may have to move either up or down from its new
+    // position, if it moves up then the sift down is a no-op.
+    iheap_meta->heap[index] = iheap_meta->heap[iheap_meta->size];
+    iheap_meta->positions[iheap_meta->heap[index]] = index;
+    sift_up(iheap_meta, index);
+    sift_down(iheap_meta, index);
+}
@@ -1,74 +1,134 @@
+#include <string.h>
+
 #include "../iter_utils.h"
 
+static Chunk peek_chunk(Iterator *iterator);
+static void consume(Iterator *iterator, size_t n);
+static size_t mapped_ahead(const Map *map);
 static Option mit_next(Iterator *iterator);
 static Option mit_advance(Iterator *iterator, size_t n);
+static size_t mit_size(Iterator *iterator);
+static SizeHint mit_size_hint(Iterator *iterator);
+static Chunk mit_take_chunk(Iterator *iterator);
+static Option mit_next_back(Iterator *iterator);
+static Option mit_get(Iterator *iterator, size_t index);
 static Option fit_next(Iterator *iterator);
 static Option fit_advance(Iterator *iterator, size_t n);
+static SizeHint fit_size_hint(Iterator *iterator);
+static Chunk fit_next_chunk(Iterator *iterator);
+static Option fit_next_back(Iterator *iterator);
+static void take_run(Filter *filter, size_t n);
+static void skip_rejected(Filter *filter);
+static Option rit_next(Iterator *iterator);
+static size_t rit_size(Iterator *iterator);
+static SizeHint rit_size_hint(Iterator *iterator);
+static Option rit_next_back(Iterator *iterator);
+static Option rit_get(Iterator *iterator, size_t index);
+static Option zit_next(Iterator *iterator);
+static Option zit_advance(Iterator *iterator, size_t n);
+static SizeHint zit_size_hint(Iterator *iterator);
+static Option zit_get(Iterator *iterator, size_t index);
+static Option chit_next(Iterator *iterator);
+static SizeHint chit_size_hint(Iterator *iterator);
+static Option chit_get(Iterator *iterator, size_t index);
+static Option eit_next(Iterator *iterator);
+static Option eit_advance(Iterator *iterator, size_t n);
+static SizeHint eit_size_hint(Iterator *iterator);
+static Option eit_get(Iterator *iterator, size_t index);
+static Option tit_next(Iterator *iterator);
+static Option tit_advance(Iterator *iterator, size_t n);
+static SizeHint tit_size_hint(Iterator *iterator);
+static Chunk tit_next_chunk(Iterator *iterator);
+static Option tit_get(Iterator *iterator, size_t index);
+static void skip_prefix(Skip *skip);
+static Option skit_next(Iterator *iterator);
+static Option skit_advance(Iterator *iterator, size_t n);
+static SizeHint skit_size_hint(Iterator *iterator);
+static Chunk skit_next_chunk(Iterator *iterator);
+static Option skit_get(Iterator *iterator, size_t index);
+static Option sbit_next(Iterator *iterator);
+static Option sbit_advance(Iterator *iterator, size_t n);
+static SizeHint sbit_size_hint(Iterator *iterator);
+static Option sbit_get(Iterator *iterator, size_t index);
+static Option ckit_next(Iterator *iterator);
+static SizeHint ckit_size_hint(Iterator *iterator);
+static Option ckit_get(Iterator *iterator, size_t index);
+static Option wnit_next(Iterator *iterator);
+static SizeHint wnit_size_hint(Iterator *iterator);
+static Option wnit_get(Iterator *iterator, size_t index);
+static Option mkit_next(Iterator *iterator);
+static SizeHint mkit_size_hint(Iterator *iterator);
+static bool merge_beats(const MergeK *merge, size_t a, size_t b);
+static size_t merge_build(MergeK *merge, size_t node);
+static void merge_replay(MergeK *merge, size_t leaf);
+static size_t saturating_add(size_t a, size_t b);
+static size_t saturating_sub(size_t a, size_t b);
 
 bool iter_all(Iterator *iterator, pred_fn predicate) {
-    for (
-        Option option = iter_next(*iterator);
-        option.is_valid;
-        option = iter_next(*iterator)
-    ) {
-        if (!option_filter(option, predicate).is_valid) {
-            return false;
+    for (Chunk chunk = peek_chunk(iterator); chunk.size > 0; chunk = peek_chunk(iterator)) {
+        for (size_t i = 0; i < chunk.size; i++) {
+            if (!predicate(CHUNK_GET(chunk, i))) {
+                consume(iterator, i + 1);
+                return false;
+            }
         }
+        consume(iterator, chunk.size);
     }
     return true;
 }
 
 bool iter_any(Iterator *iterator, pred_fn predicate) {
-    for (
-        Option option = iter_next(*iterator);
-        option.is_valid;
-        option = iter_next(*iterator)
-    ) {
-        if (option_filter(option, predicate).is_valid) {
-            return true;
+    for (Chunk chunk = peek_chunk(iterator); chunk.size > 0; chunk = peek_chunk(iterator)) {
+        for (size_t i = 0; i < chunk.size; i++) {
+            if (predicate(CHUNK_GET(chunk, i))) {
+                consume(iterator, i + 1);
+                return true;
+            }
         }
+        consume(iterator, chunk.size);
     }
     return false;
 }
 
 Option iter_find(Iterator *iterator, pred_fn predicate) {
-    for (
-        Option option = iter_next(*iterator);
-        option.is_valid;
-        option = iter_next(*iterator)
-    ) {
-        if (option_filter(option, predicate).is_valid) {
-            return option;
+    for (Chunk chunk = peek_chunk(iterator); chunk.size > 0; chunk = peek_chunk(iterator)) {
+        for (size_t i = 0; i < chunk.size; i++) {
+            void *elem = CHUNK_GET(chunk, i);
+            if (predicate(elem)) {
+                consume(iterator, i + 1);
+                return option_some(elem);
+            }
         }
+        consume(iterator, chunk.size);
     }
     return option_none();
 }
 
 Option iter_find_map(Iterator *iterator, map_opt_fn unary_op) {
-    for (
-        Option option = iter_next(*iterator);
-        option.is_valid;
-        option = iter_next(*iterator)
-    ) {
-        option = option_and_then(option, unary_op);
-        if (option.is_valid) {
-            return option;
+    for (Chunk chunk = peek_chunk(iterator); chunk.size > 0; chunk = peek_chunk(iterator)) {
+        for (size_t i = 0; i < chunk.size; i++) {
+            Option option = unary_op(CHUNK_GET(chunk, i));
+            if (option.is_valid) {
+                consume(iterator, i + 1);
+                return option;
+            }
         }
+        consume(iterator, chunk.size);
     }
     return option_none();
 }
 
 int iter_find_index(Iterator *iterator, pred_fn predicate) {
     int index = 0;
-    for (
-        Option option = iter_next(*iterator);
-        option.is_valid;
-        option = iter_next(*iterator)
-    ) {
-        if (option_filter(option, predicate).is_valid) {
-            return index;
+    for (Chunk chunk = peek_chunk(iterator); chunk.size > 0; chunk = peek_chunk(iterator)) {
+        for (size_t i = 0; i < chunk.size; i++) {
+            if (predicate(CHUNK_GET(chunk, i))) {
+                consume(iterator, i + 1);
+                return index;
+            }
+            index++;
         }
-        index++;
+        consume(iterator, chunk.size);
     }
     return -1;
 }
@@ -78,89 +138,945 @@ bool iter_is_partitioned(Iterator *iterator, pred_fn predicate) {
 }
 
 bool iter_is_sorted(Iterator *iterator, compare_fn compare) {
-    for (
-        Option option_prev = iter_next(*iterator), option_cur = iter_next(*iterator);
-        option_cur.is_valid;
-        option_prev = option_cur, option_cur = iter_next(*iterator)
-    ) {
-        if (compare(option_prev.value, option_cur.value) > 0) {
-            return false;
+    void *prev = NULL;
+    for (Chunk chunk = peek_chunk(iterator); chunk.size > 0; chunk = peek_chunk(iterator)) {
+        for (size_t i = 0; i < chunk.size; i++) {
+            void *cur = CHUNK_GET(chunk, i);
+            if (prev != NULL && compare(prev, cur) > 0) {
+                consume(iterator, i + 1);
+                return false;
+            }
+            prev = cur;
         }
+        consume(iterator, chunk.size);
     }
     return true;
 }
 
 int iter_compare(Iterator *iterator1, Iterator *iterator2, compare_fn compare) {
-    Option option1 = iter_next(*iterator1);
-    Option option2 = iter_next(*iterator2);
-    for (
-        ;
-        option_and(option1, option2).is_valid;
-        option1 = iter_next(*iterator1), option2 = iter_next(*iterator2)
-    ) {
-        int cmp_result = compare(option1.value, option2.value);
-        if (cmp_result != 0) {
-            return cmp_result;
+    Chunk chunk1 = peek_chunk(iterator1);
+    Chunk chunk2 = peek_chunk(iterator2);
+    while (chunk1.size > 0 && chunk2.size > 0) {
+        // Compare the elements both blocks have, then refill the
+        // exhausted block(s).
+        size_t size = (chunk1.size < chunk2.size) ? chunk1.size : chunk2.size;
+        for (size_t i = 0; i < size; i++) {
+            int cmp_result = compare(CHUNK_GET(chunk1, i), CHUNK_GET(chunk2, i));
+            if (cmp_result != 0) {
+                consume(iterator1, i + 1);
+                consume(iterator2, i + 1);
+                return cmp_result;
+            }
+        }
+
+        consume(iterator1, size);
+        consume(iterator2, size);
+        if (size == chunk1.size) {
+            chunk1 = peek_chunk(iterator1);
+        } else {
+            chunk1.data = CHUNK_GET(chunk1, size);
+            chunk1.size -= size;
+        }
+        if (size == chunk2.size) {
+            chunk2 = peek_chunk(iterator2);
+        } else {
+            chunk2.data = CHUNK_GET(chunk2, size);
+            chunk2.size -= size;
         }
     }
-    return (option1.is_valid) ? 1 : ((option2.is_valid) ? -1 : 0);
+    return (chunk1.size > 0) ? 1 : ((chunk2.size > 0) ? -1 : 0);
 }
 
 Option iter_last(Iterator *iterator) {
-    Option option_prev = iter_next(*iterator);
-    for (
-        Option option_cur = iter_next(*iterator);
-        option_cur.is_valid;
-        option_prev = option_cur, option_cur = iter_next(*iterator)
-    );
-    return option_prev;
+    if (iter_has_flags(*iterator, ITER_DOUBLE_ENDED)) {
+        return iter_next_back(*iterator);
+    }
+
+    Option option_last = option_none();
+    for (Chunk chunk = iter_take_chunk(iterator); chunk.size > 0; chunk = iter_take_chunk(iterator)) {
+        option_last = option_some(CHUNK_GET(chunk, chunk.size - 1));
+    }
+    return option_last;
 }
 
 void iter_reduce(Iterator *iterator, void (*func)(void *, void *), void *init) {
-    for (Option option = iter_next(*iterator); option.is_valid;
-         option = iter_next(*iterator)) {
-        func(init, option.value);
+    for (Chunk chunk = iter_take_chunk(iterator); chunk.size > 0; chunk = iter_take_chunk(iterator)) {
+        for (size_t i = 0; i < chunk.size; i++) {
+            func(init, CHUNK_GET(chunk, i));
+        }
     }
 }
 
 Iterator map_iter(Map *map, Iterator *iterator, map_fn unary_op) {
     map->iterator = iterator;
     map->unary_op = unary_op;
+    map->front = 0;
+    map->mapped_front = 0;
     Iterator map_iterator = iter_default(NULL, map, mit_next);
     map_iterator.advance = mit_advance;
-    map_iterator.size = map->iterator->size;
+    map_iterator.size = mit_size;
+    map_iterator.size_hint = mit_size_hint;
+    map_iterator.take_chunk = mit_take_chunk;
+    map_iterator.next_back = iter_has_flags(*iterator, ITER_DOUBLE_ENDED) ? mit_next_back : NULL;
+    map_iterator.get = iter_has_flags(*iterator, ITER_RANDOM_ACCESS) ? mit_get : NULL;
+    map_iterator.flags = iterator->flags;
     return map_iterator;
 }
 
 Iterator filter_iter(Filter *filter, Iterator *iterator, pred_fn predicate) {
     filter->iterator = iterator;
     filter->predicate = predicate;
+    filter->run = (Chunk) { .data = NULL, .size = 0, .elem_size = 0 };
+    filter->rejected = 0;
     Iterator filter_iterator = iter_default(NULL, filter, fit_next);
     filter_iterator.advance = fit_advance;
+    filter_iterator.size_hint = fit_size_hint;
+    filter_iterator.next_chunk = iter_has_chunks(*iterator) ? fit_next_chunk : NULL;
+    filter_iterator.next_back = iter_has_flags(*iterator, ITER_DOUBLE_ENDED) ? fit_next_back : NULL;
+    filter_iterator.flags = iterator->flags & ITER_DOUBLE_ENDED;
     return filter_iterator;
 }
 
+Iterator rev_iter(Rev *rev, Iterator *iterator) {
+    ASSERT(
+        iter_has_flags(*iterator, ITER_DOUBLE_ENDED),
+        "iterator should be double ended"
+    );
+    rev->iterator = iterator;
+    Iterator rev_iterator = iter_default(NULL, rev, rit_next);
+    rev_iterator.size = rit_size;
+    rev_iterator.size_hint = rit_size_hint;
+    rev_iterator.next_back = rit_next_back;
+    rev_iterator.get = iter_has_flags(*iterator, ITER_RANDOM_ACCESS) ? rit_get : NULL;
+    rev_iterator.flags = iterator->flags;
+    return rev_iterator;
+}
+
+Iterator zip_iter(Zip *zip, Iterator *iterator1, Iterator *iterator2) {
+    zip->iterator1 = iterator1;
+    zip->iterator2 = iterator2;
+    Iterator zip_iterator = iter_default(NULL, zip, zit_next);
+    zip_iterator.advance = zit_advance;
+    zip_iterator.size_hint = zit_size_hint;
+    zip_iterator.flags = iterator1->flags & iterator2->flags & ITER_RANDOM_ACCESS;
+    zip_iterator.get = iter_has_flags(zip_iterator, ITER_RANDOM_ACCESS) ? zit_get : NULL;
+    return zip_iterator;
+}
+
+Iterator chain_iter(Chain *chain, Iterator *iterator1, Iterator *iterator2) {
+    chain->iterator1 = iterator1;
+    chain->iterator2 = iterator2;
+    Iterator chain_iterator = iter_default(NULL, chain, chit_next);
+    chain_iterator.size_hint = chit_size_hint;
+    chain_iterator.flags = iterator1->flags & iterator2->flags & ITER_RANDOM_ACCESS;
+    chain_iterator.get = iter_has_flags(chain_iterator, ITER_RANDOM_ACCESS) ? chit_get : NULL;
+    return chain_iterator;
+}
+
+Iterator enumerate_iter(Enumerate *enumerate, Iterator *iterator) {
+    enumerate->iterator = iterator;
+    enumerate->index = 0;
+    Iterator enumerate_iterator = iter_default(NULL, enumerate, eit_next);
+    enumerate_iterator.advance = eit_advance;
+    enumerate_iterator.size_hint = eit_size_hint;
+    enumerate_iterator.flags = iterator->flags & ITER_RANDOM_ACCESS;
+    enumerate_iterator.get = iter_has_flags(*iterator, ITER_RANDOM_ACCESS) ? eit_get : NULL;
+    return enumerate_iterator;
+}
+
+Iterator take_iter(Take *take, Iterator *iterator, size_t n) {
+    take->iterator = iterator;
+    take->n = n;
+    Iterator take_iterator = iter_default(NULL, take, tit_next);
+    take_iterator.advance = tit_advance;
+    take_iterator.size_hint = tit_size_hint;
+    take_iterator.next_chunk = iter_has_chunks(*iterator) ? tit_next_chunk : NULL;
+    take_iterator.flags = iterator->flags & ITER_RANDOM_ACCESS;
+    take_iterator.get = iter_has_flags(*iterator, ITER_RANDOM_ACCESS) ? tit_get : NULL;
+    return take_iterator;
+}
+
+Iterator skip_iter(Skip *skip, Iterator *iterator, size_t n) {
+    skip->iterator = iterator;
+    skip->n = n;
+    Iterator skip_iterator = iter_default(NULL, skip, skit_next);
+    skip_iterator.advance = skit_advance;
+    skip_iterator.size_hint = skit_size_hint;
+    skip_iterator.next_chunk = iter_has_chunks(*iterator) ? skit_next_chunk : NULL;
+    skip_iterator.flags = iterator->flags & ITER_RANDOM_ACCESS;
+    skip_iterator.get = iter_has_flags(*iterator, ITER_RANDOM_ACCESS) ? skit_get : NULL;
+    return skip_iterator;
+}
+
+Iterator step_by_iter(StepBy *step_by, Iterator *iterator, size_t step) {
+    ASSERT(step > 0, "step (is %zu) should be > 0", step);
+    step_by->iterator = iterator;
+    step_by->step = step;
+    Iterator step_by_iterator = iter_default(NULL, step_by, sbit_next);
+    step_by_iterator.advance = sbit_advance;
+    step_by_iterator.size_hint = sbit_size_hint;
+    step_by_iterator.flags = iterator->flags & ITER_RANDOM_ACCESS;
+    step_by_iterator.get = iter_has_flags(*iterator, ITER_RANDOM_ACCESS) ? sbit_get : NULL;
+    return step_by_iterator;
+}
+
+Iterator chunks_iter(Chunks *chunks, Iterator *iterator, void *buffer, size_t elem_size, size_t size) {
+    ASSERT(size > 0, "size (is %zu) should be > 0", size);
+    chunks->iterator = iterator;
+    chunks->elem_size = elem_size;
+    chunks->size = size;
+    chunks->buffer = buffer;
+    Iterator chunks_iterator = iter_default(NULL, chunks, ckit_next);
+    chunks_iterator.size_hint = ckit_size_hint;
+    if (iter_has_flags(*iterator, ITER_RANDOM_ACCESS) && iter_has_chunks(*iterator)) {
+        chunks_iterator.flags = ITER_RANDOM_ACCESS;
+        chunks_iterator.get = ckit_get;
+    }
+    return chunks_iterator;
+}
+
+Iterator windows_iter(
+    Windows *windows,
+    Iterator *iterator,
+    void *buffer,
+    size_t elem_size,
+    size_t size
+) {
+    ASSERT(size > 0, "size (is %zu) should be > 0", size);
+    windows->iterator = iterator;
+    windows->elem_size = elem_size;
+    windows->size = size;
+    windows->buffering = false;
+    windows->head = 0;
+    windows->buffer = buffer;
+    Iterator windows_iterator = iter_default(NULL, windows, wnit_next);
+    windows_iterator.size_hint = wnit_size_hint;
+    if (iter_has_flags(*iterator, ITER_RANDOM_ACCESS) && iter_has_chunks(*iterator)) {
+        windows_iterator.flags = ITER_RANDOM_ACCESS;
+        windows_iterator.get = wnit_get;
+    }
+    return windows_iterator;
+}
+
+Iterator merge_k_iter(
+    MergeK *merge,
+    Iterator *iterators,
+    size_t k,
+    size_t elem_size,
+    compare_fn compare,
+    Allocator alloc
+) {
+    merge->iterators = iterators;
+    merge->k = k;
+    merge->elem_size = elem_size;
+    merge->compare = compare;
+    merge->dedup = false;
+    merge->started = false;
+    merge->yielded = k;
+    merge->has_last = false;
+    merge->last = NULL;
+    merge->alloc = alloc;
+    merge->heads = allocator_allocate(merge->alloc, (k > 0 ? k : 1) * sizeof(void *));
+    merge->tree = allocator_allocate(merge->alloc, (k > 0 ? k : 1) * sizeof(size_t));
+    ASSERT(merge->heads != NULL && merge->tree != NULL, "Out of memory");
+    Iterator merge_iterator = iter_default(NULL, merge, mkit_next);
+    merge_iterator.size_hint = mkit_size_hint;
+    return merge_iterator;
+}
+
+Iterator merge_k_dedup_iter(
+    MergeK *merge,
+    Iterator *iterators,
+    size_t k,
+    size_t elem_size,
+    compare_fn compare,
+    Allocator alloc
+) {
+    Iterator merge_iterator = merge_k_iter(merge, iterators, k, elem_size, compare, alloc);
+    merge->dedup = true;
+    merge->last = allocator_allocate(merge->alloc, (elem_size > 0) ? elem_size : 1);
+    ASSERT(merge->last != NULL, "Out of memory");
+    return merge_iterator;
+}
+
+void merge_k_free(MergeK *merge) {
+    allocator_deallocate(merge->alloc, merge->heads);
+    allocator_deallocate(merge->alloc, merge->tree);
+    allocator_deallocate(merge->alloc, merge->last);
+}
+
+// Get the next block of elements, an iterator without next_chunk gives a
+// block of 1 element which is already consumed.
+static Chunk peek_chunk(Iterator *iterator) {
+    if (!iter_has_chunks(*iterator)) {
+        Option option = iter_next(*iterator);
+        return (Chunk) { .data = option.value, .size = option.is_valid, .elem_size = 0 };
+    }
+    return iter_next_chunk(*iterator);
+}
+
+// Move the iterator past n elements of the block from peek_chunk.
+static void consume(Iterator *iterator, size_t n) {
+    if (iter_has_chunks(*iterator) && n > 0) {
+        iter_advance(*iterator, n);
+    }
+}
+
+// Get the number of elements from the front of the map that get has
+// already mapped. Elements are mapped in place, so each one must be mapped
+// exactly once however it is reached. Elements taken from the source by
+// next, advance, take_chunk or next_back are only reached once, so get is
+// the only way to reach them twice.
+static size_t mapped_ahead(const Map *map) {
+    return (map->mapped_front > map->front) ? map->mapped_front - map->front : 0;
+}
+
 static Option mit_next(Iterator *iterator) {
-    Map *current = iterator->current;
-    Option option = iter_next(*(current->iterator));
-    option_map(option, current->unary_op);
-    return option;
+    return mit_advance(iterator, 1);
 }
 
 static Option mit_advance(Iterator *iterator, size_t n) {
     Map *current = iterator->current;
     Option option = iter_advance(*(current->iterator), n);
-    option_map(option, current->unary_op);
+    if (option.is_valid && mapped_ahead(current) == 0) {
+        current->unary_op(option.value);
+    }
+    if (option.is_valid) {
+        current->mapped_front = (current->front + 1 > current->mapped_front)
+            ? current->front + 1
+            : current->mapped_front;
+        current->front += n;
+    }
+    return option;
+}
+
+static size_t mit_size(Iterator *iterator) {
+    Map *current = iterator->current;
+    return iter_size(*(current->iterator));
+}
+
+static SizeHint mit_size_hint(Iterator *iterator) {
+    Map *current = iterator->current;
+    return iter_size_hint(*(current->iterator));
+}
+
+// A map has no next_chunk, as peeking would map elements that may never
+// be taken. The block is taken from the source first, then mapped.
+static Chunk mit_take_chunk(Iterator *iterator) {
+    Map *current = iterator->current;
+    size_t start = mapped_ahead(current);
+    Chunk chunk = iter_take_chunk(current->iterator);
+    for (size_t i = start; i < chunk.size; i++) {
+        current->unary_op(CHUNK_GET(chunk, i));
+    }
+    current->front += chunk.size;
+    if (current->front > current->mapped_front) {
+        current->mapped_front = current->front;
+    }
+    return chunk;
+}
+
+// Only a map over a random access source, which has an exact size, can
+// have elements mapped ahead by get, so the position of the back element
+// is only needed then.
+static Option mit_next_back(Iterator *iterator) {
+    Map *current = iterator->current;
+    size_t ahead = mapped_ahead(current);
+    size_t position = (ahead > 0) ? iter_size_hint(*(current->iterator)).lower - 1 : 0;
+    Option option = iter_next_back(*(current->iterator));
+    if (option.is_valid && (ahead == 0 || position >= ahead)) {
+        current->unary_op(option.value);
+    }
+    return option;
+}
+
+// Map every element up to index, so the mapped elements stay a prefix and
+// each element is still mapped once.
+static Option mit_get(Iterator *iterator, size_t index) {
+    Map *current = iterator->current;
+    size_t start = mapped_ahead(current);
+    Option option = iter_get(*(current->iterator), index);
+    if (!option.is_valid || index < start) {
+        return option;
+    }
+
+    for (size_t i = start; i <= index; i++) {
+        current->unary_op(iter_get(*(current->iterator), i).value);
+    }
+    current->mapped_front = current->front + index + 1;
     return option;
 }
 
 static Option fit_next(Iterator *iterator) {
     Filter *current = iterator->current;
+    if (current->run.size > 0) {
+        take_run(current, 1);
+        return iter_next(*(current->iterator));
+    }
+    skip_rejected(current);
     return iter_find(current->iterator, current->predicate);
 }
 
 static Option fit_advance(Iterator *iterator, size_t n) {
     Filter *current = iterator->current;
-    iter_advance(*(current->iterator), n);
-    return iter_find(iterator, current->predicate);
+    if (!iter_has_chunks(*iterator)) {
+        Option ret = fit_next(iterator);
+        while (--n > 0 && fit_next(iterator).is_valid);
+        return ret;
+    }
+
+    // Skip whole runs of matching elements at a time.
+    Option ret = option_none();
+    while (n > 0) {
+        Chunk chunk = fit_next_chunk(iterator);
+        if (chunk.size == 0) {
+            break;
+        }
+        size_t count = (chunk.size < n) ? chunk.size : n;
+        ret = ret.is_valid ? ret : option_some(chunk.data);
+        take_run(current, count);
+        iter_advance(*(current->iterator), count);
+        n -= count;
+    }
+    return ret;
+}
+
+// Any number of the source's elements may be filtered out.
+static SizeHint fit_size_hint(Iterator *iterator) {
+    Filter *current = iterator->current;
+    return (SizeHint) { .lower = 0, .upper = iter_size_hint(*(current->iterator)).upper };
+}
+
+// Skip the source's elements up to the next match and get the run of
+// matching elements that starts there, unless a run is already known.
+static Chunk fit_next_chunk(Iterator *iterator) {
+    Filter *current = iterator->current;
+    if (current->run.size > 0) {
+        return current->run;
+    }
+    skip_rejected(current);
+    for (
+        Chunk chunk = iter_next_chunk(*(current->iterator));
+        chunk.size > 0;
+        chunk = iter_next_chunk(*(current->iterator))
+    ) {
+        size_t start = 0;
+        while (start < chunk.size && !current->predicate(CHUNK_GET(chunk, start))) {
+            start++;
+        }
+        if (start == chunk.size) {
+            iter_advance(*(current->iterator), chunk.size);
+            continue;
+        }
+        if (start > 0) {
+            iter_advance(*(current->iterator), start);
+        }
+
+        size_t end = start + 1;
+        while (end < chunk.size && current->predicate(CHUNK_GET(chunk, end))) {
+            end++;
+        }
+        current->run = (Chunk) {
+            .data = CHUNK_GET(chunk, start),
+            .size = end - start,
+            .elem_size = chunk.elem_size
+        };
+        current->rejected = (end < chunk.size) ? 1 : 0;
+        return current->run;
+    }
+    return (Chunk) { .data = NULL, .size = 0, .elem_size = 0 };
+}
+
+// The known run may reach the back, so it is dropped and tested again.
+static Option fit_next_back(Iterator *iterator) {
+    Filter *current = iterator->current;
+    current->run.size = 0;
+    current->rejected = 0;
+    for (
+        Option option = iter_next_back(*(current->iterator));
+        option.is_valid;
+        option = iter_next_back(*(current->iterator))
+    ) {
+        if (current->predicate(option.value)) {
+            return option;
+        }
+    }
+    return option_none();
+}
+
+// Drop the first n elements of the known run as they are taken.
+static void take_run(Filter *filter, size_t n) {
+    n = (n < filter->run.size) ? n : filter->run.size;
+    filter->run.data = CHUNK_GET(filter->run, n);
+    filter->run.size -= n;
+}
+
+// Move the source past the rejected elements once the run is taken.
+static void skip_rejected(Filter *filter) {
+    if (filter->rejected > 0) {
+        iter_advance(*(filter->iterator), filter->rejected);
+        filter->rejected = 0;
+    }
+}
+
+static Option rit_next(Iterator *iterator) {
+    Rev *current = iterator->current;
+    return iter_next_back(*(current->iterator));
+}
+
+static size_t rit_size(Iterator *iterator) {
+    Rev *current = iterator->current;
+    return iter_size(*(current->iterator));
+}
+
+static SizeHint rit_size_hint(Iterator *iterator) {
+    Rev *current = iterator->current;
+    return iter_size_hint(*(current->iterator));
+}
+
+static Option rit_next_back(Iterator *iterator) {
+    Rev *current = iterator->current;
+    return iter_next(*(current->iterator));
+}
+
+static Option rit_get(Iterator *iterator, size_t index) {
+    Rev *current = iterator->current;
+    size_t size = iter_size_hint(*(current->iterator)).lower;
+    if (index >= size) {
+        return option_none();
+    }
+    return iter_get(*(current->iterator), size - 1 - index);
+}
+
+static Option zit_next(Iterator *iterator) {
+    return zit_advance(iterator, 1);
+}
+
+static Option zit_advance(Iterator *iterator, size_t n) {
+    Zip *current = iterator->current;
+    Option option1 = iter_advance(*(current->iterator1), n);
+    Option option2 = iter_advance(*(current->iterator2), n);
+    if (!option1.is_valid || !option2.is_valid) {
+        return option_none();
+    }
+    current->pair = (Pair) { .first = option1.value, .second = option2.value };
+    return option_some(&current->pair);
+}
+
+static SizeHint zit_size_hint(Iterator *iterator) {
+    Zip *current = iterator->current;
+    return size_hint_min(
+        iter_size_hint(*(current->iterator1)),
+        iter_size_hint(*(current->iterator2))
+    );
+}
+
+static Option zit_get(Iterator *iterator, size_t index) {
+    Zip *current = iterator->current;
+    Option option1 = iter_get(*(current->iterator1), index);
+    Option option2 = iter_get(*(current->iterator2), index);
+    if (!option1.is_valid || !option2.is_valid) {
+        return option_none();
+    }
+    current->pair = (Pair) { .first = option1.value, .second = option2.value };
+    return option_some(&current->pair);
+}
+
+static Option chit_next(Iterator *iterator) {
+    Chain *current = iterator->current;
+    Option option = iter_next(*(current->iterator1));
+    return option.is_valid ? option : iter_next(*(current->iterator2));
+}
+
+static SizeHint chit_size_hint(Iterator *iterator) {
+    Chain *current = iterator->current;
+    SizeHint hint1 = iter_size_hint(*(current->iterator1));
+    SizeHint hint2 = iter_size_hint(*(current->iterator2));
+    return (SizeHint) {
+        .lower = saturating_add(hint1.lower, hint2.lower),
+        .upper = saturating_add(hint1.upper, hint2.upper)
+    };
+}
+
+// Random access iterators have an exact size, so index can be split
+// between the two iterators.
+static Option chit_get(Iterator *iterator, size_t index) {
+    Chain *current = iterator->current;
+    size_t size1 = iter_size_hint(*(current->iterator1)).lower;
+    return (index < size1)
+        ? iter_get(*(current->iterator1), index)
+        : iter_get(*(current->iterator2), index - size1);
+}
+
+static Option eit_next(Iterator *iterator) {
+    return eit_advance(iterator, 1);
+}
+
+static Option eit_advance(Iterator *iterator, size_t n) {
+    Enumerate *current = iterator->current;
+    Option option = iter_advance(*(current->iterator), n);
+    if (!option.is_valid) {
+        return option_none();
+    }
+    current->enumerated = (Enumerated) { .index = current->index, .value = option.value };
+    current->index += n;
+    return option_some(&current->enumerated);
+}
+
+static SizeHint eit_size_hint(Iterator *iterator) {
+    Enumerate *current = iterator->current;
+    return iter_size_hint(*(current->iterator));
+}
+
+static Option eit_get(Iterator *iterator, size_t index) {
+    Enumerate *current = iterator->current;
+    Option option = iter_get(*(current->iterator), index);
+    if (!option.is_valid) {
+        return option_none();
+    }
+    current->enumerated = (Enumerated) { .index = current->index + index, .value = option.value };
+    return option_some(&current->enumerated);
+}
+
+static Option tit_next(Iterator *iterator) {
+    return tit_advance(iterator, 1);
+}
+
+static Option tit_advance(Iterator *iterator, size_t n) {
+    Take *current = iterator->current;
+    if (current->n == 0) {
+        return option_none();
+    }
+    Option option = iter_advance(*(current->iterator), (n < current->n) ? n : current->n);
+    current->n = saturating_sub(current->n, n);
+    return option;
+}
+
+static SizeHint tit_size_hint(Iterator *iterator) {
+    Take *current = iterator->current;
+    return size_hint_min(iter_size_hint(*(current->iterator)), size_hint_exact(current->n));
+}
+
+static Chunk tit_next_chunk(Iterator *iterator) {
+    Take *current = iterator->current;
+    Chunk chunk = iter_next_chunk(*(current->iterator));
+    chunk.size = (chunk.size < current->n) ? chunk.size : current->n;
+    return chunk;
+}
+
+static Option tit_get(Iterator *iterator, size_t index) {
+    Take *current = iterator->current;
+    return (index < current->n) ? iter_get(*(current->iterator), index) : option_none();
+}
+
+// Skip the first n elements the first time the iterator is used, this is
+// O(1) for random access iterators.
+static void skip_prefix(Skip *skip) {
+    if (skip->n > 0) {
+        iter_advance(*(skip->iterator), skip->n);
+        skip->n = 0;
+    }
+}
+
+static Option skit_next(Iterator *iterator) {
+    return skit_advance(iterator, 1);
+}
+
+static Option skit_advance(Iterator *iterator, size_t n) {
+    Skip *current = iterator->current;
+    skip_prefix(current);
+    return iter_advance(*(current->iterator), n);
+}
+
+static SizeHint skit_size_hint(Iterator *iterator) {
+    Skip *current = iterator->current;
+    SizeHint hint = iter_size_hint(*(current->iterator));
+    return (SizeHint) {
+        .lower = saturating_sub(hint.lower, current->n),
+        .upper = (hint.upper == SIZE_MAX) ? SIZE_MAX : saturating_sub(hint.upper, current->n)
+    };
+}
+
+static Chunk skit_next_chunk(Iterator *iterator) {
+    Skip *current = iterator->current;
+    skip_prefix(current);
+    return iter_next_chunk(*(current->iterator));
+}
+
+static Option skit_get(Iterator *iterator, size_t index) {
+    Skip *current = iterator->current;
+    return iter_get(*(current->iterator), saturating_add(index, current->n));
+}
+
+static Option sbit_next(Iterator *iterator) {
+    return sbit_advance(iterator, 1);
+}
+
+static Option sbit_advance(Iterator *iterator, size_t n) {
+    StepBy *current = iterator->current;
+    return iter_advance(*(current->iterator), n * current->step);
+}
+
+static SizeHint sbit_size_hint(Iterator *iterator) {
+    StepBy *current = iterator->current;
+    SizeHint hint = iter_size_hint(*(current->iterator));
+    return (SizeHint) {
+        .lower = (hint.lower + current->step - 1) / current->step,
+        .upper = (hint.upper == SIZE_MAX) ? SIZE_MAX : (hint.upper + current->step - 1) / current->step
+    };
+}
+
+static Option sbit_get(Iterator *iterator, size_t index) {
+    StepBy *current = iterator->current;
+    return iter_get(*(current->iterator), index * current->step);
+}
+
+// A chunk held whole by a block of the iterator, or the last one of a
+// single block, is yielded in place. Otherwise its elements are gathered
+// from the following blocks into the buffer.
+static Option ckit_next(Iterator *iterator) {
+    Chunks *current = iterator->current;
+    Iterator *source = current->iterator;
+    if (iter_has_chunks(*source)) {
+        Chunk block = iter_next_chunk(*source);
+        bool is_single_block = iter_has_flags(*source, ITER_RANDOM_ACCESS);
+        if (block.size == 0) {
+            return option_none();
+        }
+        if (block.size >= current->size || is_single_block) {
+            block.size = (block.size < current->size) ? block.size : current->size;
+            iter_advance(*source, block.size);
+            current->chunk = block;
+            return option_some(&current->chunk);
+        }
+    }
+    size_t elem_size = current->elem_size;
+    size_t filled = 0;
+    while (filled < current->size) {
+        Chunk block = peek_chunk(source);
+        if (block.size == 0) {
+            break;
+        }
+        size_t left = current->size - filled;
+        size_t count = (block.size < left) ? block.size : left;
+        memcpy(current->buffer + filled * elem_size, block.data, count * elem_size);
+        consume(source, count);
+        filled += count;
+    }
+    if (filled == 0) {
+        return option_none();
+    }
+    current->chunk = (Chunk) {
+        .data = current->buffer,
+        .size = filled,
+        .elem_size = elem_size
+    };
+    return option_some(&current->chunk);
+}
+
+static SizeHint ckit_size_hint(Iterator *iterator) {
+    Chunks *current = iterator->current;
+    SizeHint hint = iter_size_hint(*(current->iterator));
+    return (SizeHint) {
+        .lower = hint.lower / current->size + (hint.lower % current->size != 0),
+        .upper = (hint.upper == SIZE_MAX)
+            ? SIZE_MAX
+            : hint.upper / current->size + (hint.upper % current->size != 0)
+    };
+}
+
+static Option ckit_get(Iterator *iterator, size_t index) {
+    Chunks *current = iterator->current;
+    Chunk block = iter_next_chunk(*(current->iterator));
+    size_t start = index * current->size;
+    if (start >= block.size) {
+        return option_none();
+    }
+    current->chunk = (Chunk) {
+        .data = CHUNK_GET(block, start),
+        .size = (block.size - start < current->size) ? block.size - start : current->size,
+        .elem_size = block.elem_size
+    };
+    return option_some(&current->chunk);
+}
+
+// Windows are yielded in place while the block of the iterator holds them
+// whole. From the first one it does not, the last size elements are kept
+// at head and head + size of the buffer, so the window starting at head is
+// contiguous and each new element replaces the oldest one.
+static Option wnit_next(Iterator *iterator) {
+    Windows *current = iterator->current;
+    Iterator *source = current->iterator;
+    size_t elem_size = current->elem_size;
+    size_t size = current->size;
+    if (!current->buffering && iter_has_chunks(*source)) {
+        Chunk block = iter_next_chunk(*source);
+        if (block.size >= size) {
+            block.size = size;
+            iter_advance(*source, 1);
+            current->window = block;
+            return option_some(&current->window);
+        }
+        if (iter_has_flags(*source, ITER_RANDOM_ACCESS)) {
+            return option_none();
+        }
+    }
+    if (!current->buffering) {
+        for (size_t i = 0; i < size; i++) {
+            Option option = iter_next(*source);
+            if (!option.is_valid) {
+                return option_none();
+            }
+            memcpy(current->buffer + i * elem_size, option.value, elem_size);
+            memcpy(current->buffer + (i + size) * elem_size, option.value, elem_size);
+        }
+        current->buffering = true;
+        current->head = 0;
+    } else {
+        Option option = iter_next(*source);
+        if (!option.is_valid) {
+            return option_none();
+        }
+        memcpy(current->buffer + current->head * elem_size, option.value, elem_size);
+        memcpy(current->buffer + (current->head + size) * elem_size, option.value, elem_size);
+        current->head = (current->head + 1) % size;
+    }
+    current->window = (Chunk) {
+        .data = current->buffer + current->head * elem_size,
+        .size = size,
+        .elem_size = elem_size
+    };
+    return option_some(&current->window);
+}
+
+// Once buffering, each element of the iterator makes a new window.
+static SizeHint wnit_size_hint(Iterator *iterator) {
+    Windows *current = iterator->current;
+    SizeHint hint = iter_size_hint(*(current->iterator));
+    if (current->buffering) {
+        return hint;
+    }
+    return (SizeHint) {
+        .lower = saturating_sub(saturating_add(hint.lower, 1), current->size),
+        .upper = (hint.upper == SIZE_MAX) ? SIZE_MAX : saturating_sub(hint.upper + 1, current->size)
+    };
+}
+
+static Option wnit_get(Iterator *iterator, size_t index) {
+    Windows *current = iterator->current;
+    Chunk block = iter_next_chunk(*(current->iterator));
+    if (index >= block.size || block.size - index < current->size) {
+        return option_none();
+    }
+    current->window = (Chunk) {
+        .data = CHUNK_GET(block, index),
+        .size = current->size,
+        .elem_size = block.elem_size
+    };
+    return option_some(&current->window);
+}
+
+// The heads are read on the first call. The iterator of the last yielded
+// element is only advanced on the following call, so that element stays
+// valid until then. Iterators may reuse the storage of their elements, so
+// duplicates are compared against a copy of the last yielded element.
+static Option mkit_next(Iterator *iterator) {
+    MergeK *current = iterator->current;
+    if (current->k == 0) {
+        return option_none();
+    }
+    if (!current->started) {
+        for (size_t i = 0; i < current->k; i++) {
+            current->heads[i] = iter_next(current->iterators[i]).value;
+        }
+        current->tree[0] = merge_build(current, 1);
+        current->started = true;
+    }
+
+    while (true) {
+        if (current->yielded < current->k) {
+            current->heads[current->yielded] = iter_next(current->iterators[current->yielded]).value;
+            merge_replay(current, current->yielded);
+        }
+        size_t winner = current->tree[0];
+        void *head = current->heads[winner];
+        if (head == NULL) {
+            current->yielded = current->k;
+            return option_none();
+        }
+        current->yielded = winner;
+        if (!current->dedup) {
+            return option_some(head);
+        }
+        if (!current->has_last || current->compare(head, current->last) != 0) {
+            memcpy(current->last, head, current->elem_size);
+            current->has_last = true;
+            return option_some(head);
+        }
+    }
+}
+
+// The merge holds the heads it has read besides what the iterators have
+// left, deduplication can drop everything but one element.
+static SizeHint mkit_size_hint(Iterator *iterator) {
+    MergeK *current = iterator->current;
+    SizeHint hint = { .lower = 0, .upper = 0 };
+    for (size_t i = 0; i < current->k; i++) {
+        bool holds_head = current->started && current->heads[i] != NULL && i != current->yielded;
+        SizeHint source_hint = iter_size_hint(current->iterators[i]);
+        hint.lower = saturating_add(hint.lower, saturating_add(source_hint.lower, holds_head));
+        hint.upper = saturating_add(hint.upper, saturating_add(source_hint.upper, holds_head));
+    }
+    if (current->dedup) {
+        hint.lower = (hint.lower > 0) ? 1 : 0;
+    }
+    return hint;
+}
+
+// Check if the head of iterator a comes before the head of iterator b, an
+// exhausted iterator comes after everything and ties go to the lower index.
+static bool merge_beats(const MergeK *merge, size_t a, size_t b) {
+    void *head_a = merge->heads[a];
+    void *head_b = merge->heads[b];
+    if (head_a == NULL || head_b == NULL) {
+        return head_b == NULL && (head_a != NULL || a < b);
+    }
+    int cmp = merge->compare(head_a, head_b);
+    return cmp < 0 || (cmp == 0 && a < b);
+}
+
+// Play the matches of the subtree rooted at node, storing the loser of each
+// internal node and returning the winner. Nodes >= k are the leaves, node
+// k + i standing for iterator i.
+static size_t merge_build(MergeK *merge, size_t node) {
+    if (node >= merge->k) {
+        return node - merge->k;
+    }
+    size_t left = merge_build(merge, 2 * node);
+    size_t right = merge_build(merge, 2 * node + 1);
+    bool left_wins = merge_beats(merge, left, right);
+    merge->tree[node] = left_wins ? right : left;
+    return left_wins ? left : right;
+}
+
+// Replay the matches on the path from a leaf whose head changed to the
+// root, the new winner ends up in tree[0].
+static void merge_replay(MergeK *merge, size_t leaf) {
+    size_t winner = leaf;
+    for (size_t node = (merge->k + leaf) / 2; node > 0; node /= 2) {
+        if (merge_beats(merge, merge->tree[node], winner)) {
+            size_t loser = winner;
+            winner = merge->tree[node];
+            merge->tree[node] = loser;
+        }
+    }
+    merge->tree[0] = winner;
+}
+
+static size_t saturating_add(size_t a, size_t b) {
+    return (a > SIZE_MAX - b) ? SIZE_MAX : a + b;
+}
+
+static size_t saturating_sub(size_t a, size_t b) {
+    return (a > b) ? a - b : 0;
 }
@@ -1,7 +1,23 @@
 #include "../iterator.h"
 
+SizeHint size_hint_exact(size_t size) {
+    return (SizeHint) { .lower = size, .upper = size };
+}
+
+SizeHint size_hint_min(SizeHint hint1, SizeHint hint2) {
+    return (SizeHint) {
+        .lower = (hint1.lower < hint2.lower) ? hint1.lower : hint2.lower,
+        .upper = (hint1.upper < hint2.upper) ? hint1.upper : hint2.upper
+    };
+}
+
+bool size_hint_is_exact(SizeHint hint) {
+    return hint.lower == hint.upper;
+}
+
 static Option default_advance(Iterator *iterator, size_t n);
 static size_t default_size(Iterator *iterator);
+static SizeHint default_size_hint(Iterator *iterator);
 
 Iterator iter_default(
     void *container,
@@ -11,13 +27,37 @@ Iterator iter_default(
     Iterator iterator = {
         .container = container,
         .current = current,
+        .index = 0,
+        .back = 0,
+        .flags = 0,
         .next = next,
         .advance = default_advance,
-        .size = default_size
+        .size = default_size,
+        .next_chunk = NULL,
+        .size_hint = default_size_hint,
+        .next_back = NULL,
+        .get = NULL,
+        .take_chunk = NULL
     };
     return iterator;
 }
 
+Chunk iter_take_chunk(Iterator *iterator) {
+    if (iterator->take_chunk != NULL) {
+        return iterator->take_chunk(iterator);
+    }
+    if (iterator->next_chunk == NULL) {
+        Option option = iter_next(*iterator);
+        return (Chunk) { .data = option.value, .size = option.is_valid, .elem_size = 0 };
+    }
+
+    Chunk chunk = iter_next_chunk(*iterator);
+    if (chunk.size > 0) {
+        iter_advance(*iterator, chunk.size);
+    }
+    return chunk;
+}
+
 static Option default_advance(Iterator *iterator, size_t n) {
     Option ret = iterator->next(iterator);
     while (--n > 0 && iterator->next(iterator).is_valid);
@@ -26,6 +66,13 @@ static Option default_advance(Iterator *iterator, size_t n) {
 
 static size_t default_size(Iterator *iterator) {
     size_t size = 0;
-    for (; iter_next(*iterator).is_valid; ++size);
+    for (Chunk chunk = iter_take_chunk(iterator); chunk.size > 0; chunk = iter_take_chunk(iterator)) {
+        size += chunk.size;
+    }
     return size;
 }
+
+static SizeHint default_size_hint(Iterator *iterator) {
+    (void) iterator;
+    return (SizeHint) { .lower = 0, .upper = SIZE_MAX };
+}
@@ -0,0 +1,296 @@
+#include <string.h>
+
+#include "../par_iter.h"
+#include "../vector.h"
+
+#define WORD_BITS 64
+
+typedef enum {
+    PAR_FOR_EACH,
+    PAR_MAP,
+    PAR_REDUCE
+} ParKind;
+
+// The work to do on every element, shared by all the threads of a call.
+typedef struct {
+    ParKind kind;
+    void (*visit)(void *value, void *context);
+    void *context;
+    map_fn unary_op;
+    void (*func)(void *acc, void *value);
+    void (*combine)(void *acc, void *other);
+    const void *identity;
+    void *result;
+    size_t acc_size;
+} ParTask;
+
+// A range of contiguous elements processed by one thread.
+typedef struct {
+    const ParTask *task;
+    char *data;
+    size_t size;
+    size_t elem_size;
+    void *acc;
+} ParRange;
+
+// A range of a vector filtered by one thread. Ranges start on a word of
+// the shared match bitmap, so no 2 threads write the same word.
+typedef struct {
+    const char *data;
+    size_t start;
+    size_t end;
+    size_t elem_size;
+    pred_fn predicate;
+    uint64_t *matches;
+    size_t count;
+    char *dst;
+} FilterRange;
+
+static void run(Iterator *iterator, const ParTask *task, ParArgs args);
+static void run_chunk(const ParTask *task, Chunk chunk, ThreadPool *pool, size_t nthreads, Allocator alloc);
+static void run_range(void *arg);
+static void apply(const ParTask *task, void *value);
+static void run_tasks(ThreadPool *pool, Task *tasks, size_t count);
+static void count_matches(void *arg);
+static void copy_matches(void *arg);
+
+void internal_par_for_each(
+    Iterator *iterator,
+    void (*func)(void *value, void *context),
+    void *context,
+    ParArgs args
+) {
+    ParTask task = { .kind = PAR_FOR_EACH, .visit = func, .context = context };
+    run(iterator, &task, args);
+}
+
+void internal_par_map(Iterator *iterator, map_fn unary_op, ParArgs args) {
+    ParTask task = { .kind = PAR_MAP, .unary_op = unary_op };
+    run(iterator, &task, args);
+}
+
+void internal_par_reduce(
+    Iterator *iterator,
+    void (*func)(void *acc, void *value),
+    void (*combine)(void *acc, void *other),
+    void *init,
+    size_t acc_size,
+    ParArgs args
+) {
+    void *identity = allocator_allocate(args.alloc, acc_size);
+    ASSERT(identity != NULL, "Out of memory");
+    memcpy(identity, init, acc_size);
+    ParTask task = {
+        .kind = PAR_REDUCE,
+        .func = func,
+        .combine = combine,
+        .identity = identity,
+        .result = init,
+        .acc_size = acc_size
+    };
+    run(iterator, &task, args);
+    allocator_deallocate(args.alloc, identity);
+}
+
+void *internal_vec_par_filter(const void *vector, pred_fn predicate, ParArgs args) {
+    ThreadPool *pool = (args.pool != NULL) ? args.pool : thread_pool_global();
+    size_t nthreads = (args.nthreads > 0) ? args.nthreads : thread_pool_size(pool) + 1;
+    size_t size = vec_size(vector);
+    size_t elem_size = vec_elem_size(vector);
+
+    // Ranges have at least PAR_MIN_RANGE elements and a multiple of
+    // WORD_BITS, except for the last one.
+    size_t nranges = size / PAR_MIN_RANGE;
+    nranges = (nranges < nthreads) ? nranges : nthreads;
+    nranges = (nranges > 0) ? nranges : 1;
+    size_t range_size = (size + nranges - 1) / nranges;
+    range_size = (range_size + WORD_BITS - 1) / WORD_BITS * WORD_BITS;
+    nranges = (size > 0) ? (size + range_size - 1) / range_size : 1;
+
+    size_t nwords = (size + WORD_BITS - 1) / WORD_BITS;
+    uint64_t *matches = allocator_allocate(args.alloc, (nwords > 0 ? nwords : 1) * sizeof(uint64_t));
+    FilterRange *ranges = allocator_allocate(args.alloc, nranges * sizeof(FilterRange));
+    Task *tasks = allocator_allocate(args.alloc, nranges * sizeof(Task));
+    ASSERT(matches != NULL && ranges != NULL && tasks != NULL, "Out of memory");
+    for (size_t i = 0; i < nranges; i++) {
+        size_t start = i * range_size;
+        ranges[i] = (FilterRange) {
+            .data = vector,
+            .start = start,
+            .end = (start + range_size < size) ? start + range_size : size,
+            .elem_size = elem_size,
+            .predicate = predicate,
+            .matches = matches
+        };
+        tasks[i] = (Task) { .func = count_matches, .arg = &ranges[i] };
+    }
+    run_tasks(pool, tasks, nranges);
+
+    // Each range writes its matches right after those of the ranges
+    // before it.
+    size_t total = 0;
+    for (size_t i = 0; i < nranges; i++) {
+        total += ranges[i].count;
+    }
+    void *result = internal_vec_new(elem_size, (VecArgs) { .cap = total, .alloc = args.alloc }, total);
+    size_t offset = 0;
+    for (size_t i = 0; i < nranges; i++) {
+        ranges[i].dst = (char *) result + offset * elem_size;
+        offset += ranges[i].count;
+        tasks[i] = (Task) { .func = copy_matches, .arg = &ranges[i] };
+    }
+    run_tasks(pool, tasks, nranges);
+
+    allocator_deallocate(args.alloc, tasks);
+    allocator_deallocate(args.alloc, ranges);
+    allocator_deallocate(args.alloc, matches);
+    return result;
+}
+
+// Take the blocks of the iterator one by one, splitting each one across
+// the threads. The fallback blocks of iterators without chunks hold a
+// single element that may not outlive the next call, so they are
+// processed right away.
+static void run(Iterator *iterator, const ParTask *task, ParArgs args) {
+    ThreadPool *pool = (args.pool != NULL) ? args.pool : thread_pool_global();
+    size_t nthreads = (args.nthreads > 0) ? args.nthreads : thread_pool_size(pool) + 1;
+    for (Chunk chunk = iter_take_chunk(iterator); chunk.size > 0; chunk = iter_take_chunk(iterator)) {
+        if (chunk.elem_size == 0) {
+            apply(task, chunk.data);
+        } else {
+            run_chunk(task, chunk, pool, nthreads, args.alloc);
+        }
+    }
+}
+
+// Split a block in equal ranges of at least PAR_MIN_RANGE elements and
+// run one task per range. Reductions fold each range into its own accumulator, which are
+// combined in order once all ranges are done.
+static void run_chunk(const ParTask *task, Chunk chunk, ThreadPool *pool, size_t nthreads, Allocator alloc) {
+    size_t nranges = chunk.size / PAR_MIN_RANGE;
+    nranges = (nranges < nthreads) ? nranges : nthreads;
+    if (nranges <= 1) {
+        ParRange range = {
+            .task = task,
+            .data = chunk.data,
+            .size = chunk.size,
+            .elem_size = chunk.elem_size,
+            .acc = task->result
+        };
+        run_range(&range);
+        return;
+    }
+
+    ParRange *ranges = allocator_allocate(alloc, nranges * sizeof(ParRange));
+    Task *tasks = allocator_allocate(alloc, nranges * sizeof(Task));
+    char *accs = (task->kind == PAR_REDUCE) ? allocator_allocate(alloc, nranges * task->acc_size) : NULL;
+    ASSERT(ranges != NULL && tasks != NULL, "Out of memory");
+    ASSERT(task->kind != PAR_REDUCE || accs != NULL, "Out of memory");
+    size_t start = 0;
+    for (size_t i = 0; i < nranges; i++) {
+        size_t end = chunk.size / nranges * (i + 1) + ((i + 1 == nranges) ? chunk.size % nranges : 0);
+        ranges[i] = (ParRange) {
+            .task = task,
+            .data = (char *) chunk.data + start * chunk.elem_size,
+            .size = end - start,
+            .elem_size = chunk.elem_size,
+            .acc = (accs != NULL) ? accs + i * task->acc_size : NULL
+        };
+        tasks[i] = (Task) { .func = run_range, .arg = &ranges[i] };
+        if (accs != NULL) {
+            memcpy(ranges[i].acc, task->identity, task->acc_size);
+        }
+        start = end;
+    }
+    run_tasks(pool, tasks, nranges);
+
+    if (accs != NULL) {
+        for (size_t i = 0; i < nranges; i++) {
+            task->combine(task->result, ranges[i].acc);
+        }
+        allocator_deallocate(alloc, accs);
+    }
+    allocator_deallocate(alloc, tasks);
+    allocator_deallocate(alloc, ranges);
+}
+
+// Process every element of a range, it has the signature of a task
+// function. The task kind is checked once rather than per element.
+static void run_range(void *arg) {
+    ParRange *range = arg;
+    const ParTask *task = range->task;
+    char *end = range->data + range->size * range->elem_size;
+    switch (task->kind) {
+        case PAR_FOR_EACH:
+            for (char *value = range->data; value < end; value += range->elem_size) {
+                task->visit(value, task->context);
+            }
+            break;
+        case PAR_MAP:
+            for (char *value = range->data; value < end; value += range->elem_size) {
+                task->unary_op(value);
+            }
+            break;
+        case PAR_REDUCE:
+            for (char *value = range->data; value < end; value += range->elem_size) {
+                task->func(range->acc, value);
+            }
+            break;
+    }
+}
+
+// Do the work of a task on one element, reductions fold it into the
+// result.
+static void apply(const ParTask *task, void *value) {
+    switch (task->kind) {
+        case PAR_FOR_EACH:
+            task->visit(value, task->context);
+            break;
+        case PAR_MAP:
+            task->unary_op(value);
+            break;
+        case PAR_REDUCE:
+            task->func(task->result, value);
+            break;
+    }
+}
+
+// Run the first task on the calling thread and spawn the others as one
+// batch, then wait for all of them.
+static void run_tasks(ThreadPool *pool, Task *tasks, size_t count) {
+    TaskScope scope = thread_pool_scope(pool);
+    thread_pool_spawn_batch(&scope, tasks + 1, count - 1);
+    tasks[0].func(tasks[0].arg);
+    thread_pool_wait(&scope);
+}
+
+// Test every element of a filter range, recording the matches in the
+// bitmap and counting them.
+static void count_matches(void *arg) {
+    FilterRange *range = arg;
+    range->count = 0;
+    for (size_t word = range->start / WORD_BITS; word * WORD_BITS < range->end; word++) {
+        uint64_t bits = 0;
+        size_t end = (word * WORD_BITS + WORD_BITS < range->end) ? word * WORD_BITS + WORD_BITS : range->end;
+        for (size_t i = word * WORD_BITS; i < end; i++) {
+            uint64_t match = range->predicate(range->data + i * range->elem_size);
+            bits |= match << (i % WORD_BITS);
+        }
+        range->matches[word] = bits;
+        range->count += (size_t) __builtin_popcountll(bits);
+    }
+}
+
+// Copy the matches of a filter range to its place in the output, walking
+// the set bits of the bitmap.
+static void copy_matches(void *arg) {
+    FilterRange *range = arg;
+    char *dst = range->dst;
+    for (size_t word = range->start / WORD_BITS; word * WORD_BITS < range->end; word++) {
+        for (uint64_t bits = range->matches[word]; bits != 0; bits &= bits - 1) {
+            size_t i = word * WORD_BITS + (size_t) __builtin_ctzll(bits);
+            memcpy(dst, range->data + i * range->elem_size, range->elem_size);
+            dst += range->elem_size;
+        }
+    }
+}
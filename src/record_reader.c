@@ -0,0 +1,377 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../base.h"
+#include "../record_reader.h"
+
+// A buffer filled by the reading side, ready once it may be consumed.
+typedef struct {
+    char *data;
+    size_t filled;
+    bool ready;
+    int error;
+} ReadBuffer;
+
+struct record_reader {
+    int fd;
+    RecordReaderArgs args;
+    ReadBuffer buffers[2];
+    int current;
+    char *pos;
+    char *end;
+    char *scratch;
+    size_t scratch_capacity;
+    bool pending;
+    Chunk record;
+    int error;
+    bool eof;
+    off_t start;
+    off_t offset;
+    off_t file_size;
+    uint64_t consumed;
+
+    // Background reading, the thread owns the buffers that are not ready.
+    bool threaded;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool stop;
+    bool finished;
+};
+
+static bool fetch(RecordReader *reader);
+static void fill(RecordReader *reader, ReadBuffer *buffer);
+static void *read_ahead(void *arg);
+static void reserve_scratch(RecordReader *reader, size_t size);
+static char *take(RecordReader *reader, size_t size);
+static Option rrit_next(Iterator *iterator);
+static Option rrit_next_prefixed(Iterator *iterator);
+static Option rrit_advance(Iterator *iterator, size_t n);
+static Chunk rrit_next_chunk(Iterator *iterator);
+static SizeHint rrit_size_hint(Iterator *iterator);
+
+RecordReader *internal_record_reader_new(int fd, RecordReaderArgs args) {
+    ASSERT(args.buffer_size > 0, "Buffer size must be greater than 0");
+    RecordReader *reader = allocator_allocate(args.alloc, sizeof(RecordReader));
+    ASSERT(reader != NULL, "Out of memory");
+    *reader = (RecordReader) { .fd = fd, .args = args, .current = -1, .file_size = -1 };
+    size_t nbuffers = args.background ? 2 : 1;
+    for (size_t i = 0; i < nbuffers; i++) {
+        reader->buffers[i].data = allocator_allocate(args.alloc, args.buffer_size);
+        ASSERT(reader->buffers[i].data != NULL, "Out of memory");
+    }
+
+    // Hints only apply to regular files, whose size also bounds the
+    // number of records.
+    struct stat st;
+    reader->start = lseek(fd, 0, SEEK_CUR);
+    reader->offset = reader->start;
+    if (reader->start >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        reader->file_size = st.st_size;
+        posix_fadvise(fd, reader->offset, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    if (args.background) {
+        pthread_mutex_init(&reader->lock, NULL);
+        pthread_cond_init(&reader->cond, NULL);
+        reader->threaded = pthread_create(&reader->thread, NULL, read_ahead, reader) == 0;
+        if (!reader->threaded) {
+            pthread_cond_destroy(&reader->cond);
+            pthread_mutex_destroy(&reader->lock);
+        }
+    }
+    return reader;
+}
+
+Iterator record_reader_iter(RecordReader *reader) {
+    if (reader->args.record_size == 0) {
+        Iterator iterator = iter_default(NULL, reader, rrit_next_prefixed);
+        iterator.size_hint = rrit_size_hint;
+        return iterator;
+    }
+    Iterator iterator = iter_default(NULL, reader, rrit_next);
+    iterator.advance = rrit_advance;
+    iterator.next_chunk = rrit_next_chunk;
+    iterator.size_hint = rrit_size_hint;
+    return iterator;
+}
+
+int record_reader_error(const RecordReader *reader) {
+    return reader->error;
+}
+
+void record_reader_free(RecordReader *reader) {
+    if (reader->threaded) {
+        pthread_mutex_lock(&reader->lock);
+        reader->stop = true;
+        pthread_cond_broadcast(&reader->cond);
+        pthread_mutex_unlock(&reader->lock);
+        pthread_join(reader->thread, NULL);
+        pthread_cond_destroy(&reader->cond);
+        pthread_mutex_destroy(&reader->lock);
+    }
+    Allocator alloc = reader->args.alloc;
+    for (size_t i = 0; i < 2; i++) {
+        if (reader->buffers[i].data != NULL) {
+            allocator_deallocate(alloc, reader->buffers[i].data);
+        }
+    }
+    if (reader->scratch != NULL) {
+        allocator_deallocate(alloc, reader->scratch);
+    }
+    allocator_deallocate(alloc, reader);
+}
+
+// Make the next buffer the current one, returning false at the end of the
+// file or on an error. In the background the current buffer is handed
+// back to the thread and the next one is waited for.
+static bool fetch(RecordReader *reader) {
+    if (reader->eof || reader->error != 0) {
+        return false;
+    }
+    ReadBuffer *buffer;
+    if (reader->threaded) {
+        int next = (reader->current + 1) % 2;
+        pthread_mutex_lock(&reader->lock);
+        if (reader->current >= 0) {
+            reader->buffers[reader->current].ready = false;
+            pthread_cond_broadcast(&reader->cond);
+        }
+        while (!reader->buffers[next].ready && !reader->finished) {
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        }
+        bool ready = reader->buffers[next].ready;
+        pthread_mutex_unlock(&reader->lock);
+        reader->current = next;
+        buffer = &reader->buffers[next];
+        if (!ready) {
+            buffer->filled = 0;
+            buffer->error = 0;
+        }
+    } else {
+        reader->current = 0;
+        buffer = &reader->buffers[0];
+        fill(reader, buffer);
+    }
+    reader->pos = buffer->data;
+    reader->end = buffer->data + buffer->filled;
+    reader->error = buffer->error;
+    reader->eof = buffer->filled == 0;
+    return buffer->filled > 0;
+}
+
+// Read until the buffer is full or the file ends, then ask the kernel to
+// prefetch the following buffer.
+static void fill(RecordReader *reader, ReadBuffer *buffer) {
+    buffer->filled = 0;
+    buffer->error = 0;
+    while (buffer->filled < reader->args.buffer_size) {
+        ssize_t bytes = read(reader->fd, buffer->data + buffer->filled, reader->args.buffer_size - buffer->filled);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            buffer->error = errno;
+            break;
+        }
+        if (bytes == 0) {
+            break;
+        }
+        buffer->filled += (size_t) bytes;
+    }
+    if (reader->file_size >= 0) {
+        reader->offset += (off_t) buffer->filled;
+        posix_fadvise(reader->fd, reader->offset, (off_t) reader->args.buffer_size, POSIX_FADV_WILLNEED);
+    }
+}
+
+// Fill the buffers in turn while the consumer works on the other one,
+// stopping at the end of the file.
+static void *read_ahead(void *arg) {
+    RecordReader *reader = arg;
+    bool done = false;
+    for (int i = 0; !done; i = (i + 1) % 2) {
+        pthread_mutex_lock(&reader->lock);
+        while (reader->buffers[i].ready && !reader->stop) {
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        }
+        bool stop = reader->stop;
+        pthread_mutex_unlock(&reader->lock);
+        if (stop) {
+            break;
+        }
+
+        fill(reader, &reader->buffers[i]);
+        done = reader->buffers[i].filled == 0 || reader->buffers[i].error != 0;
+        pthread_mutex_lock(&reader->lock);
+        reader->buffers[i].ready = true;
+        pthread_cond_broadcast(&reader->cond);
+        pthread_mutex_unlock(&reader->lock);
+    }
+    pthread_mutex_lock(&reader->lock);
+    reader->finished = true;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+// Grow the scratch buffer to hold at least size bytes.
+static void reserve_scratch(RecordReader *reader, size_t size) {
+    if (size > reader->scratch_capacity) {
+        char *scratch = allocator_reallocate(reader->args.alloc, reader->scratch, size);
+        ASSERT(scratch != NULL, "Out of memory");
+        reader->scratch = scratch;
+        reader->scratch_capacity = size;
+    }
+}
+
+// Take the next size bytes, from the current buffer when they are all in
+// it, else put together in the scratch buffer. Returns NULL at the end of
+// the file, which is an error in the middle of a record.
+static char *take(RecordReader *reader, size_t size) {
+    if ((size_t) (reader->end - reader->pos) >= size) {
+        char *data = reader->pos;
+        reader->pos += size;
+        reader->consumed += size;
+        return data;
+    }
+    reserve_scratch(reader, size);
+    size_t taken = 0;
+    while (true) {
+        size_t count = (size_t) (reader->end - reader->pos);
+        count = (count < size - taken) ? count : size - taken;
+        if (count > 0) {
+            memcpy(reader->scratch + taken, reader->pos, count);
+            reader->pos += count;
+            taken += count;
+        }
+        if (taken == size) {
+            break;
+        }
+        if (!fetch(reader)) {
+            if (taken > 0 && reader->error == 0) {
+                reader->error = EBADMSG;
+            }
+            return NULL;
+        }
+    }
+    reader->consumed += size;
+    return reader->scratch;
+}
+
+// Return the next fixed size record, starting with one already put
+// together by next_chunk.
+static Option rrit_next(Iterator *iterator) {
+    RecordReader *current = iterator->current;
+    if (current->pending) {
+        current->pending = false;
+        return option_some(current->scratch);
+    }
+    char *record = take(current, current->args.record_size);
+    return (record != NULL) ? option_some(record) : option_none();
+}
+
+// Return the next length prefixed record as a chunk of bytes.
+static Option rrit_next_prefixed(Iterator *iterator) {
+    RecordReader *current = iterator->current;
+    char *prefix = take(current, sizeof(uint32_t));
+    if (prefix == NULL) {
+        return option_none();
+    }
+    uint32_t size;
+    memcpy(&size, prefix, sizeof(uint32_t));
+    char *data = take(current, size);
+    if (data == NULL) {
+        current->error = (current->error != 0) ? current->error : EBADMSG;
+        return option_none();
+    }
+    current->record = (Chunk) { .data = data, .size = size, .elem_size = 1 };
+    return option_some(&current->record);
+}
+
+// Skip n records, the whole records of the current buffer at once. The
+// first record is copied past the one take puts together in the scratch
+// buffer when more buffers are fetched after it, as they overwrite it.
+static Option rrit_advance(Iterator *iterator, size_t n) {
+    RecordReader *current = iterator->current;
+    size_t record_size = current->args.record_size;
+    char *kept = NULL;
+    if (n > 1) {
+        reserve_scratch(current, 2 * record_size);
+        kept = current->scratch + record_size;
+    }
+    Option first = option_none();
+    for (size_t i = 0; i < n;) {
+        size_t count = (size_t) (current->end - current->pos) / record_size;
+        count = (count < n - i) ? count : n - i;
+        if (current->pending || count == 0) {
+            Option record = rrit_next(iterator);
+            if (!record.is_valid) {
+                break;
+            }
+            if (i == 0) {
+                first = (n > 1) ? option_some(memcpy(kept, record.value, record_size)) : record;
+            }
+            i++;
+            continue;
+        }
+        if (i == 0) {
+            first = option_some((count < n) ? memcpy(kept, current->pos, record_size) : current->pos);
+        }
+        current->pos += count * record_size;
+        current->consumed += count * record_size;
+        i += count;
+    }
+    return first;
+}
+
+// Return the whole records left in the current buffer. A record split
+// across buffers is put together and returned alone, it is taken by the
+// following advance.
+static Chunk rrit_next_chunk(Iterator *iterator) {
+    RecordReader *current = iterator->current;
+    size_t record_size = current->args.record_size;
+    Chunk chunk = { .data = NULL, .size = 0, .elem_size = record_size };
+    if (current->pending) {
+        chunk.data = current->scratch;
+        chunk.size = 1;
+        return chunk;
+    }
+    if (current->pos == current->end && !fetch(current)) {
+        return chunk;
+    }
+    size_t count = (size_t) (current->end - current->pos) / record_size;
+    if (count > 0) {
+        chunk.data = current->pos;
+        chunk.size = count;
+        return chunk;
+    }
+    chunk.data = take(current, record_size);
+    chunk.size = chunk.data != NULL;
+    current->pending = chunk.data != NULL;
+    return chunk;
+}
+
+// The records left are bounded by the bytes left in a regular file, a
+// record put together but not taken yet counts too.
+static SizeHint rrit_size_hint(Iterator *iterator) {
+    RecordReader *current = iterator->current;
+    if (current->error != 0 || current->eof) {
+        return (SizeHint) { .lower = current->pending, .upper = current->pending };
+    }
+    if (current->file_size < 0) {
+        return (SizeHint) { .lower = current->pending, .upper = SIZE_MAX };
+    }
+    uint64_t read = (uint64_t) current->start + current->consumed;
+    uint64_t left = ((uint64_t) current->file_size > read) ? (uint64_t) current->file_size - read : 0;
+    if (current->args.record_size == 0) {
+        return (SizeHint) { .lower = 0, .upper = left / sizeof(uint32_t) };
+    }
+    size_t size = left / current->args.record_size + current->pending;
+    return (SizeHint) { .lower = size, .upper = size };
+}
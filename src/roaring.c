@@ -0,0 +1,898 @@
+#include <errno.h>
+#include <string.h>
+
+#include "../base.h"
+#include "../bitvec.h"
+#include "../roaring.h"
+
+#define BITMAP_WORDS 1024
+#define CHUNK_BITS 65536
+
+typedef enum { TYPE_ARRAY, TYPE_BITMAP, TYPE_RUN } ContainerType;
+
+typedef enum { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE } SetOp;
+
+// The values start to start + length, stored as length so a run can
+// cover the whole chunk.
+typedef struct {
+    uint16_t start;
+    uint16_t length;
+} Run;
+
+// The values of a chunk, data is an array of size values, BITMAP_WORDS
+// words or an array of size runs.
+typedef struct {
+    uint16_t key;
+    uint16_t type;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t cardinality;
+    void *data;
+} Container;
+
+struct roaring {
+    Container *containers;
+    size_t size;
+    size_t capacity;
+    Allocator alloc;
+};
+
+static size_t find(const Roaring *roaring, uint16_t key, bool *found);
+static void insert_container(Roaring *roaring, size_t index, Container container);
+static void remove_container(Roaring *roaring, size_t index);
+static void push_container(Roaring *roaring, Container container);
+static void free_container(Allocator alloc, Container *container);
+static Container make_array(Allocator alloc, uint16_t key, uint32_t capacity);
+static Container make_run(Allocator alloc, uint16_t key, uint32_t first, uint32_t last);
+static Container clone_container(Allocator alloc, const Container *container);
+static bool container_contains(const Container *container, uint16_t low);
+static size_t lower_bound(const uint16_t *values, size_t size, uint16_t value);
+static size_t gallop(const uint16_t *values, size_t size, size_t from, uint16_t value);
+static void set_range(uint64_t *words, uint32_t first, uint32_t last);
+static uint32_t next_bit(const uint64_t *words, uint32_t position, bool set);
+static void to_words(const Container *container, uint64_t *words);
+static Container from_words(Allocator alloc, uint16_t key, const uint64_t *words);
+static void convert(Allocator alloc, Container *container, ContainerType type);
+static uint32_t count_runs(const Container *container);
+static Container combine(Allocator alloc, const Container *container1, const Container *container2, SetOp op);
+static Container combine_arrays(Allocator alloc, const Container *container1, const Container *container2, SetOp op);
+static Container filter(Allocator alloc, const Container *array, const Container *other, bool keep);
+static Roaring *combine_all(const Roaring *roaring1, const Roaring *roaring2, SetOp op);
+static size_t payload_size(const Container *container);
+static bool read_container(const char *data, size_t size, size_t index, size_t *offset, Container *container, Allocator alloc);
+static void iter_enter(RoaringIter *iter);
+static Option rit_next(Iterator *iterator);
+static Option rit_advance(Iterator *iterator, size_t n);
+static SizeHint rit_size_hint(Iterator *iterator);
+
+Roaring *internal_roaring_new(RoaringArgs args) {
+    Roaring *roaring = allocator_allocate(args.alloc, sizeof(Roaring));
+    ASSERT(roaring != NULL, "Out of memory");
+    *roaring = (Roaring) { .alloc = args.alloc };
+    return roaring;
+}
+
+Roaring *internal_roaring_deserialize(const void *data, size_t size, RoaringArgs args) {
+    uint32_t header[2];
+    if (size < sizeof(header)) {
+        errno = EBADMSG;
+        return NULL;
+    }
+    memcpy(header, data, sizeof(header));
+    if (header[0] != ROARING_MAGIC) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (header[1] > CHUNK_BITS || (size - sizeof(header)) / 8 < header[1]) {
+        errno = EBADMSG;
+        return NULL;
+    }
+
+    Roaring *roaring = internal_roaring_new(args);
+    size_t offset = sizeof(header) + (size_t) header[1] * 8;
+    for (size_t i = 0; i < header[1]; i++) {
+        Container container;
+        bool valid = read_container(data, size, i, &offset, &container, args.alloc);
+        valid = valid && (i == 0 || container.key > roaring->containers[i - 1].key);
+        if (!valid) {
+            free_container(args.alloc, &container);
+            roaring_free(roaring);
+            errno = EBADMSG;
+            return NULL;
+        }
+        push_container(roaring, container);
+    }
+    if (offset != size) {
+        roaring_free(roaring);
+        errno = EBADMSG;
+        return NULL;
+    }
+    return roaring;
+}
+
+void roaring_add(Roaring *roaring, uint32_t value) {
+    uint16_t key = value >> 16;
+    uint16_t low = value & 0xffff;
+    bool found;
+    size_t index = find(roaring, key, &found);
+    if (!found) {
+        insert_container(roaring, index, make_array(roaring->alloc, key, 4));
+    }
+    Container *container = &roaring->containers[index];
+    if (container->type == TYPE_RUN) {
+        if (container_contains(container, low)) {
+            return;
+        }
+        convert(roaring->alloc, container, (container->cardinality < ROARING_ARRAY_MAX) ? TYPE_ARRAY : TYPE_BITMAP);
+    }
+
+    if (container->type == TYPE_ARRAY) {
+        uint16_t *values = container->data;
+        size_t position = lower_bound(values, container->size, low);
+        if (position < container->size && values[position] == low) {
+            return;
+        }
+        if (container->size == ROARING_ARRAY_MAX) {
+            convert(roaring->alloc, container, TYPE_BITMAP);
+        } else {
+            if (container->size == container->capacity) {
+                uint32_t capacity = container->capacity * 2;
+                capacity = (capacity < ROARING_ARRAY_MAX) ? capacity : ROARING_ARRAY_MAX;
+                values = allocator_reallocate(roaring->alloc, values, capacity * sizeof(uint16_t));
+                ASSERT(values != NULL, "Out of memory");
+                container->data = values;
+                container->capacity = capacity;
+            }
+            memmove(values + position + 1, values + position, (container->size - position) * sizeof(uint16_t));
+            values[position] = low;
+            container->size++;
+            container->cardinality++;
+            return;
+        }
+    }
+
+    uint64_t *words = container->data;
+    uint64_t bit = UINT64_C(1) << (low % 64);
+    if ((words[low / 64] & bit) == 0) {
+        words[low / 64] |= bit;
+        container->cardinality++;
+    }
+}
+
+void roaring_add_range(Roaring *roaring, uint32_t first, uint32_t last) {
+    ASSERT(first <= last, "Invalid range");
+    for (uint32_t key = first >> 16; key <= last >> 16; key++) {
+        uint32_t low = (key == first >> 16) ? first & 0xffff : 0;
+        uint32_t high = (key == last >> 16) ? last & 0xffff : 0xffff;
+        bool found;
+        size_t index = find(roaring, (uint16_t) key, &found);
+        if (!found) {
+            insert_container(roaring, index, make_run(roaring->alloc, (uint16_t) key, low, high));
+            continue;
+        }
+        Container *container = &roaring->containers[index];
+        if (low == 0 && high == 0xffff) {
+            free_container(roaring->alloc, container);
+            *container = make_run(roaring->alloc, (uint16_t) key, low, high);
+            continue;
+        }
+        uint64_t words[BITMAP_WORDS];
+        to_words(container, words);
+        set_range(words, low, high);
+        free_container(roaring->alloc, container);
+        *container = from_words(roaring->alloc, (uint16_t) key, words);
+    }
+}
+
+bool roaring_remove(Roaring *roaring, uint32_t value) {
+    uint16_t low = value & 0xffff;
+    bool found;
+    size_t index = find(roaring, value >> 16, &found);
+    if (!found || !container_contains(&roaring->containers[index], low)) {
+        return false;
+    }
+    Container *container = &roaring->containers[index];
+    if (container->type == TYPE_RUN) {
+        convert(roaring->alloc, container, (container->cardinality <= ROARING_ARRAY_MAX) ? TYPE_ARRAY : TYPE_BITMAP);
+    }
+    if (container->type == TYPE_ARRAY) {
+        uint16_t *values = container->data;
+        size_t position = lower_bound(values, container->size, low);
+        memmove(values + position, values + position + 1, (container->size - position - 1) * sizeof(uint16_t));
+        container->size--;
+    } else {
+        uint64_t *words = container->data;
+        words[low / 64] &= ~(UINT64_C(1) << (low % 64));
+    }
+    container->cardinality--;
+
+    if (container->cardinality == 0) {
+        remove_container(roaring, index);
+    } else if (container->type == TYPE_BITMAP && container->cardinality <= ROARING_ARRAY_MAX) {
+        convert(roaring->alloc, container, TYPE_ARRAY);
+    }
+    return true;
+}
+
+bool roaring_contains(const Roaring *roaring, uint32_t value) {
+    bool found;
+    size_t index = find(roaring, value >> 16, &found);
+    return found && container_contains(&roaring->containers[index], value & 0xffff);
+}
+
+uint64_t roaring_cardinality(const Roaring *roaring) {
+    uint64_t cardinality = 0;
+    for (size_t i = 0; i < roaring->size; i++) {
+        cardinality += roaring->containers[i].cardinality;
+    }
+    return cardinality;
+}
+
+bool roaring_equals(const Roaring *roaring1, const Roaring *roaring2) {
+    if (roaring1->size != roaring2->size) {
+        return false;
+    }
+    for (size_t i = 0; i < roaring1->size; i++) {
+        const Container *container1 = &roaring1->containers[i];
+        const Container *container2 = &roaring2->containers[i];
+        if (container1->key != container2->key || container1->cardinality != container2->cardinality) {
+            return false;
+        }
+        if (container1->type == TYPE_ARRAY && container2->type == TYPE_ARRAY) {
+            if (memcmp(container1->data, container2->data, container1->size * sizeof(uint16_t)) != 0) {
+                return false;
+            }
+            continue;
+        }
+        uint64_t words1[BITMAP_WORDS];
+        uint64_t words2[BITMAP_WORDS];
+        to_words(container1, words1);
+        to_words(container2, words2);
+        if (memcmp(words1, words2, sizeof(words1)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Roaring *roaring_union(const Roaring *roaring1, const Roaring *roaring2) {
+    return combine_all(roaring1, roaring2, SET_UNION);
+}
+
+Roaring *roaring_intersection(const Roaring *roaring1, const Roaring *roaring2) {
+    return combine_all(roaring1, roaring2, SET_INTERSECTION);
+}
+
+Roaring *roaring_difference(const Roaring *roaring1, const Roaring *roaring2) {
+    return combine_all(roaring1, roaring2, SET_DIFFERENCE);
+}
+
+void roaring_optimize(Roaring *roaring) {
+    for (size_t i = 0; i < roaring->size; i++) {
+        Container *container = &roaring->containers[i];
+        size_t run_bytes = count_runs(container) * sizeof(Run);
+        bool small = container->cardinality <= ROARING_ARRAY_MAX;
+        size_t bytes = small ? container->cardinality * sizeof(uint16_t) : BITMAP_WORDS * sizeof(uint64_t);
+        if (run_bytes < bytes) {
+            convert(roaring->alloc, container, TYPE_RUN);
+        } else {
+            convert(roaring->alloc, container, small ? TYPE_ARRAY : TYPE_BITMAP);
+        }
+    }
+}
+
+size_t roaring_serialized_size(const Roaring *roaring) {
+    size_t size = 2 * sizeof(uint32_t) + roaring->size * 8;
+    for (size_t i = 0; i < roaring->size; i++) {
+        size += payload_size(&roaring->containers[i]);
+    }
+    return size;
+}
+
+size_t roaring_serialize(const Roaring *roaring, void *buffer) {
+    char *out = buffer;
+    uint32_t header[2] = { ROARING_MAGIC, (uint32_t) roaring->size };
+    memcpy(out, header, sizeof(header));
+    size_t offset = sizeof(header) + roaring->size * 8;
+    for (size_t i = 0; i < roaring->size; i++) {
+        const Container *container = &roaring->containers[i];
+        uint16_t descriptor[2] = { container->key, container->type };
+        uint32_t entries = (container->type == TYPE_BITMAP) ? BITMAP_WORDS : container->size;
+        memcpy(out + sizeof(header) + i * 8, descriptor, sizeof(descriptor));
+        memcpy(out + sizeof(header) + i * 8 + sizeof(descriptor), &entries, sizeof(entries));
+        memcpy(out + offset, container->data, payload_size(container));
+        offset += payload_size(container);
+    }
+    return offset;
+}
+
+void roaring_free(Roaring *roaring) {
+    for (size_t i = 0; i < roaring->size; i++) {
+        free_container(roaring->alloc, &roaring->containers[i]);
+    }
+    if (roaring->containers != NULL) {
+        allocator_deallocate(roaring->alloc, roaring->containers);
+    }
+    allocator_deallocate(roaring->alloc, roaring);
+}
+
+Iterator roaring_iter(RoaringIter *iter, const Roaring *roaring) {
+    *iter = (RoaringIter) { .roaring = roaring, .left = roaring_cardinality(roaring) };
+    iter_enter(iter);
+    Iterator iterator = iter_default((void *) roaring, iter, rit_next);
+    iterator.advance = rit_advance;
+    iterator.size_hint = rit_size_hint;
+    return iterator;
+}
+
+// Find the index of the container of a key, or where to insert it.
+static size_t find(const Roaring *roaring, uint16_t key, bool *found) {
+    size_t low = 0;
+    size_t high = roaring->size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (roaring->containers[middle].key < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *found = low < roaring->size && roaring->containers[low].key == key;
+    return low;
+}
+
+// Insert a container at an index, keeping the keys sorted.
+static void insert_container(Roaring *roaring, size_t index, Container container) {
+    push_container(roaring, container);
+    memmove(roaring->containers + index + 1, roaring->containers + index, (roaring->size - 1 - index) * sizeof(Container));
+    roaring->containers[index] = container;
+}
+
+// Free a container and close the gap it leaves.
+static void remove_container(Roaring *roaring, size_t index) {
+    free_container(roaring->alloc, &roaring->containers[index]);
+    memmove(roaring->containers + index, roaring->containers + index + 1, (roaring->size - 1 - index) * sizeof(Container));
+    roaring->size--;
+}
+
+// Append a container, its key must be greater than the last one.
+static void push_container(Roaring *roaring, Container container) {
+    if (roaring->size == roaring->capacity) {
+        size_t capacity = (roaring->capacity > 0) ? roaring->capacity * 2 : 4;
+        Container *containers = allocator_reallocate(roaring->alloc, roaring->containers, capacity * sizeof(Container));
+        ASSERT(containers != NULL, "Out of memory");
+        roaring->containers = containers;
+        roaring->capacity = capacity;
+    }
+    roaring->containers[roaring->size++] = container;
+}
+
+// Free the data of a container, empty containers have none.
+static void free_container(Allocator alloc, Container *container) {
+    if (container->data != NULL) {
+        allocator_deallocate(alloc, container->data);
+        container->data = NULL;
+    }
+}
+
+// Create an empty array container.
+static Container make_array(Allocator alloc, uint16_t key, uint32_t capacity) {
+    uint16_t *values = allocator_allocate(alloc, capacity * sizeof(uint16_t));
+    ASSERT(values != NULL, "Out of memory");
+    return (Container) { .key = key, .type = TYPE_ARRAY, .capacity = capacity, .data = values };
+}
+
+// Create a run container holding the values first to last.
+static Container make_run(Allocator alloc, uint16_t key, uint32_t first, uint32_t last) {
+    Run *runs = allocator_allocate(alloc, sizeof(Run));
+    ASSERT(runs != NULL, "Out of memory");
+    runs[0] = (Run) { .start = (uint16_t) first, .length = (uint16_t) (last - first) };
+    return (Container) {
+        .key = key,
+        .type = TYPE_RUN,
+        .size = 1,
+        .capacity = 1,
+        .cardinality = last - first + 1,
+        .data = runs
+    };
+}
+
+// Copy a container, arrays and runs with no spare capacity.
+static Container clone_container(Allocator alloc, const Container *container) {
+    Container clone = *container;
+    size_t bytes = payload_size(container);
+    clone.data = allocator_allocate(alloc, bytes);
+    ASSERT(clone.data != NULL, "Out of memory");
+    memcpy(clone.data, container->data, bytes);
+    clone.capacity = container->size;
+    return clone;
+}
+
+// Check whether a container holds the low 16 bits of a value.
+static bool container_contains(const Container *container, uint16_t low) {
+    if (container->type == TYPE_ARRAY) {
+        const uint16_t *values = container->data;
+        size_t position = lower_bound(values, container->size, low);
+        return position < container->size && values[position] == low;
+    }
+    if (container->type == TYPE_BITMAP) {
+        const uint64_t *words = container->data;
+        return (words[low / 64] >> (low % 64)) & 1;
+    }
+    // Find the last run starting at or before the value.
+    const Run *runs = container->data;
+    size_t first = 0;
+    size_t last = container->size;
+    while (first < last) {
+        size_t middle = first + (last - first) / 2;
+        if (runs[middle].start <= low) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first > 0 && (uint32_t) (low - runs[first - 1].start) <= runs[first - 1].length;
+}
+
+// Find the first index of a sorted array holding a value not less than
+// value.
+static size_t lower_bound(const uint16_t *values, size_t size, uint16_t value) {
+    size_t low = 0;
+    size_t high = size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (values[middle] < value) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// lower_bound starting at from, with steps doubling until they pass the
+// value so close values are found quickly.
+static size_t gallop(const uint16_t *values, size_t size, size_t from, uint16_t value) {
+    size_t step = 1;
+    size_t low = from;
+    while (low + step < size && values[low + step] < value) {
+        low += step;
+        step *= 2;
+    }
+    size_t high = (low + step < size) ? low + step + 1 : size;
+    return low + lower_bound(values + low, high - low, value);
+}
+
+// Set the bits first to last of a chunk.
+static void set_range(uint64_t *words, uint32_t first, uint32_t last) {
+    size_t first_word = first / 64;
+    size_t last_word = last / 64;
+    uint64_t first_mask = UINT64_MAX << (first % 64);
+    uint64_t last_mask = UINT64_MAX >> (63 - last % 64);
+    if (first_word == last_word) {
+        words[first_word] |= first_mask & last_mask;
+        return;
+    }
+    words[first_word] |= first_mask;
+    for (size_t i = first_word + 1; i < last_word; i++) {
+        words[i] = UINT64_MAX;
+    }
+    words[last_word] |= last_mask;
+}
+
+// Find the first set or clear bit of a chunk from position, CHUNK_BITS if
+// there is none.
+static uint32_t next_bit(const uint64_t *words, uint32_t position, bool set) {
+    if (position >= CHUNK_BITS) {
+        return CHUNK_BITS;
+    }
+    size_t index = position / 64;
+    uint64_t word = (set ? words[index] : ~words[index]) & (UINT64_MAX << (position % 64));
+    while (word == 0) {
+        if (++index == BITMAP_WORDS) {
+            return CHUNK_BITS;
+        }
+        word = set ? words[index] : ~words[index];
+    }
+    return index * 64 + __builtin_ctzll(word);
+}
+
+// Expand a container of any type to a bitmap.
+static void to_words(const Container *container, uint64_t *words) {
+    if (container->type == TYPE_BITMAP) {
+        memcpy(words, container->data, BITMAP_WORDS * sizeof(uint64_t));
+        return;
+    }
+    memset(words, 0, BITMAP_WORDS * sizeof(uint64_t));
+    if (container->type == TYPE_ARRAY) {
+        const uint16_t *values = container->data;
+        for (size_t i = 0; i < container->size; i++) {
+            words[values[i] / 64] |= UINT64_C(1) << (values[i] % 64);
+        }
+        return;
+    }
+    const Run *runs = container->data;
+    for (size_t i = 0; i < container->size; i++) {
+        set_range(words, runs[i].start, runs[i].start + runs[i].length);
+    }
+}
+
+// Make an array or bitmap container from a bitmap, by its cardinality. An
+// empty bitmap gives an empty container with no data.
+static Container from_words(Allocator alloc, uint16_t key, const uint64_t *words) {
+    uint32_t cardinality = mem_popcount(words, BITMAP_WORDS);
+    if (cardinality == 0) {
+        return (Container) { .key = key, .type = TYPE_ARRAY };
+    }
+    if (cardinality > ROARING_ARRAY_MAX) {
+        uint64_t *copy = allocator_allocate(alloc, BITMAP_WORDS * sizeof(uint64_t));
+        ASSERT(copy != NULL, "Out of memory");
+        memcpy(copy, words, BITMAP_WORDS * sizeof(uint64_t));
+        return (Container) { .key = key, .type = TYPE_BITMAP, .cardinality = cardinality, .data = copy };
+    }
+    Container container = make_array(alloc, key, cardinality);
+    uint16_t *values = container.data;
+    for (size_t i = 0; i < BITMAP_WORDS; i++) {
+        for (uint64_t word = words[i]; word != 0; word &= word - 1) {
+            values[container.size++] = (uint16_t) (i * 64 + __builtin_ctzll(word));
+        }
+    }
+    container.cardinality = cardinality;
+    return container;
+}
+
+// Change the type of a container in place.
+static void convert(Allocator alloc, Container *container, ContainerType type) {
+    if (container->type == type) {
+        return;
+    }
+    uint64_t words[BITMAP_WORDS];
+    to_words(container, words);
+    Container converted = { .key = container->key, .type = type, .cardinality = container->cardinality };
+    if (type == TYPE_BITMAP) {
+        converted.data = allocator_allocate(alloc, sizeof(words));
+        ASSERT(converted.data != NULL, "Out of memory");
+        memcpy(converted.data, words, sizeof(words));
+    } else if (type == TYPE_ARRAY) {
+        ASSERT(container->cardinality <= ROARING_ARRAY_MAX, "Too many values for an array");
+        converted = from_words(alloc, container->key, words);
+    } else {
+        converted.size = count_runs(container);
+        converted.capacity = converted.size;
+        Run *runs = allocator_allocate(alloc, converted.size * sizeof(Run));
+        ASSERT(runs != NULL, "Out of memory");
+        size_t count = 0;
+        for (uint32_t start = next_bit(words, 0, true); start < CHUNK_BITS;) {
+            uint32_t end = next_bit(words, start, false);
+            runs[count++] = (Run) { .start = (uint16_t) start, .length = (uint16_t) (end - start - 1) };
+            start = next_bit(words, end, true);
+        }
+        converted.data = runs;
+    }
+    free_container(alloc, container);
+    *container = converted;
+}
+
+// Count the runs of consecutive values of a container.
+static uint32_t count_runs(const Container *container) {
+    uint32_t count = 0;
+    if (container->type == TYPE_ARRAY) {
+        const uint16_t *values = container->data;
+        for (size_t i = 0; i < container->size; i++) {
+            count += i == 0 || values[i] != values[i - 1] + 1;
+        }
+    } else if (container->type == TYPE_BITMAP) {
+        // A run starts at each set bit whose previous bit is clear.
+        const uint64_t *words = container->data;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < BITMAP_WORDS; i++) {
+            count += __builtin_popcountll(words[i] & ~((words[i] << 1) | carry));
+            carry = words[i] >> 63;
+        }
+    } else {
+        count = container->size;
+    }
+    return count;
+}
+
+// Combine two containers of the same key. Arrays are merged and filtered
+// directly, other pairs go through bitmaps. The result may be empty.
+static Container combine(Allocator alloc, const Container *container1, const Container *container2, SetOp op) {
+    bool array1 = container1->type == TYPE_ARRAY;
+    bool array2 = container2->type == TYPE_ARRAY;
+    if (array1 && array2 && (op != SET_UNION || container1->size + container2->size <= ROARING_ARRAY_MAX)) {
+        return combine_arrays(alloc, container1, container2, op);
+    }
+    if (op == SET_INTERSECTION && (array1 || array2)) {
+        return array1 ? filter(alloc, container1, container2, true) : filter(alloc, container2, container1, true);
+    }
+    if (op == SET_DIFFERENCE && array1) {
+        return filter(alloc, container1, container2, false);
+    }
+    if (op == SET_UNION && (container1->cardinality == CHUNK_BITS || container2->cardinality == CHUNK_BITS)) {
+        return make_run(alloc, container1->key, 0, CHUNK_BITS - 1);
+    }
+
+    uint64_t words1[BITMAP_WORDS];
+    uint64_t words2[BITMAP_WORDS];
+    to_words(container1, words1);
+    to_words(container2, words2);
+    for (size_t i = 0; i < BITMAP_WORDS; i++) {
+        switch (op) {
+            case SET_UNION:
+                words1[i] |= words2[i];
+                break;
+            case SET_INTERSECTION:
+                words1[i] &= words2[i];
+                break;
+            case SET_DIFFERENCE:
+                words1[i] &= ~words2[i];
+                break;
+        }
+    }
+    return from_words(alloc, container1->key, words1);
+}
+
+// Merge two sorted arrays, galloping through the larger one for the
+// intersection with a much smaller one.
+static Container combine_arrays(Allocator alloc, const Container *container1, const Container *container2, SetOp op) {
+    const uint16_t *values1 = container1->data;
+    const uint16_t *values2 = container2->data;
+    size_t size1 = container1->size;
+    size_t size2 = container2->size;
+    size_t capacity = (op == SET_UNION) ? size1 + size2 : size1;
+    Container result = make_array(alloc, container1->key, capacity);
+    uint16_t *out = result.data;
+    size_t count = 0;
+
+    if (op == SET_INTERSECTION && (size1 * 64 < size2 || size2 * 64 < size1)) {
+        const uint16_t *small = (size1 < size2) ? values1 : values2;
+        const uint16_t *large = (size1 < size2) ? values2 : values1;
+        size_t small_size = (size1 < size2) ? size1 : size2;
+        size_t large_size = (size1 < size2) ? size2 : size1;
+        size_t position = 0;
+        for (size_t i = 0; i < small_size && position < large_size; i++) {
+            position = gallop(large, large_size, position, small[i]);
+            if (position < large_size && large[position] == small[i]) {
+                out[count++] = small[i];
+            }
+        }
+    } else {
+        size_t i = 0;
+        size_t j = 0;
+        while (i < size1 && j < size2) {
+            if (values1[i] < values2[j]) {
+                if (op != SET_INTERSECTION) {
+                    out[count++] = values1[i];
+                }
+                i++;
+            } else if (values1[i] > values2[j]) {
+                if (op == SET_UNION) {
+                    out[count++] = values2[j];
+                }
+                j++;
+            } else {
+                if (op != SET_DIFFERENCE) {
+                    out[count++] = values1[i];
+                }
+                i++;
+                j++;
+            }
+        }
+        for (; op != SET_INTERSECTION && i < size1; i++) {
+            out[count++] = values1[i];
+        }
+        for (; op == SET_UNION && j < size2; j++) {
+            out[count++] = values2[j];
+        }
+    }
+    result.size = count;
+    result.cardinality = count;
+    if (count == 0) {
+        free_container(alloc, &result);
+    }
+    return result;
+}
+
+// Keep the values of an array that are, or are not, in another container.
+static Container filter(Allocator alloc, const Container *array, const Container *other, bool keep) {
+    Container result = make_array(alloc, array->key, array->size);
+    const uint16_t *values = array->data;
+    uint16_t *out = result.data;
+    for (size_t i = 0; i < array->size; i++) {
+        if (container_contains(other, values[i]) == keep) {
+            out[result.size++] = values[i];
+        }
+    }
+    result.cardinality = result.size;
+    if (result.size == 0) {
+        free_container(alloc, &result);
+    }
+    return result;
+}
+
+// Walk the containers of both bitmaps by key, copying the ones only in
+// one of them as the operation requires and combining the others.
+static Roaring *combine_all(const Roaring *roaring1, const Roaring *roaring2, SetOp op) {
+    Allocator alloc = roaring1->alloc;
+    Roaring *result = internal_roaring_new((RoaringArgs) { .alloc = alloc });
+    size_t i = 0;
+    size_t j = 0;
+    while (i < roaring1->size || j < roaring2->size) {
+        const Container *container1 = (i < roaring1->size) ? &roaring1->containers[i] : NULL;
+        const Container *container2 = (j < roaring2->size) ? &roaring2->containers[j] : NULL;
+        if (container2 == NULL || (container1 != NULL && container1->key < container2->key)) {
+            if (op != SET_INTERSECTION) {
+                push_container(result, clone_container(alloc, container1));
+            }
+            i++;
+        } else if (container1 == NULL || container1->key > container2->key) {
+            if (op == SET_UNION) {
+                push_container(result, clone_container(alloc, container2));
+            }
+            j++;
+        } else {
+            Container combined = combine(alloc, container1, container2, op);
+            if (combined.cardinality > 0) {
+                push_container(result, combined);
+            }
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+// Get the size in bytes of the data of a container.
+static size_t payload_size(const Container *container) {
+    switch (container->type) {
+        case TYPE_ARRAY:
+            return container->size * sizeof(uint16_t);
+        case TYPE_BITMAP:
+            return BITMAP_WORDS * sizeof(uint64_t);
+        default:
+            return container->size * sizeof(Run);
+    }
+}
+
+// Read the container of the index-th descriptor from its data at offset,
+// checking that it is well formed. On failure the container may hold data
+// to free.
+static bool read_container(const char *data, size_t size, size_t index, size_t *offset, Container *container, Allocator alloc) {
+    uint16_t fields[2];
+    uint32_t entries;
+    const char *descriptor = data + 2 * sizeof(uint32_t) + index * 8;
+    memcpy(fields, descriptor, sizeof(fields));
+    memcpy(&entries, descriptor + sizeof(fields), sizeof(entries));
+    *container = (Container) { .key = fields[0], .type = fields[1], .size = entries, .capacity = entries };
+    bool valid = (fields[1] == TYPE_ARRAY && entries > 0 && entries <= ROARING_ARRAY_MAX)
+        || (fields[1] == TYPE_BITMAP && entries == BITMAP_WORDS)
+        || (fields[1] == TYPE_RUN && entries > 0 && entries <= CHUNK_BITS / 2);
+    if (!valid) {
+        return false;
+    }
+    if (fields[1] == TYPE_BITMAP) {
+        container->size = 0;
+        container->capacity = 0;
+    }
+    size_t bytes = payload_size(container);
+    if (size - *offset < bytes) {
+        return false;
+    }
+    container->data = allocator_allocate(alloc, bytes);
+    ASSERT(container->data != NULL, "Out of memory");
+    memcpy(container->data, data + *offset, bytes);
+    *offset += bytes;
+
+    if (container->type == TYPE_ARRAY) {
+        const uint16_t *values = container->data;
+        for (size_t i = 1; i < entries; i++) {
+            if (values[i] <= values[i - 1]) {
+                return false;
+            }
+        }
+        container->cardinality = entries;
+    } else if (container->type == TYPE_BITMAP) {
+        container->cardinality = mem_popcount(container->data, BITMAP_WORDS);
+    } else {
+        // Runs must stay in the chunk and not overlap.
+        const Run *runs = container->data;
+        for (size_t i = 0; i < entries; i++) {
+            uint32_t end = (uint32_t) runs[i].start + runs[i].length;
+            if (end > 0xffff || (i > 0 && runs[i].start <= (uint32_t) runs[i - 1].start + runs[i - 1].length)) {
+                return false;
+            }
+            container->cardinality += runs[i].length + 1;
+        }
+    }
+    return container->cardinality > 0;
+}
+
+// Set up the iterator at the start of its current container.
+static void iter_enter(RoaringIter *iter) {
+    iter->position = 0;
+    iter->offset = 0;
+    iter->word = 0;
+    iter->container_left = 0;
+    if (iter->container < iter->roaring->size) {
+        const Container *container = &iter->roaring->containers[iter->container];
+        iter->container_left = container->cardinality;
+        if (container->type == TYPE_BITMAP) {
+            iter->word = ((const uint64_t *) container->data)[0];
+        }
+    }
+}
+
+// Yield the next value of the current container, moving to the next one
+// when it is exhausted.
+static Option rit_next(Iterator *iterator) {
+    RoaringIter *current = iterator->current;
+    const Roaring *roaring = current->roaring;
+    while (current->container_left == 0) {
+        if (current->container >= roaring->size) {
+            return option_none();
+        }
+        current->container++;
+        iter_enter(current);
+    }
+    const Container *container = &roaring->containers[current->container];
+    uint32_t low;
+    if (container->type == TYPE_ARRAY) {
+        low = ((const uint16_t *) container->data)[current->position++];
+    } else if (container->type == TYPE_BITMAP) {
+        const uint64_t *words = container->data;
+        while (current->word == 0) {
+            current->word = words[++current->position];
+        }
+        low = current->position * 64 + __builtin_ctzll(current->word);
+        current->word &= current->word - 1;
+    } else {
+        Run run = ((const Run *) container->data)[current->position];
+        low = run.start + current->offset;
+        if (current->offset == run.length) {
+            current->position++;
+            current->offset = 0;
+        } else {
+            current->offset++;
+        }
+    }
+    current->container_left--;
+    current->left--;
+    current->value = (uint32_t) container->key << 16 | low;
+    return option_some(&current->value);
+}
+
+// Yield the next value and skip the n - 1 after it, the rest of the
+// current container and whole containers at once.
+static Option rit_advance(Iterator *iterator, size_t n) {
+    RoaringIter *current = iterator->current;
+    Option first = rit_next(iterator);
+    if (!first.is_valid) {
+        return first;
+    }
+    uint32_t value = current->value;
+    size_t skip = n - 1;
+    while (skip > 0) {
+        if (skip < current->container_left) {
+            for (; skip > 0; skip--) {
+                rit_next(iterator);
+            }
+            break;
+        }
+        if (current->container >= current->roaring->size) {
+            break;
+        }
+        skip -= current->container_left;
+        current->left -= current->container_left;
+        current->container++;
+        iter_enter(current);
+    }
+    current->value = value;
+    return option_some(&current->value);
+}
+
+// The number of values left is kept.
+static SizeHint rit_size_hint(Iterator *iterator) {
+    RoaringIter *current = iterator->current;
+    return size_hint_exact(current->left);
+}
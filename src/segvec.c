@@ -0,0 +1,227 @@
+#include <string.h>
+
+#include "../base.h"
+#include "../segvec.h"
+
+#define SEGVEC_META_PTR(segvec) (((SegVecMeta *) segvec) - 1)
+#define SEGVEC_PTR(segvec_meta) ((void **) (segvec_meta + 1))
+#define SEGVEC_GET(segment, index, elem_size) (void *) ((size_t) segment + ((index) * elem_size))
+#define DEFAULT_FIRST_SEGMENT_SIZE 16
+
+typedef struct {
+    size_t size;
+    size_t capacity;
+    size_t segment_count;
+    size_t first_segment_bits;
+    size_t elem_size;
+    Allocator alloc;
+} SegVecMeta;
+
+static size_t segment_of(const SegVecMeta *segvec_meta, size_t index);
+static size_t segment_start(const SegVecMeta *segvec_meta, size_t segment);
+static size_t segment_size(const SegVecMeta *segvec_meta, size_t segment);
+static void *locate(const SegVecMeta *segvec_meta, size_t index);
+static void add_segment(SegVecMeta *segvec_meta);
+static Option sit_next(Iterator *iterator);
+static Option sit_advance(Iterator *iterator, size_t n);
+static size_t sit_size(Iterator *iterator);
+static SizeHint sit_size_hint(Iterator *iterator);
+
+void *internal_segvec_new(size_t elem_size, SegVecArgs args) {
+    SegVecMeta *segvec_meta = allocator_allocate(
+        args.alloc,
+        sizeof(SegVecMeta) + (sizeof(void *) * SEGVEC_MAX_SEGMENTS)
+    );
+    ASSERT(segvec_meta != NULL, "Out of memory");
+
+    // The first segment size is the smallest power of 2 >= args.cap.
+    size_t first_segment_bits = 0;
+    size_t cap = (args.cap == 0) ? DEFAULT_FIRST_SEGMENT_SIZE : args.cap;
+    while (((size_t) 1 << first_segment_bits) < cap) {
+        first_segment_bits++;
+    }
+
+    segvec_meta->size = 0;
+    segvec_meta->capacity = 0;
+    segvec_meta->segment_count = 0;
+    segvec_meta->first_segment_bits = first_segment_bits;
+    segvec_meta->elem_size = elem_size;
+    segvec_meta->alloc = args.alloc;
+    return memset(SEGVEC_PTR(segvec_meta), 0, sizeof(void *) * SEGVEC_MAX_SEGMENTS);
+}
+
+void *internal_segvec_get(const void *segvec, size_t index) {
+    SegVecMeta *segvec_meta = SEGVEC_META_PTR(segvec);
+    ASSERT(
+        index < segvec_meta->size,
+        "Index (is %zu) should be < segvec_size (is %zu)",
+        index,
+        segvec_meta->size
+    );
+    return locate(segvec_meta, index);
+}
+
+void *internal_segvec_push_back(void *segvec, const void *elem) {
+    SegVecMeta *segvec_meta = SEGVEC_META_PTR(segvec);
+    if (segvec_meta->size == segvec_meta->capacity) {
+        add_segment(segvec_meta);
+    }
+
+    // Insert the element.
+    void *slot = locate(segvec_meta, segvec_meta->size);
+    memcpy(slot, elem, segvec_meta->elem_size);
+    segvec_meta->size++;
+    return slot;
+}
+
+void segvec_pop_back(void *segvec, void *elem) {
+    SegVecMeta *segvec_meta = SEGVEC_META_PTR(segvec);
+    ASSERT(
+        segvec_meta->size > 0,
+        "segvec_size (is %zu) should be > 0",
+        segvec_meta->size
+    );
+
+    // Copy the popped element to elem.
+    segvec_meta->size--;
+    if (elem != NULL) {
+        memcpy(elem, locate(segvec_meta, segvec_meta->size), segvec_meta->elem_size);
+    }
+}
+
+size_t segvec_size(const void *segvec) {
+    return SEGVEC_META_PTR(segvec)->size;
+}
+
+size_t segvec_capacity(const void *segvec) {
+    return SEGVEC_META_PTR(segvec)->capacity;
+}
+
+bool segvec_is_empty(const void *segvec) {
+    return segvec_size(segvec) == 0;
+}
+
+void segvec_clear(void *segvec) {
+    SEGVEC_META_PTR(segvec)->size = 0;
+}
+
+void segvec_free(void *segvec) {
+    SegVecMeta *segvec_meta = SEGVEC_META_PTR(segvec);
+    void **segments = segvec;
+    for (size_t i = 0; i < segvec_meta->segment_count; i++) {
+        allocator_deallocate(segvec_meta->alloc, segments[i]);
+    }
+    allocator_deallocate(segvec_meta->alloc, segvec_meta);
+}
+
+void segvec_reserve(void *segvec, size_t new_capacity) {
+    SegVecMeta *segvec_meta = SEGVEC_META_PTR(segvec);
+    while (segvec_meta->capacity < new_capacity) {
+        add_segment(segvec_meta);
+    }
+}
+
+void segvec_shrink(void *segvec) {
+    SegVecMeta *segvec_meta = SEGVEC_META_PTR(segvec);
+    void **segments = segvec;
+    size_t used_segments = (segvec_meta->size == 0)
+        ? 0
+        : segment_of(segvec_meta, segvec_meta->size - 1) + 1;
+
+    while (segvec_meta->segment_count > used_segments) {
+        segvec_meta->segment_count--;
+        allocator_deallocate(segvec_meta->alloc, segments[segvec_meta->segment_count]);
+        segments[segvec_meta->segment_count] = NULL;
+    }
+    segvec_meta->capacity = (used_segments == 0) ? 0 : segment_start(segvec_meta, used_segments);
+}
+
+Iterator segvec_iter(void *segvec) {
+    Iterator iterator = iter_default(SEGVEC_META_PTR(segvec), NULL, sit_next);
+    iterator.advance = sit_advance;
+    iterator.size = sit_size;
+    iterator.size_hint = sit_size_hint;
+    return iterator;
+}
+
+// Find the segment which holds the element at index.
+static size_t segment_of(const SegVecMeta *segvec_meta, size_t index) {
+    size_t first_segments = index >> segvec_meta->first_segment_bits;
+    if (first_segments == 0) {
+        return 0;
+    }
+    return (sizeof(size_t) * 8) - (size_t) __builtin_clzl(first_segments);
+}
+
+// Find the index of the first element of a segment.
+static size_t segment_start(const SegVecMeta *segvec_meta, size_t segment) {
+    return (segment == 0) ? 0 : (size_t) 1 << (segvec_meta->first_segment_bits + segment - 1);
+}
+
+// Find the number of elements a segment holds.
+static size_t segment_size(const SegVecMeta *segvec_meta, size_t segment) {
+    return (segment == 0)
+        ? (size_t) 1 << segvec_meta->first_segment_bits
+        : segment_start(segvec_meta, segment);
+}
+
+// Get a pointer to the slot of index, its segment must be allocated.
+static void *locate(const SegVecMeta *segvec_meta, size_t index) {
+    void **segments = SEGVEC_PTR(segvec_meta);
+    size_t segment = segment_of(segvec_meta, index);
+    return SEGVEC_GET(
+        segments[segment],
+        index - segment_start(segvec_meta, segment),
+        segvec_meta->elem_size
+    );
+}
+
+// Allocate the next segment, the existing segments are left untouched.
+static void add_segment(SegVecMeta *segvec_meta) {
+    ASSERT(
+        segvec_meta->segment_count < SEGVEC_MAX_SEGMENTS,
+        "segment_count (is %zu) should be < %d",
+        segvec_meta->segment_count,
+        SEGVEC_MAX_SEGMENTS
+    );
+    void **segments = SEGVEC_PTR(segvec_meta);
+    size_t size = segment_size(segvec_meta, segvec_meta->segment_count);
+    void *segment = allocator_allocate(segvec_meta->alloc, size * segvec_meta->elem_size);
+    ASSERT(segment != NULL, "Out of memory");
+
+    segments[segvec_meta->segment_count] = segment;
+    segvec_meta->segment_count++;
+    segvec_meta->capacity += size;
+}
+
+// Move the iterator by 1 element.
+static Option sit_next(Iterator *iterator) {
+    return sit_advance(iterator, 1);
+}
+
+// Move the iterator by n elements.
+static Option sit_advance(Iterator *iterator, size_t n) {
+    SegVecMeta *segvec_meta = iterator->container;
+    if (iterator->index >= segvec_meta->size) {
+        return option_none();
+    }
+    void *current = locate(segvec_meta, iterator->index);
+    iterator->index += n;
+    return option_some(current);
+}
+
+// Get the number of elements in the iterator.
+static size_t sit_size(Iterator *iterator) {
+    SegVecMeta *segvec_meta = iterator->container;
+    size_t size = (iterator->index < segvec_meta->size) ? segvec_meta->size - iterator->index : 0;
+    iterator->index = segvec_meta->size;
+    return size;
+}
+
+// Get the exact number of elements left without moving the iterator.
+static SizeHint sit_size_hint(Iterator *iterator) {
+    SegVecMeta *segvec_meta = iterator->container;
+    return size_hint_exact(
+        (iterator->index < segvec_meta->size) ? segvec_meta->size - iterator->index : 0
+    );
+}
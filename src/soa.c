@@ -0,0 +1,220 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../base.h"
+#include "../soa.h"
+
+#define SOA_ALIGNMENT 64
+
+typedef struct {
+    size_t offset;
+    size_t size;
+    char *data;
+} SoAColumn;
+
+struct soa {
+    size_t size;
+    size_t capacity;
+    size_t row_size;
+    size_t nfields;
+    Allocator alloc;
+    void *memory;
+    SoAColumn columns[];
+};
+
+// The comparison function of the column being sorted by soa_sort_by.
+static _Thread_local compare_fn sort_compare = NULL;
+
+static void grow(SoA *soa, size_t new_capacity);
+static SoAColumn *find_column(const SoA *soa, size_t offset);
+static int compare_rows(const void *value1, const void *value2);
+
+SoA *internal_soa_new(size_t row_size, const SoAField *fields, size_t nfields, SoAArgs args) {
+    ASSERT(nfields > 0 && nfields <= SOA_MAX_FIELDS, "Invalid number of fields");
+    SoA *soa = allocator_allocate(args.alloc, sizeof(SoA) + nfields * sizeof(SoAColumn));
+    ASSERT(soa != NULL, "Out of memory");
+    *soa = (SoA) { .row_size = row_size, .nfields = nfields, .alloc = args.alloc };
+    for (size_t i = 0; i < nfields; i++) {
+        ASSERT(fields[i].offset + fields[i].size <= row_size, "Field out of the row type");
+        soa->columns[i] = (SoAColumn) { .offset = fields[i].offset, .size = fields[i].size };
+    }
+    grow(soa, args.cap);
+    return soa;
+}
+
+void *internal_soa_column(const SoA *soa, size_t offset) {
+    return find_column(soa, offset)->data;
+}
+
+void internal_soa_push_back(SoA *soa, const void *row, size_t row_size) {
+    ASSERT(row_size == soa->row_size, "Row type mismatch");
+    if (soa->size == soa->capacity) {
+        grow(soa, (soa->capacity > 0) ? soa->capacity * 2 : 8);
+    }
+    soa->size++;
+    soa_set(soa, soa->size - 1, row);
+}
+
+void internal_soa_sort_by(SoA *soa, size_t offset, compare_fn compare) {
+    if (soa->size < 2) {
+        return;
+    }
+    // Sort pointers to the values, so the comparison needs no context and
+    // ties are broken by position, then turn them into row indices.
+    SoAColumn *column = find_column(soa, offset);
+    const char **rows = allocator_allocate(soa->alloc, soa->size * sizeof(char *));
+    size_t *permutation = allocator_allocate(soa->alloc, soa->size * sizeof(size_t));
+    ASSERT(rows != NULL && permutation != NULL, "Out of memory");
+    for (size_t i = 0; i < soa->size; i++) {
+        rows[i] = column->data + i * column->size;
+    }
+    compare_fn previous = sort_compare;
+    sort_compare = compare;
+    view_sort(view_new(rows, soa->size, sizeof(char *)), compare_rows);
+    sort_compare = previous;
+    for (size_t i = 0; i < soa->size; i++) {
+        permutation[i] = (size_t) (rows[i] - column->data) / column->size;
+    }
+    soa_permute(soa, permutation);
+    allocator_deallocate(soa->alloc, permutation);
+    allocator_deallocate(soa->alloc, rows);
+}
+
+void soa_get(const SoA *soa, size_t index, void *row) {
+    ASSERT(index < soa->size, "Index out of bounds");
+    memset(row, 0, soa->row_size);
+    for (size_t i = 0; i < soa->nfields; i++) {
+        const SoAColumn *column = &soa->columns[i];
+        memcpy((char *) row + column->offset, column->data + index * column->size, column->size);
+    }
+}
+
+void soa_set(SoA *soa, size_t index, const void *row) {
+    ASSERT(index < soa->size, "Index out of bounds");
+    for (size_t i = 0; i < soa->nfields; i++) {
+        SoAColumn *column = &soa->columns[i];
+        memcpy(column->data + index * column->size, (const char *) row + column->offset, column->size);
+    }
+}
+
+void soa_erase(SoA *soa, size_t index) {
+    ASSERT(index < soa->size, "Index out of bounds");
+    size_t count = soa->size - index - 1;
+    for (size_t i = 0; i < soa->nfields; i++) {
+        SoAColumn *column = &soa->columns[i];
+        char *position = column->data + index * column->size;
+        memmove(position, position + column->size, count * column->size);
+    }
+    soa->size--;
+}
+
+void soa_swap_erase(SoA *soa, size_t index) {
+    ASSERT(index < soa->size, "Index out of bounds");
+    size_t last = soa->size - 1;
+    if (index != last) {
+        for (size_t i = 0; i < soa->nfields; i++) {
+            SoAColumn *column = &soa->columns[i];
+            memcpy(column->data + index * column->size, column->data + last * column->size, column->size);
+        }
+    }
+    soa->size--;
+}
+
+void soa_permute(SoA *soa, const size_t *permutation) {
+    if (soa->size < 2) {
+        return;
+    }
+    // Gather each column into a scratch buffer sized for the widest one,
+    // then copy it back.
+    size_t max_size = 0;
+    for (size_t i = 0; i < soa->nfields; i++) {
+        max_size = (soa->columns[i].size > max_size) ? soa->columns[i].size : max_size;
+    }
+    char *scratch = allocator_allocate(soa->alloc, soa->size * max_size);
+    ASSERT(scratch != NULL, "Out of memory");
+    for (size_t i = 0; i < soa->nfields; i++) {
+        SoAColumn *column = &soa->columns[i];
+        size_t size = column->size;
+        for (size_t j = 0; j < soa->size; j++) {
+            ASSERT(permutation[j] < soa->size, "Index out of bounds");
+            memcpy(scratch + j * size, column->data + permutation[j] * size, size);
+        }
+        memcpy(column->data, scratch, soa->size * size);
+    }
+    allocator_deallocate(soa->alloc, scratch);
+}
+
+size_t soa_size(const SoA *soa) {
+    return soa->size;
+}
+
+size_t soa_capacity(const SoA *soa) {
+    return soa->capacity;
+}
+
+void soa_reserve(SoA *soa, size_t new_capacity) {
+    if (new_capacity > soa->capacity) {
+        grow(soa, new_capacity);
+    }
+}
+
+void soa_clear(SoA *soa) {
+    soa->size = 0;
+}
+
+void soa_free(SoA *soa) {
+    if (soa->memory != NULL) {
+        allocator_deallocate(soa->alloc, soa->memory);
+    }
+    allocator_deallocate(soa->alloc, soa);
+}
+
+// Move the columns to a new allocation holding new_capacity rows, each
+// column starting on an aligned boundary.
+static void grow(SoA *soa, size_t new_capacity) {
+    size_t total = SOA_ALIGNMENT - 1;
+    for (size_t i = 0; i < soa->nfields; i++) {
+        size_t bytes = soa->columns[i].size * new_capacity;
+        total += (bytes + SOA_ALIGNMENT - 1) & ~(size_t) (SOA_ALIGNMENT - 1);
+    }
+    void *memory = allocator_allocate(soa->alloc, total);
+    ASSERT(memory != NULL, "Out of memory");
+    uintptr_t address = ((uintptr_t) memory + SOA_ALIGNMENT - 1) & ~(uintptr_t) (SOA_ALIGNMENT - 1);
+    char *data = (char *) memory + (address - (uintptr_t) memory);
+    for (size_t i = 0; i < soa->nfields; i++) {
+        SoAColumn *column = &soa->columns[i];
+        if (soa->size > 0) {
+            memcpy(data, column->data, soa->size * column->size);
+        }
+        column->data = data;
+        size_t bytes = column->size * new_capacity;
+        data += (bytes + SOA_ALIGNMENT - 1) & ~(size_t) (SOA_ALIGNMENT - 1);
+    }
+    if (soa->memory != NULL) {
+        allocator_deallocate(soa->alloc, soa->memory);
+    }
+    soa->memory = memory;
+    soa->capacity = new_capacity;
+}
+
+// Find the column of the field at offset in the row type.
+static SoAColumn *find_column(const SoA *soa, size_t offset) {
+    for (size_t i = 0; i < soa->nfields; i++) {
+        if (soa->columns[i].offset == offset) {
+            return (SoAColumn *) &soa->columns[i];
+        }
+    }
+    ASSERT(false, "Field is not a column");
+    return NULL;
+}
+
+// Compare two pointers to column values, ties ordered by position.
+static int compare_rows(const void *value1, const void *value2) {
+    const char *row1 = *(const char *const *) value1;
+    const char *row2 = *(const char *const *) value2;
+    int result = sort_compare(row1, row2);
+    if (result != 0) {
+        return result;
+    }
+    return (row1 > row2) - (row1 < row2);
+}
@@ -0,0 +1,477 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../base.h"
+#include "../thread_pool.h"
+
+#define DEQUE_INITIAL_CAP 256
+#define IDLE_SPINS 64
+
+// The circular buffer of a deque. When a deque grows, the new array keeps
+// a link to the one it replaced, since thieves may still be reading it.
+typedef struct task_array {
+    int64_t cap;
+    struct task_array *prev;
+    _Atomic(Task *) tasks[];
+} TaskArray;
+
+// Chase-Lev deque, the owner works at the bottom and thieves at the top.
+typedef struct {
+    _Atomic(int64_t) top;
+    _Atomic(int64_t) bottom;
+    _Atomic(TaskArray *) array;
+} TaskDeque;
+
+typedef struct {
+    ThreadPool *pool;
+    pthread_t thread;
+    TaskDeque deque;
+    uint64_t seed;
+    atomic_size_t executed;
+    atomic_size_t steals;
+    atomic_size_t failed_steals;
+    _Atomic(uint64_t) idle_ns;
+} Worker;
+
+struct thread_pool {
+    Worker *workers;
+    size_t nthreads;
+    Allocator alloc;
+    pthread_mutex_t injector_lock;
+    Task *injector_head;
+    Task *injector_tail;
+    atomic_size_t injected;
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;
+    atomic_size_t sleeping;
+    atomic_bool stop;
+};
+
+static _Thread_local Worker *current_worker = NULL;
+static ThreadPool *global_pool = NULL;
+static pthread_once_t global_pool_once = PTHREAD_ONCE_INIT;
+
+static void *worker_main(void *arg);
+static Task *wait_for_task(ThreadPool *pool, Worker *worker);
+static Task *find_task(ThreadPool *pool, Worker *worker);
+static Task *steal(ThreadPool *pool, Worker *worker);
+static void execute(Worker *worker, Task *task);
+static void inject(ThreadPool *pool, Task *tasks, size_t count);
+static Task *injector_pop(ThreadPool *pool);
+static void wake(ThreadPool *pool, size_t count);
+static Worker *worker_of(const ThreadPool *pool);
+static void deque_init(TaskDeque *deque, Allocator alloc);
+static void deque_free(TaskDeque *deque, Allocator alloc);
+static void deque_push(TaskDeque *deque, Task *tasks, size_t count, Allocator alloc);
+static Task *deque_pop(TaskDeque *deque);
+static Task *deque_steal(TaskDeque *deque, bool *contended);
+static TaskArray *array_new(int64_t cap, Allocator alloc);
+static TaskArray *grow(TaskDeque *deque, TaskArray *array, int64_t top, int64_t bottom, Allocator alloc);
+static void create_global_pool(void);
+static void free_global_pool(void);
+static uint64_t now_ns(void);
+
+ThreadPool *internal_thread_pool_new(ThreadPoolArgs args) {
+    size_t nthreads = args.nthreads;
+    if (nthreads == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (ncpus > 2) ? (size_t) ncpus - 1 : 1;
+    }
+
+    ThreadPool *pool = allocator_allocate(args.alloc, sizeof(ThreadPool));
+    ASSERT(pool != NULL, "Out of memory");
+    pool->workers = allocator_allocate(args.alloc, nthreads * sizeof(Worker));
+    ASSERT(pool->workers != NULL, "Out of memory");
+    pool->nthreads = nthreads;
+    pool->alloc = args.alloc;
+    pthread_mutex_init(&pool->injector_lock, NULL);
+    pool->injector_head = NULL;
+    pool->injector_tail = NULL;
+    atomic_init(&pool->injected, 0);
+    pthread_mutex_init(&pool->sleep_lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    atomic_init(&pool->sleeping, 0);
+    atomic_init(&pool->stop, false);
+
+    // Every worker must be initialized before any starts stealing.
+    for (size_t i = 0; i < nthreads; i++) {
+        Worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        deque_init(&worker->deque, args.alloc);
+        worker->seed = i + 1;
+        atomic_init(&worker->executed, 0);
+        atomic_init(&worker->steals, 0);
+        atomic_init(&worker->failed_steals, 0);
+        atomic_init(&worker->idle_ns, 0);
+    }
+    for (size_t i = 0; i < nthreads; i++) {
+        int err = pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]);
+        ASSERT(err == 0, "pthread_create failed (error %d)", err);
+    }
+    return pool;
+}
+
+void thread_pool_free(ThreadPool *pool) {
+    atomic_store(&pool->stop, true);
+    pthread_mutex_lock(&pool->sleep_lock);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->sleep_lock);
+    for (size_t i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        deque_free(&pool->workers[i].deque, pool->alloc);
+    }
+    pthread_mutex_destroy(&pool->injector_lock);
+    pthread_mutex_destroy(&pool->sleep_lock);
+    pthread_cond_destroy(&pool->wake);
+
+    Allocator alloc = pool->alloc;
+    allocator_deallocate(alloc, pool->workers);
+    allocator_deallocate(alloc, pool);
+}
+
+ThreadPool *thread_pool_global(void) {
+    pthread_once(&global_pool_once, create_global_pool);
+    return global_pool;
+}
+
+size_t thread_pool_size(const ThreadPool *pool) {
+    return pool->nthreads;
+}
+
+ThreadPoolStats thread_pool_stats(const ThreadPool *pool) {
+    ThreadPoolStats stats = { 0 };
+    for (size_t i = 0; i < pool->nthreads; i++) {
+        Worker *worker = &pool->workers[i];
+        stats.executed += atomic_load_explicit(&worker->executed, memory_order_relaxed);
+        stats.steals += atomic_load_explicit(&worker->steals, memory_order_relaxed);
+        stats.failed_steals += atomic_load_explicit(&worker->failed_steals, memory_order_relaxed);
+        stats.idle_ns += atomic_load_explicit(&worker->idle_ns, memory_order_relaxed);
+    }
+    return stats;
+}
+
+TaskScope thread_pool_scope(ThreadPool *pool) {
+    return (TaskScope) { .pool = pool, .pending = 0 };
+}
+
+void thread_pool_spawn(TaskScope *scope, Task *task) {
+    thread_pool_spawn_batch(scope, task, 1);
+}
+
+void thread_pool_spawn_batch(TaskScope *scope, Task *tasks, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    ThreadPool *pool = scope->pool;
+    atomic_fetch_add_explicit(&scope->pending, count, memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        tasks[i].scope = scope;
+    }
+
+    Worker *worker = worker_of(pool);
+    if (worker != NULL) {
+        deque_push(&worker->deque, tasks, count, pool->alloc);
+    } else {
+        inject(pool, tasks, count);
+    }
+    wake(pool, count);
+}
+
+void thread_pool_wait(TaskScope *scope) {
+    Worker *worker = worker_of(scope->pool);
+    while (atomic_load_explicit(&scope->pending, memory_order_acquire) > 0) {
+        Task *task = find_task(scope->pool, worker);
+        if (task != NULL) {
+            execute(worker, task);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+void thread_pool_join(ThreadPool *pool, task_fn func1, void *arg1, task_fn func2, void *arg2) {
+    TaskScope scope = thread_pool_scope(pool);
+    Task task = { .func = func2, .arg = arg2 };
+    thread_pool_spawn(&scope, &task);
+    func1(arg1);
+    thread_pool_wait(&scope);
+}
+
+// Run tasks until the pool stops, the time spent looking for a task is
+// counted as idle.
+static void *worker_main(void *arg) {
+    Worker *worker = arg;
+    ThreadPool *pool = worker->pool;
+    current_worker = worker;
+    while (true) {
+        Task *task = find_task(pool, worker);
+        if (task == NULL) {
+            uint64_t start = now_ns();
+            task = wait_for_task(pool, worker);
+            atomic_fetch_add_explicit(&worker->idle_ns, now_ns() - start, memory_order_relaxed);
+            if (task == NULL) {
+                return NULL;
+            }
+        }
+        execute(worker, task);
+    }
+}
+
+// Look for a task a few more times, then sleep until a task is spawned or
+// the pool stops. Sleepers register themselves before their last look, and
+// spawners check for sleepers after publishing their tasks, so either the
+// sleeper sees the task or the spawner sees the sleeper.
+static Task *wait_for_task(ThreadPool *pool, Worker *worker) {
+    for (size_t spin = 0; spin < IDLE_SPINS; spin++) {
+        sched_yield();
+        Task *task = find_task(pool, worker);
+        if (task != NULL) {
+            return task;
+        }
+    }
+
+    Task *task = NULL;
+    pthread_mutex_lock(&pool->sleep_lock);
+    atomic_fetch_add(&pool->sleeping, 1);
+    while (!atomic_load(&pool->stop) && (task = find_task(pool, worker)) == NULL) {
+        pthread_cond_wait(&pool->wake, &pool->sleep_lock);
+    }
+    atomic_fetch_sub(&pool->sleeping, 1);
+    pthread_mutex_unlock(&pool->sleep_lock);
+    return task;
+}
+
+// Take a task from the worker's own deque, then from the injector queue,
+// then from the other workers. worker is NULL for threads outside the
+// pool.
+static Task *find_task(ThreadPool *pool, Worker *worker) {
+    Task *task = (worker != NULL) ? deque_pop(&worker->deque) : NULL;
+    if (task == NULL) {
+        task = injector_pop(pool);
+    }
+    if (task == NULL) {
+        task = steal(pool, worker);
+    }
+    return task;
+}
+
+// Try every other worker's deque once, starting from a random one so the
+// thieves spread out. The round is retried while a steal lost a race,
+// since the deque may still hold tasks.
+static Task *steal(ThreadPool *pool, Worker *worker) {
+    size_t start = 0;
+    if (worker != NULL) {
+        worker->seed ^= worker->seed << 13;
+        worker->seed ^= worker->seed >> 7;
+        worker->seed ^= worker->seed << 17;
+        start = worker->seed % pool->nthreads;
+    }
+
+    bool contended = true;
+    while (contended) {
+        contended = false;
+        for (size_t i = 0; i < pool->nthreads; i++) {
+            Worker *victim = &pool->workers[(start + i) % pool->nthreads];
+            if (victim == worker) {
+                continue;
+            }
+            bool lost = false;
+            Task *task = deque_steal(&victim->deque, &lost);
+            if (task != NULL) {
+                if (worker != NULL) {
+                    atomic_fetch_add_explicit(&worker->steals, 1, memory_order_relaxed);
+                }
+                return task;
+            }
+            if (lost && worker != NULL) {
+                atomic_fetch_add_explicit(&worker->failed_steals, 1, memory_order_relaxed);
+            }
+            contended |= lost;
+        }
+    }
+    return NULL;
+}
+
+// Run a task and mark it finished in its scope. The scope is read first,
+// since the task may be freed as soon as the scope has no pending tasks.
+static void execute(Worker *worker, Task *task) {
+    TaskScope *scope = task->scope;
+    task->func(task->arg);
+    if (worker != NULL) {
+        atomic_fetch_add_explicit(&worker->executed, 1, memory_order_relaxed);
+    }
+    atomic_fetch_sub_explicit(&scope->pending, 1, memory_order_release);
+}
+
+// Append tasks spawned outside the pool to the injector queue.
+static void inject(ThreadPool *pool, Task *tasks, size_t count) {
+    for (size_t i = 0; i + 1 < count; i++) {
+        tasks[i].next = &tasks[i + 1];
+    }
+    tasks[count - 1].next = NULL;
+
+    pthread_mutex_lock(&pool->injector_lock);
+    if (pool->injector_tail != NULL) {
+        pool->injector_tail->next = &tasks[0];
+    } else {
+        pool->injector_head = &tasks[0];
+    }
+    pool->injector_tail = &tasks[count - 1];
+    atomic_fetch_add(&pool->injected, count);
+    pthread_mutex_unlock(&pool->injector_lock);
+}
+
+// Take the oldest task of the injector queue, the counter lets finders
+// skip the lock when it is empty.
+static Task *injector_pop(ThreadPool *pool) {
+    if (atomic_load(&pool->injected) == 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&pool->injector_lock);
+    Task *task = pool->injector_head;
+    if (task != NULL) {
+        pool->injector_head = task->next;
+        if (pool->injector_head == NULL) {
+            pool->injector_tail = NULL;
+        }
+        atomic_fetch_sub(&pool->injected, 1);
+    }
+    pthread_mutex_unlock(&pool->injector_lock);
+    return task;
+}
+
+// Wake sleeping workers after tasks were published, one for a single task
+// and all of them for a batch.
+static void wake(ThreadPool *pool, size_t count) {
+    if (atomic_load(&pool->sleeping) == 0) {
+        return;
+    }
+    pthread_mutex_lock(&pool->sleep_lock);
+    if (count > 1) {
+        pthread_cond_broadcast(&pool->wake);
+    } else {
+        pthread_cond_signal(&pool->wake);
+    }
+    pthread_mutex_unlock(&pool->sleep_lock);
+}
+
+// Get the calling thread's worker if it belongs to pool, NULL otherwise.
+static Worker *worker_of(const ThreadPool *pool) {
+    return (current_worker != NULL && current_worker->pool == pool) ? current_worker : NULL;
+}
+
+// Initialize an empty deque.
+static void deque_init(TaskDeque *deque, Allocator alloc) {
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, array_new(DEQUE_INITIAL_CAP, alloc));
+}
+
+// Free the array of a deque and all the arrays it replaced.
+static void deque_free(TaskDeque *deque, Allocator alloc) {
+    TaskArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    while (array != NULL) {
+        TaskArray *prev = array->prev;
+        allocator_deallocate(alloc, array);
+        array = prev;
+    }
+}
+
+// Push tasks at the bottom of the deque, only called by its owner. The
+// store of bottom publishes all of them at once.
+static void deque_push(TaskDeque *deque, Task *tasks, size_t count, Allocator alloc) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    TaskArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    while (bottom - top + (int64_t) count > array->cap) {
+        array = grow(deque, array, top, bottom, alloc);
+    }
+    for (size_t i = 0; i < count; i++) {
+        int64_t slot = (bottom + (int64_t) i) & (array->cap - 1);
+        atomic_store_explicit(&array->tasks[slot], &tasks[i], memory_order_relaxed);
+    }
+    atomic_store(&deque->bottom, bottom + (int64_t) count);
+}
+
+// Pop the newest task from the bottom of the deque, only called by its
+// owner. When a single task is left the owner races the thieves for it.
+static Task *deque_pop(TaskDeque *deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    TaskArray *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store(&deque->bottom, bottom);
+    int64_t top = atomic_load(&deque->top);
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    Task *task = atomic_load_explicit(&array->tasks[bottom & (array->cap - 1)], memory_order_relaxed);
+    if (top == bottom) {
+        if (!atomic_compare_exchange_strong(&deque->top, &top, top + 1)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Steal the oldest task from the top of the deque. contended is set when
+// another thread took the task first.
+static Task *deque_steal(TaskDeque *deque, bool *contended) {
+    int64_t top = atomic_load(&deque->top);
+    int64_t bottom = atomic_load(&deque->bottom);
+    if (top >= bottom) {
+        return NULL;
+    }
+
+    TaskArray *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    Task *task = atomic_load_explicit(&array->tasks[top & (array->cap - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong(&deque->top, &top, top + 1)) {
+        *contended = true;
+        return NULL;
+    }
+    return task;
+}
+
+// Allocate an array of cap task slots, cap must be a power of 2.
+static TaskArray *array_new(int64_t cap, Allocator alloc) {
+    TaskArray *array = allocator_allocate(alloc, sizeof(TaskArray) + (size_t) cap * sizeof(_Atomic(Task *)));
+    ASSERT(array != NULL, "Out of memory");
+    array->cap = cap;
+    array->prev = NULL;
+    return array;
+}
+
+// Replace the array of a deque with one twice as large holding the same
+// tasks at the same indices.
+static TaskArray *grow(TaskDeque *deque, TaskArray *array, int64_t top, int64_t bottom, Allocator alloc) {
+    TaskArray *new_array = array_new(array->cap * 2, alloc);
+    for (int64_t i = top; i < bottom; i++) {
+        Task *task = atomic_load_explicit(&array->tasks[i & (array->cap - 1)], memory_order_relaxed);
+        atomic_store_explicit(&new_array->tasks[i & (new_array->cap - 1)], task, memory_order_relaxed);
+    }
+    new_array->prev = array;
+    atomic_store_explicit(&deque->array, new_array, memory_order_release);
+    return new_array;
+}
+
+// Create the global pool, it is freed when the process exits.
+static void create_global_pool(void) {
+    global_pool = thread_pool_new();
+    atexit(free_global_pool);
+}
+
+// Free the global pool.
+static void free_global_pool(void) {
+    thread_pool_free(global_pool);
+}
+
+// Get the time of the monotonic clock in nanoseconds.
+static uint64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000 + (uint64_t) time.tv_nsec;
+}
@@ -0,0 +1,471 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "../vec_io.h"
+
+#if defined(__x86_64__)
+#define X86_CRC32
+#include <immintrin.h>
+#endif
+
+#define CRC32C_POLY 0x82F63B78u
+
+// The file header, its layout is documented in vec_io.h.
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t header_size;
+    uint32_t checksum;
+    uint64_t elem_size;
+    uint64_t count;
+} VecHeader;
+
+// The state of a mapped vector, the context of its allocator. The file
+// descriptor is only kept open, and locked, for read-write mappings. A
+// pointer to it follows the header in the private header page.
+typedef struct {
+    int fd;
+    bool writable;
+    char *base;
+    size_t length;
+} VecMapping;
+
+_Static_assert(sizeof(VecHeader) == 32, "VecHeader must be 32 bytes");
+
+static VecHeader make_header(const void *vector);
+static bool check_header(const VecHeader *header, size_t elem_size);
+static bool check_checksum(const VecHeader *header, const void *vector);
+static bool check_file_size(int fd, const VecHeader *header);
+static char *map_file(int fd, size_t length, bool writable);
+static VecMapping *find_mapping(void *vector);
+static void *mapping_allocate(Allocator alloc, size_t size);
+static void *mapping_reallocate(Allocator alloc, void *ptr, size_t size);
+static void mapping_deallocate(Allocator alloc, void *ptr);
+static bool read_all(int fd, void *data, size_t size);
+static bool write_all(int fd, const void *data, size_t size);
+static uint32_t crc32c_scalar(const uint8_t *data, size_t size, uint32_t crc);
+#ifdef X86_CRC32
+static uint32_t crc32c_sse42(const uint8_t *data, size_t size, uint32_t crc);
+#endif
+
+uint32_t mem_crc32c(const void *data, size_t size, uint32_t crc) {
+#ifdef X86_CRC32
+    if (__builtin_cpu_supports("sse4.2")) {
+        return ~crc32c_sse42(data, size, ~crc);
+    }
+#endif
+    return ~crc32c_scalar(data, size, ~crc);
+}
+
+bool vec_write_fd(const void *vector, int fd) {
+    VecHeader header = make_header(vector);
+    size_t data_size = vec_size(vector) * vec_elem_size(vector);
+    struct iovec iov[2] = {
+        { .iov_base = &header, .iov_len = sizeof(VecHeader) },
+        { .iov_base = (void *) vector, .iov_len = data_size }
+    };
+    ssize_t written;
+    do {
+        written = writev(fd, iov, 2);
+    } while (written < 0 && errno == EINTR);
+    if (written < 0) {
+        return false;
+    }
+
+    // Finish a short write with plain writes.
+    size_t done = (size_t) written;
+    if (done < sizeof(VecHeader)) {
+        if (!write_all(fd, (char *) &header + done, sizeof(VecHeader) - done)) {
+            return false;
+        }
+        done = sizeof(VecHeader);
+    }
+    done -= sizeof(VecHeader);
+    return write_all(fd, (const char *) vector + done, data_size - done);
+}
+
+void *internal_vec_read_fd(int fd, size_t elem_size, VecArgs args) {
+    VecHeader header;
+    if (
+        !read_all(fd, &header, sizeof(VecHeader))
+        || !check_header(&header, elem_size)
+        || !check_file_size(fd, &header)
+    ) {
+        return NULL;
+    }
+    char skipped[256];
+    for (size_t skip = header.header_size - sizeof(VecHeader); skip > 0;) {
+        size_t size = (skip < sizeof(skipped)) ? skip : sizeof(skipped);
+        if (!read_all(fd, skipped, size)) {
+            return NULL;
+        }
+        skip -= size;
+    }
+
+    void *vector = internal_vec_new(elem_size, args, header.count);
+    if (!read_all(fd, vector, header.count * elem_size) || !check_checksum(&header, vector)) {
+        vec_free(vector);
+        return NULL;
+    }
+    return vector;
+}
+
+bool vec_write_file(const void *vector, FILE *file) {
+    VecHeader header = make_header(vector);
+    return fwrite(&header, sizeof(VecHeader), 1, file) == 1
+        && fwrite(vector, vec_elem_size(vector), vec_size(vector), file) == vec_size(vector);
+}
+
+void *internal_vec_read_file(FILE *file, size_t elem_size, VecArgs args) {
+    VecHeader header;
+    if (fread(&header, sizeof(VecHeader), 1, file) != 1) {
+        errno = ferror(file) ? errno : EBADMSG;
+        return NULL;
+    }
+    if (!check_header(&header, elem_size)) {
+        return NULL;
+    }
+    for (size_t skip = header.header_size - sizeof(VecHeader); skip > 0; skip--) {
+        if (fgetc(file) == EOF) {
+            errno = ferror(file) ? errno : EBADMSG;
+            return NULL;
+        }
+    }
+
+    void *vector = internal_vec_new(elem_size, args, header.count);
+    if (fread(vector, elem_size, header.count, file) != header.count) {
+        errno = ferror(file) ? errno : EBADMSG;
+        vec_free(vector);
+        return NULL;
+    }
+    if (!check_checksum(&header, vector)) {
+        vec_free(vector);
+        return NULL;
+    }
+    return vector;
+}
+
+void *internal_vec_mmap(const char *path, size_t elem_size, VecMmapMode mode) {
+    size_t meta_size = internal_vec_meta_size();
+    ASSERT(
+        sizeof(VecHeader) + sizeof(VecMapping *) + meta_size <= VEC_MMAP_HEADER_SIZE,
+        "Header too small for the metadata"
+    );
+    bool writable = mode == VEC_MMAP_READ_WRITE;
+    if (writable && VEC_MMAP_HEADER_SIZE % (size_t) sysconf(_SC_PAGESIZE) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    int fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // Read the header, or write it to a new file. The checksum of a file
+    // opened for writing is dropped since the elements change in place.
+    struct stat st;
+    VecHeader header = {
+        .magic = VEC_IO_MAGIC,
+        .version = VEC_IO_VERSION,
+        .flags = 0,
+        .header_size = VEC_MMAP_HEADER_SIZE,
+        .checksum = 0,
+        .elem_size = elem_size,
+        .count = 0
+    };
+    bool ok = !writable || flock(fd, LOCK_EX | LOCK_NB) == 0;
+    ok = ok && fstat(fd, &st) == 0;
+    if (ok && writable && st.st_size == 0) {
+        ok = ftruncate(fd, VEC_MMAP_HEADER_SIZE) == 0;
+        st.st_size = VEC_MMAP_HEADER_SIZE;
+    } else if (ok) {
+        ok = read_all(fd, &header, sizeof(VecHeader)) && check_header(&header, elem_size);
+        if (ok && (header.header_size != VEC_MMAP_HEADER_SIZE || (uint64_t) st.st_size < VEC_MMAP_HEADER_SIZE)) {
+            errno = EINVAL;
+            ok = false;
+        } else if (ok && (uint64_t) (st.st_size - VEC_MMAP_HEADER_SIZE) / elem_size < header.count) {
+            errno = EBADMSG;
+            ok = false;
+        }
+        header.flags &= (uint16_t) ~(writable ? VEC_IO_CHECKSUM : 0);
+    }
+    if (ok && writable) {
+        ok = pwrite(fd, &header, sizeof(VecHeader), 0) == sizeof(VecHeader);
+    }
+
+    size_t length = (size_t) st.st_size;
+    char *base = ok ? map_file(fd, length, writable) : MAP_FAILED;
+    if (base == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+    if (!writable) {
+        size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+        size_t start = (VEC_MMAP_HEADER_SIZE + page_size - 1) / page_size * page_size;
+        if (start < length) {
+            mprotect(base + start, length - start, PROT_READ);
+        }
+        close(fd);
+        fd = -1;
+    }
+
+    Allocator alloc = allocator_new();
+    VecMapping *mapping = allocator_allocate(alloc, sizeof(VecMapping));
+    ASSERT(mapping != NULL, "Out of memory");
+    *mapping = (VecMapping) { .fd = fd, .writable = writable, .base = base, .length = length };
+    memcpy(base + sizeof(VecHeader), &mapping, sizeof(VecMapping *));
+    alloc = (Allocator) {
+        .ctx = mapping,
+        .allocate = mapping_allocate,
+        .reallocate = mapping_reallocate,
+        .deallocate = mapping_deallocate
+    };
+    return internal_vec_place(
+        base + VEC_MMAP_HEADER_SIZE - meta_size,
+        elem_size,
+        header.count,
+        (length - VEC_MMAP_HEADER_SIZE) / elem_size,
+        alloc
+    );
+}
+
+bool vec_mmap_sync(void *vector) {
+    VecMapping *mapping = find_mapping(vector);
+    if (!mapping->writable) {
+        return true;
+    }
+    VecHeader *header = (VecHeader *) mapping->base;
+    header->count = vec_size(vector);
+    size_t length = vec_capacity(vector) * vec_elem_size(vector);
+    return pwrite(mapping->fd, header, sizeof(VecHeader), 0) == sizeof(VecHeader)
+        && (length == 0 || msync(vector, length, MS_SYNC) == 0)
+        && fdatasync(mapping->fd) == 0;
+}
+
+// Fill in the header of a vector, checksumming its elements.
+static VecHeader make_header(const void *vector) {
+    return (VecHeader) {
+        .magic = VEC_IO_MAGIC,
+        .version = VEC_IO_VERSION,
+        .flags = VEC_IO_CHECKSUM,
+        .header_size = sizeof(VecHeader),
+        .checksum = mem_crc32c(vector, vec_size(vector) * vec_elem_size(vector), 0),
+        .elem_size = vec_elem_size(vector),
+        .count = vec_size(vector)
+    };
+}
+
+// Check that a header belongs to a vector of elem_size elements this
+// version can read, setting errno otherwise.
+static bool check_header(const VecHeader *header, size_t elem_size) {
+    if (
+        header->magic != VEC_IO_MAGIC
+        || header->version > VEC_IO_VERSION
+        || header->header_size < sizeof(VecHeader)
+        || header->elem_size != elem_size
+        || (elem_size > 0 && header->count > SIZE_MAX / elem_size)
+    ) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+// Check the elements read against the checksum of the header, if it has
+// one, setting errno on a mismatch.
+static bool check_checksum(const VecHeader *header, const void *vector) {
+    if ((header->flags & VEC_IO_CHECKSUM) && mem_crc32c(vector, header->count * header->elem_size, 0) != header->checksum) {
+        errno = EBADMSG;
+        return false;
+    }
+    return true;
+}
+
+// Check that a regular file holds as many bytes as the header announces,
+// so a corrupt count fails before allocating the vector. Other files are
+// only checked while reading.
+static bool check_file_size(int fd, const VecHeader *header) {
+    struct stat st;
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || offset < 0) {
+        return true;
+    }
+    uint64_t left = (uint64_t) (st.st_size - offset);
+    uint64_t needed = header->header_size - sizeof(VecHeader);
+    if (left < needed || (left - needed) / header->elem_size < header->count) {
+        errno = EBADMSG;
+        return false;
+    }
+    return true;
+}
+
+// Map a file of length bytes. The header page is private, so the metadata
+// written into its padding stays in this process. The elements of a
+// read-write file are shared right after it, those of a read-only file
+// stay private as they are never written.
+static char *map_file(int fd, size_t length, bool writable) {
+    char *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED || !writable || length == VEC_MMAP_HEADER_SIZE) {
+        return base;
+    }
+    void *elements = mmap(
+        base + VEC_MMAP_HEADER_SIZE,
+        length - VEC_MMAP_HEADER_SIZE,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_FIXED,
+        fd,
+        VEC_MMAP_HEADER_SIZE
+    );
+    if (elements == MAP_FAILED) {
+        int error = errno;
+        munmap(base, length);
+        errno = error;
+        return MAP_FAILED;
+    }
+    return base;
+}
+
+// Find the mapping of a vector from the pointer after its header.
+static VecMapping *find_mapping(void *vector) {
+    VecMapping *mapping;
+    memcpy(&mapping, (char *) vector - VEC_MMAP_HEADER_SIZE + sizeof(VecHeader), sizeof(VecMapping *));
+    return mapping;
+}
+
+// A mapped vector is only allocated by vec_mmap, copying it to the heap
+// would leave the copy with this allocator.
+static void *mapping_allocate(Allocator alloc, size_t size) {
+    (void) alloc;
+    (void) size;
+    ASSERT(false, "A shared mapped vector cannot be modified");
+    return NULL;
+}
+
+// Resize the file and map it again to hold the metadata and size bytes of
+// elements, carrying the private header page over. The mapping may move.
+static void *mapping_reallocate(Allocator alloc, void *ptr, size_t size) {
+    VecMapping *mapping = alloc.ctx;
+    ASSERT(mapping->writable, "A read-only mapped vector cannot be resized");
+    size_t meta_offset = VEC_MMAP_HEADER_SIZE - internal_vec_meta_size();
+    ASSERT((char *) ptr == mapping->base + meta_offset, "Not a mapped vector");
+    size_t length = meta_offset + size;
+    if (ftruncate(mapping->fd, (off_t) length) < 0) {
+        return NULL;
+    }
+    char *base = map_file(mapping->fd, length, true);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    memcpy(base, mapping->base, VEC_MMAP_HEADER_SIZE);
+    munmap(mapping->base, mapping->length);
+    mapping->base = base;
+    mapping->length = length;
+    return base + meta_offset;
+}
+
+// Unmap the vector. A read-write file gets the final size in its header
+// and is trimmed to the elements, if trimming fails readers ignore the
+// extra bytes. Closing the file releases its lock.
+static void mapping_deallocate(Allocator alloc, void *ptr) {
+    VecMapping *mapping = alloc.ctx;
+    if (mapping->writable) {
+        void *vector = (char *) ptr + internal_vec_meta_size();
+        size_t length = VEC_MMAP_HEADER_SIZE + vec_size(vector) * vec_elem_size(vector);
+        VecHeader *header = (VecHeader *) mapping->base;
+        header->count = vec_size(vector);
+        ssize_t written = pwrite(mapping->fd, header, sizeof(VecHeader), 0);
+        (void) written;
+        munmap(mapping->base, mapping->length);
+        int trimmed = ftruncate(mapping->fd, (off_t) length);
+        (void) trimmed;
+        close(mapping->fd);
+    } else {
+        munmap(mapping->base, mapping->length);
+    }
+    allocator_deallocate(allocator_new(), mapping);
+}
+
+// Read the whole buffer, retrying on short reads and interrupts. Reaching
+// the end of the file early is an error.
+static bool read_all(int fd, void *data, size_t size) {
+    while (size > 0) {
+        ssize_t bytes = read(fd, data, size);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (bytes == 0) {
+            errno = EBADMSG;
+            return false;
+        }
+        data = (char *) data + bytes;
+        size -= (size_t) bytes;
+    }
+    return true;
+}
+
+// Write the whole buffer, retrying on short writes and interrupts.
+static bool write_all(int fd, const void *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data = (const char *) data + written;
+        size -= (size_t) written;
+    }
+    return true;
+}
+
+// Compute the CRC a byte at a time with a lookup table, without the
+// inversions of mem_crc32c. The table is cheap next to the data it is
+// used for.
+static uint32_t crc32c_scalar(const uint8_t *data, size_t size, uint32_t crc) {
+    uint32_t table[256];
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t entry = i;
+        for (int bit = 0; bit < 8; bit++) {
+            entry = (entry >> 1) ^ ((entry & 1) ? CRC32C_POLY : 0);
+        }
+        table[i] = entry;
+    }
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc >> 8) ^ table[(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef X86_CRC32
+
+// Compute the CRC 8 bytes at a time with the crc32 instruction.
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(const uint8_t *data, size_t size, uint32_t crc) {
+    uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t) crc64;
+    for (; size > 0; size--, data++) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+
+#endif
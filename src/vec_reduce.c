@@ -0,0 +1,501 @@
+#include <math.h>
+
+#include "../vec_reduce.h"
+#include "../vector.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Float sums are split in halves until they are at most this long, the
+// halves are then summed in 8 interleaved lanes.
+#define PAIRWISE_BLOCK 128
+
+typedef double (*block_sum_fn)(const double *data, size_t size, double center, bool squared);
+
+static double pairwise_sum(block_sum_fn block_sum, const double *data, size_t size, double center, bool squared);
+static block_sum_fn select_block_sum(void);
+static double fold_lanes(const double lanes[8]);
+static double term(double value, double center, bool squared);
+static int64_t sum_i32_scalar(const int32_t *data, size_t size);
+static int32_t minmax_i32_scalar(const int32_t *data, size_t size, bool max, int32_t result);
+static void scan_i32_scalar(const int32_t *src, int32_t *dst, size_t size, bool exclusive, uint32_t total);
+static double minmax_f64_scalar(const double *data, size_t size, bool max, double result);
+static void scan_f64(const double *src, double *dst, size_t size, bool exclusive);
+static int64_t sum_i32(const int32_t *data, size_t size);
+static int32_t minmax_i32(const int32_t *data, size_t size, bool max);
+static void scan_i32(const int32_t *src, int32_t *dst, size_t size, bool exclusive);
+static double minmax_f64(const double *data, size_t size, bool max);
+#ifndef X86_SIMD
+static double block_sum_scalar(const double *data, size_t size, double center, bool squared);
+#else
+static int64_t sum_i32_sse2(const int32_t *data, size_t size);
+static int32_t minmax_i32_sse2(const int32_t *data, size_t size, bool max);
+static void scan_i32_sse2(const int32_t *src, int32_t *dst, size_t size, bool exclusive);
+static double block_sum_sse2(const double *data, size_t size, double center, bool squared);
+static double minmax_f64_sse2(const double *data, size_t size, bool max);
+static int64_t sum_i32_avx2(const int32_t *data, size_t size);
+static int32_t minmax_i32_avx2(const int32_t *data, size_t size, bool max);
+static void scan_i32_avx2(const int32_t *src, int32_t *dst, size_t size, bool exclusive);
+static double block_sum_avx2(const double *data, size_t size, double center, bool squared);
+static double minmax_f64_avx2(const double *data, size_t size, bool max);
+#endif
+
+int64_t mem_sum_i32(const int32_t *data, size_t size) {
+    return sum_i32(data, size);
+}
+
+int32_t mem_min_i32(const int32_t *data, size_t size) {
+    return minmax_i32(data, size, false);
+}
+
+int32_t mem_max_i32(const int32_t *data, size_t size) {
+    return minmax_i32(data, size, true);
+}
+
+void mem_inclusive_scan_i32(const int32_t *src, int32_t *dst, size_t size) {
+    scan_i32(src, dst, size, false);
+}
+
+void mem_exclusive_scan_i32(const int32_t *src, int32_t *dst, size_t size) {
+    scan_i32(src, dst, size, true);
+}
+
+double mem_sum_f64(const double *data, size_t size) {
+    return pairwise_sum(select_block_sum(), data, size, 0.0, false);
+}
+
+double mem_min_f64(const double *data, size_t size) {
+    return minmax_f64(data, size, false);
+}
+
+double mem_max_f64(const double *data, size_t size) {
+    return minmax_f64(data, size, true);
+}
+
+double mem_mean_f64(const double *data, size_t size) {
+    if (size == 0) {
+        return NAN;
+    }
+    return mem_sum_f64(data, size) / (double) size;
+}
+
+double mem_variance_f64(const double *data, size_t size) {
+    if (size == 0) {
+        return NAN;
+    }
+    double mean = mem_mean_f64(data, size);
+    return pairwise_sum(select_block_sum(), data, size, mean, true) / (double) size;
+}
+
+void mem_inclusive_scan_f64(const double *src, double *dst, size_t size) {
+    scan_f64(src, dst, size, false);
+}
+
+void mem_exclusive_scan_f64(const double *src, double *dst, size_t size) {
+    scan_f64(src, dst, size, true);
+}
+
+int64_t vec_sum_i32(const int32_t *vector) {
+    return sum_i32(vector, vec_size(vector));
+}
+
+int32_t vec_min_i32(const int32_t *vector) {
+    return minmax_i32(vector, vec_size(vector), false);
+}
+
+int32_t vec_max_i32(const int32_t *vector) {
+    return minmax_i32(vector, vec_size(vector), true);
+}
+
+void *internal_vec_inclusive_scan_i32(int32_t *vector) {
+    vector = internal_vec_make_unique(vector);
+    scan_i32(vector, vector, vec_size(vector), false);
+    return vector;
+}
+
+void *internal_vec_exclusive_scan_i32(int32_t *vector) {
+    vector = internal_vec_make_unique(vector);
+    scan_i32(vector, vector, vec_size(vector), true);
+    return vector;
+}
+
+double vec_sum_f64(const double *vector) {
+    return mem_sum_f64(vector, vec_size(vector));
+}
+
+double vec_min_f64(const double *vector) {
+    return minmax_f64(vector, vec_size(vector), false);
+}
+
+double vec_max_f64(const double *vector) {
+    return minmax_f64(vector, vec_size(vector), true);
+}
+
+double vec_mean_f64(const double *vector) {
+    return mem_mean_f64(vector, vec_size(vector));
+}
+
+double vec_variance_f64(const double *vector) {
+    return mem_variance_f64(vector, vec_size(vector));
+}
+
+void *internal_vec_inclusive_scan_f64(double *vector) {
+    vector = internal_vec_make_unique(vector);
+    scan_f64(vector, vector, vec_size(vector), false);
+    return vector;
+}
+
+void *internal_vec_exclusive_scan_f64(double *vector) {
+    vector = internal_vec_make_unique(vector);
+    scan_f64(vector, vector, vec_size(vector), true);
+    return vector;
+}
+
+// Sum the halves of the array recursively, the split points only depend on
+// the size so the result is the same whichever block_sum is used.
+static double pairwise_sum(block_sum_fn block_sum, const double *data, size_t size, double center, bool squared) {
+    if (size <= PAIRWISE_BLOCK) {
+        return block_sum(data, size, center, squared);
+    }
+    size_t half = size / 2 / 8 * 8;
+    return pairwise_sum(block_sum, data, half, center, squared)
+        + pairwise_sum(block_sum, data + half, size - half, center, squared);
+}
+
+// Pick the block sum of the widest instruction set the CPU supports.
+static block_sum_fn select_block_sum(void) {
+#ifdef X86_SIMD
+    return __builtin_cpu_supports("avx2") ? block_sum_avx2 : block_sum_sse2;
+#else
+    return block_sum_scalar;
+#endif
+}
+
+// Add up the 8 lanes of a block sum, every block sum folds its lanes in
+// this order.
+static double fold_lanes(const double lanes[8]) {
+    return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6]))
+        + ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+}
+
+// Get the value to add to a block sum for an element.
+static double term(double value, double center, bool squared) {
+    return squared ? (value - center) * (value - center) : value;
+}
+
+// Sum an array into a 64 bits integer.
+static int64_t sum_i32(const int32_t *data, size_t size) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return sum_i32_avx2(data, size);
+    }
+    return sum_i32_sse2(data, size);
+#else
+    return sum_i32_scalar(data, size);
+#endif
+}
+
+// Find the smallest or largest element of an array.
+static int32_t minmax_i32(const int32_t *data, size_t size, bool max) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return minmax_i32_avx2(data, size, max);
+    }
+    return minmax_i32_sse2(data, size, max);
+#else
+    return minmax_i32_scalar(data, size, max, max ? INT32_MIN : INT32_MAX);
+#endif
+}
+
+// Compute the inclusive or exclusive prefix sums of an array.
+static void scan_i32(const int32_t *src, int32_t *dst, size_t size, bool exclusive) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        scan_i32_avx2(src, dst, size, exclusive);
+        return;
+    }
+    scan_i32_sse2(src, dst, size, exclusive);
+#else
+    scan_i32_scalar(src, dst, size, exclusive, 0);
+#endif
+}
+
+// Find the smallest or largest element of an array, ignoring NaNs.
+static double minmax_f64(const double *data, size_t size, bool max) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return minmax_f64_avx2(data, size, max);
+    }
+    return minmax_f64_sse2(data, size, max);
+#else
+    return minmax_f64_scalar(data, size, max, max ? -INFINITY : INFINITY);
+#endif
+}
+
+// Scalar version of sum_i32, also used for the tails of the SIMD versions.
+static int64_t sum_i32_scalar(const int32_t *data, size_t size) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < size; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+// Scalar version of minmax_i32 starting from result, also used for the
+// tails of the SIMD versions.
+static int32_t minmax_i32_scalar(const int32_t *data, size_t size, bool max, int32_t result) {
+    for (size_t i = 0; i < size; i++) {
+        if (max ? data[i] > result : data[i] < result) {
+            result = data[i];
+        }
+    }
+    return result;
+}
+
+// Scalar version of scan_i32 starting from total, also used for the tails
+// of the SIMD versions. The sums are unsigned so they can wrap around.
+static void scan_i32_scalar(const int32_t *src, int32_t *dst, size_t size, bool exclusive, uint32_t total) {
+    for (size_t i = 0; i < size; i++) {
+        uint32_t value = (uint32_t) src[i];
+        total += value;
+        dst[i] = (int32_t) (exclusive ? total - value : total);
+    }
+}
+
+#ifndef X86_SIMD
+
+// Scalar version of the block sums, it keeps 8 lanes like the SIMD
+// versions so they all round the same way.
+static double block_sum_scalar(const double *data, size_t size, double center, bool squared) {
+    double lanes[8] = { 0 };
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        for (size_t lane = 0; lane < 8; lane++) {
+            lanes[lane] += term(data[i + lane], center, squared);
+        }
+    }
+    double sum = fold_lanes(lanes);
+    for (; i < size; i++) {
+        sum += term(data[i], center, squared);
+    }
+    return sum;
+}
+
+#endif // X86_SIMD
+
+// Scalar version of minmax_f64 starting from result, also used for the
+// tails of the SIMD versions. NaNs fail both comparisons so they are
+// skipped.
+static double minmax_f64_scalar(const double *data, size_t size, bool max, double result) {
+    for (size_t i = 0; i < size; i++) {
+        if (max ? data[i] > result : data[i] < result) {
+            result = data[i];
+        }
+    }
+    return result;
+}
+
+// Compute the prefix sums of an array left to right, vectorizing the scan
+// would change the rounding of float sums.
+static void scan_f64(const double *src, double *dst, size_t size, bool exclusive) {
+    double total = 0.0;
+    for (size_t i = 0; i < size; i++) {
+        double next = total + src[i];
+        dst[i] = exclusive ? total : next;
+        total = next;
+    }
+}
+
+#ifdef X86_SIMD
+
+// Sign extend 4 elements at a time into 2 lanes of 64 bits.
+static int64_t sum_i32_sse2(const int32_t *data, size_t size) {
+    __m128i sums = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i signs = _mm_srai_epi32(block, 31);
+        sums = _mm_add_epi64(sums, _mm_unpacklo_epi32(block, signs));
+        sums = _mm_add_epi64(sums, _mm_unpackhi_epi32(block, signs));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, sums);
+    return lanes[0] + lanes[1] + sum_i32_scalar(data + i, size - i);
+}
+
+// Keep the 4 running extremes in a register, SSE2 has no 32 bits min and
+// max so they are selected with a compare mask.
+static int32_t minmax_i32_sse2(const int32_t *data, size_t size, bool max) {
+    int32_t result = max ? INT32_MIN : INT32_MAX;
+    __m128i extremes = _mm_set1_epi32(result);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i better = max ? _mm_cmpgt_epi32(block, extremes) : _mm_cmplt_epi32(block, extremes);
+        extremes = _mm_or_si128(_mm_and_si128(better, block), _mm_andnot_si128(better, extremes));
+    }
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i *) lanes, extremes);
+    result = minmax_i32_scalar(lanes, 4, max, result);
+    return minmax_i32_scalar(data + i, size - i, max, result);
+}
+
+// Scan 4 elements at a time with 2 shifted adds, then add the total of
+// the previous elements broadcast from the last lane.
+static void scan_i32_sse2(const int32_t *src, int32_t *dst, size_t size, bool exclusive) {
+    __m128i total = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i sums = _mm_add_epi32(block, _mm_slli_si128(block, 4));
+        sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+        sums = _mm_add_epi32(sums, total);
+        total = _mm_shuffle_epi32(sums, 0xFF);
+        _mm_storeu_si128((__m128i *) (dst + i), exclusive ? _mm_sub_epi32(sums, block) : sums);
+    }
+    scan_i32_scalar(src + i, dst + i, size - i, exclusive, (uint32_t) _mm_cvtsi128_si32(total));
+}
+
+// Keep the 8 lanes of the block sum in 4 registers.
+static double block_sum_sse2(const double *data, size_t size, double center, bool squared) {
+    __m128d centers = _mm_set1_pd(center);
+    __m128d sums[4] = { _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd() };
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        for (size_t j = 0; j < 4; j++) {
+            __m128d block = _mm_loadu_pd(data + i + 2 * j);
+            if (squared) {
+                block = _mm_sub_pd(block, centers);
+                block = _mm_mul_pd(block, block);
+            }
+            sums[j] = _mm_add_pd(sums[j], block);
+        }
+    }
+    double lanes[8];
+    for (size_t j = 0; j < 4; j++) {
+        _mm_storeu_pd(lanes + 2 * j, sums[j]);
+    }
+    double sum = fold_lanes(lanes);
+    for (; i < size; i++) {
+        sum += term(data[i], center, squared);
+    }
+    return sum;
+}
+
+// Keep the 4 running extremes in 2 registers. minpd and maxpd return their
+// second operand when either is NaN, so NaN elements are skipped.
+static double minmax_f64_sse2(const double *data, size_t size, bool max) {
+    double result = max ? -INFINITY : INFINITY;
+    __m128d extremes[2] = { _mm_set1_pd(result), _mm_set1_pd(result) };
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        for (size_t j = 0; j < 2; j++) {
+            __m128d block = _mm_loadu_pd(data + i + 2 * j);
+            extremes[j] = max ? _mm_max_pd(block, extremes[j]) : _mm_min_pd(block, extremes[j]);
+        }
+    }
+    double lanes[4];
+    _mm_storeu_pd(lanes, extremes[0]);
+    _mm_storeu_pd(lanes + 2, extremes[1]);
+    result = minmax_f64_scalar(lanes, 4, max, result);
+    return minmax_f64_scalar(data + i, size - i, max, result);
+}
+
+// AVX2 version of sum_i32_sse2, 8 elements into 4 lanes at a time.
+__attribute__((target("avx2")))
+static int64_t sum_i32_avx2(const int32_t *data, size_t size) {
+    __m256i sums = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) (data + i));
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(block)));
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(block, 1)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, sums);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_i32_scalar(data + i, size - i);
+}
+
+// AVX2 version of minmax_i32_sse2, 8 elements at a time.
+__attribute__((target("avx2")))
+static int32_t minmax_i32_avx2(const int32_t *data, size_t size, bool max) {
+    int32_t result = max ? INT32_MIN : INT32_MAX;
+    __m256i extremes = _mm256_set1_epi32(result);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) (data + i));
+        extremes = max ? _mm256_max_epi32(block, extremes) : _mm256_min_epi32(block, extremes);
+    }
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i *) lanes, extremes);
+    result = minmax_i32_scalar(lanes, 8, max, result);
+    return minmax_i32_scalar(data + i, size - i, max, result);
+}
+
+// AVX2 version of scan_i32_sse2, 8 elements at a time. The shifts only
+// work within 128 bits lanes, so the low lane's total is then added to
+// the high lane.
+__attribute__((target("avx2")))
+static void scan_i32_avx2(const int32_t *src, int32_t *dst, size_t size, bool exclusive) {
+    __m256i total = _mm256_setzero_si256();
+    __m256i last = _mm256_set1_epi32(7);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i sums = _mm256_add_epi32(block, _mm256_slli_si256(block, 4));
+        sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 8));
+        __m256i low_total = _mm256_shuffle_epi32(_mm256_permute2x128_si256(sums, sums, 0x08), 0xFF);
+        sums = _mm256_add_epi32(sums, low_total);
+        sums = _mm256_add_epi32(sums, total);
+        total = _mm256_permutevar8x32_epi32(sums, last);
+        _mm256_storeu_si256((__m256i *) (dst + i), exclusive ? _mm256_sub_epi32(sums, block) : sums);
+    }
+    uint32_t carry = (uint32_t) _mm256_cvtsi256_si32(total);
+    scan_i32_scalar(src + i, dst + i, size - i, exclusive, carry);
+}
+
+// AVX2 version of block_sum_sse2, the 8 lanes fit in 2 registers.
+__attribute__((target("avx2")))
+static double block_sum_avx2(const double *data, size_t size, double center, bool squared) {
+    __m256d centers = _mm256_set1_pd(center);
+    __m256d sums[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        for (size_t j = 0; j < 2; j++) {
+            __m256d block = _mm256_loadu_pd(data + i + 4 * j);
+            if (squared) {
+                block = _mm256_sub_pd(block, centers);
+                block = _mm256_mul_pd(block, block);
+            }
+            sums[j] = _mm256_add_pd(sums[j], block);
+        }
+    }
+    double lanes[8];
+    _mm256_storeu_pd(lanes, sums[0]);
+    _mm256_storeu_pd(lanes + 4, sums[1]);
+    double sum = fold_lanes(lanes);
+    for (; i < size; i++) {
+        sum += term(data[i], center, squared);
+    }
+    return sum;
+}
+
+// AVX2 version of minmax_f64_sse2, 4 elements at a time.
+__attribute__((target("avx2")))
+static double minmax_f64_avx2(const double *data, size_t size, bool max) {
+    double result = max ? -INFINITY : INFINITY;
+    __m256d extremes = _mm256_set1_pd(result);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m256d block = _mm256_loadu_pd(data + i);
+        extremes = max ? _mm256_max_pd(block, extremes) : _mm256_min_pd(block, extremes);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, extremes);
+    result = minmax_f64_scalar(lanes, 4, max, result);
+    return minmax_f64_scalar(data + i, size - i, max, result);
+}
+
+#endif // X86_SIMD
@@ -0,0 +1,330 @@
+#include "../vec_search.h"
+#include "../vector.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define X86_SIMD
+#include <immintrin.h>
+#endif
+
+static size_t find_u8(const uint8_t *data, size_t size, uint8_t value, bool equal);
+static size_t find_i32(const int32_t *data, size_t size, int32_t value, bool equal);
+static size_t count_i32(const int32_t *data, size_t size, int32_t value, bool less);
+static size_t count_lt_f64(const double *data, size_t size, double value);
+static size_t find_u8_scalar(const uint8_t *data, size_t size, uint8_t value, bool equal);
+static size_t find_i32_scalar(const int32_t *data, size_t size, int32_t value, bool equal);
+static size_t count_i32_scalar(const int32_t *data, size_t size, int32_t value, bool less);
+static size_t count_lt_f64_scalar(const double *data, size_t size, double value);
+#ifdef X86_SIMD
+static size_t find_u8_sse2(const uint8_t *data, size_t size, uint8_t value, bool equal);
+static size_t find_i32_sse2(const int32_t *data, size_t size, int32_t value, bool equal);
+static size_t count_i32_sse2(const int32_t *data, size_t size, int32_t value, bool less);
+static size_t count_lt_f64_sse2(const double *data, size_t size, double value);
+static size_t find_u8_avx2(const uint8_t *data, size_t size, uint8_t value, bool equal);
+static size_t find_i32_avx2(const int32_t *data, size_t size, int32_t value, bool equal);
+static size_t count_i32_avx2(const int32_t *data, size_t size, int32_t value, bool less);
+static size_t count_lt_f64_avx2(const double *data, size_t size, double value);
+#endif
+
+size_t mem_find_eq_u8(const uint8_t *data, size_t size, uint8_t value) {
+    return find_u8(data, size, value, true);
+}
+
+size_t mem_find_ne_u8(const uint8_t *data, size_t size, uint8_t value) {
+    return find_u8(data, size, value, false);
+}
+
+size_t mem_find_eq_i32(const int32_t *data, size_t size, int32_t value) {
+    return find_i32(data, size, value, true);
+}
+
+size_t mem_find_ne_i32(const int32_t *data, size_t size, int32_t value) {
+    return find_i32(data, size, value, false);
+}
+
+size_t mem_count_eq_i32(const int32_t *data, size_t size, int32_t value) {
+    return count_i32(data, size, value, false);
+}
+
+size_t mem_count_lt_i32(const int32_t *data, size_t size, int32_t value) {
+    return count_i32(data, size, value, true);
+}
+
+size_t mem_count_lt_f64(const double *data, size_t size, double value) {
+    return count_lt_f64(data, size, value);
+}
+
+Option vec_find_eq_u8(uint8_t *vector, uint8_t value) {
+    size_t size = vec_size(vector);
+    size_t index = find_u8(vector, size, value, true);
+    return (index < size) ? option_some(&vector[index]) : option_none();
+}
+
+Option vec_find_eq_i32(int32_t *vector, int32_t value) {
+    size_t size = vec_size(vector);
+    size_t index = find_i32(vector, size, value, true);
+    return (index < size) ? option_some(&vector[index]) : option_none();
+}
+
+bool vec_any_eq_u8(const uint8_t *vector, uint8_t value) {
+    size_t size = vec_size(vector);
+    return find_u8(vector, size, value, true) < size;
+}
+
+bool vec_any_eq_i32(const int32_t *vector, int32_t value) {
+    size_t size = vec_size(vector);
+    return find_i32(vector, size, value, true) < size;
+}
+
+bool vec_all_eq_u8(const uint8_t *vector, uint8_t value) {
+    size_t size = vec_size(vector);
+    return find_u8(vector, size, value, false) == size;
+}
+
+bool vec_all_eq_i32(const int32_t *vector, int32_t value) {
+    size_t size = vec_size(vector);
+    return find_i32(vector, size, value, false) == size;
+}
+
+size_t vec_count_eq_i32(const int32_t *vector, int32_t value) {
+    return count_i32(vector, vec_size(vector), value, false);
+}
+
+size_t vec_count_if_lt_i32(const int32_t *vector, int32_t value) {
+    return count_i32(vector, vec_size(vector), value, true);
+}
+
+size_t vec_count_if_lt_f64(const double *vector, double value) {
+    return count_lt_f64(vector, vec_size(vector), value);
+}
+
+// Find the first element that is equal (or not equal) to value, picking
+// the widest instruction set the CPU supports.
+static size_t find_u8(const uint8_t *data, size_t size, uint8_t value, bool equal) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return find_u8_avx2(data, size, value, equal);
+    }
+    return find_u8_sse2(data, size, value, equal);
+#else
+    return find_u8_scalar(data, size, value, equal);
+#endif
+}
+
+// Find the first element that is equal (or not equal) to value, picking
+// the widest instruction set the CPU supports.
+static size_t find_i32(const int32_t *data, size_t size, int32_t value, bool equal) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return find_i32_avx2(data, size, value, equal);
+    }
+    return find_i32_sse2(data, size, value, equal);
+#else
+    return find_i32_scalar(data, size, value, equal);
+#endif
+}
+
+// Count the elements that are less than (or equal to) value, picking the
+// widest instruction set the CPU supports.
+static size_t count_i32(const int32_t *data, size_t size, int32_t value, bool less) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return count_i32_avx2(data, size, value, less);
+    }
+    return count_i32_sse2(data, size, value, less);
+#else
+    return count_i32_scalar(data, size, value, less);
+#endif
+}
+
+// Count the elements that are less than value, picking the widest
+// instruction set the CPU supports.
+static size_t count_lt_f64(const double *data, size_t size, double value) {
+#ifdef X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return count_lt_f64_avx2(data, size, value);
+    }
+    return count_lt_f64_sse2(data, size, value);
+#else
+    return count_lt_f64_scalar(data, size, value);
+#endif
+}
+
+// Scalar version of find_u8, also used for the tails of the SIMD versions.
+static size_t find_u8_scalar(const uint8_t *data, size_t size, uint8_t value, bool equal) {
+    size_t i = 0;
+    while (i < size && (data[i] == value) != equal) {
+        i++;
+    }
+    return i;
+}
+
+// Scalar version of find_i32, also used for the tails of the SIMD versions.
+static size_t find_i32_scalar(const int32_t *data, size_t size, int32_t value, bool equal) {
+    size_t i = 0;
+    while (i < size && (data[i] == value) != equal) {
+        i++;
+    }
+    return i;
+}
+
+// Scalar version of count_i32, also used for the tails of the SIMD versions.
+static size_t count_i32_scalar(const int32_t *data, size_t size, int32_t value, bool less) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) {
+        count += less ? (data[i] < value) : (data[i] == value);
+    }
+    return count;
+}
+
+// Scalar version of count_lt_f64, also used for the tails of the SIMD
+// versions.
+static size_t count_lt_f64_scalar(const double *data, size_t size, double value) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) {
+        count += data[i] < value;
+    }
+    return count;
+}
+
+#ifdef X86_SIMD
+
+// Compare 16 bytes at a time, the first set bit of the compare mask is the
+// first match.
+static size_t find_u8_sse2(const uint8_t *data, size_t size, uint8_t value, bool equal) {
+    __m128i needle = _mm_set1_epi8((char) value);
+    unsigned flip = equal ? 0 : 0xFFFF;
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)) ^ flip;
+        if (mask != 0) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+    }
+    return i + find_u8_scalar(data + i, size - i, value, equal);
+}
+
+// Compare 4 elements at a time, the first set bit of the compare mask is
+// the first match.
+static size_t find_i32_sse2(const int32_t *data, size_t size, int32_t value, bool equal) {
+    __m128i needle = _mm_set1_epi32(value);
+    unsigned flip = equal ? 0 : 0xF;
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128 matches = _mm_castsi128_ps(_mm_cmpeq_epi32(block, needle));
+        unsigned mask = (unsigned) _mm_movemask_ps(matches) ^ flip;
+        if (mask != 0) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+    }
+    return i + find_i32_scalar(data + i, size - i, value, equal);
+}
+
+// Compare 4 elements at a time and subtract the all ones compare lanes
+// from per lane counters, which are flushed before they can overflow.
+static size_t count_i32_sse2(const int32_t *data, size_t size, int32_t value, bool less) {
+    __m128i needle = _mm_set1_epi32(value);
+    size_t count = 0;
+    size_t i = 0;
+    while (i + 4 <= size) {
+        size_t block_end = size - ((size - i) % 4);
+        block_end = (block_end - i > ((size_t) 1 << 32)) ? i + ((size_t) 1 << 32) : block_end;
+        __m128i counts = _mm_setzero_si128();
+        for (; i < block_end; i += 4) {
+            __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+            __m128i matches = less ? _mm_cmplt_epi32(block, needle) : _mm_cmpeq_epi32(block, needle);
+            counts = _mm_sub_epi32(counts, matches);
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *) lanes, counts);
+        count += (size_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return count + count_i32_scalar(data + i, size - i, value, less);
+}
+
+// Compare 2 elements at a time, the compare mask has a bit per element.
+static size_t count_lt_f64_sse2(const double *data, size_t size, double value) {
+    __m128d needle = _mm_set1_pd(value);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 2 <= size; i += 2) {
+        unsigned mask = (unsigned) _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(data + i), needle));
+        count += (mask & 1) + (mask >> 1);
+    }
+    return count + count_lt_f64_scalar(data + i, size - i, value);
+}
+
+// AVX2 version of find_u8_sse2, 32 bytes at a time.
+__attribute__((target("avx2")))
+static size_t find_u8_avx2(const uint8_t *data, size_t size, uint8_t value, bool equal) {
+    __m256i needle = _mm256_set1_epi8((char) value);
+    unsigned flip = equal ? 0 : 0xFFFFFFFF;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) (data + i));
+        unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)) ^ flip;
+        if (mask != 0) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+    }
+    return i + find_u8_scalar(data + i, size - i, value, equal);
+}
+
+// AVX2 version of find_i32_sse2, 8 elements at a time.
+__attribute__((target("avx2")))
+static size_t find_i32_avx2(const int32_t *data, size_t size, int32_t value, bool equal) {
+    __m256i needle = _mm256_set1_epi32(value);
+    unsigned flip = equal ? 0 : 0xFF;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256 matches = _mm256_castsi256_ps(_mm256_cmpeq_epi32(block, needle));
+        unsigned mask = (unsigned) _mm256_movemask_ps(matches) ^ flip;
+        if (mask != 0) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+    }
+    return i + find_i32_scalar(data + i, size - i, value, equal);
+}
+
+// AVX2 version of count_i32_sse2, 8 elements at a time.
+__attribute__((target("avx2")))
+static size_t count_i32_avx2(const int32_t *data, size_t size, int32_t value, bool less) {
+    __m256i needle = _mm256_set1_epi32(value);
+    size_t count = 0;
+    size_t i = 0;
+    while (i + 8 <= size) {
+        size_t block_end = size - ((size - i) % 8);
+        block_end = (block_end - i > ((size_t) 1 << 32)) ? i + ((size_t) 1 << 32) : block_end;
+        __m256i counts = _mm256_setzero_si256();
+        for (; i < block_end; i += 8) {
+            __m256i block = _mm256_loadu_si256((const __m256i *) (data + i));
+            __m256i matches = less
+                ? _mm256_cmpgt_epi32(needle, block)
+                : _mm256_cmpeq_epi32(block, needle);
+            counts = _mm256_sub_epi32(counts, matches);
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *) lanes, counts);
+        for (size_t lane = 0; lane < 8; lane++) {
+            count += lanes[lane];
+        }
+    }
+    return count + count_i32_scalar(data + i, size - i, value, less);
+}
+
+// AVX2 version of count_lt_f64_sse2, 4 elements at a time.
+__attribute__((target("avx2,popcnt")))
+static size_t count_lt_f64_avx2(const double *data, size_t size, double value) {
+    __m256d needle = _mm256_set1_pd(value);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m256d matches = _mm256_cmp_pd(_mm256_loadu_pd(data + i), needle, _CMP_LT_OQ);
+        count += (size_t) __builtin_popcount((unsigned) _mm256_movemask_pd(matches));
+    }
+    return count + count_lt_f64_scalar(data + i, size - i, value);
+}
+
+#endif // X86_SIMD
@@ -1,3 +1,5 @@
+#include <stdatomic.h>
+
 #include "../base.h"
 #include "../vector.h"
 
@@ -9,17 +11,24 @@ typedef struct {
     size_t capacity;
     size_t size;
     size_t elem_size;
+    atomic_size_t ref_count;
     Allocator alloc;
 } VectorMeta;
 
 static void *resize(VectorMeta **vector_meta_ref, size_t new_capacity);
+static void *unshare(VectorMeta **vector_meta_ref, size_t new_capacity);
+static bool is_shared(const VectorMeta *vector_meta);
 static size_t find_new_capacity(size_t current_capacity, size_t required_capacity);
-static void swap(void *ptr1, void *ptr2, size_t size);
-static void quicksort(void *vector, compare_fn compare, size_t lo, size_t hi);
-static size_t partition(void *vector, compare_fn compare, size_t lo, size_t hi);
+static void sift_up(void *vector, compare_fn compare, size_t arity, size_t index);
+static void sift_down(void *vector, compare_fn compare, size_t arity, size_t index);
+static void *vit_end(const Iterator *iterator);
 static Option vit_next(Iterator *iterator);
 static Option vit_advance(Iterator *iterator, size_t n);
 static size_t vit_size(Iterator *iterator);
+static Chunk vit_next_chunk(Iterator *iterator);
+static SizeHint vit_size_hint(Iterator *iterator);
+static Option vit_next_back(Iterator *iterator);
+static Option vit_get(Iterator *iterator, size_t index);
 
 void *internal_vec_new(size_t elem_size, VecArgs args, size_t size) {
     args.cap = (size > args.cap) ? size : args.cap;
@@ -32,12 +41,50 @@ void *internal_vec_new(size_t elem_size, VecArgs args, size_t size) {
     vector_meta->capacity = args.cap;
     vector_meta->size = size;
     vector_meta->elem_size = elem_size;
+    atomic_init(&vector_meta->ref_count, 1);
     vector_meta->alloc = args.alloc;
 
     // Initialise vec elements to 0.
     return memset(VEC_PTR(vector_meta), 0, elem_size * args.cap);
 }
 
+void *internal_vec_place(void *memory, size_t elem_size, size_t size, size_t capacity, Allocator alloc) {
+    VectorMeta *vector_meta = memory;
+    vector_meta->capacity = capacity;
+    vector_meta->size = size;
+    vector_meta->elem_size = elem_size;
+    atomic_init(&vector_meta->ref_count, 1);
+    vector_meta->alloc = alloc;
+    return VEC_PTR(vector_meta);
+}
+
+size_t internal_vec_meta_size(void) {
+    return sizeof(VectorMeta);
+}
+
+void *internal_iter_collect(Iterator *iterator, size_t elem_size, VecArgs args) {
+    SizeHint hint = iter_size_hint(*iterator);
+    args.cap = (hint.lower > args.cap) ? hint.lower : args.cap;
+    void *vector = internal_vec_new(elem_size, args, 0);
+
+    // Copy whole blocks when the iterator has them, single elements
+    // otherwise.
+    for (Chunk chunk = iter_take_chunk(iterator); chunk.size > 0; chunk = iter_take_chunk(iterator)) {
+        if (chunk.elem_size == 0) {
+            vector = internal_vec_push_back(vector, chunk.data);
+            continue;
+        }
+        ASSERT(
+            chunk.elem_size == elem_size,
+            "Iterator elem_size (is %zu) should be == elem_size (is %zu)",
+            chunk.elem_size,
+            elem_size
+        );
+        vector = internal_vec_extend(vector, chunk.data, chunk.size);
+    }
+    return vector;
+}
+
 size_t internal_vec_slice(const void *vector, void *buffer, VecSliceArgs args) {
     VectorMeta *vector_meta = VEC_META_PTR(vector);
     ASSERT(
@@ -63,6 +110,27 @@ size_t internal_vec_slice(const void *vector, void *buffer, VecSliceArgs args) {
     return args.end - args.start;
 }
 
+View internal_vec_view(void *vector, VecSliceArgs args) {
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
+    ASSERT(
+        args.start <= args.end,
+        "start (is %zu) should be <= end (is %zu)",
+        args.start,
+        args.end
+    );
+    ASSERT(
+        args.end <= vector_meta->size,
+        "end (is %zu) should be <= vector_size (is %zu)",
+        args.end,
+        vector_meta->size
+    );
+    return view_new(
+        VEC_GET(vector, args.start, vector_meta->elem_size),
+        args.end - args.start,
+        vector_meta->elem_size
+    );
+}
+
 size_t vec_size(const void *vector) {
     return VEC_META_PTR(vector)->size;
 }
@@ -71,10 +139,66 @@ size_t vec_capacity(const void *vector) {
     return VEC_META_PTR(vector)->capacity;
 }
 
+size_t vec_elem_size(const void *vector) {
+    return VEC_META_PTR(vector)->elem_size;
+}
+
 bool vec_is_empty(const void *vector) {
     return vec_size(vector) == 0;
 }
 
+void *internal_vec_heapify(void *vector, compare_fn compare, VecHeapArgs args) {
+    ASSERT(args.arity >= 2, "arity (is %zu) should be >= 2", args.arity);
+    vector = internal_vec_make_unique(vector);
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
+    if (vector_meta->size < 2) {
+        return vector;
+    }
+
+    // Sift down every parent node starting from the last one.
+    for (size_t i = (vector_meta->size - 2) / args.arity + 1; i-- > 0;) {
+        sift_down(vector, compare, args.arity, i);
+    }
+    return vector;
+}
+
+void *internal_vec_heap_push(void *vector, const void *elem,
+                             compare_fn compare, VecHeapArgs args) {
+    ASSERT(args.arity >= 2, "arity (is %zu) should be >= 2", args.arity);
+    vector = internal_vec_push_back(vector, elem);
+    sift_up(vector, compare, args.arity, VEC_META_PTR(vector)->size - 1);
+    return vector;
+}
+
+void *internal_vec_heap_pop(void *vector, void *elem, compare_fn compare,
+                            VecHeapArgs args) {
+    ASSERT(args.arity >= 2, "arity (is %zu) should be >= 2", args.arity);
+    ASSERT(
+        VEC_META_PTR(vector)->size > 0,
+        "vector_size (is %zu) should be > 0",
+        VEC_META_PTR(vector)->size
+    );
+    vector = internal_vec_make_unique(vector);
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
+
+    // Copy the root to elem.
+    if (elem != NULL) {
+        memcpy(elem, vector, vector_meta->elem_size);
+    }
+
+    // Move the last element to the root and restore the heap property.
+    vector_meta->size--;
+    if (vector_meta->size > 0) {
+        memcpy(
+            vector,
+            VEC_GET(vector, vector_meta->size, vector_meta->elem_size),
+            vector_meta->elem_size
+        );
+        sift_down(vector, compare, args.arity, 0);
+    }
+    return vector;
+}
+
 void *internal_vec_insert(void *vector, const void *elem, size_t index) {
     VectorMeta *vector_meta = VEC_META_PTR(vector);
     ASSERT(
@@ -142,14 +266,15 @@ void *internal_vec_extend(void *vector, const void *array, size_t size) {
     return vector;
 }
 
-void vec_erase(void *vector, size_t index, void *elem) {
-    VectorMeta *vector_meta = VEC_META_PTR(vector);
+void *internal_vec_erase(void *vector, size_t index, void *elem) {
     ASSERT(
-        index < vector_meta->size,
+        index < VEC_META_PTR(vector)->size,
         "Index (is %zu) should be < vector_size (is %zu)",
         index,
-        vector_meta->size
+        VEC_META_PTR(vector)->size
     );
+    vector = internal_vec_make_unique(vector);
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
 
     // Copy the erased element to elem.
     if (elem != NULL) {
@@ -167,16 +292,18 @@ void vec_erase(void *vector, size_t index, void *elem) {
         VEC_GET(vector, index + 1, vector_meta->elem_size),
         (vector_meta->size - index) * vector_meta->elem_size
     );
+    return vector;
 }
 
-void vec_swap_erase(void *vector, size_t index, void *elem) {
-    VectorMeta *vector_meta = VEC_META_PTR(vector);
+void *internal_vec_swap_erase(void *vector, size_t index, void *elem) {
     ASSERT(
-        index < vector_meta->size,
+        index < VEC_META_PTR(vector)->size,
         "Index (is %zu) should be < vector_size (is %zu)",
         index,
-        vector_meta->size
+        VEC_META_PTR(vector)->size
     );
+    vector = internal_vec_make_unique(vector);
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
 
     // Copy the erased element to elem.
     if (elem != NULL) {
@@ -196,15 +323,17 @@ void vec_swap_erase(void *vector, size_t index, void *elem) {
             vector_meta->elem_size
         );
     }
+    return vector;
 }
 
-void vec_pop_back(void *vector, void *elem) {
-    VectorMeta *vector_meta = VEC_META_PTR(vector);
+void *internal_vec_pop_back(void *vector, void *elem) {
     ASSERT(
-        vector_meta->size > 0,
+        VEC_META_PTR(vector)->size > 0,
         "vector_size (is %zu) should be > 0",
-        vector_meta->size
+        VEC_META_PTR(vector)->size
     );
+    vector = internal_vec_make_unique(vector);
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
 
     // Copy the erased element to elem.
     vector_meta->size--;
@@ -215,15 +344,49 @@ void vec_pop_back(void *vector, void *elem) {
             vector_meta->elem_size
         );
     }
+    return vector;
 }
 
-void vec_clear(void *vector) {
-    VEC_META_PTR(vector)->size = 0;
+void *internal_vec_clear(void *vector) {
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
+    if (is_shared(vector_meta)) {
+        // Nothing needs to be copied, so only the capacity is kept.
+        void *cleared = internal_vec_new(
+            vector_meta->elem_size,
+            (VecArgs) { .cap = vector_meta->capacity, .alloc = vector_meta->alloc },
+            0
+        );
+        vec_free(vector);
+        return cleared;
+    }
+    vector_meta->size = 0;
+    return vector;
 }
 
 void vec_free(void *vector) {
     VectorMeta *vector_meta = VEC_META_PTR(vector);
-    allocator_deallocate(vector_meta->alloc, vector_meta);
+    if (atomic_fetch_sub_explicit(&vector_meta->ref_count, 1, memory_order_acq_rel) == 1) {
+        allocator_deallocate(vector_meta->alloc, vector_meta);
+    }
+}
+
+void *vec_clone(void *vector) {
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
+    atomic_fetch_add_explicit(&vector_meta->ref_count, 1, memory_order_relaxed);
+    return vector;
+}
+
+bool vec_is_shared(const void *vector) {
+    return is_shared(VEC_META_PTR(vector));
+}
+
+void *internal_vec_make_unique(void *vector) {
+    VectorMeta *vector_meta = VEC_META_PTR(vector);
+    if (is_shared(vector_meta)) {
+        vector = unshare(&vector_meta, vector_meta->capacity);
+        ASSERT(vector != NULL, "Out of memory");
+    }
+    return vector;
 }
 
 void *vec_reserve(void *vector, size_t new_capacity) {
@@ -242,31 +405,37 @@ void *vec_shrink(void *vector) {
     return vector;
 }
 
-void vec_reverse(void *vector) {
-    VectorMeta *vector_meta = VEC_META_PTR(vector);
-    for (size_t i = 0, j = vector_meta->size - 1; i < j; i++, j--) {
-        swap(
-            VEC_GET(vector, i, vector_meta->elem_size),
-            VEC_GET(vector, j, vector_meta->elem_size),
-            vector_meta->elem_size
-        );
-    }
+void *internal_vec_reverse(void *vector) {
+    vector = internal_vec_make_unique(vector);
+    view_reverse(vec_view(vector));
+    return vector;
 }
 
-void vec_sort(void *vector, compare_fn compare) {
-    quicksort(vector, compare, 0, VEC_META_PTR(vector)->size);
+void *internal_vec_sort(void *vector, compare_fn compare) {
+    vector = internal_vec_make_unique(vector);
+    view_sort(vec_view(vector), compare);
+    return vector;
 }
 
 Iterator vec_iter(void *vector) {
     Iterator iterator = iter_default(VEC_META_PTR(vector), vector, vit_next);
     iterator.advance = vit_advance;
     iterator.size = vit_size;
+    iterator.next_chunk = vit_next_chunk;
+    iterator.size_hint = vit_size_hint;
+    iterator.next_back = vit_next_back;
+    iterator.get = vit_get;
+    iterator.flags = ITER_DOUBLE_ENDED | ITER_RANDOM_ACCESS;
     return iterator;
 }
 
 // Resize the vector's capacity to new_capacity updating vector_meta_ref and
-// returning the updated vector.
+// returning the updated vector. A shared vector is always copied, since it
+// is about to be modified.
 static void *resize(VectorMeta **vector_meta_ref, size_t new_capacity) {
+    if (is_shared(*vector_meta_ref)) {
+        return unshare(vector_meta_ref, new_capacity);
+    }
     if (new_capacity != (*vector_meta_ref)->capacity) {
         (*vector_meta_ref)->capacity = new_capacity;
         VectorMeta *vector_meta = allocator_reallocate(
@@ -283,6 +452,37 @@ static void *resize(VectorMeta **vector_meta_ref, size_t new_capacity) {
     return VEC_PTR(*vector_meta_ref);
 }
 
+// Copy a shared vector into a new allocation with new_capacity and release
+// this reference to the shared one, updating vector_meta_ref and returning
+// the copy.
+static void *unshare(VectorMeta **vector_meta_ref, size_t new_capacity) {
+    VectorMeta *shared_meta = *vector_meta_ref;
+    size_t size = (shared_meta->size < new_capacity) ? shared_meta->size : new_capacity;
+    VectorMeta *vector_meta = allocator_allocate(
+        shared_meta->alloc,
+        sizeof(VectorMeta) + (shared_meta->elem_size * new_capacity)
+    );
+    if (vector_meta == NULL) {
+        return NULL;
+    }
+
+    vector_meta->capacity = new_capacity;
+    vector_meta->size = size;
+    vector_meta->elem_size = shared_meta->elem_size;
+    atomic_init(&vector_meta->ref_count, 1);
+    vector_meta->alloc = shared_meta->alloc;
+    memcpy(VEC_PTR(vector_meta), VEC_PTR(shared_meta), size * shared_meta->elem_size);
+
+    vec_free(VEC_PTR(shared_meta));
+    *vector_meta_ref = vector_meta;
+    return VEC_PTR(vector_meta);
+}
+
+// Check if the vector's elements are shared with a clone.
+static bool is_shared(const VectorMeta *vector_meta) {
+    return atomic_load_explicit(&vector_meta->ref_count, memory_order_acquire) > 1;
+}
+
 // Find the capacity that is a power of 2 which is greater than or equal to required_capacity.
 static size_t find_new_capacity(size_t current_capacity, size_t required_capacity) {
     current_capacity = (current_capacity == 0) ? 1 : current_capacity;
@@ -292,82 +492,76 @@ static size_t find_new_capacity(size_t current_capacity, size_t required_capacit
     return current_capacity;
 }
 
-// Swap 2 pointers of given size.
-static void swap(void *ptr1, void *ptr2, size_t size) {
-    char temp[size];
-    memcpy(temp, ptr1, size);
-    memcpy(ptr1, ptr2, size);
-    memcpy(ptr2, temp, size);
-}
-
-// Performs quicksort.
-static void quicksort(void *vector, compare_fn compare, size_t lo, size_t hi) {
-    if ((int) (hi - lo) > 1) {
-        size_t p = partition(vector, compare, lo, hi);
-        quicksort(vector, compare, lo, p);
-        quicksort(vector, compare, p + 1, hi);
+// Move the element at index towards the root until its parent is not greater.
+static void sift_up(void *vector, compare_fn compare, size_t arity, size_t index) {
+    size_t elem_size = VEC_META_PTR(vector)->elem_size;
+    char elem[elem_size];
+    memcpy(elem, VEC_GET(vector, index, elem_size), elem_size);
+
+    // Shift parents down into the hole until the element's position is found.
+    while (index > 0) {
+        size_t parent = (index - 1) / arity;
+        void *parent_elem = VEC_GET(vector, parent, elem_size);
+        if (compare(elem, parent_elem) >= 0) {
+            break;
+        }
+        memcpy(VEC_GET(vector, index, elem_size), parent_elem, elem_size);
+        index = parent;
     }
+    memcpy(VEC_GET(vector, index, elem_size), elem, elem_size);
 }
 
-// Partitions the vector such that elements to the left of the pivot are
-// lesser and elements to the right are greater than the pivot. It returns
-// index of the pivot element.
-static size_t partition(void *vector, compare_fn compare, size_t lo, size_t hi) {
+// Move the element at index towards the leaves until no child is smaller.
+static void sift_down(void *vector, compare_fn compare, size_t arity, size_t index) {
     VectorMeta *vector_meta = VEC_META_PTR(vector);
-    void *lo_elem = VEC_GET(vector, lo, vector_meta->elem_size);
-    void *mid_elem = VEC_GET(vector, (lo + hi) / 2, vector_meta->elem_size);
-    void *hi_elem = VEC_GET(vector, hi - 1, vector_meta->elem_size);
-
-    if (compare(mid_elem, hi_elem) < 0) {
-        swap(mid_elem, hi_elem, vector_meta->elem_size);
-    }
-    if (compare(lo_elem, hi_elem) < 0) {
-        swap(lo_elem, hi_elem, vector_meta->elem_size);
-    }
-    if (compare(mid_elem, lo_elem) < 0) {
-        swap(mid_elem, lo_elem, vector_meta->elem_size);
-    }
-
-    void *pivot = lo_elem;
-    while (lo < hi) {
-        do {
-            lo++;
-            lo_elem = VEC_GET(vector, lo, vector_meta->elem_size);
-        } while (compare(lo_elem, pivot) < 0);
-
-        do {
-            hi--;
-            hi_elem = VEC_GET(vector, hi, vector_meta->elem_size);
-        } while (compare(hi_elem, pivot) > 0);
+    size_t elem_size = vector_meta->elem_size;
+    char elem[elem_size];
+    memcpy(elem, VEC_GET(vector, index, elem_size), elem_size);
+
+    // Shift the smallest child up into the hole until the element's
+    // position is found.
+    for (size_t child = index * arity + 1; child < vector_meta->size; child = index * arity + 1) {
+        size_t last_child = child + arity;
+        last_child = (last_child < vector_meta->size) ? last_child : vector_meta->size;
+
+        void *min_elem = VEC_GET(vector, child, elem_size);
+        size_t min_child = child;
+        for (size_t i = child + 1; i < last_child; i++) {
+            void *child_elem = VEC_GET(vector, i, elem_size);
+            if (compare(child_elem, min_elem) < 0) {
+                min_elem = child_elem;
+                min_child = i;
+            }
+        }
 
-        if (lo < hi) {
-            swap(lo_elem, hi_elem, vector_meta->elem_size);
+        if (compare(min_elem, elem) >= 0) {
+            break;
         }
+        memcpy(VEC_GET(vector, index, elem_size), min_elem, elem_size);
+        index = min_child;
     }
+    memcpy(VEC_GET(vector, index, elem_size), elem, elem_size);
+}
 
-    swap(pivot, hi_elem, vector_meta->elem_size);
-    return hi;
+// Find the end of the iterator's range, the elements taken from the back
+// are excluded.
+static void *vit_end(const Iterator *iterator) {
+    VectorMeta *vector_meta = iterator->container;
+    void *vector = VEC_PTR(vector_meta);
+    size_t end = (iterator->back < vector_meta->size) ? vector_meta->size - iterator->back : 0;
+    return VEC_GET(vector, end, vector_meta->elem_size);
 }
 
 // Move the iterator by 1 element.
 static Option vit_next(Iterator *iterator) {
-    VectorMeta *vector_meta = iterator->container;
-    void *vector = VEC_PTR(vector_meta);
-    void *current = iterator->current;
-    if (current >= VEC_GET(vector, vector_meta->size, vector_meta->elem_size)) {
-        return option_none();
-    } else {
-        iterator->current = VEC_GET(current, 1, vector_meta->elem_size);
-        return option_some(current);
-    }
+    return vit_advance(iterator, 1);
 }
 
 // Move the iterator by n elements.
 static Option vit_advance(Iterator *iterator, size_t n) {
     VectorMeta *vector_meta = iterator->container;
-    void *vector = VEC_PTR(vector_meta);
     void *current = iterator->current;
-    if (current >= VEC_GET(vector, vector_meta->size, vector_meta->elem_size)) {
+    if (current >= vit_end(iterator)) {
         return option_none();
     } else {
         iterator->current = VEC_GET(current, n, vector_meta->elem_size);
@@ -377,10 +571,46 @@ static Option vit_advance(Iterator *iterator, size_t n) {
 
 // Get the number of elements in the iterator.
 static size_t vit_size(Iterator *iterator) {
-    VectorMeta *vector_meta = iterator->container;
-    void *vector = VEC_PTR(vector_meta);
-    void *vector_end = VEC_GET(vector, vector_meta->size, vector_meta->elem_size);
-    size_t size = ((size_t) vector_end - (size_t) iterator->current) / vector_meta->elem_size;
-    iterator->current = vector_end;
+    size_t size = vit_next_chunk(iterator).size;
+    iterator->current = vit_end(iterator);
     return size;
 }
+
+// Get the remaining elements of the vector as one block.
+static Chunk vit_next_chunk(Iterator *iterator) {
+    VectorMeta *vector_meta = iterator->container;
+    void *vector_end = vit_end(iterator);
+    size_t size = (iterator->current < vector_end)
+        ? ((size_t) vector_end - (size_t) iterator->current) / vector_meta->elem_size
+        : 0;
+    return (Chunk) {
+        .data = iterator->current,
+        .size = size,
+        .elem_size = vector_meta->elem_size
+    };
+}
+
+// Get the exact number of elements left without moving the iterator.
+static SizeHint vit_size_hint(Iterator *iterator) {
+    return size_hint_exact(vit_next_chunk(iterator).size);
+}
+
+// Move the back of the iterator by 1 element.
+static Option vit_next_back(Iterator *iterator) {
+    VectorMeta *vector_meta = iterator->container;
+    void *vector_end = vit_end(iterator);
+    if (iterator->current >= vector_end) {
+        return option_none();
+    }
+    iterator->back++;
+    return option_some((void *) ((size_t) vector_end - vector_meta->elem_size));
+}
+
+// Get the element at index from the front of the iterator.
+static Option vit_get(Iterator *iterator, size_t index) {
+    VectorMeta *vector_meta = iterator->container;
+    if (index >= vit_next_chunk(iterator).size) {
+        return option_none();
+    }
+    return option_some(VEC_GET(iterator->current, index, vector_meta->elem_size));
+}
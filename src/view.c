@@ -0,0 +1,223 @@
+#include <string.h>
+
+#include "../view.h"
+
+#define VIEW_GET(data, index, elem_size) (void *) ((size_t) data + ((index) * elem_size))
+
+static void swap(void *ptr1, void *ptr2, size_t size);
+static void quicksort(View view, compare_fn compare, size_t lo, size_t hi);
+static size_t partition(View view, compare_fn compare, size_t lo, size_t hi);
+static void *wit_end(const Iterator *iterator);
+static Option wit_next(Iterator *iterator);
+static Option wit_advance(Iterator *iterator, size_t n);
+static size_t wit_size(Iterator *iterator);
+static Chunk wit_next_chunk(Iterator *iterator);
+static SizeHint wit_size_hint(Iterator *iterator);
+static Option wit_next_back(Iterator *iterator);
+static Option wit_get(Iterator *iterator, size_t index);
+
+View view_new(void *data, size_t size, size_t elem_size) {
+    ASSERT(data != NULL || size == 0, "data must be a non NULL pointer");
+    return (View) {
+        .data = data,
+        .size = size,
+        .elem_size = elem_size
+    };
+}
+
+void *view_get(View view, size_t index) {
+    ASSERT(
+        index < view.size,
+        "Index (is %zu) should be < view_size (is %zu)",
+        index,
+        view.size
+    );
+    return VIEW_GET(view.data, index, view.elem_size);
+}
+
+View view_subview(View view, size_t start, size_t end) {
+    ASSERT(
+        start <= end,
+        "start (is %zu) should be <= end (is %zu)",
+        start,
+        end
+    );
+    ASSERT(
+        end <= view.size,
+        "end (is %zu) should be <= view_size (is %zu)",
+        end,
+        view.size
+    );
+    return view_new(VIEW_GET(view.data, start, view.elem_size), end - start, view.elem_size);
+}
+
+void view_reverse(View view) {
+    for (size_t i = 0, j = view.size - 1; i < j && j < view.size; i++, j--) {
+        swap(
+            VIEW_GET(view.data, i, view.elem_size),
+            VIEW_GET(view.data, j, view.elem_size),
+            view.elem_size
+        );
+    }
+}
+
+void view_sort(View view, compare_fn compare) {
+    quicksort(view, compare, 0, view.size);
+}
+
+Option view_binary_search(View view, const void *key, compare_fn compare) {
+    size_t lo = 0;
+    size_t hi = view.size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        void *mid_elem = VIEW_GET(view.data, mid, view.elem_size);
+        int cmp_result = compare(mid_elem, key);
+        if (cmp_result == 0) {
+            return option_some(mid_elem);
+        } else if (cmp_result < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return option_none();
+}
+
+Iterator view_iter(View *view) {
+    Iterator iterator = iter_default(view, view->data, wit_next);
+    iterator.advance = wit_advance;
+    iterator.size = wit_size;
+    iterator.next_chunk = wit_next_chunk;
+    iterator.size_hint = wit_size_hint;
+    iterator.next_back = wit_next_back;
+    iterator.get = wit_get;
+    iterator.flags = ITER_DOUBLE_ENDED | ITER_RANDOM_ACCESS;
+    return iterator;
+}
+
+// Swap 2 pointers of given size.
+static void swap(void *ptr1, void *ptr2, size_t size) {
+    char temp[size];
+    memcpy(temp, ptr1, size);
+    memcpy(ptr1, ptr2, size);
+    memcpy(ptr2, temp, size);
+}
+
+// Performs quicksort.
+static void quicksort(View view, compare_fn compare, size_t lo, size_t hi) {
+    if ((int) (hi - lo) > 1) {
+        size_t p = partition(view, compare, lo, hi);
+        quicksort(view, compare, lo, p);
+        quicksort(view, compare, p + 1, hi);
+    }
+}
+
+// Partitions the view such that elements to the left of the pivot are
+// lesser and elements to the right are greater than the pivot. It returns
+// index of the pivot element.
+static size_t partition(View view, compare_fn compare, size_t lo, size_t hi) {
+    void *lo_elem = VIEW_GET(view.data, lo, view.elem_size);
+    void *mid_elem = VIEW_GET(view.data, (lo + hi) / 2, view.elem_size);
+    void *hi_elem = VIEW_GET(view.data, hi - 1, view.elem_size);
+
+    if (compare(mid_elem, hi_elem) < 0) {
+        swap(mid_elem, hi_elem, view.elem_size);
+    }
+    if (compare(lo_elem, hi_elem) < 0) {
+        swap(lo_elem, hi_elem, view.elem_size);
+    }
+    if (compare(mid_elem, lo_elem) < 0) {
+        swap(mid_elem, lo_elem, view.elem_size);
+    }
+
+    void *pivot = lo_elem;
+    while (lo < hi) {
+        do {
+            lo++;
+            lo_elem = VIEW_GET(view.data, lo, view.elem_size);
+        } while (compare(lo_elem, pivot) < 0);
+
+        do {
+            hi--;
+            hi_elem = VIEW_GET(view.data, hi, view.elem_size);
+        } while (compare(hi_elem, pivot) > 0);
+
+        if (lo < hi) {
+            swap(lo_elem, hi_elem, view.elem_size);
+        }
+    }
+
+    swap(pivot, hi_elem, view.elem_size);
+    return hi;
+}
+
+// Find the end of the iterator's range, the elements taken from the back
+// are excluded.
+static void *wit_end(const Iterator *iterator) {
+    View *view = iterator->container;
+    size_t end = (iterator->back < view->size) ? view->size - iterator->back : 0;
+    return VIEW_GET(view->data, end, view->elem_size);
+}
+
+// Move the iterator by 1 element.
+static Option wit_next(Iterator *iterator) {
+    return wit_advance(iterator, 1);
+}
+
+// Move the iterator by n elements.
+static Option wit_advance(Iterator *iterator, size_t n) {
+    View *view = iterator->container;
+    void *current = iterator->current;
+    if (current >= wit_end(iterator)) {
+        return option_none();
+    } else {
+        iterator->current = VIEW_GET(current, n, view->elem_size);
+        return option_some(current);
+    }
+}
+
+// Get the number of elements in the iterator.
+static size_t wit_size(Iterator *iterator) {
+    size_t size = wit_next_chunk(iterator).size;
+    iterator->current = wit_end(iterator);
+    return size;
+}
+
+// Get the remaining elements of the view as one block.
+static Chunk wit_next_chunk(Iterator *iterator) {
+    View *view = iterator->container;
+    void *view_end = wit_end(iterator);
+    size_t size = (iterator->current < view_end)
+        ? ((size_t) view_end - (size_t) iterator->current) / view->elem_size
+        : 0;
+    return (Chunk) {
+        .data = iterator->current,
+        .size = size,
+        .elem_size = view->elem_size
+    };
+}
+
+// Get the exact number of elements left without moving the iterator.
+static SizeHint wit_size_hint(Iterator *iterator) {
+    return size_hint_exact(wit_next_chunk(iterator).size);
+}
+
+// Move the back of the iterator by 1 element.
+static Option wit_next_back(Iterator *iterator) {
+    View *view = iterator->container;
+    void *view_end = wit_end(iterator);
+    if (iterator->current >= view_end) {
+        return option_none();
+    }
+    iterator->back++;
+    return option_some((void *) ((size_t) view_end - view->elem_size));
+}
+
+// Get the element at index from the front of the iterator.
+static Option wit_get(Iterator *iterator, size_t index) {
+    View *view = iterator->container;
+    if (index >= wit_next_chunk(iterator).size) {
+        return option_none();
+    }
+    return option_some(VIEW_GET(iterator->current, index, view->elem_size));
+}
@@ -0,0 +1,184 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "../bitvec.h"
+
+void test_bitvec_basic() {
+    BitVec *bitvec = bitvec_new();
+    assert(bitvec_size(bitvec) == 0);
+    assert(bitvec_capacity(bitvec) == 0);
+    assert(bitvec_count(bitvec) == 0);
+
+    for (size_t i = 0; i < 1000; i++) {
+        bitvec_push_back(bitvec, i % 3 == 0);
+    }
+    assert(bitvec_size(bitvec) == 1000);
+    assert(bitvec_capacity(bitvec) >= 1000);
+    assert(bitvec_count(bitvec) == 334);
+    for (size_t i = 0; i < 1000; i++) {
+        assert(bitvec_test(bitvec, i) == (i % 3 == 0));
+    }
+
+    bitvec_set(bitvec, 1);
+    bitvec_clear(bitvec, 0);
+    assert(bitvec_test(bitvec, 1));
+    assert(!bitvec_test(bitvec, 0));
+    assert(bitvec_count(bitvec) == 334);
+
+    bitvec_fill(bitvec, true);
+    assert(bitvec_count(bitvec) == 1000);
+    assert(bitvec_words(bitvec)[15] == (UINT64_C(1) << (1000 - 960)) - 1);
+    bitvec_fill(bitvec, false);
+    assert(bitvec_count(bitvec) == 0);
+    bitvec_free(bitvec);
+}
+
+void test_bitvec_resize() {
+    BitVec *bitvec = bitvec_new(.cap = 100);
+    assert(bitvec_capacity(bitvec) == 128);
+
+    bitvec_resize(bitvec, 70, true);
+    assert(bitvec_size(bitvec) == 70);
+    assert(bitvec_count(bitvec) == 70);
+    bitvec_resize(bitvec, 10, false);
+    assert(bitvec_count(bitvec) == 10);
+
+    // Bits cut off by shrinking do not come back.
+    bitvec_resize(bitvec, 200, false);
+    assert(bitvec_count(bitvec) == 10);
+    assert(!bitvec_test(bitvec, 10) && !bitvec_test(bitvec, 69));
+    bitvec_resize(bitvec, 300, true);
+    assert(bitvec_count(bitvec) == 110);
+    assert(!bitvec_test(bitvec, 199) && bitvec_test(bitvec, 200));
+    bitvec_free(bitvec);
+}
+
+void test_bitvec_ops() {
+    BitVec *a = bitvec_new();
+    BitVec *b = bitvec_new();
+    bool expected[4][777];
+    for (size_t i = 0; i < 777; i++) {
+        bool x = i % 2 == 0;
+        bool y = i % 3 == 0;
+        bitvec_push_back(a, x);
+        bitvec_push_back(b, y);
+        expected[0][i] = x && y;
+        expected[1][i] = (x && y) || y;
+        expected[2][i] = ((x && y) || y) != y;
+        expected[3][i] = false;
+    }
+
+    bitvec_and(a, b);
+    for (size_t i = 0; i < 777; i++) {
+        assert(bitvec_test(a, i) == expected[0][i]);
+    }
+    bitvec_or(a, b);
+    for (size_t i = 0; i < 777; i++) {
+        assert(bitvec_test(a, i) == expected[1][i]);
+    }
+    bitvec_xor(a, b);
+    for (size_t i = 0; i < 777; i++) {
+        assert(bitvec_test(a, i) == expected[2][i]);
+    }
+    bitvec_fill(a, true);
+    bitvec_andnot(a, a);
+    for (size_t i = 0; i < 777; i++) {
+        assert(bitvec_test(a, i) == expected[3][i]);
+    }
+
+    bitvec_fill(a, true);
+    bitvec_andnot(a, b);
+    assert(bitvec_count(a) == 777 - bitvec_count(b));
+    bitvec_free(a);
+    bitvec_free(b);
+}
+
+void test_bitvec_popcount() {
+    uint64_t words[37];
+    size_t expected = 0;
+    srand(7);
+    for (size_t i = 0; i < 37; i++) {
+        words[i] = ((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ (uint64_t) rand();
+        expected += __builtin_popcountll(words[i]);
+    }
+    assert(mem_popcount(words, 37) == expected);
+    assert(mem_popcount(words, 0) == 0);
+    assert(mem_popcount(words, 1) == (size_t) __builtin_popcountll(words[0]));
+}
+
+void test_bitvec_rank_select() {
+    // Spans several superblocks, with a long run of zeros.
+    size_t size = 300000;
+    BitVec *bitvec = bitvec_new();
+    srand(11);
+    for (size_t i = 0; i < size; i++) {
+        bool in_gap = i >= 70000 && i < 140000;
+        bitvec_push_back(bitvec, !in_gap && rand() % 5 == 0);
+    }
+
+    size_t rank = 0;
+    for (size_t i = 0; i < size; i++) {
+        assert(bitvec_rank(bitvec, i) == rank);
+        if (bitvec_test(bitvec, i)) {
+            assert(bitvec_select(bitvec, rank) == i);
+            rank++;
+        }
+    }
+    assert(bitvec_rank(bitvec, size) == rank);
+    assert(bitvec_count(bitvec) == rank);
+    assert(bitvec_select(bitvec, rank) == size);
+
+    // Modifications rebuild the index.
+    bitvec_set(bitvec, 100000);
+    assert(bitvec_rank(bitvec, size) == rank + 1);
+    assert(bitvec_select(bitvec, bitvec_rank(bitvec, 100000)) == 100000);
+    bitvec_free(bitvec);
+
+    bitvec = bitvec_new();
+    assert(bitvec_rank(bitvec, 0) == 0);
+    assert(bitvec_select(bitvec, 0) == 0);
+    bitvec_free(bitvec);
+}
+
+void test_bitvec_ones_iter() {
+    BitVec *bitvec = bitvec_new();
+    bitvec_resize(bitvec, 1000, false);
+    size_t set[] = { 0, 63, 64, 500, 999 };
+    for (size_t i = 0; i < 5; i++) {
+        bitvec_set(bitvec, set[i]);
+    }
+
+    BitVecOnes ones;
+    Iterator it = bitvec_ones_iter(&ones, bitvec);
+    assert(iter_size_hint(it).lower == 1);
+    assert(iter_size_hint(it).upper >= 5);
+    for (size_t i = 0; i < 5; i++) {
+        assert(option_unwrap(iter_next(it), size_t) == set[i]);
+    }
+    assert(!iter_next(it).is_valid);
+    assert(iter_size_hint(it).upper == 0);
+
+    it = bitvec_ones_iter(&ones, bitvec);
+    assert(option_unwrap(iter_advance(it, 2), size_t) == 0);
+    assert(iter_size(it) == 3);
+    it = bitvec_ones_iter(&ones, bitvec);
+    assert(option_unwrap(iter_advance(it, 4), size_t) == 0);
+    assert(option_unwrap(iter_next(it), size_t) == 999);
+    assert(!iter_advance(it, 1).is_valid);
+    bitvec_free(bitvec);
+
+    bitvec = bitvec_new();
+    it = bitvec_ones_iter(&ones, bitvec);
+    assert(!iter_next(it).is_valid);
+    bitvec_free(bitvec);
+}
+
+int main() {
+    test_bitvec_basic();
+    test_bitvec_resize();
+    test_bitvec_ops();
+    test_bitvec_popcount();
+    test_bitvec_rank_select();
+    test_bitvec_ones_iter();
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "../concvec.h"
+
+#define THREADS 8
+#define PUSHES_PER_THREAD 20000
+#define READERS 4
+
+void test_concvec_basic() {
+    ConcVec(int) cvec = cvec_new(int, .cap = 4);
+    assert(cvec_size(cvec) == 0);
+
+    for (int i = 0; i < 100; i++) {
+        assert(cvec_push_back(cvec, i) == (size_t) i);
+    }
+    int array[] = {100, 101, 102};
+    assert(cvec_push_many(cvec, array, 3) == 100);
+    assert(cvec_size(cvec) == 103);
+    assert(cvec_reserved(cvec) == 103);
+    for (int i = 0; i < 103; i++) {
+        assert(*cvec_get(cvec, i) == i);
+    }
+
+    Iterator it = cvec_iter(cvec);
+    for (int i = 0; i < 103; i++) {
+        assert(option_unwrap(iter_next(it), int) == i);
+    }
+    assert(!iter_next(it).is_valid);
+    cvec_push_back(cvec, 103);
+    assert(option_unwrap(iter_next(it), int) == 103);
+
+    cvec_clear(cvec);
+    assert(cvec_size(cvec) == 0);
+    cvec_push_back(cvec, 5);
+    assert(*cvec_get(cvec, 0) == 5);
+    cvec_free(cvec);
+}
+
+void *push_worker(void *arg) {
+    ConcVec(long) cvec = arg;
+    static _Atomic long next_id = 0;
+    for (int i = 0; i < PUSHES_PER_THREAD; i++) {
+        if (i % 100 == 0) {
+            long batch[10];
+            for (int j = 0; j < 10; j++) {
+                batch[j] = next_id++;
+            }
+            cvec_push_many(cvec, batch, 10);
+            i += 9;
+        } else {
+            cvec_push_back(cvec, next_id++);
+        }
+    }
+    return NULL;
+}
+
+void test_concvec_threads() {
+    ConcVec(long) cvec = cvec_new(long);
+    pthread_t threads[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, push_worker, cvec);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    size_t size = cvec_size(cvec);
+    assert(size == THREADS * PUSHES_PER_THREAD);
+    bool *seen = calloc(size, sizeof(bool));
+    Iterator it = cvec_iter(cvec);
+    for (Option option = iter_next(it); option.is_valid; option = iter_next(it)) {
+        long id = option_unwrap(option, long);
+        assert(id >= 0 && (size_t) id < size);
+        assert(!seen[id]);
+        seen[id] = true;
+    }
+    free(seen);
+    cvec_free(cvec);
+}
+
+typedef struct {
+    ConcVec(long) cvec;
+    long thread;
+} Appender;
+
+void *append_worker(void *arg) {
+    Appender *appender = arg;
+    for (long i = 0; i < PUSHES_PER_THREAD; i++) {
+        cvec_push_back(appender->cvec, appender->thread * PUSHES_PER_THREAD + i + 1);
+    }
+    return NULL;
+}
+
+// Read the committed prefix while it grows. The pushes of a thread get
+// increasing indices, so a prefix holds its first pushes in order.
+void *get_worker(void *arg) {
+    ConcVec(long) cvec = arg;
+    long expected[THREADS] = {0};
+    for (size_t i = 0; i < THREADS * PUSHES_PER_THREAD;) {
+        for (size_t size = cvec_size(cvec); i < size; i++) {
+            long value = *cvec_get(cvec, i) - 1;
+            assert(value >= 0 && value < THREADS * PUSHES_PER_THREAD);
+            long thread = value / PUSHES_PER_THREAD;
+            assert(value % PUSHES_PER_THREAD == expected[thread]);
+            expected[thread]++;
+        }
+    }
+    return NULL;
+}
+
+void test_concvec_get_threads() {
+    ConcVec(long) cvec = cvec_new(long);
+    pthread_t readers[READERS];
+    for (int i = 0; i < READERS; i++) {
+        pthread_create(&readers[i], NULL, get_worker, cvec);
+    }
+    pthread_t threads[THREADS];
+    Appender appenders[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        appenders[i] = (Appender) { .cvec = cvec, .thread = i };
+        pthread_create(&threads[i], NULL, append_worker, &appenders[i]);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    assert(cvec_size(cvec) == THREADS * PUSHES_PER_THREAD);
+    cvec_free(cvec);
+}
+
+int main() {
+    test_concvec_basic();
+    test_concvec_threads();
+    test_concvec_get_threads();
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <assert.h>
+
+#include "../deque.h"
+
+void test_deque_basic() {
+    Deque(int) deque = deque_new(int);
+    assert(deque_size(deque) == 0);
+    assert(deque_is_empty(deque));
+
+    deque_push_back(deque, 2);
+    deque_push_back(deque, 3);
+    deque_push_front(deque, 1);
+    deque_push_front(deque, 0);
+    assert(deque_size(deque) == 4);
+    assert(deque_capacity(deque) >= 4);
+    for (int i = 0; i < 4; i++) {
+        assert(*deque_get(deque, i) == i);
+    }
+
+    int popped;
+    deque_pop_front(deque, &popped);
+    assert(popped == 0);
+    deque_pop_back(deque, &popped);
+    assert(popped == 3);
+    deque_pop_back(deque, NULL);
+    assert(deque_size(deque) == 1);
+    assert(*deque_get(deque, 0) == 1);
+
+    deque_clear(deque);
+    assert(deque_is_empty(deque));
+    deque_free(deque);
+}
+
+void test_deque_fifo_wraparound() {
+    Deque(int) deque = deque_new(int, .cap = 8);
+    assert(deque_capacity(deque) == 8);
+
+    int next = 0;
+    int expected = 0;
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 5; i++) {
+            deque_push_back(deque, next++);
+        }
+        for (int i = 0; i < 3; i++) {
+            int popped;
+            deque_pop_front(deque, &popped);
+            assert(popped == expected++);
+        }
+    }
+    assert(deque_size(deque) == 200);
+    for (size_t i = 0; i < deque_size(deque); i++) {
+        assert(*deque_get(deque, i) == expected + (int) i);
+    }
+    deque_free(deque);
+}
+
+void test_deque_grow_wrapped() {
+    for (int front = 0; front < 8; front++) {
+        Deque(int) deque = deque_new(int, .cap = 8);
+        for (int i = 0; i < front; i++) {
+            deque_push_front(deque, -1 - i);
+        }
+        for (int i = 0; i < 8 - front; i++) {
+            deque_push_back(deque, i);
+        }
+        deque_push_back(deque, 8 - front);
+        assert(deque_capacity(deque) == 16);
+        for (int i = 0; i < 9; i++) {
+            assert(*deque_get(deque, i) == i - front);
+        }
+        deque_free(deque);
+    }
+}
+
+void test_deque_iter() {
+    Deque(int) deque = deque_new(int, .cap = 4);
+    deque_push_back(deque, 2);
+    deque_push_back(deque, 3);
+    deque_push_front(deque, 1);
+    deque_push_front(deque, 0);
+
+    DequeSpan spans[2];
+    deque_spans(deque, spans);
+    assert(spans[0].size == 2);
+    assert(spans[1].size == 2);
+    assert(((int *) spans[0].data)[0] == 0);
+    assert(((int *) spans[1].data)[1] == 3);
+
+    Iterator it = deque_iter(deque);
+    for (int i = 0; i < 4; i++) {
+        Option option = iter_next(it);
+        assert(option_unwrap(option, int) == i);
+        deque_iter_spans(&it, spans);
+        assert(spans[0].size + spans[1].size == (size_t) (3 - i));
+    }
+    assert(!iter_next(it).is_valid);
+
+    it = deque_iter(deque);
+    assert(option_unwrap(iter_advance(it, 3), int) == 0);
+    assert(option_unwrap(iter_next(it), int) == 3);
+    assert(!iter_next(it).is_valid);
+
+    it = deque_iter(deque);
+    iter_next(it);
+    assert(iter_size(it) == 3);
+    assert(!iter_next(it).is_valid);
+
+    deque_free(deque);
+}
+
+int main() {
+    test_deque_basic();
+    test_deque_fifo_wraparound();
+    test_deque_grow_wrapped();
+    test_deque_iter();
+    return 0;
+}
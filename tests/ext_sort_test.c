@@ -0,0 +1,141 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../ext_sort.h"
+#include "../iter_utils.h"
+#include "../vector.h"
+
+typedef struct {
+    unsigned key;
+    unsigned payload[3];
+} Record;
+
+static int int_compare(const int *a, const int *b) {
+    return (*a > *b) - (*a < *b);
+}
+
+static int record_compare(const Record *a, const Record *b) {
+    return (a->key > b->key) - (a->key < b->key);
+}
+
+static bool is_odd(const int *value) {
+    return *value % 2 != 0;
+}
+
+void test_ext_sort_in_memory() {
+    Vec(int) vec = vec_from_array(((int[]) {5, 3, 9, 1, 7}), 5);
+    Iterator it = vec_iter(vec);
+    ExtSort *sort = ext_sort_new(&it, int, (compare_fn) int_compare);
+    Iterator sorted = ext_sort_iter(sort);
+    assert(iter_size_hint(sorted).lower == 5);
+    Vec(int) result = iter_collect(&sorted, int);
+    int expected[] = {1, 3, 5, 7, 9};
+    assert(vec_size(result) == 5);
+    for (int i = 0; i < 5; i++) {
+        assert(result[i] == expected[i]);
+    }
+    assert(ext_sort_error(sort) == 0);
+    ext_sort_free(sort);
+    vec_free(result);
+
+    Vec(int) empty = vec_new(int);
+    it = vec_iter(empty);
+    sort = ext_sort_new(&it, int, (compare_fn) int_compare, .run_size = 4);
+    sorted = ext_sort_iter(sort);
+    assert(!iter_next(sorted).is_valid);
+    ext_sort_free(sort);
+    vec_free(empty);
+    vec_free(vec);
+}
+
+void test_ext_sort_spilled() {
+    size_t size = 100000;
+    Vec(int) vec = vec_new(int, .cap = size);
+    srand(42);
+    for (size_t i = 0; i < size; i++) {
+        vec_push_back(vec, rand() % 5000 - 2500);
+    }
+    Iterator it = vec_iter(vec);
+    ExtSort *sort = ext_sort_new(&it, int, (compare_fn) int_compare, .run_size = 999, .buffer_size = 256);
+    Iterator sorted = ext_sort_iter(sort);
+    assert(iter_size_hint(sorted).lower == size);
+    Vec(int) result = iter_collect(&sorted, int);
+    assert(ext_sort_error(sort) == 0);
+    ext_sort_free(sort);
+
+    vec_sort(vec, (compare_fn) int_compare);
+    assert(vec_size(result) == size);
+    assert(memcmp(result, vec, size * sizeof(int)) == 0);
+    vec_free(result);
+
+    // Single element input from an iterator without blocks, with a buffer
+    // smaller than an element.
+    it = vec_iter(vec);
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &it, (pred_fn) is_odd);
+    sort = ext_sort_new(&filter_it, int, (compare_fn) int_compare, .run_size = 1000, .buffer_size = 1);
+    int previous = INT32_MIN;
+    size_t count = 0;
+    sorted = ext_sort_iter(sort);
+    for (Option o = iter_next(sorted); o.is_valid; o = iter_next(sorted)) {
+        int value = *(int *) o.value;
+        assert(value % 2 != 0 && value >= previous);
+        previous = value;
+        count++;
+    }
+    it = vec_iter(vec);
+    filter_it = filter_iter(&filter, &it, (pred_fn) is_odd);
+    Vec(int) odds = iter_collect(&filter_it, int);
+    assert(count == vec_size(odds));
+    ext_sort_free(sort);
+    vec_free(odds);
+    vec_free(vec);
+}
+
+void test_ext_sort_write_fd() {
+    size_t size = 20000;
+    Vec(Record) records = vec_new(Record, .cap = size);
+    for (size_t i = 0; i < size; i++) {
+        unsigned key = (unsigned) (i * 7919 % size);
+        vec_push_back(records, ((Record) { .key = key, .payload = {key, key + 1, key + 2} }));
+    }
+    Iterator it = vec_iter(records);
+    ExtSort *sort = ext_sort_new(&it, Record, (compare_fn) record_compare, .run_size = 3000, .buffer_size = 4096);
+
+    char path[] = "/tmp/ext_sort_test_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    unlink(path);
+    assert(ext_sort_write_fd(sort, fd));
+    ext_sort_free(sort);
+
+    Vec(Record) result = vec_new(Record, .cap = size);
+    Record record;
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    while (read(fd, &record, sizeof(Record)) == sizeof(Record)) {
+        vec_push_back(result, record);
+    }
+    close(fd);
+    assert(vec_size(result) == size);
+    for (size_t i = 0; i < size; i++) {
+        assert(result[i].key == i && result[i].payload[2] == i + 2);
+    }
+    vec_free(result);
+
+    // Spilling to a missing directory fails and leaves the result empty.
+    it = vec_iter(records);
+    sort = ext_sort_new(&it, Record, (compare_fn) record_compare, .run_size = 100, .tmp_dir = "/nonexistent");
+    assert(ext_sort_error(sort) != 0);
+    Iterator sorted = ext_sort_iter(sort);
+    assert(!iter_next(sorted).is_valid);
+    ext_sort_free(sort);
+    vec_free(records);
+}
+
+int main() {
+    test_ext_sort_in_memory();
+    test_ext_sort_spilled();
+    test_ext_sort_write_fd();
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <assert.h>
+
+#include "../indexed_heap.h"
+
+int int_compare(const int *val1, const int *val2) {
+    return (*val1 - *val2);
+}
+
+void test_indexed_heap_basic() {
+    IndexedHeap(int) iheap = iheap_new(int, (compare_fn) int_compare);
+    assert(iheap_size(iheap) == 0);
+    assert(iheap_is_empty(iheap));
+
+    iheap_push(iheap, 3, 30);
+    iheap_push(iheap, 0, 50);
+    iheap_push(iheap, 7, 10);
+    iheap_push(iheap, 1, 40);
+    assert(iheap_size(iheap) == 4);
+    assert(iheap_capacity(iheap) >= 8);
+    assert(iheap_contains(iheap, 7));
+    assert(!iheap_contains(iheap, 2));
+    assert(!iheap_contains(iheap, 100));
+    assert(iheap_top(iheap) == 7);
+    assert(iheap[3] == 30);
+
+    assert(iheap_pop(iheap) == 7);
+    assert(iheap[7] == 10);
+    assert(!iheap_contains(iheap, 7));
+    assert(iheap_pop(iheap) == 3);
+    assert(iheap_pop(iheap) == 1);
+    assert(iheap_pop(iheap) == 0);
+    assert(iheap_is_empty(iheap));
+
+    iheap_free(iheap);
+}
+
+void test_indexed_heap_decrease_key() {
+    IndexedHeap(int) iheap = iheap_new(int, (compare_fn) int_compare, .cap = 16);
+    for (int i = 0; i < 16; i++) {
+        iheap_push(iheap, i, 100 + i);
+    }
+
+    iheap_decrease_key(iheap, 15, 5);
+    iheap_decrease_key(iheap, 8, 7);
+    iheap_decrease_key(iheap, 8, 6);
+    assert(iheap[8] == 6);
+    assert(iheap_pop(iheap) == 15);
+    assert(iheap_pop(iheap) == 8);
+    assert(iheap_pop(iheap) == 0);
+
+    iheap_remove(iheap, 1);
+    iheap_remove(iheap, 14);
+    assert(!iheap_contains(iheap, 1));
+    assert(iheap_size(iheap) == 11);
+    for (int i = 2; i < 14; i++) {
+        if (i != 8) {
+            assert(iheap_pop(iheap) == (size_t) i);
+        }
+    }
+    assert(iheap_is_empty(iheap));
+
+    iheap_push(iheap, 1, 1);
+    iheap_clear(iheap);
+    assert(iheap_is_empty(iheap));
+    assert(!iheap_contains(iheap, 1));
+
+    iheap_free(iheap);
+}
+
+void test_indexed_heap_4_ary() {
+    IndexedHeap(int) dist = iheap_new(int, (compare_fn) int_compare, .arity = 4);
+    for (size_t i = 0; i < 200; i++) {
+        iheap_push(dist, i, (int) ((i * 71) % 200) + 1000);
+    }
+    for (size_t i = 0; i < 200; i += 3) {
+        iheap_decrease_key(dist, i, dist[i] - 1000);
+    }
+
+    int prev = -1;
+    while (!iheap_is_empty(dist)) {
+        size_t key = iheap_pop(dist);
+        assert(dist[key] >= prev);
+        prev = dist[key];
+    }
+
+    iheap_free(dist);
+}
+
+int main() {
+    test_indexed_heap_basic();
+    test_indexed_heap_decrease_key();
+    test_indexed_heap_4_ary();
+    return 0;
+}
@@ -0,0 +1,696 @@
+#include <assert.h>
+
+#include "../deque.h"
+#include "../iter_utils.h"
+#include "../vector.h"
+
+static bool is_even(const int *value) {
+    return *value % 2 == 0;
+}
+
+static int predicate_calls = 0;
+
+static bool is_even_counted(const int *value) {
+    predicate_calls++;
+    return is_even(value);
+}
+
+static bool is_negative(const int *value) {
+    return *value < 0;
+}
+
+static void square(int *value) {
+    *value *= *value;
+}
+
+static void times_ten(int *value) {
+    *value *= 10;
+}
+
+static void sum(int *total, const int *value) {
+    *total += *value;
+}
+
+static int int_compare(const int *a, const int *b) {
+    return *a - *b;
+}
+
+void test_iter_vec_chunks() {
+    Vec(int) vec = vec_from_array(((int[]) {0, 1, 2, 3, 4, 5, 6, 7}), 8);
+
+    Iterator it = vec_iter(vec);
+    assert(iter_has_chunks(it));
+    Chunk chunk = iter_next_chunk(it);
+    assert(chunk.data == vec);
+    assert(chunk.size == 8);
+    assert(chunk.elem_size == sizeof(int));
+
+    // Peeking does not move the iterator, advancing does.
+    iter_advance(it, 3);
+    chunk = iter_next_chunk(it);
+    assert(chunk.data == &vec[3]);
+    assert(chunk.size == 5);
+    assert(iter_take_chunk(&it).size == 5);
+    assert(iter_next_chunk(it).size == 0);
+    assert(!iter_next(it).is_valid);
+    vec_free(vec);
+}
+
+void test_iter_find_resumes() {
+    Vec(int) vec = vec_from_array(((int[]) {1, 2, 3, 4, 5, 6}), 6);
+    Iterator it = vec_iter(vec);
+    assert(option_unwrap(iter_find(&it, (pred_fn) is_even), int) == 2);
+    assert(option_unwrap(iter_next(it), int) == 3);
+    assert(option_unwrap(iter_find(&it, (pred_fn) is_even), int) == 4);
+    assert(option_unwrap(iter_find(&it, (pred_fn) is_even), int) == 6);
+    assert(!iter_find(&it, (pred_fn) is_even).is_valid);
+
+    it = vec_iter(vec);
+    assert(iter_find_index(&it, (pred_fn) is_even) == 1);
+    assert(iter_find_index(&it, (pred_fn) is_even) == 1);
+    it = vec_iter(vec);
+    assert(!iter_all(&it, (pred_fn) is_even));
+    assert(option_unwrap(iter_next(it), int) == 2);
+    it = vec_iter(vec);
+    assert(!iter_any(&it, (pred_fn) is_negative));
+    it = vec_iter(vec);
+    assert(iter_is_sorted(&it, (compare_fn) int_compare));
+    it = vec_iter(vec);
+    assert(option_unwrap(iter_last(&it), int) == 6);
+    vec_free(vec);
+
+    // Searching a map only maps the elements it looks at.
+    vec = vec_from_array(((int[]) {1, 2, 3, 4, 5}), 5);
+    it = vec_iter(vec);
+    Map map;
+    Iterator map_it = map_iter(&map, &it, (map_fn) square);
+    assert(option_unwrap(iter_find(&map_it, (pred_fn) is_even), int) == 4);
+    int expected[] = {1, 4, 3, 4, 5};
+    for (int i = 0; i < 5; i++) {
+        assert(vec[i] == expected[i]);
+    }
+    assert(iter_any(&map_it, (pred_fn) is_even));
+    assert(vec[2] == 9 && vec[3] == 16 && vec[4] == 5);
+    int total = 0;
+    iter_reduce(&map_it, (void (*)(void *, void *)) sum, &total);
+    assert(total == 25);
+    vec_free(vec);
+}
+
+void test_iter_map_filter_chunks() {
+    Vec(int) vec = vec_from_array(((int[]) {1, 2, 3, 4, 6, 7, 8, 9, 10}), 9);
+    Iterator it = vec_iter(vec);
+    Map map;
+    Iterator map_it = map_iter(&map, &it, (map_fn) square);
+    assert(!iter_has_chunks(map_it));
+
+    // A map is taken by blocks, each one mapped once taken.
+    Chunk chunk = iter_take_chunk(&map_it);
+    assert(chunk.size == 9 && chunk.elem_size == sizeof(int));
+    assert(((int *) chunk.data)[8] == 100);
+    assert(iter_take_chunk(&map_it).size == 0);
+    int expected[] = {1, 4, 9, 16, 36, 49, 64, 81, 100};
+    for (int i = 0; i < 9; i++) {
+        assert(vec[i] == expected[i]);
+    }
+    vec_free(vec);
+
+    // Adapters over a map only map the elements they take.
+    vec = vec_from_array(((int[]) {1, 2, 3, 4, 6, 7, 8, 9, 10}), 9);
+    it = vec_iter(vec);
+    map_it = map_iter(&map, &it, (map_fn) square);
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &map_it, (pred_fn) is_even);
+    assert(option_unwrap(iter_find(&filter_it, (pred_fn) is_even), int) == 4);
+    assert(vec[2] == 3);
+    int total = 0;
+    for_each(int, value, filter_it, {
+        total += value;
+    });
+    assert(total == 16 + 36 + 64 + 100);
+    for (int i = 0; i < 9; i++) {
+        assert(vec[i] == expected[i]);
+    }
+    vec_free(vec);
+
+    vec = vec_from_array(((int[]) {1, 2, 3, 4, 5, 6}), 6);
+    it = vec_iter(vec);
+    map_it = map_iter(&map, &it, (map_fn) square);
+    Take take;
+    Iterator take_it = take_iter(&take, &map_it, 2);
+    total = 0;
+    for_each(int, value, take_it, {
+        total += value;
+    });
+    assert(total == 5);
+    int untouched[] = {1, 4, 3, 4, 5, 6};
+    for (int i = 0; i < 6; i++) {
+        assert(vec[i] == untouched[i]);
+    }
+    vec_free(vec);
+
+    // Taking a run that was peeked does not test it again.
+    vec = vec_from_array(((int[]) {2, 4, 5, 6, 8, 10, 11, 12}), 8);
+    it = vec_iter(vec);
+    filter_it = filter_iter(&filter, &it, (pred_fn) is_even_counted);
+    total = 0;
+    for_each(int, value, filter_it, {
+        total += value;
+    });
+    assert(total == 42);
+    assert(predicate_calls == 8);
+
+    predicate_calls = 0;
+    it = vec_iter(vec);
+    filter_it = filter_iter(&filter, &it, (pred_fn) is_even_counted);
+    assert(iter_next_chunk(filter_it).size == 2);
+    assert(option_unwrap(iter_next(filter_it), int) == 2);
+    assert(option_unwrap(iter_advance(filter_it, 2), int) == 4);
+    assert(option_unwrap(iter_next(filter_it), int) == 8);
+    assert(iter_take_chunk(&filter_it).size == 1);
+    assert(option_unwrap(iter_next(filter_it), int) == 12);
+    assert(!iter_next(filter_it).is_valid);
+    assert(predicate_calls == 8);
+    vec_free(vec);
+}
+
+void test_iter_mixed_sources() {
+    Vec(int) vec = vec_from_array(((int[]) {5, 6, 7, 8}), 4);
+    Deque(int) deque = deque_new(int);
+    for (int i = 5; i < 9; i++) {
+        deque_push_back(deque, i);
+    }
+
+    Iterator vec_it = vec_iter(vec);
+    Iterator deque_it = deque_iter(deque);
+    assert(!iter_has_chunks(deque_it));
+    assert(iter_compare(&vec_it, &deque_it, (compare_fn) int_compare) == 0);
+
+    deque_push_back(deque, 9);
+    vec_it = vec_iter(vec);
+    deque_it = deque_iter(deque);
+    assert(iter_compare(&vec_it, &deque_it, (compare_fn) int_compare) == -1);
+
+    Filter filter;
+    deque_it = deque_iter(deque);
+    Iterator filter_it = filter_iter(&filter, &deque_it, (pred_fn) is_even);
+    assert(!iter_has_chunks(filter_it));
+    int total = 0;
+    iter_reduce(&filter_it, (void (*)(void *, void *)) sum, &total);
+    assert(total == 14);
+
+    int count = 0;
+    for_each(int, value, vec_iter(vec), {
+        if (value == 7) {
+            break;
+        }
+        count++;
+    });
+    assert(count == 2);
+
+    vec_free(vec);
+    deque_free(deque);
+}
+
+void test_iter_size_hint() {
+    Vec(int) vec = vec_from_array(((int[]) {1, 2, 3, 4, 5}), 5);
+    Iterator it = vec_iter(vec);
+    SizeHint hint = iter_size_hint(it);
+    assert(size_hint_is_exact(hint));
+    assert(hint.lower == 5);
+
+    // Asking for the hint does not move the iterator.
+    assert(option_unwrap(iter_next(it), int) == 1);
+    assert(iter_size_hint(it).upper == 4);
+
+    Map map;
+    Iterator map_it = map_iter(&map, &it, (map_fn) square);
+    hint = iter_size_hint(map_it);
+    assert(size_hint_is_exact(hint) && hint.lower == 4);
+
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &map_it, (pred_fn) is_even);
+    hint = iter_size_hint(filter_it);
+    assert(hint.lower == 0 && hint.upper == 4);
+    assert(iter_size(map_it) == 4);
+    assert(iter_size_hint(filter_it).upper == 0);
+
+    Deque(int) deque = deque_new(int);
+    deque_push_back(deque, 1);
+    deque_push_front(deque, 0);
+    Iterator deque_it = deque_iter(deque);
+    iter_next(deque_it);
+    hint = size_hint_min(iter_size_hint(deque_it), iter_size_hint(filter_it));
+    assert(size_hint_is_exact(iter_size_hint(deque_it)));
+    assert(iter_size_hint(deque_it).lower == 1);
+    assert(hint.lower == 0 && hint.upper == 0);
+    vec_free(vec);
+    deque_free(deque);
+}
+
+void test_iter_double_ended() {
+    Vec(int) vec = vec_from_array(((int[]) {1, 2, 3, 4, 5, 6}), 6);
+    Iterator it = vec_iter(vec);
+    assert(iter_has_flags(it, ITER_DOUBLE_ENDED | ITER_RANDOM_ACCESS));
+    assert(option_unwrap(iter_last(&it), int) == 6);
+
+    Rev rev;
+    Iterator rev_it = rev_iter(&rev, &it);
+    assert(option_unwrap(iter_get(rev_it, 0), int) == 5);
+    assert(option_unwrap(iter_next(rev_it), int) == 5);
+    assert(option_unwrap(iter_next_back(rev_it), int) == 1);
+    assert(option_unwrap(iter_next(rev_it), int) == 4);
+    assert(iter_size_hint(rev_it).lower == 2);
+
+    it = vec_iter(vec);
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &it, (pred_fn) is_even);
+    assert(iter_has_flags(filter_it, ITER_DOUBLE_ENDED));
+    assert(!iter_has_flags(filter_it, ITER_RANDOM_ACCESS));
+    assert(option_unwrap(iter_next_back(filter_it), int) == 6);
+    assert(option_unwrap(iter_next_back(filter_it), int) == 4);
+    assert(option_unwrap(iter_next(filter_it), int) == 2);
+    assert(!iter_next(filter_it).is_valid);
+
+    // A map over a source without an exact size still maps from the back.
+    it = vec_iter(vec);
+    filter_it = filter_iter(&filter, &it, (pred_fn) is_even);
+    Map map;
+    Iterator map_it = map_iter(&map, &filter_it, (map_fn) times_ten);
+    assert(option_unwrap(iter_next_back(map_it), int) == 60);
+    assert(option_unwrap(iter_next_back(map_it), int) == 40);
+    assert(option_unwrap(iter_next(map_it), int) == 20);
+    assert(!iter_next_back(map_it).is_valid);
+
+    Vec(int) evens = vec_from_array(((int[]) {2, 4, 6, 8}), 4);
+    it = vec_iter(evens);
+    filter_it = filter_iter(&filter, &it, (pred_fn) is_even);
+    rev_it = rev_iter(&rev, &filter_it);
+    map_it = map_iter(&map, &rev_it, (map_fn) times_ten);
+    assert(option_unwrap(iter_last(&map_it), int) == 20);
+    assert(option_unwrap(iter_next(map_it), int) == 80);
+    assert(evens[0] == 20 && evens[1] == 4 && evens[2] == 6 && evens[3] == 80);
+    vec_free(evens);
+    vec_free(vec);
+}
+
+void test_iter_map_random_access() {
+    Vec(int) vec = vec_from_array(((int[]) {1, 2, 3, 4, 5, 6, 7, 8}), 8);
+    Iterator it = vec_iter(vec);
+    Map map;
+    Iterator map_it = map_iter(&map, &it, (map_fn) square);
+    assert(iter_has_flags(map_it, ITER_DOUBLE_ENDED | ITER_RANDOM_ACCESS));
+
+    // Each element is squared once however it is reached.
+    assert(option_unwrap(iter_next_back(map_it), int) == 64);
+    assert(option_unwrap(iter_get(map_it, 2), int) == 9);
+    assert(option_unwrap(iter_get(map_it, 2), int) == 9);
+    assert(option_unwrap(iter_next(map_it), int) == 1);
+    assert(option_unwrap(iter_get(map_it, 5), int) == 49);
+    assert(option_unwrap(iter_next_back(map_it), int) == 49);
+    assert(!iter_get(map_it, 5).is_valid);
+    int total = 0;
+    for_each(int, value, map_it, {
+        total += value;
+    });
+    assert(total == 4 + 9 + 16 + 25 + 36);
+    int expected[] = {1, 4, 9, 16, 25, 36, 49, 64};
+    for (int i = 0; i < 8; i++) {
+        assert(vec[i] == expected[i]);
+    }
+    vec_free(vec);
+}
+
+void test_iter_zip_chain_enumerate() {
+    Vec(int) vec1 = vec_from_array(((int[]) {1, 2, 3}), 3);
+    Vec(int) vec2 = vec_from_array(((int[]) {10, 20, 30, 40}), 4);
+
+    Iterator it1 = vec_iter(vec1);
+    Iterator it2 = vec_iter(vec2);
+    Zip zip;
+    Iterator zip_it = zip_iter(&zip, &it1, &it2);
+    assert(iter_size_hint(zip_it).upper == 3);
+    Pair *pair = iter_get(zip_it, 2).value;
+    assert(*(int *) pair->first == 3 && *(int *) pair->second == 30);
+    int total = 0;
+    for_each(Pair, p, zip_it, {
+        total += *(int *) p.first * *(int *) p.second;
+    });
+    assert(total == 10 + 40 + 90);
+
+    it1 = vec_iter(vec1);
+    it2 = vec_iter(vec2);
+    Chain chain;
+    Iterator chain_it = chain_iter(&chain, &it1, &it2);
+    assert(iter_size_hint(chain_it).lower == 7);
+    assert(option_unwrap(iter_get(chain_it, 4), int) == 20);
+    Vec(int) chained = iter_collect(&chain_it, int);
+    assert(vec_size(chained) == 7);
+    assert(chained[2] == 3 && chained[3] == 10 && chained[6] == 40);
+
+    it2 = vec_iter(vec2);
+    iter_next(it2);
+    Enumerate enumerate;
+    Iterator enumerate_it = enumerate_iter(&enumerate, &it2);
+    Enumerated *enumerated = iter_get(enumerate_it, 1).value;
+    assert(enumerated->index == 1 && *(int *) enumerated->value == 30);
+    enumerated = iter_next(enumerate_it).value;
+    assert(enumerated->index == 0 && *(int *) enumerated->value == 20);
+    enumerated = iter_advance(enumerate_it, 2).value;
+    assert(enumerated->index == 1 && *(int *) enumerated->value == 30);
+    assert(!iter_next(enumerate_it).is_valid);
+
+    vec_free(vec1);
+    vec_free(vec2);
+    vec_free(chained);
+}
+
+void test_iter_take_skip_step_by() {
+    Vec(int) vec = vec_from_array(((int[]) {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), 10);
+
+    Iterator it = vec_iter(vec);
+    Skip skip;
+    Iterator skip_it = skip_iter(&skip, &it, 3);
+    Take take;
+    Iterator take_it = take_iter(&take, &skip_it, 5);
+    assert(size_hint_is_exact(iter_size_hint(take_it)));
+    assert(iter_size_hint(take_it).lower == 5);
+    assert(option_unwrap(iter_get(take_it, 4), int) == 7);
+    assert(!iter_get(take_it, 5).is_valid);
+
+    // Skipping a random access iterator moves it in one step.
+    assert(option_unwrap(iter_next(take_it), int) == 3);
+    assert((int *) it.current == &vec[4]);
+    Vec(int) taken = iter_collect(&take_it, int);
+    assert(vec_size(taken) == 4);
+    assert(taken[0] == 4 && taken[3] == 7);
+    assert(option_unwrap(iter_next(it), int) == 8);
+
+    it = vec_iter(vec);
+    StepBy step_by;
+    Iterator step_it = step_by_iter(&step_by, &it, 4);
+    assert(iter_size_hint(step_it).lower == 3);
+    assert(option_unwrap(iter_get(step_it, 2), int) == 8);
+    assert(option_unwrap(iter_next(step_it), int) == 0);
+    assert(option_unwrap(iter_next(step_it), int) == 4);
+    assert(option_unwrap(iter_next(step_it), int) == 8);
+    assert(!iter_next(step_it).is_valid);
+
+    // Take and skip work without random access too.
+    Deque(int) deque = deque_new(int);
+    for (int i = 0; i < 6; i++) {
+        deque_push_back(deque, i);
+    }
+    Iterator deque_it = deque_iter(deque);
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &deque_it, (pred_fn) is_even);
+    skip_it = skip_iter(&skip, &filter_it, 1);
+    take_it = take_iter(&take, &skip_it, 1);
+    assert(iter_size_hint(take_it).lower == 0);
+    assert(iter_size_hint(take_it).upper == 1);
+    assert(option_unwrap(iter_next(take_it), int) == 2);
+    assert(!iter_next(take_it).is_valid);
+
+    vec_free(vec);
+    vec_free(taken);
+    deque_free(deque);
+}
+
+void test_iter_chunks_windows() {
+    Vec(int) vec = vec_from_array(((int[]) {1, 2, 3, 4, 5, 6, 7}), 7);
+    int buffer[8];
+
+    Iterator it = vec_iter(vec);
+    Chunks chunks;
+    Iterator chunks_it = chunks_iter(&chunks, &it, buffer, sizeof(int), 3);
+    assert(size_hint_is_exact(iter_size_hint(chunks_it)));
+    assert(iter_size_hint(chunks_it).lower == 3);
+    Chunk *chunk = iter_get(chunks_it, 2).value;
+    assert(chunk->size == 1 && *(int *) chunk->data == 7);
+    size_t sizes[] = {3, 3, 1};
+    int count = 0;
+    for_each(Chunk, c, chunks_it, {
+        assert(c.size == sizes[count]);
+        assert(*(int *) c.data == count * 3 + 1);
+        count++;
+    });
+    assert(count == 3);
+
+    it = vec_iter(vec);
+    Windows windows;
+    Iterator windows_it = windows_iter(&windows, &it, buffer, sizeof(int), 3);
+    assert(iter_size_hint(windows_it).lower == 5);
+    Chunk *window = iter_get(windows_it, 4).value;
+    assert(*(int *) CHUNK_GET(*window, 2) == 7);
+    assert(!iter_get(windows_it, 5).is_valid);
+    int sums[5];
+    count = 0;
+    for_each(Chunk, w, windows_it, {
+        sums[count++] = ITER_PIPE(int, x, w, REDUCE(int, acc, 0, acc + x));
+    });
+    assert(count == 5);
+    for (int i = 0; i < 5; i++) {
+        assert(sums[i] == 3 * i + 6);
+    }
+
+    // A filter yields several blocks, chunks and windows span them.
+    Vec(int) evens = vec_from_array(((int[]) {2, 3, 4, 5, 6, 8, 10, 12}), 8);
+    it = vec_iter(evens);
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &it, (pred_fn) is_even);
+    chunks_it = chunks_iter(&chunks, &filter_it, buffer, sizeof(int), 2);
+    count = 0;
+    for_each(Chunk, c, chunks_it, {
+        assert(c.size == 2);
+        assert(*(int *) CHUNK_GET(c, 0) == 4 * count + 2);
+        assert(*(int *) CHUNK_GET(c, 1) == 4 * count + 4);
+        count++;
+    });
+    assert(count == 3);
+
+    it = vec_iter(evens);
+    filter_it = filter_iter(&filter, &it, (pred_fn) is_even);
+    chunks_it = chunks_iter(&chunks, &filter_it, buffer, sizeof(int), 4);
+    chunk = iter_next(chunks_it).value;
+    assert(chunk->size == 4 && *(int *) CHUNK_GET(*chunk, 3) == 8);
+    chunk = iter_next(chunks_it).value;
+    assert(chunk->size == 2 && *(int *) CHUNK_GET(*chunk, 1) == 12);
+    assert(!iter_next(chunks_it).is_valid);
+
+    it = vec_iter(evens);
+    filter_it = filter_iter(&filter, &it, (pred_fn) is_even);
+    windows_it = windows_iter(&windows, &filter_it, buffer, sizeof(int), 2);
+    int expected[] = {2, 4, 6, 8, 10, 12};
+    count = 0;
+    for_each(Chunk, w, windows_it, {
+        assert(*(int *) CHUNK_GET(w, 0) == expected[count]);
+        assert(*(int *) CHUNK_GET(w, 1) == expected[count + 1]);
+        count++;
+    });
+    assert(count == 5);
+
+    // A deque has no blocks at all.
+    Deque(int) deque = deque_new(int);
+    for (int i = 1; i <= 7; i++) {
+        deque_push_back(deque, i);
+    }
+    Iterator deque_it = deque_iter(deque);
+    chunks_it = chunks_iter(&chunks, &deque_it, buffer, sizeof(int), 3);
+    assert(size_hint_is_exact(iter_size_hint(chunks_it)));
+    assert(iter_size_hint(chunks_it).lower == 3);
+    count = 0;
+    for_each(Chunk, c, chunks_it, {
+        assert(c.size == sizes[count]);
+        assert(*(int *) CHUNK_GET(c, c.size - 1) == count * 3 + (int) c.size);
+        count++;
+    });
+    assert(count == 3);
+
+    deque_it = deque_iter(deque);
+    windows_it = windows_iter(&windows, &deque_it, buffer, sizeof(int), 3);
+    assert(iter_size_hint(windows_it).lower == 5);
+    count = 0;
+    for_each(Chunk, w, windows_it, {
+        assert(ITER_PIPE(int, x, w, REDUCE(int, acc, 0, acc + x)) == 3 * count + 6);
+        count++;
+        assert(iter_size_hint(windows_it).lower == (size_t) (5 - count));
+    });
+    assert(count == 5);
+
+    deque_free(deque);
+    vec_free(evens);
+    vec_free(vec);
+}
+
+typedef struct {
+    int key;
+    int source;
+} Tagged;
+
+static int tagged_compare(const Tagged *a, const Tagged *b) {
+    return a->key - b->key;
+}
+
+void test_iter_merge_k() {
+    Vec(int) a = vec_from_array(((int[]) {1, 4, 4, 9}), 4);
+    Vec(int) b = vec_from_array(((int[]) {2, 4, 10, 11, 12}), 5);
+    Vec(int) c = vec_new(int);
+    Vec(int) d = vec_from_array(((int[]) {0, 3, 9}), 3);
+    Iterator its[] = {vec_iter(a), vec_iter(b), vec_iter(c), vec_iter(d)};
+
+    MergeK merge;
+    Iterator merge_it = merge_k_iter(&merge, its, 4, sizeof(int), (compare_fn) int_compare, allocator_new());
+    assert(iter_size_hint(merge_it).lower == 12);
+    assert(*(int *) iter_next(merge_it).value == 0);
+    assert(iter_size_hint(merge_it).lower == 11);
+    Vec(int) merged = iter_collect(&merge_it, int);
+    int expected[] = {1, 2, 3, 4, 4, 4, 9, 9, 10, 11, 12};
+    assert(vec_size(merged) == 11);
+    for (int i = 0; i < 11; i++) {
+        assert(merged[i] == expected[i]);
+    }
+    assert(!iter_next(merge_it).is_valid);
+    assert(iter_size_hint(merge_it).upper == 0);
+    merge_k_free(&merge);
+    vec_free(merged);
+
+    Iterator dedup_its[] = {vec_iter(a), vec_iter(b), vec_iter(c), vec_iter(d)};
+    Iterator dedup_it = merge_k_dedup_iter(&merge, dedup_its, 4, sizeof(int), (compare_fn) int_compare, allocator_new());
+    Vec(int) deduped = iter_collect(&dedup_it, int);
+    int unique[] = {0, 1, 2, 3, 4, 9, 10, 11, 12};
+    assert(vec_size(deduped) == 9);
+    for (int i = 0; i < 9; i++) {
+        assert(deduped[i] == unique[i]);
+    }
+    merge_k_free(&merge);
+    vec_free(deduped);
+
+    // Equal keys keep the order of the iterators.
+    Vec(Tagged) t0 = vec_from_array(((Tagged[]) {{1, 0}, {2, 0}, {2, 0}}), 3);
+    Vec(Tagged) t1 = vec_from_array(((Tagged[]) {{1, 1}, {2, 1}}), 2);
+    Vec(Tagged) t2 = vec_from_array(((Tagged[]) {{0, 2}, {2, 2}}), 2);
+    Iterator tagged_its[] = {vec_iter(t0), vec_iter(t1), vec_iter(t2)};
+    Iterator tagged_it = merge_k_iter(&merge, tagged_its, 3, sizeof(Tagged), (compare_fn) tagged_compare, allocator_new());
+    Tagged order[] = {{0, 2}, {1, 0}, {1, 1}, {2, 0}, {2, 0}, {2, 1}, {2, 2}};
+    int count = 0;
+    for (Option o = iter_next(tagged_it); o.is_valid; o = iter_next(tagged_it)) {
+        Tagged *tagged = o.value;
+        assert(tagged->key == order[count].key && tagged->source == order[count].source);
+        count++;
+    }
+    assert(count == 7);
+    merge_k_free(&merge);
+
+    Iterator none_it = merge_k_iter(&merge, NULL, 0, sizeof(int), (compare_fn) int_compare, allocator_new());
+    assert(iter_size_hint(none_it).upper == 0);
+    assert(!iter_next(none_it).is_valid);
+    merge_k_free(&merge);
+
+    Iterator single[] = {vec_iter(a)};
+    Iterator single_it = merge_k_dedup_iter(&merge, single, 1, sizeof(int), (compare_fn) int_compare, allocator_new());
+    assert(iter_size_hint(single_it).lower == 1 && iter_size_hint(single_it).upper == 4);
+    Vec(int) single_out = iter_collect(&single_it, int);
+    assert(vec_size(single_out) == 3);
+    assert(single_out[0] == 1 && single_out[1] == 4 && single_out[2] == 9);
+    merge_k_free(&merge);
+    vec_free(single_out);
+
+    vec_free(a);
+    vec_free(b);
+    vec_free(c);
+    vec_free(d);
+    vec_free(t0);
+    vec_free(t1);
+    vec_free(t2);
+}
+
+void test_iter_collect() {
+    Vec(int) vec = vec_from_array(((int[]) {2, 4, 5, 6, 8, 9, 10}), 7);
+    Iterator it = vec_iter(vec);
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &it, (pred_fn) is_even);
+    Vec(int) evens = iter_collect(&filter_it, int);
+    assert(vec_size(evens) == 5);
+    int expected[] = {2, 4, 6, 8, 10};
+    for (int i = 0; i < 5; i++) {
+        assert(evens[i] == expected[i]);
+    }
+
+    Deque(int) deque = deque_new(int);
+    for (int i = 0; i < 10; i++) {
+        deque_push_front(deque, i);
+    }
+    Iterator deque_it = deque_iter(deque);
+    Vec(int) from_deque = iter_collect(&deque_it, int);
+    assert(vec_size(from_deque) == 10);
+    assert(vec_capacity(from_deque) == 10);
+    for (int i = 0; i < 10; i++) {
+        assert(from_deque[i] == 9 - i);
+    }
+
+    vec_free(vec);
+    vec_free(evens);
+    vec_free(from_deque);
+    deque_free(deque);
+}
+
+void test_iter_pipe() {
+    Vec(int) vec = vec_from_array(((int[]) {1, 2, 3, 4, 5, 6, 7, 8}), 8);
+
+    int total = ITER_PIPE(int, x, vec_view(vec),
+        MAP(x * x),
+        FILTER(x % 2 == 0),
+        REDUCE(int, acc, 0, acc + x)
+    );
+    assert(total == 4 + 16 + 36 + 64);
+
+    // The same pipeline through the iterator adapters.
+    Vec(int) copy = vec_from_array(vec, vec_size(vec));
+    Iterator it = vec_iter(copy);
+    Map map;
+    Iterator map_it = map_iter(&map, &it, (map_fn) square);
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &map_it, (pred_fn) is_even);
+    int iter_total = 0;
+    iter_reduce(&filter_it, (void (*)(void *, void *)) sum, &iter_total);
+    assert(iter_total == total);
+    vec_free(copy);
+
+    // The source is not modified by MAP.
+    assert(vec[1] == 2);
+
+    double mean = ITER_PIPE(int, x, vec_view(vec, .start = 4),
+        REDUCE(double, acc, 0.0, acc + x / 4.0)
+    );
+    assert(mean == 6.5);
+
+    int count = 0;
+    ITER_PIPE(int, x, view_from_array(vec, 4),
+        FILTER(x > 1),
+        MAP(x - 1),
+        FILTER(x % 2 == 1),
+        FOR_EACH({ count += x; })
+    );
+    assert(count == 1 + 3);
+
+    int empty = ITER_PIPE(int, x, vec_view(vec, .end = 0), REDUCE(int, acc, -1, x));
+    assert(empty == -1);
+    vec_free(vec);
+}
+
+int main() {
+    test_iter_vec_chunks();
+    test_iter_find_resumes();
+    test_iter_map_filter_chunks();
+    test_iter_mixed_sources();
+    test_iter_size_hint();
+    test_iter_double_ended();
+    test_iter_map_random_access();
+    test_iter_zip_chain_enumerate();
+    test_iter_take_skip_step_by();
+    test_iter_chunks_windows();
+    test_iter_merge_k();
+    test_iter_collect();
+    test_iter_pipe();
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "../iter_utils.h"
+#include "../par_iter.h"
+#include "../vector.h"
+
+#define SIZE 100000
+
+void double_int(void *value) {
+    *(int *) value *= 2;
+}
+
+void count_even(void *value, void *context) {
+    if (*(int *) value % 2 == 0) {
+        atomic_fetch_add((atomic_size_t *) context, 1);
+    }
+}
+
+void add_int(void *acc, void *value) {
+    *(long *) acc += *(int *) value;
+}
+
+void add_long(void *acc, void *other) {
+    *(long *) acc += *(long *) other;
+}
+
+// Keeps the first and last value folded, to check the combine order.
+typedef struct {
+    int first;
+    int last;
+    bool empty;
+} Span;
+
+void span_add(void *acc, void *value) {
+    Span *span = acc;
+    if (span->empty) {
+        span->first = *(int *) value;
+        span->empty = false;
+    }
+    span->last = *(int *) value;
+}
+
+void span_combine(void *acc, void *other) {
+    Span *span = acc;
+    Span *other_span = other;
+    if (other_span->empty) {
+        return;
+    }
+    if (span->empty) {
+        *span = *other_span;
+        return;
+    }
+    span->last = other_span->last;
+}
+
+void test_par_map() {
+    int *vector = vec_new(int);
+    for (int i = 0; i < SIZE; i++) {
+        vec_push_back(vector, i);
+    }
+
+    Iterator iterator = vec_iter(vector);
+    par_map(&iterator, double_int, .nthreads = 4);
+    for (int i = 0; i < SIZE; i++) {
+        assert(vector[i] == 2 * i);
+    }
+    assert(!iter_next(iterator).is_valid);
+
+    // A range shorter than PAR_MIN_RANGE per thread stays on one thread.
+    View tail = vec_view(vector, .start = SIZE - 10);
+    iterator = view_iter(&tail);
+    par_map(&iterator, double_int);
+    assert(vector[SIZE - 11] == 2 * (SIZE - 11));
+    assert(vector[SIZE - 1] == 4 * (SIZE - 1));
+
+    // Ranges can run on a pool of the caller's.
+    ThreadPool *pool = thread_pool_new(.nthreads = 2);
+    iterator = vec_iter(vector);
+    par_map(&iterator, double_int, .pool = pool);
+    assert(vector[SIZE / 2] == 4 * (SIZE / 2));
+    thread_pool_free(pool);
+
+    // A clone is unshared before its elements are mapped.
+    int *clone = vec_clone(vector);
+    vec_make_unique(clone);
+    iterator = vec_iter(clone);
+    par_map(&iterator, double_int, .nthreads = 4);
+    assert(clone[SIZE / 2] == 8 * (SIZE / 2));
+    assert(vector[SIZE / 2] == 4 * (SIZE / 2));
+    vec_free(clone);
+    vec_free(vector);
+}
+
+void test_par_for_each() {
+    int *vector = vec_new(int);
+    for (int i = 0; i < SIZE; i++) {
+        vec_push_back(vector, i);
+    }
+
+    atomic_size_t count = 0;
+    Iterator iterator = vec_iter(vector);
+    par_for_each(&iterator, count_even, &count, .nthreads = 3);
+    assert(count == SIZE / 2);
+
+    // Iterators without chunks run on the calling thread.
+    count = 0;
+    View head = vec_view(vector, .end = 10);
+    View tail = vec_view(vector, .start = SIZE - 10);
+    Iterator iterator1 = view_iter(&head);
+    Iterator iterator2 = view_iter(&tail);
+    Chain chain;
+    Iterator chained = chain_iter(&chain, &iterator1, &iterator2);
+    par_for_each(&chained, count_even, &count);
+    assert(count == 10);
+    vec_free(vector);
+}
+
+void test_par_reduce() {
+    int *vector = vec_new(int);
+    for (int i = 0; i < SIZE; i++) {
+        vec_push_back(vector, i);
+    }
+
+    long sum = 0;
+    Iterator iterator = vec_iter(vector);
+    par_reduce(&iterator, add_int, add_long, &sum, .nthreads = 8);
+    assert(sum == (long) SIZE * (SIZE - 1) / 2);
+
+    Span span = { .empty = true };
+    View tail = vec_view(vector, .start = 1);
+    iterator = view_iter(&tail);
+    par_reduce(&iterator, span_add, span_combine, &span, .nthreads = 8);
+    assert(!span.empty && span.first == 1 && span.last == SIZE - 1);
+    vec_free(vector);
+}
+
+bool is_multiple_of_37(const void *value) {
+    return *(const int *) value % 37 == 0;
+}
+
+bool always(const void *value) {
+    (void) value;
+    return true;
+}
+
+void test_vec_par_filter() {
+    int *vector = vec_new(int);
+    int *empty = vec_par_filter(vector, always);
+    assert(vec_size(empty) == 0);
+    vec_free(empty);
+
+    for (int i = 0; i < SIZE + 7; i++) {
+        vec_push_back(vector, i);
+    }
+    int *filtered = vec_par_filter(vector, is_multiple_of_37, .nthreads = 5);
+    assert(vec_size(filtered) == (SIZE + 7 + 36) / 37);
+    for (size_t i = 0; i < vec_size(filtered); i++) {
+        assert(filtered[i] == 37 * (int) i);
+    }
+    vec_free(filtered);
+
+    int *copy = vec_par_filter(vector, always);
+    assert(vec_size(copy) == vec_size(vector));
+    assert(memcmp(copy, vector, vec_size(vector) * sizeof(int)) == 0);
+    vec_free(copy);
+    vec_free(vector);
+}
+
+int main() {
+    test_par_map();
+    test_par_for_each();
+    test_par_reduce();
+    test_vec_par_filter();
+    return 0;
+}
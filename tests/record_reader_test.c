@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../iter_utils.h"
+#include "../record_reader.h"
+#include "../vector.h"
+
+typedef struct {
+    int32_t id;
+    int32_t value;
+    int32_t extra;
+} Entry;
+
+static int tmp_fd() {
+    char path[] = "/tmp/record_reader_test_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    unlink(path);
+    return fd;
+}
+
+static bool is_even_id(const Entry *entry) {
+    return entry->id % 2 == 0;
+}
+
+void test_record_reader_fixed() {
+    size_t size = 50000;
+    Vec(Entry) entries = vec_new(Entry, .cap = size);
+    for (size_t i = 0; i < size; i++) {
+        vec_push_back(entries, ((Entry) { .id = (int32_t) i, .value = (int32_t) (i * 7), .extra = -1 }));
+    }
+    int fd = tmp_fd();
+    assert(write(fd, entries, size * sizeof(Entry)) == (ssize_t) (size * sizeof(Entry)));
+
+    // 1000 is not a multiple of 12, so records are split across buffers.
+    for (int background = 0; background < 2; background++) {
+        assert(lseek(fd, 0, SEEK_SET) == 0);
+        RecordReader *reader = record_reader_new(fd, .record_size = sizeof(Entry), .buffer_size = 1000, .background = background);
+        Iterator it = record_reader_iter(reader);
+        assert(size_hint_is_exact(iter_size_hint(it)));
+        assert(iter_size_hint(it).lower == size);
+        Entry *first = iter_next(it).value;
+        assert(first->id == 0);
+        assert(iter_size_hint(it).lower == size - 1);
+        Vec(Entry) read_back = iter_collect(&it, Entry);
+        assert(vec_size(read_back) == size - 1);
+        assert(memcmp(read_back, entries + 1, (size - 1) * sizeof(Entry)) == 0);
+        assert(iter_size_hint(it).upper == 0);
+        assert(record_reader_error(reader) == 0);
+        record_reader_free(reader);
+        vec_free(read_back);
+    }
+
+    // Through the adapters, one record at a time.
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    RecordReader *reader = record_reader_new(fd, .record_size = sizeof(Entry), .buffer_size = 4096, .background = true);
+    Iterator it = record_reader_iter(reader);
+    Filter filter;
+    Iterator filter_it = filter_iter(&filter, &it, (pred_fn) is_even_id);
+    size_t count = 0;
+    for (Option o = iter_next(filter_it); o.is_valid; o = iter_next(filter_it)) {
+        Entry *entry = o.value;
+        assert(entry->id == (int32_t) (2 * count) && entry->value == entry->id * 7);
+        count++;
+    }
+    assert(count == size / 2);
+    record_reader_free(reader);
+
+    // A file ending inside a record.
+    assert(ftruncate(fd, 10 * sizeof(Entry) + 5) == 0);
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    reader = record_reader_new(fd, .record_size = sizeof(Entry), .buffer_size = 64);
+    it = record_reader_iter(reader);
+    Vec(Entry) truncated = iter_collect(&it, Entry);
+    assert(vec_size(truncated) == 10);
+    assert(record_reader_error(reader) == EBADMSG);
+    record_reader_free(reader);
+    vec_free(truncated);
+
+    // Freeing a reader before reading everything stops its thread.
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    reader = record_reader_new(fd, .record_size = sizeof(Entry), .buffer_size = 16, .background = true);
+    it = record_reader_iter(reader);
+    assert(((Entry *) iter_next(it).value)->id == 0);
+    record_reader_free(reader);
+
+    close(fd);
+    vec_free(entries);
+}
+
+void test_record_reader_advance() {
+    int32_t values[20];
+    for (int32_t i = 0; i < 20; i++) {
+        values[i] = i;
+    }
+    int fd = tmp_fd();
+    assert(write(fd, values, sizeof(values)) == (ssize_t) sizeof(values));
+
+    // Steps cross buffers, of whole records and of records split across
+    // them, the first record of each step must survive the fetches.
+    size_t buffer_sizes[] = { 16, 10 };
+    for (size_t b = 0; b < 2; b++) {
+        for (int background = 0; background < 2; background++) {
+            assert(lseek(fd, 0, SEEK_SET) == 0);
+            RecordReader *reader = record_reader_new(
+                fd,
+                .record_size = sizeof(int32_t),
+                .buffer_size = buffer_sizes[b],
+                .background = background
+            );
+            int32_t expected = 0;
+            for_each_step(int32_t, x, record_reader_iter(reader), 3, {
+                assert(x == expected);
+                expected += 3;
+            });
+            assert(expected == 21);
+            assert(record_reader_error(reader) == 0);
+            record_reader_free(reader);
+        }
+    }
+    close(fd);
+}
+
+void test_record_reader_prefixed() {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    size_t lengths[] = {5, 0, 300, 1, 17, 2000, 3};
+    size_t nrecords = sizeof(lengths) / sizeof(lengths[0]);
+    char data[2000];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (char) (i % 251);
+    }
+    for (size_t i = 0; i < nrecords; i++) {
+        uint32_t length = (uint32_t) lengths[i];
+        assert(write(fds[1], &length, sizeof(length)) == sizeof(length));
+        assert(write(fds[1], data, length) == (ssize_t) length);
+    }
+    close(fds[1]);
+
+    // Records longer than the buffers are put together.
+    RecordReader *reader = record_reader_new(fds[0], .buffer_size = 64, .background = true);
+    Iterator it = record_reader_iter(reader);
+    assert(iter_size_hint(it).upper == SIZE_MAX);
+    size_t count = 0;
+    for (Option o = iter_next(it); o.is_valid; o = iter_next(it)) {
+        Chunk *record = o.value;
+        assert(record->size == lengths[count] && record->elem_size == 1);
+        assert(record->size == 0 || memcmp(record->data, data, record->size) == 0);
+        count++;
+    }
+    assert(count == nrecords);
+    assert(record_reader_error(reader) == 0);
+    record_reader_free(reader);
+    close(fds[0]);
+}
+
+static int int32_compare(const int32_t *a, const int32_t *b) {
+    return (*a > *b) - (*a < *b);
+}
+
+void test_record_reader_merge() {
+    // Buffers of a single record, each read overwrites the last one.
+    int32_t values[][4] = { {1, 1, 2, 5}, {3, 4} };
+    size_t sizes[] = {4, 2};
+    RecordReader *readers[2];
+    Iterator its[2];
+    int fds[2];
+    for (size_t i = 0; i < 2; i++) {
+        fds[i] = tmp_fd();
+        assert(write(fds[i], values[i], sizes[i] * sizeof(int32_t)) == (ssize_t) (sizes[i] * sizeof(int32_t)));
+        assert(lseek(fds[i], 0, SEEK_SET) == 0);
+        readers[i] = record_reader_new(fds[i], .record_size = sizeof(int32_t), .buffer_size = sizeof(int32_t));
+        its[i] = record_reader_iter(readers[i]);
+    }
+
+    MergeK merge;
+    Iterator merge_it = merge_k_dedup_iter(&merge, its, 2, sizeof(int32_t), (compare_fn) int32_compare, allocator_new());
+    int32_t expected = 1;
+    for (Option o = iter_next(merge_it); o.is_valid; o = iter_next(merge_it)) {
+        assert(option_unwrap(o, int32_t) == expected);
+        expected++;
+    }
+    assert(expected == 6);
+    merge_k_free(&merge);
+    for (size_t i = 0; i < 2; i++) {
+        record_reader_free(readers[i]);
+        close(fds[i]);
+    }
+}
+
+int main() {
+    test_record_reader_fixed();
+    test_record_reader_advance();
+    test_record_reader_prefixed();
+    test_record_reader_merge();
+    return 0;
+}
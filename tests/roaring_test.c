@@ -0,0 +1,278 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../bitvec.h"
+#include "../roaring.h"
+
+// Values spread over sparse, dense and full chunks.
+static Roaring *make_mixed(BitVec *reference, unsigned seed) {
+    Roaring *roaring = roaring_new();
+    srand(seed);
+    for (int i = 0; i < 3000; i++) {
+        uint32_t value = (uint32_t) rand() % (1 << 16);
+        roaring_add(roaring, value);
+        bitvec_set(reference, value);
+    }
+    for (int i = 0; i < 30000; i++) {
+        uint32_t value = (1 << 16) + (uint32_t) rand() % (1 << 16);
+        roaring_add(roaring, value);
+        bitvec_set(reference, value);
+    }
+    uint32_t first = 3 * (1 << 16) + (uint32_t) rand() % 1000;
+    uint32_t last = 5 * (1 << 16) + (uint32_t) rand() % 1000;
+    roaring_add_range(roaring, first, last);
+    for (uint32_t value = first; value <= last; value++) {
+        bitvec_set(reference, value);
+    }
+    return roaring;
+}
+
+static void check_against(const Roaring *roaring, const BitVec *reference) {
+    assert(roaring_cardinality(roaring) == bitvec_count(reference));
+    BitVecOnes ones;
+    Iterator expected = bitvec_ones_iter(&ones, reference);
+    RoaringIter iter;
+    Iterator it = roaring_iter(&iter, roaring);
+    for (Option value = iter_next(it); value.is_valid; value = iter_next(it)) {
+        assert(option_unwrap(value, uint32_t) == option_unwrap(iter_next(expected), size_t));
+    }
+    assert(!iter_next(expected).is_valid);
+}
+
+void test_roaring_basic() {
+    Roaring *roaring = roaring_new();
+    assert(roaring_cardinality(roaring) == 0);
+    assert(!roaring_contains(roaring, 0));
+
+    uint32_t values[] = { 7, 3, 1 << 20, UINT32_MAX, 65535, 65536, 3 };
+    for (size_t i = 0; i < 7; i++) {
+        roaring_add(roaring, values[i]);
+    }
+    assert(roaring_cardinality(roaring) == 6);
+    for (size_t i = 0; i < 7; i++) {
+        assert(roaring_contains(roaring, values[i]));
+    }
+    assert(!roaring_contains(roaring, 4));
+    assert(!roaring_contains(roaring, (1 << 20) + 1));
+
+    assert(roaring_remove(roaring, 7));
+    assert(!roaring_remove(roaring, 7));
+    assert(!roaring_remove(roaring, 8));
+    assert(roaring_remove(roaring, UINT32_MAX));
+    assert(!roaring_contains(roaring, UINT32_MAX));
+    assert(roaring_cardinality(roaring) == 4);
+    roaring_free(roaring);
+}
+
+void test_roaring_containers() {
+    // Grow an array into a bitmap and shrink it back.
+    Roaring *roaring = roaring_new();
+    for (uint32_t i = 0; i < 10000; i++) {
+        roaring_add(roaring, i * 2);
+    }
+    assert(roaring_cardinality(roaring) == 10000);
+    size_t bitmap_size = roaring_serialized_size(roaring);
+    for (uint32_t i = 0; i < 10000; i++) {
+        assert(roaring_contains(roaring, i * 2));
+        assert(!roaring_contains(roaring, i * 2 + 1));
+    }
+    for (uint32_t i = 0; i < 9000; i++) {
+        assert(roaring_remove(roaring, i * 2));
+    }
+    assert(roaring_cardinality(roaring) == 1000);
+    assert(roaring_serialized_size(roaring) < bitmap_size);
+    for (uint32_t i = 9000; i < 10000; i++) {
+        assert(roaring_remove(roaring, i * 2));
+    }
+    assert(roaring_cardinality(roaring) == 0);
+    roaring_free(roaring);
+
+    // Ranges are runs until values are added to them.
+    roaring = roaring_new();
+    roaring_add_range(roaring, 100, 3 * (1 << 16) + 99);
+    assert(roaring_cardinality(roaring) == 3 * (1 << 16));
+    assert(roaring_serialized_size(roaring) < 100);
+    assert(!roaring_contains(roaring, 99));
+    assert(roaring_contains(roaring, 100));
+    assert(roaring_contains(roaring, 3 * (1 << 16) + 99));
+    assert(!roaring_contains(roaring, 3 * (1 << 16) + 100));
+    roaring_add(roaring, 1);
+    assert(roaring_remove(roaring, 1 << 16));
+    assert(roaring_cardinality(roaring) == 3 * (1 << 16));
+
+    // Optimizing turns them back into runs.
+    Roaring *copy = roaring_union(roaring, roaring);
+    size_t size = roaring_serialized_size(roaring);
+    roaring_optimize(roaring);
+    assert(roaring_serialized_size(roaring) < size / 100);
+    assert(roaring_equals(roaring, copy));
+    roaring_add_range(roaring, 0, UINT32_MAX);
+    assert(roaring_cardinality(roaring) == (uint64_t) 1 << 32);
+    roaring_free(copy);
+    roaring_free(roaring);
+}
+
+void test_roaring_set_ops() {
+    BitVec *reference1 = bitvec_new();
+    BitVec *reference2 = bitvec_new();
+    bitvec_resize(reference1, 8 * (1 << 16), false);
+    bitvec_resize(reference2, 8 * (1 << 16), false);
+    Roaring *roaring1 = make_mixed(reference1, 1);
+    Roaring *roaring2 = make_mixed(reference2, 2);
+    roaring_add(roaring2, 7 * (1 << 16));
+    bitvec_set(reference2, 7 * (1 << 16));
+
+    for (int optimized = 0; optimized < 2; optimized++) {
+        BitVec *expected = bitvec_new();
+        bitvec_resize(expected, 8 * (1 << 16), false);
+
+        Roaring *result = roaring_union(roaring1, roaring2);
+        bitvec_or(expected, reference1);
+        bitvec_or(expected, reference2);
+        check_against(result, expected);
+        roaring_free(result);
+
+        result = roaring_intersection(roaring1, roaring2);
+        bitvec_fill(expected, false);
+        bitvec_or(expected, reference1);
+        bitvec_and(expected, reference2);
+        check_against(result, expected);
+        roaring_free(result);
+
+        result = roaring_difference(roaring1, roaring2);
+        bitvec_fill(expected, false);
+        bitvec_or(expected, reference1);
+        bitvec_andnot(expected, reference2);
+        check_against(result, expected);
+        roaring_free(result);
+
+        result = roaring_difference(roaring2, roaring1);
+        bitvec_fill(expected, false);
+        bitvec_or(expected, reference2);
+        bitvec_andnot(expected, reference1);
+        check_against(result, expected);
+        roaring_free(result);
+
+        bitvec_free(expected);
+        roaring_optimize(roaring1);
+    }
+
+    // A few values against many, which gallops.
+    Roaring *small = roaring_new();
+    roaring_add(small, 5);
+    roaring_add(small, 3001);
+    Roaring *large = roaring_new();
+    for (uint32_t i = 1; i < 4000; i += 2) {
+        roaring_add(large, i);
+    }
+    Roaring *result = roaring_intersection(small, large);
+    assert(roaring_cardinality(result) == 2);
+    assert(roaring_contains(result, 5) && roaring_contains(result, 3001));
+    roaring_free(result);
+    Roaring *empty = roaring_new();
+    result = roaring_intersection(small, empty);
+    assert(roaring_cardinality(result) == 0);
+    roaring_free(result);
+    roaring_free(empty);
+
+    roaring_free(small);
+    roaring_free(large);
+    roaring_free(roaring1);
+    roaring_free(roaring2);
+    bitvec_free(reference1);
+    bitvec_free(reference2);
+}
+
+void test_roaring_serialize() {
+    BitVec *reference = bitvec_new();
+    bitvec_resize(reference, 8 * (1 << 16), false);
+    Roaring *roaring = make_mixed(reference, 3);
+    roaring_optimize(roaring);
+    roaring_add(roaring, 1);
+    bitvec_set(reference, 1);
+
+    size_t size = roaring_serialized_size(roaring);
+    char *buffer = malloc(size + 1);
+    assert(roaring_serialize(roaring, buffer + 1) == size);
+    Roaring *read = roaring_deserialize(buffer + 1, size);
+    assert(read != NULL);
+    assert(roaring_equals(read, roaring));
+    check_against(read, reference);
+    roaring_free(read);
+
+    errno = 0;
+    assert(roaring_deserialize(buffer + 1, size - 1) == NULL);
+    assert(errno == EBADMSG);
+    buffer[1] ^= 1;
+    assert(roaring_deserialize(buffer + 1, size) == NULL);
+    assert(errno == EINVAL);
+    buffer[1] ^= 1;
+
+    // An array out of order.
+    uint32_t header[2] = { ROARING_MAGIC, 1 };
+    uint16_t fields[2] = { 0, 0 };
+    uint32_t entries = 2;
+    uint16_t values[2] = { 9, 4 };
+    char bad[sizeof(header) + 8 + sizeof(values)];
+    memcpy(bad, header, sizeof(header));
+    memcpy(bad + sizeof(header), fields, sizeof(fields));
+    memcpy(bad + sizeof(header) + sizeof(fields), &entries, sizeof(entries));
+    memcpy(bad + sizeof(header) + 8, values, sizeof(values));
+    assert(roaring_deserialize(bad, sizeof(bad)) == NULL);
+    assert(errno == EBADMSG);
+    values[0] = 1;
+    memcpy(bad + sizeof(header) + 8, values, sizeof(values));
+    read = roaring_deserialize(bad, sizeof(bad));
+    assert(roaring_cardinality(read) == 2);
+    roaring_free(read);
+
+    Roaring *empty = roaring_new();
+    assert(roaring_serialize(empty, buffer) == 8);
+    read = roaring_deserialize(buffer, 8);
+    assert(roaring_cardinality(read) == 0);
+    roaring_free(read);
+    roaring_free(empty);
+
+    free(buffer);
+    roaring_free(roaring);
+    bitvec_free(reference);
+}
+
+void test_roaring_iter() {
+    Roaring *roaring = roaring_new();
+    roaring_add_range(roaring, 65530, 65540);
+    for (uint32_t i = 0; i < 5000; i++) {
+        roaring_add(roaring, (1 << 20) + i * 3);
+    }
+    roaring_add(roaring, 2);
+
+    RoaringIter iter;
+    Iterator it = roaring_iter(&iter, roaring);
+    assert(iter_size_hint(it).lower == 5012);
+    assert(iter_size_hint(it).upper == 5012);
+    assert(option_unwrap(iter_next(it), uint32_t) == 2);
+    assert(option_unwrap(iter_next(it), uint32_t) == 65530);
+    assert(option_unwrap(iter_advance(it, 6), uint32_t) == 65531);
+    assert(option_unwrap(iter_next(it), uint32_t) == 65537);
+    assert(option_unwrap(iter_advance(it, 5), uint32_t) == 65538);
+    assert(option_unwrap(iter_next(it), uint32_t) == (1 << 20) + 6);
+    assert(iter_size_hint(it).upper == 4997);
+    assert(option_unwrap(iter_advance(it, 4997), uint32_t) == (1 << 20) + 9);
+    assert(!iter_next(it).is_valid);
+    assert(iter_size_hint(it).upper == 0);
+
+    it = roaring_iter(&iter, roaring);
+    assert(iter_size(it) == 5012);
+    roaring_free(roaring);
+}
+
+int main() {
+    test_roaring_basic();
+    test_roaring_containers();
+    test_roaring_set_ops();
+    test_roaring_serialize();
+    test_roaring_iter();
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <assert.h>
+
+#include "../segvec.h"
+
+void test_segvec_basic() {
+    SegVec(int) segvec = segvec_new(int);
+    assert(segvec_size(segvec) == 0);
+    assert(segvec_capacity(segvec) == 0);
+    assert(segvec_is_empty(segvec));
+
+    for (int i = 0; i < 1000; i++) {
+        int *elem = segvec_push_back(segvec, i);
+        assert(*elem == i);
+    }
+    assert(segvec_size(segvec) == 1000);
+    assert(segvec_capacity(segvec) >= 1000);
+    for (int i = 0; i < 1000; i++) {
+        assert(*segvec_get(segvec, i) == i);
+    }
+
+    int popped;
+    segvec_pop_back(segvec, &popped);
+    assert(popped == 999);
+    segvec_pop_back(segvec, NULL);
+    assert(segvec_size(segvec) == 998);
+
+    segvec_clear(segvec);
+    assert(segvec_is_empty(segvec));
+    segvec_free(segvec);
+}
+
+void test_segvec_pointer_stability() {
+    SegVec(double) segvec = segvec_new(double, .cap = 4);
+    double *first = segvec_push_back(segvec, 1.5);
+    double *pointers[100];
+    pointers[0] = first;
+    for (int i = 1; i < 100; i++) {
+        pointers[i] = segvec_push_back(segvec, i * 2.0);
+    }
+
+    assert(first == segvec_get(segvec, 0));
+    assert(*first == 1.5);
+    for (int i = 1; i < 100; i++) {
+        assert(pointers[i] == segvec_get(segvec, i));
+        assert(*pointers[i] == i * 2.0);
+    }
+    segvec_free(segvec);
+}
+
+void test_segvec_reserve_and_shrink() {
+    SegVec(int) segvec = segvec_new(int, .cap = 3);
+    segvec_reserve(segvec, 100);
+    assert(segvec_capacity(segvec) >= 100);
+    assert(segvec_size(segvec) == 0);
+
+    for (int i = 0; i < 10; i++) {
+        segvec_push_back(segvec, i);
+    }
+    segvec_shrink(segvec);
+    assert(segvec_capacity(segvec) >= 10);
+    assert(segvec_capacity(segvec) < 100);
+    for (int i = 0; i < 10; i++) {
+        assert(*segvec_get(segvec, i) == i);
+    }
+
+    segvec_clear(segvec);
+    segvec_shrink(segvec);
+    assert(segvec_capacity(segvec) == 0);
+    segvec_push_back(segvec, 7);
+    assert(*segvec_get(segvec, 0) == 7);
+    segvec_free(segvec);
+}
+
+void test_segvec_iter() {
+    SegVec(int) segvec = segvec_new(int, .cap = 2);
+    for (int i = 0; i < 50; i++) {
+        segvec_push_back(segvec, i);
+    }
+
+    Iterator it = segvec_iter(segvec);
+    for (int i = 0; i < 50; i++) {
+        assert(option_unwrap(iter_next(it), int) == i);
+    }
+    assert(!iter_next(it).is_valid);
+
+    it = segvec_iter(segvec);
+    assert(option_unwrap(iter_advance(it, 10), int) == 0);
+    assert(option_unwrap(iter_next(it), int) == 10);
+    assert(iter_size_hint(it).lower == 39);
+    assert(iter_size_hint(it).upper == 39);
+    assert(iter_size(it) == 39);
+    assert(iter_size_hint(it).upper == 0);
+    assert(!iter_next(it).is_valid);
+    segvec_free(segvec);
+}
+
+int main() {
+    test_segvec_basic();
+    test_segvec_pointer_stability();
+    test_segvec_reserve_and_shrink();
+    test_segvec_iter();
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include "../soa.h"
+
+typedef struct {
+    double x;
+    double y;
+    char name[12];
+    int id;
+    char unused;
+} Particle;
+
+static int compare_double(const void *value1, const void *value2) {
+    double a = *(const double *) value1;
+    double b = *(const double *) value2;
+    return (a > b) - (a < b);
+}
+
+void test_soa_basic() {
+    SoA *soa = soa_new(Particle, (x, y, name, id));
+    assert(soa_size(soa) == 0);
+    assert(soa_capacity(soa) == 0);
+
+    for (int i = 0; i < 100; i++) {
+        soa_push_back(soa, ((Particle) { .x = i, .y = -i, .name = "p", .id = i, .unused = 'u' }));
+    }
+    assert(soa_size(soa) == 100);
+    assert(soa_capacity(soa) >= 100);
+
+    double *x = soa_column(soa, Particle, x);
+    int *id = soa_column(soa, Particle, id);
+    assert((uintptr_t) x % 64 == 0);
+    assert((uintptr_t) id % 64 == 0);
+    for (int i = 0; i < 100; i++) {
+        assert(x[i] == i);
+        assert(id[i] == i);
+    }
+
+    Particle particle;
+    soa_get(soa, 42, &particle);
+    assert(particle.x == 42 && particle.y == -42 && particle.id == 42);
+    assert(particle.name[0] == 'p' && particle.name[1] == '\0');
+    assert(particle.unused == 0);
+
+    particle.y = 7;
+    soa_set(soa, 42, &particle);
+    assert(soa_column(soa, Particle, y)[42] == 7);
+
+    soa_clear(soa);
+    assert(soa_size(soa) == 0);
+    soa_free(soa);
+}
+
+void test_soa_erase() {
+    SoA *soa = soa_new(Particle, (x, id), .cap = 4);
+    assert(soa_capacity(soa) == 4);
+    for (int i = 0; i < 10; i++) {
+        soa_push_back(soa, ((Particle) { .x = i * 0.5, .id = i }));
+    }
+
+    soa_erase(soa, 0);
+    soa_erase(soa, 4);
+    int *id = soa_column(soa, Particle, id);
+    double *x = soa_column(soa, Particle, x);
+    int ordered[] = { 1, 2, 3, 4, 6, 7, 8, 9 };
+    assert(soa_size(soa) == 8);
+    for (size_t i = 0; i < 8; i++) {
+        assert(id[i] == ordered[i]);
+        assert(x[i] == ordered[i] * 0.5);
+    }
+
+    soa_swap_erase(soa, 1);
+    soa_swap_erase(soa, 6);
+    int swapped[] = { 1, 9, 3, 4, 6, 7 };
+    assert(soa_size(soa) == 6);
+    for (size_t i = 0; i < 6; i++) {
+        assert(id[i] == swapped[i]);
+        assert(x[i] == swapped[i] * 0.5);
+    }
+    soa_free(soa);
+}
+
+void test_soa_sort_by() {
+    SoA *soa = soa_new(Particle, (x, y, id));
+    double keys[] = { 3, 1, 2, 1, 3, 0, 2, 1 };
+    for (int i = 0; i < 8; i++) {
+        soa_push_back(soa, ((Particle) { .x = keys[i], .y = i * 10, .id = i }));
+    }
+    soa_sort_by(soa, Particle, x, compare_double);
+
+    // Equal keys keep their order.
+    double *x = soa_column(soa, Particle, x);
+    double *y = soa_column(soa, Particle, y);
+    int *id = soa_column(soa, Particle, id);
+    int sorted[] = { 5, 1, 3, 7, 2, 6, 0, 4 };
+    for (size_t i = 0; i < 8; i++) {
+        assert(id[i] == sorted[i]);
+        assert(x[i] == keys[sorted[i]]);
+        assert(y[i] == sorted[i] * 10);
+    }
+
+    size_t reverse[] = { 7, 6, 5, 4, 3, 2, 1, 0 };
+    soa_permute(soa, reverse);
+    for (size_t i = 0; i < 8; i++) {
+        assert(id[i] == sorted[7 - i]);
+    }
+    soa_free(soa);
+}
+
+void test_soa_view() {
+    SoA *soa = soa_new(Particle, (x, id));
+    for (int i = 0; i < 1000; i++) {
+        soa_push_back(soa, ((Particle) { .x = i, .id = i % 7 }));
+    }
+
+    View view = soa_view(soa, Particle, id);
+    assert(view.size == 1000);
+    assert(view.elem_size == sizeof(int));
+    Iterator it = view_iter(&view);
+    long sum = 0;
+    for (Option elem = iter_next(it); elem.is_valid; elem = iter_next(it)) {
+        sum += option_unwrap(elem, int);
+    }
+    long expected = 0;
+    for (int i = 0; i < 1000; i++) {
+        expected += i % 7;
+    }
+    assert(sum == expected);
+
+    soa_reserve(soa, 5000);
+    assert(soa_capacity(soa) == 5000);
+    view = soa_view(soa, Particle, x);
+    assert(((double *) view.data)[999] == 999);
+    soa_free(soa);
+}
+
+int main() {
+    test_soa_basic();
+    test_soa_erase();
+    test_soa_sort_by();
+    test_soa_view();
+    return 0;
+}
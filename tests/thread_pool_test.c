@@ -0,0 +1,167 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "../thread_pool.h"
+
+#define TASKS 1000
+
+void increment(void *arg) {
+    atomic_fetch_add((atomic_size_t *) arg, 1);
+}
+
+typedef struct {
+    const long *data;
+    size_t size;
+    long sum;
+    ThreadPool *pool;
+} SumArgs;
+
+// Sums an array by splitting it in halves with thread_pool_join.
+void parallel_sum(void *arg) {
+    SumArgs *args = arg;
+    if (args->size <= 64) {
+        args->sum = 0;
+        for (size_t i = 0; i < args->size; i++) {
+            args->sum += args->data[i];
+        }
+        return;
+    }
+    size_t half = args->size / 2;
+    SumArgs left = { args->data, half, 0, args->pool };
+    SumArgs right = { args->data + half, args->size - half, 0, args->pool };
+    thread_pool_join(args->pool, parallel_sum, &left, parallel_sum, &right);
+    args->sum = left.sum + right.sum;
+}
+
+typedef struct {
+    ThreadPool *pool;
+    atomic_size_t *counter;
+    Task children[10];
+} Spawner;
+
+// Spawns tasks from inside a worker, into the worker's own deque.
+void spawn_children(void *arg) {
+    Spawner *spawner = arg;
+    TaskScope scope = thread_pool_scope(spawner->pool);
+    for (size_t i = 0; i < 10; i++) {
+        spawner->children[i] = (Task) { .func = increment, .arg = spawner->counter };
+    }
+    thread_pool_spawn_batch(&scope, spawner->children, 10);
+    thread_pool_wait(&scope);
+}
+
+typedef struct {
+    ThreadPool *pool;
+    pthread_barrier_t barrier;
+    Task children[4];
+    atomic_bool done;
+} Rendezvous;
+
+void meet(void *arg) {
+    pthread_barrier_wait(arg);
+}
+
+// Spawns 4 tasks that only finish once 4 threads run them at once, the
+// spawning worker pops one so the others have to be stolen.
+void spawn_rendezvous(void *arg) {
+    Rendezvous *rendezvous = arg;
+    TaskScope scope = thread_pool_scope(rendezvous->pool);
+    for (size_t i = 0; i < 4; i++) {
+        rendezvous->children[i] = (Task) { .func = meet, .arg = &rendezvous->barrier };
+    }
+    thread_pool_spawn_batch(&scope, rendezvous->children, 4);
+    thread_pool_wait(&scope);
+    atomic_store(&rendezvous->done, true);
+}
+
+void test_thread_pool_scope() {
+    ThreadPool *pool = thread_pool_new(.nthreads = 4);
+    assert(thread_pool_size(pool) == 4);
+
+    atomic_size_t counter = 0;
+    Task tasks[TASKS];
+    TaskScope scope = thread_pool_scope(pool);
+    for (size_t i = 0; i < TASKS / 2; i++) {
+        tasks[i] = (Task) { .func = increment, .arg = &counter };
+        thread_pool_spawn(&scope, &tasks[i]);
+    }
+    for (size_t i = TASKS / 2; i < TASKS; i++) {
+        tasks[i] = (Task) { .func = increment, .arg = &counter };
+    }
+    thread_pool_spawn_batch(&scope, &tasks[TASKS / 2], TASKS / 2);
+    thread_pool_wait(&scope);
+    assert(counter == TASKS);
+
+    // An empty scope returns right away.
+    TaskScope empty = thread_pool_scope(pool);
+    thread_pool_wait(&empty);
+
+    ThreadPoolStats stats = thread_pool_stats(pool);
+    assert(stats.executed <= TASKS);
+    thread_pool_free(pool);
+}
+
+void test_thread_pool_nested() {
+    ThreadPool *pool = thread_pool_new(.nthreads = 3);
+    atomic_size_t counter = 0;
+    Spawner spawners[20];
+    Task tasks[20];
+    TaskScope scope = thread_pool_scope(pool);
+    for (size_t i = 0; i < 20; i++) {
+        spawners[i] = (Spawner) { .pool = pool, .counter = &counter };
+        tasks[i] = (Task) { .func = spawn_children, .arg = &spawners[i] };
+    }
+    thread_pool_spawn_batch(&scope, tasks, 20);
+    thread_pool_wait(&scope);
+    assert(counter == 200);
+    thread_pool_free(pool);
+}
+
+void test_thread_pool_join() {
+    static long data[100000];
+    for (size_t i = 0; i < 100000; i++) {
+        data[i] = (long) i;
+    }
+
+    ThreadPool *pool = thread_pool_new(.nthreads = 4);
+    SumArgs args = { data, 100000, 0, pool };
+    parallel_sum(&args);
+    assert(args.sum == 100000L * 99999 / 2);
+
+    thread_pool_free(pool);
+
+    assert(thread_pool_global() == thread_pool_global());
+    args = (SumArgs) { data, 1000, 0, thread_pool_global() };
+    parallel_sum(&args);
+    assert(args.sum == 1000L * 999 / 2);
+}
+
+void test_thread_pool_stats() {
+    ThreadPool *pool = thread_pool_new(.nthreads = 4);
+    Rendezvous rendezvous = { .pool = pool, .done = false };
+    pthread_barrier_init(&rendezvous.barrier, NULL, 4);
+    Task root = { .func = spawn_rendezvous, .arg = &rendezvous };
+    TaskScope scope = thread_pool_scope(pool);
+    thread_pool_spawn(&scope, &root);
+
+    // Spin instead of helping, so that the root task runs on a worker.
+    while (!atomic_load(&rendezvous.done)) {
+    }
+    thread_pool_wait(&scope);
+    pthread_barrier_destroy(&rendezvous.barrier);
+
+    ThreadPoolStats stats = thread_pool_stats(pool);
+    assert(stats.executed == 5);
+    assert(stats.steals == 3);
+    thread_pool_free(pool);
+}
+
+int main() {
+    test_thread_pool_scope();
+    test_thread_pool_nested();
+    test_thread_pool_join();
+    test_thread_pool_stats();
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../vec_io.h"
+
+typedef struct {
+    int id;
+    double score;
+    char tag[4];
+} Record;
+
+static int tmp_fd() {
+    char path[] = "/tmp/vec_io_test_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    unlink(path);
+    return fd;
+}
+
+void test_mem_crc32c() {
+    assert(mem_crc32c("123456789", 9, 0) == 0xE3069283u);
+    assert(mem_crc32c("", 0, 0) == 0);
+
+    // A CRC can be computed piece by piece.
+    char data[1000];
+    for (int i = 0; i < 1000; i++) {
+        data[i] = (char) (i * 31 + 7);
+    }
+    uint32_t whole = mem_crc32c(data, 1000, 0);
+    assert(mem_crc32c(data + 333, 667, mem_crc32c(data, 333, 0)) == whole);
+    assert(mem_crc32c(data + 1, 999, mem_crc32c(data, 1, 0)) == whole);
+}
+
+void test_vec_io_fd() {
+    size_t size = 100000;
+    Vec(Record) records = vec_new(Record, .cap = size);
+    for (size_t i = 0; i < size; i++) {
+        vec_push_back(records, ((Record) { .id = (int) i, .score = i * 0.5, .tag = "abc" }));
+    }
+
+    int fd = tmp_fd();
+    assert(vec_write_fd(records, fd));
+    assert(lseek(fd, 0, SEEK_CUR) == (off_t) (32 + size * sizeof(Record)));
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    Vec(Record) read_back = vec_read_fd(fd, Record, .cap = size + 10);
+    assert(read_back != NULL);
+    assert(vec_size(read_back) == size);
+    assert(vec_capacity(read_back) == size + 10);
+    assert(memcmp(read_back, records, size * sizeof(Record)) == 0);
+    vec_free(read_back);
+
+    // Wrong element size.
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    errno = 0;
+    assert(vec_read_fd(fd, int) == NULL && errno == EINVAL);
+
+    // Corrupted element.
+    char byte = 'x';
+    assert(pwrite(fd, &byte, 1, 32 + 5 * sizeof(Record) + 1) == 1);
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    errno = 0;
+    assert(vec_read_fd(fd, Record) == NULL && errno == EBADMSG);
+
+    // Truncated file.
+    assert(ftruncate(fd, 32 + 10 * sizeof(Record)) == 0);
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    errno = 0;
+    assert(vec_read_fd(fd, Record) == NULL && errno == EBADMSG);
+    close(fd);
+
+    // Through a pipe, for a vector small enough for its buffer.
+    int fds[2];
+    assert(pipe(fds) == 0);
+    Vec(int) small = vec_from_array(((int[]) {4, 8, 15, 16, 23, 42}), 6);
+    assert(vec_write_fd(small, fds[1]));
+    Vec(int) empty = vec_new(int);
+    assert(vec_write_fd(empty, fds[1]));
+    close(fds[1]);
+    Vec(int) small_back = vec_read_fd(fds[0], int);
+    assert(vec_size(small_back) == 6 && small_back[5] == 42);
+    Vec(int) empty_back = vec_read_fd(fds[0], int);
+    assert(empty_back != NULL && vec_size(empty_back) == 0);
+    errno = 0;
+    assert(vec_read_fd(fds[0], int) == NULL && errno == EBADMSG);
+    close(fds[0]);
+
+    vec_free(small);
+    vec_free(small_back);
+    vec_free(empty);
+    vec_free(empty_back);
+    vec_free(records);
+}
+
+void test_vec_io_file() {
+    FILE *file = tmpfile();
+    assert(file != NULL);
+    Vec(double) doubles = vec_from_array(((double[]) {1.5, -2.25, 1e300}), 3);
+    Vec(char) chars = vec_from_array("hello", 5);
+    assert(vec_write_file(doubles, file));
+    assert(vec_write_file(chars, file));
+    rewind(file);
+
+    Vec(double) doubles_back = vec_read_file(file, double);
+    Vec(char) chars_back = vec_read_file(file, char);
+    assert(vec_size(doubles_back) == 3 && doubles_back[2] == 1e300);
+    assert(vec_size(chars_back) == 5 && memcmp(chars_back, "hello", 5) == 0);
+    errno = 0;
+    assert(vec_read_file(file, char) == NULL && errno == EBADMSG);
+
+    // A header longer than 32 bytes is skipped, here the elements start at
+    // offset 4096.
+    int fd = tmp_fd();
+    struct {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t flags;
+        uint32_t header_size;
+        uint32_t checksum;
+        uint64_t elem_size;
+        uint64_t count;
+    } header = { VEC_IO_MAGIC, VEC_IO_VERSION, 0, 4096, 0, sizeof(double), 3 };
+    assert(pwrite(fd, &header, sizeof(header), 0) == sizeof(header));
+    assert(pwrite(fd, doubles, 3 * sizeof(double), 4096) == 3 * sizeof(double));
+    Vec(double) padded = vec_read_fd(fd, double);
+    assert(padded != NULL && vec_size(padded) == 3 && padded[1] == -2.25);
+    FILE *padded_file = fdopen(fd, "rb");
+    rewind(padded_file);
+    Vec(double) padded_back = vec_read_file(padded_file, double);
+    assert(padded_back != NULL && memcmp(padded_back, doubles, 3 * sizeof(double)) == 0);
+    fclose(padded_file);
+
+    fclose(file);
+    vec_free(doubles);
+    vec_free(chars);
+    vec_free(doubles_back);
+    vec_free(chars_back);
+    vec_free(padded);
+    vec_free(padded_back);
+}
+
+void test_vec_mmap() {
+    char path[] = "/tmp/vec_mmap_test_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    // A new file grows through the mapping.
+    Vec(int) vec = vec_mmap(path, int, VEC_MMAP_READ_WRITE);
+    assert(vec != NULL && vec_size(vec) == 0);
+    for (int i = 0; i < 100000; i++) {
+        vec_push_back(vec, i * 3);
+    }
+    assert(vec_size(vec) == 100000 && vec[99999] == 299997);
+    vec[0] = -1;
+    assert(vec_mmap_sync(vec));
+    vec_free(vec);
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    assert(st.st_size == VEC_MMAP_HEADER_SIZE + 100000 * sizeof(int));
+
+    // Mapped read-only it works like any vector.
+    vec = vec_mmap(path, int, VEC_MMAP_READ_ONLY);
+    assert(vec != NULL && vec_size(vec) == 100000);
+    assert(vec[0] == -1 && vec[500] == 1500);
+    Iterator it = vec_iter(vec);
+    long long total = 0;
+    for (Option o = iter_next(it); o.is_valid; o = iter_next(it)) {
+        total += *(int *) o.value;
+    }
+    assert(total == 3LL * 99999 * 100000 / 2 - 1);
+    Vec(int) clone = vec_clone(vec);
+    vec_free(vec);
+    assert(clone[1] == 3);
+    vec_free(clone);
+
+    // Files of mapped vectors are vector files, and are checked the same.
+    fd = open(path, O_RDONLY);
+    Vec(int) read_back = vec_read_fd(fd, int);
+    close(fd);
+    assert(read_back != NULL && vec_size(read_back) == 100000 && read_back[7] == 21);
+    vec_free(read_back);
+    errno = 0;
+    assert(vec_mmap(path, double, VEC_MMAP_READ_ONLY) == NULL && errno == EINVAL);
+
+    // Shrinking and erasing write through to the file.
+    vec = vec_mmap(path, int, VEC_MMAP_READ_WRITE);
+    int erased;
+    vec_erase(vec, 0, &erased);
+    assert(erased == -1 && vec[0] == 3);
+    vec_clear(vec);
+    vec_push_back(vec, 7);
+    vec = vec_shrink(vec);
+    assert(vec_capacity(vec) == 1);
+    vec_free(vec);
+    vec = vec_mmap(path, int, VEC_MMAP_READ_ONLY);
+    assert(vec_size(vec) == 1 && vec[0] == 7);
+    vec_free(vec);
+
+    // Only one read-write mapping at a time, readers share its elements
+    // but keep their own size.
+    vec = vec_mmap(path, int, VEC_MMAP_READ_WRITE);
+    errno = 0;
+    assert(vec_mmap(path, int, VEC_MMAP_READ_WRITE) == NULL && errno == EWOULDBLOCK);
+    Vec(int) reader = vec_mmap(path, int, VEC_MMAP_READ_ONLY);
+    assert(reader != NULL && vec_size(reader) == 1);
+    vec[0] = 8;
+    for (int i = 0; i < 1000; i++) {
+        vec_push_back(vec, i);
+    }
+    vec[0] = 9;
+    assert(vec_size(reader) == 1 && vec_capacity(reader) == 1 && reader[0] == 9);
+    assert(vec_size(vec) == 1001 && vec[1000] == 999);
+    vec_free(reader);
+    vec_free(vec);
+    vec = vec_mmap(path, int, VEC_MMAP_READ_WRITE);
+    assert(vec != NULL && vec_size(vec) == 1001 && vec[0] == 9 && vec[1] == 0);
+    vec_free(vec);
+
+    unlink(path);
+    errno = 0;
+    assert(vec_mmap(path, int, VEC_MMAP_READ_ONLY) == NULL && errno == ENOENT);
+}
+
+int main() {
+    test_mem_crc32c();
+    test_vec_io_fd();
+    test_vec_io_file();
+    test_vec_mmap();
+    return 0;
+}
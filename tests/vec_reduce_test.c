@@ -0,0 +1,141 @@
+#include <assert.h>
+#include <math.h>
+
+#include "../vec_reduce.h"
+#include "../vector.h"
+
+void test_vec_reduce_i32() {
+    int32_t *ints = vec_new(int32_t);
+    assert(vec_sum_i32(ints) == 0);
+    assert(vec_min_i32(ints) == INT32_MAX);
+    assert(vec_max_i32(ints) == INT32_MIN);
+
+    int64_t expected = 0;
+    for (int32_t i = 0; i < 1003; i++) {
+        int32_t value = (i % 2 == 0) ? INT32_MAX - i : -i;
+        vec_push_back(ints, value);
+        expected += value;
+    }
+    assert(vec_sum_i32(ints) == expected);
+    assert(vec_max_i32(ints) == INT32_MAX);
+    assert(vec_min_i32(ints) == -1001);
+    ints[1002] = INT32_MIN;
+    assert(vec_min_i32(ints) == INT32_MIN);
+    assert(mem_min_i32(ints, 3) == -1);
+    assert(mem_max_i32(ints + 1, 1) == -1);
+    vec_free(ints);
+}
+
+void test_vec_reduce_scan_i32() {
+    int32_t *ints = vec_new(int32_t);
+    for (int32_t i = 0; i < 45; i++) {
+        vec_push_back(ints, i * 1000003);
+    }
+    int32_t *inclusive = vec_new(int32_t, .cap = vec_size(ints));
+    int32_t *exclusive = vec_new(int32_t, .cap = vec_size(ints));
+    for (size_t i = 0; i < vec_size(ints); i++) {
+        vec_push_back(inclusive, ints[i]);
+        vec_push_back(exclusive, ints[i]);
+    }
+    vec_inclusive_scan_i32(inclusive);
+    vec_exclusive_scan_i32(exclusive);
+
+    uint32_t total = 0;
+    for (size_t i = 0; i < vec_size(ints); i++) {
+        assert(exclusive[i] == (int32_t) total);
+        total += (uint32_t) ints[i];
+        assert(inclusive[i] == (int32_t) total);
+    }
+
+    // Scanning a clone leaves the vector it was cloned from as it was.
+    int32_t *clone = vec_clone(ints);
+    vec_inclusive_scan_i32(clone);
+    vec_exclusive_scan_i32(ints);
+    for (size_t i = 0; i < vec_size(ints); i++) {
+        assert(clone[i] == inclusive[i]);
+        assert(ints[i] == exclusive[i]);
+    }
+    vec_free(clone);
+    vec_free(ints);
+    vec_free(inclusive);
+    vec_free(exclusive);
+}
+
+void test_vec_reduce_f64() {
+    double *doubles = vec_new(double);
+    assert(vec_sum_f64(doubles) == 0.0);
+    assert(isnan(vec_mean_f64(doubles)));
+    assert(isnan(vec_variance_f64(doubles)));
+    assert(vec_min_f64(doubles) == INFINITY);
+    assert(vec_max_f64(doubles) == -INFINITY);
+
+    for (int i = 1; i <= 1001; i++) {
+        vec_push_back(doubles, i * 0.5);
+    }
+    assert(vec_sum_f64(doubles) == 1001.0 * 1002.0 / 4.0);
+    assert(vec_mean_f64(doubles) == 250.5);
+    double variance = 0.25 * (1001.0 * 1001.0 - 1.0) / 12.0;
+    assert(fabs(vec_variance_f64(doubles) - variance) < 1e-9 * variance);
+    assert(vec_min_f64(doubles) == 0.5);
+    assert(vec_max_f64(doubles) == 500.5);
+
+    doubles[0] = NAN;
+    doubles[1000] = NAN;
+    assert(vec_min_f64(doubles) == 1.0);
+    assert(vec_max_f64(doubles) == 500.0);
+    vec_free(doubles);
+
+    // The rounding error of a naive loop grows with the number of terms.
+    double *tenths = vec_new(double);
+    double naive = 0.0;
+    long double exact = 0.0L;
+    for (int i = 0; i < 1 << 20; i++) {
+        vec_push_back(tenths, 0.1);
+        naive += 0.1;
+        exact += 0.1L;
+    }
+    double pairwise_error = fabsl(vec_sum_f64(tenths) - exact);
+    assert(pairwise_error < fabsl(naive - exact) / 100);
+    vec_free(tenths);
+}
+
+void test_vec_reduce_scan_f64() {
+    double *doubles = vec_new(double);
+    double *copy = vec_new(double);
+    for (int i = 0; i < 37; i++) {
+        vec_push_back(doubles, 0.1 * i);
+        vec_push_back(copy, 0.1 * i);
+    }
+    double *exclusive = vec_new(double, .cap = vec_size(doubles));
+    for (size_t i = 0; i < vec_size(doubles); i++) {
+        vec_push_back(exclusive, doubles[i]);
+    }
+    vec_inclusive_scan_f64(doubles);
+    vec_exclusive_scan_f64(exclusive);
+
+    double total = 0.0;
+    for (size_t i = 0; i < vec_size(copy); i++) {
+        assert(exclusive[i] == total);
+        total += copy[i];
+        assert(doubles[i] == total);
+    }
+
+    double *clone = vec_clone(copy);
+    vec_exclusive_scan_f64(clone);
+    for (size_t i = 0; i < vec_size(copy); i++) {
+        assert(clone[i] == exclusive[i]);
+        assert(copy[i] == 0.1 * (int) i);
+    }
+    vec_free(clone);
+    vec_free(doubles);
+    vec_free(copy);
+    vec_free(exclusive);
+}
+
+int main() {
+    test_vec_reduce_i32();
+    test_vec_reduce_scan_i32();
+    test_vec_reduce_f64();
+    test_vec_reduce_scan_f64();
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <assert.h>
+#include <math.h>
+
+#include "../vec_search.h"
+#include "../vector.h"
+
+void test_vec_search_find() {
+    uint8_t *bytes = vec_new(uint8_t);
+    for (int i = 0; i < 100; i++) {
+        vec_push_back(bytes, 7);
+    }
+    assert(mem_find_eq_u8(bytes, vec_size(bytes), 9) == vec_size(bytes));
+    assert(!vec_any_eq_u8(bytes, 9));
+    assert(vec_all_eq_u8(bytes, 7));
+
+    // Matches in the vector body and in the scalar tail.
+    for (size_t index = 0; index < vec_size(bytes); index += 13) {
+        bytes[index] = 9;
+        Option found = vec_find_eq_u8(bytes, 9);
+        assert(found.is_valid && found.value == &bytes[index]);
+        assert(mem_find_ne_u8(bytes, vec_size(bytes), 7) == index);
+        assert(!vec_all_eq_u8(bytes, 7));
+        bytes[index] = 7;
+    }
+    vec_free(bytes);
+
+    int32_t *ints = vec_new(int32_t);
+    assert(!vec_find_eq_i32(ints, 0).is_valid);
+    assert(vec_all_eq_i32(ints, 0));
+    for (int32_t i = 0; i < 37; i++) {
+        vec_push_back(ints, i);
+    }
+    for (int32_t i = 0; i < 37; i++) {
+        Option found = vec_find_eq_i32(ints, i);
+        assert(found.is_valid && *(int32_t *) found.value == i);
+        assert(vec_any_eq_i32(ints, i));
+    }
+    assert(!vec_any_eq_i32(ints, -1));
+    assert(mem_find_ne_i32(ints, vec_size(ints), 0) == 1);
+    vec_free(ints);
+}
+
+void test_vec_search_count() {
+    int32_t *ints = vec_new(int32_t);
+    for (int32_t i = 0; i < 1001; i++) {
+        vec_push_back(ints, i % 10 - 5);
+    }
+    size_t expected_eq = 0;
+    size_t expected_lt = 0;
+    for (size_t i = 0; i < vec_size(ints); i++) {
+        expected_eq += ints[i] == 3;
+        expected_lt += ints[i] < 3;
+    }
+    assert(vec_count_eq_i32(ints, 3) == expected_eq);
+    assert(vec_count_if_lt_i32(ints, 3) == expected_lt);
+    assert(vec_count_if_lt_i32(ints, INT32_MIN) == 0);
+    assert(mem_count_lt_i32(ints, 3, 100) == 3);
+    vec_free(ints);
+
+    double *doubles = vec_new(double);
+    for (int i = 0; i < 103; i++) {
+        vec_push_back(doubles, i * 0.5);
+    }
+    assert(vec_count_if_lt_f64(doubles, 10.0) == 20);
+    doubles[0] = NAN;
+    doubles[102] = NAN;
+    assert(vec_count_if_lt_f64(doubles, INFINITY) == 101);
+    assert(vec_count_if_lt_f64(doubles, NAN) == 0);
+    vec_free(doubles);
+}
+
+int main() {
+    test_vec_search_find();
+    test_vec_search_count();
+    return 0;
+}
@@ -491,6 +491,190 @@ void test_vector_sort() {
     vec_free(vec6);
 }
 
+void test_vector_heap() {
+    Vec(int) vec = vec_from_array(((int[]) {5, 2, 9, 1, 7, 3, 8, 6, 4, 0}), 10);
+    vec_heapify(vec, (compare_fn) int_compare);
+    assert(vec[0] == 0);
+
+    vec_heap_push(vec, -1, (compare_fn) int_compare);
+    vec_heap_push(vec, 11, (compare_fn) int_compare);
+    assert(vec_size(vec) == 12);
+    assert(vec[0] == -1);
+
+    int popped;
+    for (int i = -1; i < 10; i++) {
+        vec_heap_pop(vec, &popped, (compare_fn) int_compare);
+        assert(popped == i);
+    }
+    vec_heap_pop(vec, &popped, (compare_fn) int_compare);
+    assert(popped == 11);
+    assert(vec_is_empty(vec));
+    vec_free(vec);
+}
+
+void test_vector_heap_4_ary() {
+    Vec(int) vec = vec_new(int);
+    for (int i = 0; i < 100; i++) {
+        vec_heap_push(vec, (i * 37) % 100, (compare_fn) int_compare, .arity = 4);
+    }
+    assert(vec_size(vec) == 100);
+
+    int popped;
+    for (int i = 0; i < 100; i++) {
+        vec_heap_pop(vec, &popped, (compare_fn) int_compare, .arity = 4);
+        assert(popped == i);
+    }
+
+    vec_extend(vec, ((int[]) {4, 4, 1, 3, 2, 0}), 6);
+    vec_heapify(vec, (compare_fn) int_compare, .arity = 4);
+    vec_heap_pop(vec, &popped, (compare_fn) int_compare, .arity = 4);
+    assert(popped == 0);
+    vec_heap_pop(vec, NULL, (compare_fn) int_compare, .arity = 4);
+    assert(vec[0] == 2);
+    assert(vec_size(vec) == 4);
+    vec_free(vec);
+}
+
+void test_vector_view() {
+    Vec(int) vec = vec_from_array(((int[]) {9, 8, 7, 6, 5, 4, 3, 2, 1, 0}), 10);
+
+    View view = vec_view(vec, .start = 2, .end = 7);
+    assert(view.size == 5);
+    assert(view.elem_size == sizeof(int));
+    assert(view.data == &vec[2]);
+    assert(*view_at(view, int, 0) == 7);
+
+    view_sort(view, (compare_fn) int_compare);
+    assert(vec[0] == 9);
+    assert(vec[1] == 8);
+    for (int i = 2; i < 7; i++) {
+        assert(vec[i] == i + 1);
+    }
+    assert(vec[7] == 2);
+
+    int key = 5;
+    assert(option_unwrap(view_binary_search(view, &key, (compare_fn) int_compare), int) == 5);
+    key = 42;
+    assert(!view_binary_search(view, &key, (compare_fn) int_compare).is_valid);
+
+    View sub = view_subview(view, 1, 3);
+    view_reverse(sub);
+    assert(vec[3] == 5);
+    assert(vec[4] == 4);
+
+    Iterator it = view_iter(&sub);
+    assert(option_unwrap(iter_next(it), int) == 5);
+    assert(option_unwrap(iter_next(it), int) == 4);
+    assert(!iter_next(it).is_valid);
+
+    View all = vec_view(vec);
+    assert(all.size == 10);
+    view_reverse(view_subview(all, 0, 0));
+    vec_free(vec);
+}
+
+void test_vector_clone() {
+    Vec(int) vec = vec_from_array(((int[]) {3, 1, 2}), 3);
+    assert(!vec_is_shared(vec));
+
+    Vec(int) clone = vec_clone(vec);
+    assert(clone == vec);
+    assert(vec_is_shared(vec));
+    assert(vec_is_shared(clone));
+
+    // The first modification copies, the original is left untouched.
+    vec_push_back(clone, 4);
+    assert(clone != vec);
+    assert(!vec_is_shared(vec));
+    assert(!vec_is_shared(clone));
+    assert(vec_size(vec) == 3);
+    assert(vec_size(clone) == 4);
+    assert(clone[3] == 4);
+
+    Vec(int) sorted = vec_clone(vec);
+    vec_sort(sorted, (compare_fn) int_compare);
+    assert(sorted[0] == 1 && sorted[1] == 2 && sorted[2] == 3);
+    assert(vec[0] == 3 && vec[1] == 1 && vec[2] == 2);
+
+    Vec(int) erased = vec_clone(vec);
+    int value = 0;
+    vec_erase(erased, 0, &value);
+    assert(value == 3);
+    assert(vec_size(erased) == 2);
+    assert(vec_size(vec) == 3);
+
+    Vec(int) cleared = vec_clone(vec);
+    vec_clear(cleared);
+    assert(vec_size(cleared) == 0);
+    assert(vec_capacity(cleared) == vec_capacity(vec));
+    assert(vec_size(vec) == 3);
+
+    // Direct writes need the vector to be made unique first.
+    Vec(int) written = vec_clone(vec);
+    vec_make_unique(written);
+    written[0] = 42;
+    assert(vec[0] == 3);
+
+    // Freeing one reference keeps the elements alive for the other.
+    Vec(int) last = vec_clone(vec);
+    vec_free(vec);
+    assert(!vec_is_shared(last));
+    assert(last[0] == 3);
+
+    vec_free(clone);
+    vec_free(sorted);
+    vec_free(erased);
+    vec_free(cleared);
+    vec_free(written);
+    vec_free(last);
+}
+
+void test_vector_iter_reverse() {
+    Vec(int) vec = vec_from_array(((int[]) {0, 1, 2, 3, 4}), 5);
+    Iterator it = vec_iter(vec);
+    for (int i = 4; i >= 0; i--) {
+        assert(option_unwrap(iter_next_back(it), int) == i);
+    }
+    assert(!iter_next_back(it).is_valid);
+
+    it = vec_iter(vec);
+    assert(option_unwrap(iter_next_back(it), int) == 4);
+    assert(option_unwrap(iter_next(it), int) == 0);
+    assert(option_unwrap(iter_get(it, 2), int) == 3);
+    assert(!iter_get(it, 3).is_valid);
+    assert(iter_size_hint(it).lower == 3);
+    assert(option_unwrap(iter_advance(it, 2), int) == 1);
+    assert(option_unwrap(iter_next(it), int) == 3);
+    assert(!iter_next(it).is_valid);
+    assert(!iter_next_back(it).is_valid);
+    vec_free(vec);
+}
+
+void test_vector_iter_collect() {
+    Vec(int) vec = vec_from_array(((int[]) {1, 2, 3, 4, 5}), 5);
+    Iterator it = vec_iter(vec);
+    iter_next(it);
+
+    Vec(int) collected = iter_collect(&it, int);
+    assert(vec_size(collected) == 4);
+    assert(vec_capacity(collected) == 4);
+    for (int i = 0; i < 4; i++) {
+        assert(collected[i] == i + 2);
+    }
+    assert(!iter_next(it).is_valid);
+
+    View view = vec_view(vec, .end = 2);
+    it = view_iter(&view);
+    Vec(int) from_view = iter_collect(&it, int, .cap = 8);
+    assert(vec_size(from_view) == 2);
+    assert(vec_capacity(from_view) == 8);
+    assert(from_view[0] == 1 && from_view[1] == 2);
+
+    vec_free(vec);
+    vec_free(collected);
+    vec_free(from_view);
+}
+
 int main() {
     test_vector_basic();
     test_vector_with_capacity();
@@ -508,5 +692,11 @@ int main() {
     test_vector_person_struct_array();
     test_2d_vector_person_struct();
     test_vector_sort();
+    test_vector_heap();
+    test_vector_heap_4_ary();
+    test_vector_view();
+    test_vector_clone();
+    test_vector_iter_reverse();
+    test_vector_iter_collect();
     return 0;
 }
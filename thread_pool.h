@@ -0,0 +1,197 @@
+/**
+ * @file thread_pool.h
+ * @brief Definition and functions for a work-stealing thread pool.
+ * @note Every worker owns a Chase-Lev deque: it pushes and pops tasks at
+ * the bottom, idle workers steal from the top of the others. Tasks
+ * spawned from outside the pool go through a shared injector queue.
+ * Threads waiting for a scope run pending tasks instead of blocking.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+/**
+ * @brief Function pointer type for task functions.
+ * @param arg The argument of the task.
+ */
+typedef void (*task_fn)(void *arg);
+
+/**
+ * @brief Opaque type of a thread pool.
+ */
+typedef struct thread_pool ThreadPool;
+
+/**
+ * @struct TaskScope
+ * @brief A group of tasks that can be waited for.
+ */
+typedef struct {
+    /** The pool the tasks run on */
+    ThreadPool *pool;
+
+    /** The number of spawned tasks that have not finished yet */
+    atomic_size_t pending;
+} TaskScope;
+
+/**
+ * @struct Task
+ * @brief A unit of work, its storage is provided by the caller and must
+ * stay valid until the scope it was spawned in has been waited for.
+ */
+typedef struct task {
+    /** The function of the task */
+    task_fn func;
+
+    /** The argument passed to `func` */
+    void *arg;
+
+    /** The scope the task was spawned in, set when it is spawned */
+    TaskScope *scope;
+
+    /** Link of the injector queue, for internal use */
+    struct task *next;
+} Task;
+
+/**
+ * @struct ThreadPoolArgs
+ * @brief Optional args for creating a thread pool.
+ */
+typedef struct {
+    /** The number of worker threads, 0 for one less than the online CPUs
+     * (at least 1), since waiting threads run tasks too */
+    size_t nthreads;
+
+    /** The allocator used for the pool and its deques */
+    Allocator alloc;
+} ThreadPoolArgs;
+
+/**
+ * @struct ThreadPoolStats
+ * @brief Counters of a thread pool, summed over its workers.
+ */
+typedef struct {
+    /** The number of tasks run by the workers */
+    size_t executed;
+
+    /** The number of tasks a worker took from another worker's deque */
+    size_t steals;
+
+    /** The number of steal attempts that lost a race for a task */
+    size_t failed_steals;
+
+    /** The total time the workers spent without a task, in nanoseconds */
+    uint64_t idle_ns;
+} ThreadPoolStats;
+
+/**
+ * @brief Creates a new thread pool and starts its workers.
+ * @param pool_args Optional args, see `ThreadPoolArgs` for more info.
+ * @return The created thread pool.
+ * @note `pool_args` defaults to
+ * `(ThreadPoolArgs) { .nthreads = 0, .alloc = allocator_new() }`
+ */
+#define thread_pool_new(...)                                                   \
+    internal_thread_pool_new(                                                  \
+        (ThreadPoolArgs) {                                                     \
+            .nthreads = 0, .alloc = allocator_new(), __VA_ARGS__               \
+        }                                                                      \
+    )
+
+/**
+ * @brief Stops the workers of a thread pool and frees it.
+ * @param pool The thread pool, no scope of it may have pending tasks.
+ */
+void thread_pool_free(ThreadPool *pool);
+
+/**
+ * @brief Returns the pool shared by the whole process.
+ * @return The shared thread pool.
+ * @note It is created with the default args on the first call and freed
+ * at exit. Library code should use it rather than creating its own
+ * threads, so the cores are not oversubscribed.
+ */
+ThreadPool *thread_pool_global(void);
+
+/**
+ * @brief Returns the number of worker threads of a pool.
+ * @param pool The thread pool.
+ * @return The number of workers.
+ */
+size_t thread_pool_size(const ThreadPool *pool);
+
+/**
+ * @brief Returns the counters of a pool.
+ * @param pool The thread pool.
+ * @return The counters, see `ThreadPoolStats` for more info.
+ * @note The counters are read while the workers run, so they are only
+ * exact once the pool is quiet.
+ */
+ThreadPoolStats thread_pool_stats(const ThreadPool *pool);
+
+/**
+ * @brief Creates an empty scope on a pool.
+ * @param pool The thread pool.
+ * @return The scope.
+ */
+TaskScope thread_pool_scope(ThreadPool *pool);
+
+/**
+ * @brief Spawns a task in a scope.
+ * @param scope Pointer to the scope.
+ * @param task Pointer to the task, its `func` and `arg` must be set.
+ * @note Tasks spawned from a worker of the pool go to its own deque, the
+ * others go to the injector queue.
+ */
+void thread_pool_spawn(TaskScope *scope, Task *task);
+
+/**
+ * @brief Spawns an array of tasks in a scope at once.
+ * @param scope Pointer to the scope.
+ * @param tasks The tasks, their `func` and `arg` must be set.
+ * @param count The number of tasks.
+ * @note Publishing and waking the workers happen once for the whole
+ * batch instead of once per task.
+ */
+void thread_pool_spawn_batch(TaskScope *scope, Task *tasks, size_t count);
+
+/**
+ * @brief Waits until all the tasks of a scope have finished, running
+ * pending tasks of the pool in the meantime.
+ * @param scope Pointer to the scope.
+ */
+void thread_pool_wait(TaskScope *scope);
+
+/**
+ * @brief Runs 2 functions, potentially in parallel, and returns once both
+ * have finished.
+ * @param pool The thread pool.
+ * @param func1 The first function, run by the calling thread.
+ * @param arg1 The argument of `func1`.
+ * @param func2 The second function, made available to the other threads.
+ * @param arg2 The argument of `func2`.
+ */
+void thread_pool_join(
+    ThreadPool *pool,
+    task_fn func1,
+    void *arg1,
+    task_fn func2,
+    void *arg2
+);
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to create a new thread pool.
+ * @param args The number of workers and the allocator of the pool.
+ * @return The new thread pool.
+ */
+ThreadPool *internal_thread_pool_new(ThreadPoolArgs args);
+
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,193 @@
+/**
+ * @file vec_io.h
+ * @brief Functions for writing vectors to files and reading them back
+ * without parsing.
+ * @note A file holds a 32 byte header followed by the raw bytes of the
+ * elements. The header stores, in native byte order: the magic
+ * `VEC_IO_MAGIC` (u32), the format version (u16), flags (u16), the size
+ * of the header (u32), the CRC-32C of the elements (u32), the element
+ * size (u64) and the number of elements (u64). Readers skip any header
+ * bytes past the 32 they know, so the elements can start at a later
+ * offset, e.g. a page boundary.
+ * @note Vectors can also be mapped from files with `vec_mmap`, the
+ * elements of these files start at offset `VEC_MMAP_HEADER_SIZE` and they
+ * can be read with `vec_read_fd` too.
+ * @note On errors the functions set `errno`: `EINVAL` for a file that is
+ * not a vector of the requested element size, `EBADMSG` for a truncated
+ * file or a checksum mismatch, the `errno` of the failing call otherwise.
+ */
+
+#ifndef VEC_IO_H
+#define VEC_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "vector.h"
+
+/**
+ * @brief The magic number at the start of a vector file, "CVEC".
+ */
+#define VEC_IO_MAGIC 0x43564543u
+
+/**
+ * @brief The version of the file format written by this library.
+ */
+#define VEC_IO_VERSION 1
+
+/**
+ * @brief Header flag set when the checksum field holds the CRC-32C of the
+ * elements.
+ */
+#define VEC_IO_CHECKSUM 0x1
+
+/**
+ * @brief Computes the CRC-32C (Castagnoli) of a buffer.
+ * @param data The buffer.
+ * @param size The size of the buffer in bytes.
+ * @param crc The CRC of the preceding bytes, 0 for the first buffer.
+ * @return The CRC of the preceding bytes and the buffer.
+ * @note Uses the SSE4.2 crc32 instruction when the CPU supports it.
+ */
+uint32_t mem_crc32c(const void *data, size_t size, uint32_t crc);
+
+/**
+ * @brief Writes a vector to a file descriptor.
+ * @param vector The vector.
+ * @param fd The file descriptor.
+ * @return true on success, false on error.
+ * @note The header and the elements are written with a single `writev`
+ * when the descriptor accepts the whole write.
+ */
+bool vec_write_fd(const void *vector, int fd);
+
+/**
+ * @brief Reads a vector from a file descriptor.
+ * @param fd The file descriptor.
+ * @param elem_type The type of the elements in the vector.
+ * @param vec_args Optional args, see `VecArgs` for more info.
+ * @return The read vector, NULL on error.
+ * @note `vec_args` defaults to `(VecArgs) { .cap = 0, .alloc = allocator_new() }`
+ * @note The vector is allocated once from the header and the elements are
+ * read with a single `read` on regular files.
+ */
+#define vec_read_fd(fd, elem_type, ...)                                        \
+    ((Vec(elem_type)) internal_vec_read_fd(                                    \
+        fd,                                                                    \
+        sizeof(elem_type),                                                     \
+        (VecArgs) { .cap = 0, .alloc = allocator_new(), __VA_ARGS__ }          \
+    ))
+
+/**
+ * @brief Writes a vector to a stream, through its buffer.
+ * @param vector The vector.
+ * @param file The stream.
+ * @return true on success, false on error.
+ * @note Several vectors can be written to the same stream one after
+ * another, it is not flushed.
+ */
+bool vec_write_file(const void *vector, FILE *file);
+
+/**
+ * @brief Reads a vector from a stream, through its buffer.
+ * @param file The stream.
+ * @param elem_type The type of the elements in the vector.
+ * @param vec_args Optional args, see `VecArgs` for more info.
+ * @return The read vector, NULL on error.
+ * @note `vec_args` defaults to `(VecArgs) { .cap = 0, .alloc = allocator_new() }`
+ * @note The stream is left right after the vector, so works on pipes and
+ * on streams holding several vectors.
+ */
+#define vec_read_file(file, elem_type, ...)                                    \
+    ((Vec(elem_type)) internal_vec_read_file(                                  \
+        file,                                                                  \
+        sizeof(elem_type),                                                     \
+        (VecArgs) { .cap = 0, .alloc = allocator_new(), __VA_ARGS__ }          \
+    ))
+
+/**
+ * @brief The size of the header of a mapped vector file, the elements
+ * start right after it.
+ */
+#define VEC_MMAP_HEADER_SIZE 4096
+
+/**
+ * @brief The access modes of a mapped vector.
+ */
+typedef enum {
+    /** The elements can only be read, writing them faults */
+    VEC_MMAP_READ_ONLY,
+
+    /** The elements are read and written in place, the vector can grow */
+    VEC_MMAP_READ_WRITE
+} VecMmapMode;
+
+/**
+ * @brief Maps a vector file into memory.
+ * @param path The path of the file, in read-write mode it is created if
+ * it does not exist or is empty.
+ * @param elem_type The type of the elements in the vector.
+ * @param mode The access mode, see `VecMmapMode` for more info.
+ * @return The vector, NULL on error.
+ * @note The vector works with all the vec_* functions and is freed with
+ * `vec_free`, which updates the header, trims the file to the elements
+ * and unmaps it. Growing a read-write vector extends the file with
+ * `ftruncate` and maps it again, so it may move.
+ * @note Mapped vectors can be cloned, but a clone must not be modified
+ * while it is shared since its elements cannot be copied to the heap.
+ * @note Pages are loaded on first access. The header page, which holds
+ * the size and capacity of the vector, is private to each mapping. The
+ * elements of a read-write mapping are shared with every process mapping
+ * the file, a read-only mapping sees them but keeps its own size.
+ * @note A read-write mapping takes an exclusive `flock` on the file until
+ * it is freed, a second read-write mapping fails with `EWOULDBLOCK`.
+ * Read-write mode needs `VEC_MMAP_HEADER_SIZE` to be a multiple of the
+ * page size and fails with `EINVAL` otherwise. The checksum is not
+ * maintained for mapped files.
+ */
+#define vec_mmap(path, elem_type, mode)                                        \
+    ((Vec(elem_type)) internal_vec_mmap(path, sizeof(elem_type), mode))
+
+/**
+ * @brief Writes the size of a mapped vector to its header and flushes the
+ * mapping to the file.
+ * @param vector The mapped vector.
+ * @return true on success, false on error.
+ * @note `vec_free` updates the header too, this is for making the
+ * elements durable while the vector is in use.
+ */
+bool vec_mmap_sync(void *vector);
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to read a vector from a file descriptor.
+ * @param fd The file descriptor.
+ * @param elem_size The size of an element.
+ * @param args The capacity and allocator of the vector.
+ * @return The read vector, NULL on error.
+ */
+void *internal_vec_read_fd(int fd, size_t elem_size, VecArgs args);
+
+/**
+ * @brief Internal function to read a vector from a stream.
+ * @param file The stream.
+ * @param elem_size The size of an element.
+ * @param args The capacity and allocator of the vector.
+ * @return The read vector, NULL on error.
+ */
+void *internal_vec_read_file(FILE *file, size_t elem_size, VecArgs args);
+
+/**
+ * @brief Internal function to map a vector file into memory.
+ * @param path The path of the file.
+ * @param elem_size The size of an element.
+ * @param mode The access mode.
+ * @return The mapped vector, NULL on error.
+ */
+void *internal_vec_mmap(const char *path, size_t elem_size, VecMmapMode mode);
+
+
+#endif // VEC_IO_H
@@ -0,0 +1,260 @@
+/**
+ * @file vec_reduce.h
+ * @brief Vectorized reductions and prefix scans for vectors of integers
+ * and floats.
+ * @note On x86 the functions use AVX2 when the CPU supports it and SSE2
+ * otherwise, other architectures use a scalar loop. Float sums are
+ * computed pairwise in a fixed order, so they give the same result on
+ * every instruction set.
+ */
+
+#ifndef VEC_REDUCE_H
+#define VEC_REDUCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Sums the elements of an array.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @return The sum of the elements, widened to 64 bits.
+ */
+int64_t mem_sum_i32(const int32_t *data, size_t size);
+
+/**
+ * @brief Finds the smallest element of an array.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @return The smallest element, `INT32_MAX` if the array is empty.
+ */
+int32_t mem_min_i32(const int32_t *data, size_t size);
+
+/**
+ * @brief Finds the largest element of an array.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @return The largest element, `INT32_MIN` if the array is empty.
+ */
+int32_t mem_max_i32(const int32_t *data, size_t size);
+
+/**
+ * @brief Computes the inclusive prefix sums of an array.
+ * @param src The array to scan.
+ * @param dst The array receiving `src[0] + ... + src[i]` at index `i`, may
+ * be equal to `src`.
+ * @param size The number of elements in the arrays.
+ * @note Overflowing sums wrap around.
+ */
+void mem_inclusive_scan_i32(const int32_t *src, int32_t *dst, size_t size);
+
+/**
+ * @brief Computes the exclusive prefix sums of an array.
+ * @param src The array to scan.
+ * @param dst The array receiving `src[0] + ... + src[i - 1]` at index `i`,
+ * may be equal to `src`.
+ * @param size The number of elements in the arrays.
+ * @note Overflowing sums wrap around.
+ */
+void mem_exclusive_scan_i32(const int32_t *src, int32_t *dst, size_t size);
+
+/**
+ * @brief Sums the elements of an array using pairwise summation.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @return The sum of the elements.
+ */
+double mem_sum_f64(const double *data, size_t size);
+
+/**
+ * @brief Finds the smallest element of an array, ignoring NaNs.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @return The smallest element, `INFINITY` if the array is empty or only
+ * holds NaNs.
+ */
+double mem_min_f64(const double *data, size_t size);
+
+/**
+ * @brief Finds the largest element of an array, ignoring NaNs.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @return The largest element, `-INFINITY` if the array is empty or only
+ * holds NaNs.
+ */
+double mem_max_f64(const double *data, size_t size);
+
+/**
+ * @brief Computes the arithmetic mean of an array.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @return The mean of the elements, NaN if the array is empty.
+ */
+double mem_mean_f64(const double *data, size_t size);
+
+/**
+ * @brief Computes the population variance of an array.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @return The variance of the elements, NaN if the array is empty.
+ * @note Uses two passes: the mean first, then the squared deviations from
+ * it, which avoids the cancellation of the sum of squares formula.
+ */
+double mem_variance_f64(const double *data, size_t size);
+
+/**
+ * @brief Computes the inclusive prefix sums of an array.
+ * @param src The array to scan.
+ * @param dst The array receiving `src[0] + ... + src[i]` at index `i`, may
+ * be equal to `src`.
+ * @param size The number of elements in the arrays.
+ * @note The sums are accumulated left to right, so they match a
+ * sequential loop exactly.
+ */
+void mem_inclusive_scan_f64(const double *src, double *dst, size_t size);
+
+/**
+ * @brief Computes the exclusive prefix sums of an array.
+ * @param src The array to scan.
+ * @param dst The array receiving `src[0] + ... + src[i - 1]` at index `i`,
+ * may be equal to `src`.
+ * @param size The number of elements in the arrays.
+ * @note The sums are accumulated left to right, so they match a
+ * sequential loop exactly.
+ */
+void mem_exclusive_scan_f64(const double *src, double *dst, size_t size);
+
+/**
+ * @brief Sums the elements of a vector.
+ * @param vector The vector.
+ * @return The sum of the elements, widened to 64 bits.
+ */
+int64_t vec_sum_i32(const int32_t *vector);
+
+/**
+ * @brief Finds the smallest element of a vector.
+ * @param vector The vector.
+ * @return The smallest element, `INT32_MAX` if the vector is empty.
+ */
+int32_t vec_min_i32(const int32_t *vector);
+
+/**
+ * @brief Finds the largest element of a vector.
+ * @param vector The vector.
+ * @return The largest element, `INT32_MIN` if the vector is empty.
+ */
+int32_t vec_max_i32(const int32_t *vector);
+
+/**
+ * @brief Replaces each element of a vector with the sum of the elements
+ * up to and including it.
+ * @param vector The vector.
+ */
+#define vec_inclusive_scan_i32(vector)                                         \
+    do {                                                                       \
+        vector = internal_vec_inclusive_scan_i32(vector);                      \
+    } while(0)
+
+/**
+ * @brief Replaces each element of a vector with the sum of the elements
+ * before it.
+ * @param vector The vector.
+ */
+#define vec_exclusive_scan_i32(vector)                                         \
+    do {                                                                       \
+        vector = internal_vec_exclusive_scan_i32(vector);                      \
+    } while(0)
+
+/**
+ * @brief Sums the elements of a vector using pairwise summation.
+ * @param vector The vector.
+ * @return The sum of the elements.
+ */
+double vec_sum_f64(const double *vector);
+
+/**
+ * @brief Finds the smallest element of a vector, ignoring NaNs.
+ * @param vector The vector.
+ * @return The smallest element, `INFINITY` if the vector is empty or only
+ * holds NaNs.
+ */
+double vec_min_f64(const double *vector);
+
+/**
+ * @brief Finds the largest element of a vector, ignoring NaNs.
+ * @param vector The vector.
+ * @return The largest element, `-INFINITY` if the vector is empty or only
+ * holds NaNs.
+ */
+double vec_max_f64(const double *vector);
+
+/**
+ * @brief Computes the arithmetic mean of a vector.
+ * @param vector The vector.
+ * @return The mean of the elements, NaN if the vector is empty.
+ */
+double vec_mean_f64(const double *vector);
+
+/**
+ * @brief Computes the population variance of a vector.
+ * @param vector The vector.
+ * @return The variance of the elements, NaN if the vector is empty.
+ */
+double vec_variance_f64(const double *vector);
+
+/**
+ * @brief Replaces each element of a vector with the sum of the elements
+ * up to and including it.
+ * @param vector The vector.
+ */
+#define vec_inclusive_scan_f64(vector)                                         \
+    do {                                                                       \
+        vector = internal_vec_inclusive_scan_f64(vector);                      \
+    } while(0)
+
+/**
+ * @brief Replaces each element of a vector with the sum of the elements
+ * before it.
+ * @param vector The vector.
+ */
+#define vec_exclusive_scan_f64(vector)                                         \
+    do {                                                                       \
+        vector = internal_vec_exclusive_scan_f64(vector);                      \
+    } while(0)
+
+/*------------------------ Internal Helper Functions ------------------------*/
+
+/**
+ * @brief Internal function to replace each element of a vector with the
+ * sum of the elements up to and including it.
+ * @param vector The vector.
+ * @return The vector, it is a new pointer if it was shared.
+ */
+void *internal_vec_inclusive_scan_i32(int32_t *vector);
+
+/**
+ * @brief Internal function to replace each element of a vector with the
+ * sum of the elements before it.
+ * @param vector The vector.
+ * @return The vector, it is a new pointer if it was shared.
+ */
+void *internal_vec_exclusive_scan_i32(int32_t *vector);
+
+/**
+ * @brief Internal function to replace each element of a vector with the
+ * sum of the elements up to and including it.
+ * @param vector The vector.
+ * @return The vector, it is a new pointer if it was shared.
+ */
+void *internal_vec_inclusive_scan_f64(double *vector);
+
+/**
+ * @brief Internal function to replace each element of a vector with the
+ * sum of the elements before it.
+ * @param vector The vector.
+ * @return The vector, it is a new pointer if it was shared.
+ */
+void *internal_vec_exclusive_scan_f64(double *vector);
+
+
+#endif // VEC_REDUCE_H
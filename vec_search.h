@@ -0,0 +1,157 @@
+/**
+ * @file vec_search.h
+ * @brief Vectorized search and count functions for vectors of primitive
+ * elements.
+ * @note On x86 the functions use AVX2 when the CPU supports it and SSE2
+ * otherwise, other architectures use a scalar loop.
+ */
+
+#ifndef VEC_SEARCH_H
+#define VEC_SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "option.h"
+
+/**
+ * @brief Finds the first element of an array equal to a value.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @param value The value to search for.
+ * @return The index of the first match, `size` if there is none.
+ */
+size_t mem_find_eq_u8(const uint8_t *data, size_t size, uint8_t value);
+
+/**
+ * @brief Finds the first element of an array not equal to a value.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @param value The value to skip.
+ * @return The index of the first mismatch, `size` if there is none.
+ */
+size_t mem_find_ne_u8(const uint8_t *data, size_t size, uint8_t value);
+
+/**
+ * @brief Finds the first element of an array equal to a value.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @param value The value to search for.
+ * @return The index of the first match, `size` if there is none.
+ */
+size_t mem_find_eq_i32(const int32_t *data, size_t size, int32_t value);
+
+/**
+ * @brief Finds the first element of an array not equal to a value.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @param value The value to skip.
+ * @return The index of the first mismatch, `size` if there is none.
+ */
+size_t mem_find_ne_i32(const int32_t *data, size_t size, int32_t value);
+
+/**
+ * @brief Counts the elements of an array equal to a value.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @param value The value to count.
+ * @return The number of matching elements.
+ */
+size_t mem_count_eq_i32(const int32_t *data, size_t size, int32_t value);
+
+/**
+ * @brief Counts the elements of an array less than a value.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @param value The value to compare against.
+ * @return The number of elements < `value`.
+ */
+size_t mem_count_lt_i32(const int32_t *data, size_t size, int32_t value);
+
+/**
+ * @brief Counts the elements of an array less than a value.
+ * @param data The array.
+ * @param size The number of elements in the array.
+ * @param value The value to compare against.
+ * @return The number of elements < `value`, NaNs are never counted.
+ */
+size_t mem_count_lt_f64(const double *data, size_t size, double value);
+
+/**
+ * @brief Finds the first element of a vector equal to a value.
+ * @param vector The vector.
+ * @param value The value to search for.
+ * @return An Option holding a pointer to the first match, None if there
+ * is no match.
+ */
+Option vec_find_eq_u8(uint8_t *vector, uint8_t value);
+
+/**
+ * @brief Finds the first element of a vector equal to a value.
+ * @param vector The vector.
+ * @param value The value to search for.
+ * @return An Option holding a pointer to the first match, None if there
+ * is no match.
+ */
+Option vec_find_eq_i32(int32_t *vector, int32_t value);
+
+/**
+ * @brief Checks if any element of a vector is equal to a value.
+ * @param vector The vector.
+ * @param value The value to search for.
+ * @return `true` if an element is equal to `value`, `false` otherwise.
+ */
+bool vec_any_eq_u8(const uint8_t *vector, uint8_t value);
+
+/**
+ * @brief Checks if any element of a vector is equal to a value.
+ * @param vector The vector.
+ * @param value The value to search for.
+ * @return `true` if an element is equal to `value`, `false` otherwise.
+ */
+bool vec_any_eq_i32(const int32_t *vector, int32_t value);
+
+/**
+ * @brief Checks if every element of a vector is equal to a value.
+ * @param vector The vector.
+ * @param value The value to compare against.
+ * @return `true` if all elements are equal to `value` (or the vector is
+ * empty), `false` otherwise.
+ */
+bool vec_all_eq_u8(const uint8_t *vector, uint8_t value);
+
+/**
+ * @brief Checks if every element of a vector is equal to a value.
+ * @param vector The vector.
+ * @param value The value to compare against.
+ * @return `true` if all elements are equal to `value` (or the vector is
+ * empty), `false` otherwise.
+ */
+bool vec_all_eq_i32(const int32_t *vector, int32_t value);
+
+/**
+ * @brief Counts the elements of a vector equal to a value.
+ * @param vector The vector.
+ * @param value The value to count.
+ * @return The number of matching elements.
+ */
+size_t vec_count_eq_i32(const int32_t *vector, int32_t value);
+
+/**
+ * @brief Counts the elements of a vector less than a value.
+ * @param vector The vector.
+ * @param value The value to compare against.
+ * @return The number of elements < `value`.
+ */
+size_t vec_count_if_lt_i32(const int32_t *vector, int32_t value);
+
+/**
+ * @brief Counts the elements of a vector less than a value.
+ * @param vector The vector.
+ * @param value The value to compare against.
+ * @return The number of elements < `value`, NaNs are never counted.
+ */
+size_t vec_count_if_lt_f64(const double *vector, double value);
+
+
+#endif // VEC_SEARCH_H
@@ -11,6 +11,7 @@
 
 #include "allocator.h"
 #include "iterator.h"
+#include "view.h"
 
 /**
  * @brief Macro to define a vector type with the specified element type.
@@ -60,6 +61,24 @@
         sizeof(array[0]) * size                                                \
     )
 
+/**
+ * @brief Creates a new vector from the elements left in an iterator.
+ * @param iterator A pointer to the iterator, it is exhausted afterwards.
+ * @param elem_type The type of the elements of the iterator.
+ * @param vec_args Optional args, see `VecArgs` for more info.
+ * @return The created vector.
+ * @note `vec_args` defaults to `(VecArgs) { .cap = 0, .alloc = allocator_new() }`
+ * @note The capacity is preallocated from the iterator's size hint and
+ * blocks from `next_chunk` are copied in bulk.
+ * @note Elements are shallow copied from the iterator.
+ */
+#define iter_collect(iterator, elem_type, ...)                                 \
+    internal_iter_collect(                                                     \
+        iterator,                                                              \
+        sizeof(elem_type),                                                     \
+        (VecArgs) { .cap = 0, .alloc = allocator_new(), __VA_ARGS__ }          \
+    )
+
 /**
  * @brief Creates a slice of the vector.
  * @param vector The vector.
@@ -80,6 +99,21 @@
         (VecSliceArgs) { .start = 0, .end = vec_size(vector), __VA_ARGS__ }    \
     )
 
+/**
+ * @brief Creates a view of a range of the vector without copying it.
+ * @param vector The vector.
+ * @param vec_slice_args Optional args, see `VecSliceArgs` for more info.
+ * @return The view.
+ * @note Defaults to `(VecSliceArgs) { .start = 0, .end = vec_size(vector) }`
+ * @note `vec_slice_args.start` is inclusive, however `.end` is exclusive.
+ * @note The view is invalidated when the vector is resized or freed.
+ */
+#define vec_view(vector, ...)                                                  \
+    internal_vec_view(                                                         \
+        vector,                                                                \
+        (VecSliceArgs) { .start = 0, .end = vec_size(vector), __VA_ARGS__ }    \
+    )
+
 /**
  * @brief Inserts an element into the vector at the specified index.
  * @param vector The vector.
@@ -118,6 +152,67 @@
         vector = internal_vec_extend(vector, _a, size);                        \
     } while (0)
 
+/**
+ * @brief Rearranges the elements of the vector into a heap.
+ * @param vector The vector.
+ * @param compare The comparison function used to order the heap.
+ * @param vec_heap_args Optional args, see `VecHeapArgs` for more info.
+ * @note Defaults to `(VecHeapArgs) { .arity = 2 }`
+ * @note The heap is a min heap with respect to `compare`, this means that
+ * `vector[0]` is always the smallest element. Supply a reversed comparison
+ * function to get a max heap.
+ * @note The same `compare` and `vec_heap_args` must be used for all heap
+ * operations on the vector.
+ */
+#define vec_heapify(vector, compare, ...)                                      \
+    do {                                                                       \
+        vector = internal_vec_heapify(                                         \
+            vector,                                                            \
+            compare,                                                           \
+            (VecHeapArgs) { .arity = 2, __VA_ARGS__ }                          \
+        );                                                                     \
+    } while(0)
+
+/**
+ * @brief Pushes an element onto a heap stored in the vector.
+ * @param vector The vector, must already be a heap.
+ * @param elem The element to push.
+ * @param compare The comparison function used to order the heap.
+ * @param vec_heap_args Optional args, see `VecHeapArgs` for more info.
+ * @note Defaults to `(VecHeapArgs) { .arity = 2 }`
+ * @note elem is shallow copied.
+ */
+#define vec_heap_push(vector, elem, compare, ...)                              \
+    do {                                                                       \
+        typeof(*vector) _e = elem;                                             \
+        vector = internal_vec_heap_push(                                       \
+            vector,                                                            \
+            &_e,                                                               \
+            compare,                                                           \
+            (VecHeapArgs) { .arity = 2, __VA_ARGS__ }                          \
+        );                                                                     \
+    } while(0)
+
+/**
+ * @brief Removes the smallest element from a heap stored in the vector.
+ * @param vector The vector, must already be a non empty heap.
+ * @param elem A pointer to store the removed element.
+ * @param compare The comparison function used to order the heap.
+ * @param vec_heap_args Optional args, see `VecHeapArgs` for more info.
+ * @note Defaults to `(VecHeapArgs) { .arity = 2 }`
+ * @note Supply NULL for `elem` if you don't care about the removed value.
+ * @note The capacity of vector remains the same (i.e. free is not called).
+ */
+#define vec_heap_pop(vector, elem, compare, ...)                               \
+    do {                                                                       \
+        vector = internal_vec_heap_pop(                                        \
+            vector,                                                            \
+            elem,                                                              \
+            compare,                                                           \
+            (VecHeapArgs) { .arity = 2, __VA_ARGS__ }                          \
+        );                                                                     \
+    } while(0)
+
 /**
  * @brief Returns the number of elements in the vector.
  * @param vector The vector.
@@ -132,6 +227,13 @@ size_t vec_size(const void *vector);
  */
 size_t vec_capacity(const void *vector);
 
+/**
+ * @brief Returns the size of an element of the vector.
+ * @param vector The vector.
+ * @return The size of an element in bytes.
+ */
+size_t vec_elem_size(const void *vector);
+
 /**
  * @brief Checks if the vector is empty.
  * @param vector The vector.
@@ -149,7 +251,10 @@ bool vec_is_empty(const void *vector);
  * @note vec_swap_erase is a faster alternative to this function, but it does
  * not maintain the order of the vector.
  */
-void vec_erase(void *vector, size_t index, void *elem);
+#define vec_erase(vector, index, elem)                                         \
+    do {                                                                       \
+        vector = internal_vec_erase(vector, index, elem);                      \
+    } while(0)
 
 /**
  * @brief Erases by swapping the element at the specified index with the
@@ -160,7 +265,10 @@ void vec_erase(void *vector, size_t index, void *elem);
  * @note Supply NULL for `elem` if you don't care about the erased value.
  * @note The capacity of vector remains the same (i.e. free is not called).
  */
-void vec_swap_erase(void *vector, size_t index, void *elem);
+#define vec_swap_erase(vector, index, elem)                                    \
+    do {                                                                       \
+        vector = internal_vec_swap_erase(vector, index, elem);                 \
+    } while(0)
 
 /**
  * @brief Removes the last element from the vector.
@@ -169,23 +277,63 @@ void vec_swap_erase(void *vector, size_t index, void *elem);
  * @note Supply NULL for `elem` if you don't care about the erased value.
  * @note The capacity of vector remains the same (i.e. free is not called).
  */
-void vec_pop_back(void *vector, void *elem);
+#define vec_pop_back(vector, elem)                                             \
+    do {                                                                       \
+        vector = internal_vec_pop_back(vector, elem);                          \
+    } while(0)
 
 /**
  * @brief Clears the vector, removing all elements.
  * @param vector The vector to clear.
  * @note The capacity of vector remains the same (i.e. free is not called).
  */
-void vec_clear(void *vector);
+#define vec_clear(vector)                                                      \
+    do {                                                                       \
+        vector = internal_vec_clear(vector);                                   \
+    } while(0)
 
 /**
  * @brief Frees the memory used by the vector.
  * @param vector The vector to free.
  * @note If the vector holds references to elements on the heap then
  * it is the user's responsibility to free those objects.
+ * @note If the vector is shared (see `vec_clone`) then only this reference
+ * is released, the memory is freed when the last reference is released.
  */
 void vec_free(void *vector);
 
+/**
+ * @brief Creates a copy-on-write clone of the vector in O(1).
+ * @param vector The vector.
+ * @return The clone, it shares its elements with `vector` until either
+ * of them is modified.
+ * @note The first modification through a vec_* function, e.g.
+ * `vec_push_back`, `vec_insert` or `vec_erase`, copies the elements of the
+ * modified vector, this is why all modifying functions reassign `vector`.
+ * @note Writing directly to elements, e.g. `vec[0] = 1` or through a view,
+ * is not tracked. Call `vec_make_unique` first to write to a shared vector.
+ * @note The clone must be freed with `vec_free` like any other vector.
+ * Clones may be used and freed from different threads.
+ */
+void *vec_clone(void *vector);
+
+/**
+ * @brief Makes sure the vector does not share its elements with a clone,
+ * copying them if needed.
+ * @param vector The vector.
+ */
+#define vec_make_unique(vector)                                                \
+    do {                                                                       \
+        vector = internal_vec_make_unique(vector);                             \
+    } while(0)
+
+/**
+ * @brief Checks if the vector shares its elements with a clone.
+ * @param vector The vector.
+ * @return `true` if the vector is shared, `false` otherwise.
+ */
+bool vec_is_shared(const void *vector);
+
 /**
  * @brief Reserves capacity for the vector, ensuring it can hold at least
  * the specified number of elements.
@@ -206,14 +354,20 @@ void *vec_shrink(void *vector);
  * @brief Reverses the order of elements in the vector in place.
  * @param vector The vector to reverse.
  */
-void vec_reverse(void *vector);
+#define vec_reverse(vector)                                                    \
+    do {                                                                       \
+        vector = internal_vec_reverse(vector);                                 \
+    } while(0)
 
 /**
  * @brief Sorts the elements of a vector using a custom comparison function.
  * @param vector The vector to sort.
  * @param c The custom comparison function used to compare elements.
  */
-void vec_sort(void *vector, compare_fn compare);
+#define vec_sort(vector, compare)                                              \
+    do {                                                                       \
+        vector = internal_vec_sort(vector, compare);                           \
+    } while(0)
 
 /**
  * @brief Creates an iterator for the vector.
@@ -256,6 +410,19 @@ typedef struct {
     size_t end;
 } VecSliceArgs;
 
+/**
+ * @brief Represents optional arguments for heap operations on a vector.
+ * @note Examples of how to use this struct:
+ * @note `vec_heapify(vec, compare);`
+ * @note `vec_heapify(vec, compare, .arity = 4);`
+ * @note `vec_heap_push(vec, 10, compare, .arity = 4);`
+ * @note `vec_heap_pop(vec, &elem, compare, .arity = 4);`
+ */
+typedef struct {
+    /** The number of children of each node, must be >= 2 */
+    size_t arity;
+} VecHeapArgs;
+
 /*------------------------ Internal Helper Functions ------------------------*/
 
 /**
@@ -268,6 +435,35 @@ typedef struct {
  */
 void *internal_vec_new(size_t elem_size, VecArgs args, size_t size);
 
+/**
+ * @brief Internal function to create a vector in memory provided by the
+ * caller, for vectors whose storage is managed by a custom allocator.
+ * @param memory The memory, `internal_vec_meta_size()` bytes for the
+ * metadata followed by room for `capacity` elements.
+ * @param elem_size The size of an element of the vector.
+ * @param size The number of elements already in the memory.
+ * @param capacity The capacity of the vector.
+ * @param alloc The allocator that reallocates and deallocates `memory`.
+ * @return The vector, its elements start right after the metadata.
+ */
+void *internal_vec_place(void *memory, size_t elem_size, size_t size, size_t capacity, Allocator alloc);
+
+/**
+ * @brief Internal function to get the size of the metadata stored before
+ * the elements of a vector.
+ * @return The size of the metadata.
+ */
+size_t internal_vec_meta_size(void);
+
+/**
+ * @brief Internal function to create a new vector from an iterator.
+ * @param iterator The iterator.
+ * @param elem_size The size of an element of the iterator.
+ * @param args The capacity and allocator for the vector.
+ * @return The new vector.
+ */
+void *internal_iter_collect(Iterator *iterator, size_t elem_size, VecArgs args);
+
 /**
  * @brief Creates a slice of the vector.
  * @param vector The vector.
@@ -277,6 +473,14 @@ void *internal_vec_new(size_t elem_size, VecArgs args, size_t size);
  */
 size_t internal_vec_slice(const void *vector, void *buffer, VecSliceArgs args);
 
+/**
+ * @brief Creates a view of a range of the vector.
+ * @param vector The vector.
+ * @param args The start and end indices of the view.
+ * @return The view.
+ */
+View internal_vec_view(void *vector, VecSliceArgs args);
+
 /**
  * @brief Internal function to insert an element into the vector at the
  * specified index.
@@ -305,5 +509,96 @@ void *internal_vec_push_back(void *vector, const void *elem);
  */
 void *internal_vec_extend(void *vector, const void *array, size_t size);
 
+/**
+ * @brief Internal function to erase an element at the specified index.
+ * @param vector The vector.
+ * @param index The index of the element to erase.
+ * @param elem A pointer to store the erased element.
+ * @return The vector without the erased element.
+ */
+void *internal_vec_erase(void *vector, size_t index, void *elem);
+
+/**
+ * @brief Internal function to erase an element at the specified index by
+ * swapping it with the last element.
+ * @param vector The vector.
+ * @param index The index of the element to erase.
+ * @param elem A pointer to store the erased element.
+ * @return The vector without the erased element.
+ */
+void *internal_vec_swap_erase(void *vector, size_t index, void *elem);
+
+/**
+ * @brief Internal function to remove the last element from the vector.
+ * @param vector The vector.
+ * @param elem A pointer to store the popped element.
+ * @return The vector without the popped element.
+ */
+void *internal_vec_pop_back(void *vector, void *elem);
+
+/**
+ * @brief Internal function to clear the vector.
+ * @param vector The vector.
+ * @return The cleared vector.
+ */
+void *internal_vec_clear(void *vector);
+
+/**
+ * @brief Internal function to reverse the order of elements in the vector.
+ * @param vector The vector.
+ * @return The reversed vector.
+ */
+void *internal_vec_reverse(void *vector);
+
+/**
+ * @brief Internal function to sort the elements of the vector.
+ * @param vector The vector.
+ * @param compare The comparison function used to compare elements.
+ * @return The sorted vector.
+ */
+void *internal_vec_sort(void *vector, compare_fn compare);
+
+/**
+ * @brief Internal function to copy the elements of a shared vector so that
+ * it no longer shares them.
+ * @param vector The vector.
+ * @return The vector, it is a new pointer if the elements were copied.
+ */
+void *internal_vec_make_unique(void *vector);
+
+/**
+ * @brief Internal function to rearrange the elements of the vector
+ * into a heap.
+ * @param vector The vector.
+ * @param compare The comparison function used to order the heap.
+ * @param args The arity of the heap.
+ * @return The vector arranged as a heap.
+ */
+void *internal_vec_heapify(void *vector, compare_fn compare, VecHeapArgs args);
+
+/**
+ * @brief Internal function to push an element onto a heap stored in
+ * the vector.
+ * @param vector The vector.
+ * @param elem A pointer to the element to push.
+ * @param compare The comparison function used to order the heap.
+ * @param args The arity of the heap.
+ * @return The vector with the pushed element.
+ */
+void *internal_vec_heap_push(void *vector, const void *elem,
+                             compare_fn compare, VecHeapArgs args);
+
+/**
+ * @brief Internal function to remove the smallest element from a heap
+ * stored in the vector.
+ * @param vector The vector.
+ * @param elem A pointer to store the removed element.
+ * @param compare The comparison function used to order the heap.
+ * @param args The arity of the heap.
+ * @return The vector without the removed element.
+ */
+void *internal_vec_heap_pop(void *vector, void *elem, compare_fn compare,
+                            VecHeapArgs args);
+
 
 #endif // VECTOR_H
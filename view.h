@@ -0,0 +1,110 @@
+/**
+ * @file view.h
+ * @brief Definition and functions for non owning views over contiguous
+ * elements.
+ */
+
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <stddef.h>
+
+#include "base.h"
+#include "iterator.h"
+
+/**
+ * @struct View
+ * @brief Represents a non owning view over contiguous elements, such as a
+ * range of a vector or an array.
+ * @note A view does not copy the elements, so it is only valid for as long
+ * as the memory it points to, e.g. until the vector is resized or freed.
+ */
+typedef struct {
+    /** A pointer to the first element of the view */
+    void *data;
+
+    /** The number of elements in the view */
+    size_t size;
+
+    /** The size of an element of the view */
+    size_t elem_size;
+} View;
+
+/**
+ * @brief Creates a view over an array.
+ * @param array The array.
+ * @param size The number of elements in the array.
+ * @return The view.
+ */
+#define view_from_array(array, size)                                           \
+    view_new(array, size, sizeof(array[0]))
+
+/**
+ * @brief Returns a typed pointer to the element at the specified index.
+ * @param view The view.
+ * @param type The type of the elements of the view.
+ * @param index The index of the element.
+ * @return A pointer to the element.
+ */
+#define view_at(view, type, index)                                             \
+    ((type *) view_get(view, index))
+
+/**
+ * @brief Creates a view over contiguous elements.
+ * @param data A pointer to the first element.
+ * @param size The number of elements.
+ * @param elem_size The size of an element.
+ * @return The view.
+ */
+View view_new(void *data, size_t size, size_t elem_size);
+
+/**
+ * @brief Returns a pointer to the element at the specified index.
+ * @param view The view.
+ * @param index The index of the element.
+ * @return A pointer to the element.
+ */
+void *view_get(View view, size_t index);
+
+/**
+ * @brief Creates a view over a range of another view.
+ * @param view The view.
+ * @param start The start index of the range, inclusive.
+ * @param end The end index of the range, exclusive.
+ * @return The view over the range.
+ */
+View view_subview(View view, size_t start, size_t end);
+
+/**
+ * @brief Reverses the order of the elements of the view in place.
+ * @param view The view.
+ */
+void view_reverse(View view);
+
+/**
+ * @brief Sorts the elements of the view in place using a custom
+ * comparison function.
+ * @param view The view.
+ * @param compare The custom comparison function used to compare elements.
+ */
+void view_sort(View view, compare_fn compare);
+
+/**
+ * @brief Searches a sorted view for an element.
+ * @param view The view, sorted with respect to `compare`.
+ * @param key A pointer to the element to search for.
+ * @param compare The comparison function the view is sorted by.
+ * @return An Option holding a pointer to a matching element, None if
+ * there is no match.
+ */
+Option view_binary_search(View view, const void *key, compare_fn compare);
+
+/**
+ * @brief Creates an iterator for the view.
+ * @param view The view, it must outlive the iterator.
+ * @return An iterator for the view.
+ */
+Iterator view_iter(View *view);
+
+
+#endif // VIEW_H